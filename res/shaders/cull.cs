@@ -0,0 +1,142 @@
+#version 420 core
+// Frustum and Hi-Z occlusion culls the multi draw candidates and compacts the draws of the ones that survive
+// into the indirect command buffer. Every candidate's draw goes into its batch's range of the buffer,
+// the commands the survivors don't take up are left zeroed by the clear before the dispatch so that they draw nothing
+
+#extension GL_ARB_compute_shader : require
+#extension GL_ARB_shader_storage_buffer_object : require
+
+layout(local_size_x = 64) in;
+
+#define CULL_STATE_VISIBLE 0u
+#define CULL_STATE_FRUSTUM_CULLED 1u
+#define CULL_STATE_OCCLUDED 2u
+// The counters start with how many candidates ended up in each of the states, followed by one per batch
+#define NUM_OF_STAT_COUNTERS 3u
+
+struct CullCandidate
+{
+    vec4 boundsMin;
+    vec4 boundsMax;
+    uint count;
+    uint first;
+    uint instance;
+    // Where the candidate's batch starts in the command buffer and which counter compacts it
+    uint outputBase;
+    uint counter;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+struct DrawArraysIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+
+layout(std430, binding = 1) writeonly buffer CullStates
+{
+    uint cullStates[];
+};
+layout(std430, binding = 2) readonly buffer Candidates
+{
+    CullCandidate candidates[];
+};
+layout(std430, binding = 3) writeonly buffer Commands
+{
+    DrawArraysIndirectCommand commands[];
+};
+layout(std430, binding = 4) buffer Counters
+{
+    uint counters[];
+};
+
+uniform vec4 u_FrustumPlanes[6];
+// The view projection the depth pyramid was rendered with
+uniform mat4 u_OcclusionViewProjection;
+uniform sampler2D u_DepthPyramid;
+uniform int u_NumOfPyramidLevels;
+uniform uint u_NumOfCandidates;
+uniform bool u_OcclusionCulling;
+// Writes the draws of the culled candidates as well, so they can be shown instead of skipped
+uniform bool u_DrawCulled;
+
+bool IsInsideFrustum(vec3 boxMin, vec3 boxMax)
+{
+    for(int i = 0; i < 6; i++)
+    {
+        // The corner furthest along the normal is the last one to leave the plane's inside
+        vec4 plane = u_FrustumPlanes[i];
+        vec3 furthest = mix(boxMin, boxMax, greaterThanEqual(plane.xyz, vec3(0.0)));
+        if(dot(plane.xyz, furthest) + plane.w < 0.0)
+            return false;
+    }
+    return true;
+}
+
+bool IsOccluded(vec3 boxMin, vec3 boxMax)
+{
+    vec2 minUV = vec2(1.0);
+    vec2 maxUV = vec2(0.0);
+    float nearestDepth = 1.0;
+    for(int i = 0; i < 8; i++)
+    {
+        vec3 corner = vec3((i & 1) != 0 ? boxMax.x : boxMin.x, (i & 2) != 0 ? boxMax.y : boxMin.y, (i & 4) != 0 ? boxMax.z : boxMin.z);
+        vec4 clip = u_OcclusionViewProjection * vec4(corner, 1.0);
+        // Part of the box is behind the camera, its projection can't be trusted
+        if(clip.w <= 0.0)
+            return false;
+
+        vec3 ndc = clip.xyz / clip.w;
+        minUV = min(minUV, ndc.xy * 0.5 + 0.5);
+        maxUV = max(maxUV, ndc.xy * 0.5 + 0.5);
+        nearestDepth = min(nearestDepth, ndc.z * 0.5 + 0.5);
+    }
+    minUV = clamp(minUV, vec2(0.0), vec2(1.0));
+    maxUV = clamp(maxUV, vec2(0.0), vec2(1.0));
+
+    // Pick the level where the box covers at most 2x2 texels, so 4 fetches cover all of it
+    vec2 extent = (maxUV - minUV) * vec2(textureSize(u_DepthPyramid, 0));
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, u_NumOfPyramidLevels - 1);
+    ivec2 levelSize = textureSize(u_DepthPyramid, level);
+    ivec2 minTexel = clamp(ivec2(minUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 maxTexel = clamp(ivec2(maxUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+    // Rounding down the sizes of odd levels can make the box straddle 3 texels, one level up it's back to 2
+    if(any(greaterThan(maxTexel - minTexel, ivec2(1))) && level < u_NumOfPyramidLevels - 1)
+    {
+        level++;
+        levelSize = textureSize(u_DepthPyramid, level);
+        minTexel = clamp(ivec2(minUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+        maxTexel = clamp(ivec2(maxUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+    }
+
+    float farthestDepth = max(
+        max(texelFetch(u_DepthPyramid, minTexel, level).r, texelFetch(u_DepthPyramid, ivec2(maxTexel.x, minTexel.y), level).r),
+        max(texelFetch(u_DepthPyramid, ivec2(minTexel.x, maxTexel.y), level).r, texelFetch(u_DepthPyramid, maxTexel, level).r));
+    return nearestDepth > farthestDepth;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+    if(index >= u_NumOfCandidates)
+        return;
+
+    CullCandidate candidate = candidates[index];
+    uint cullState = CULL_STATE_VISIBLE;
+    if(!IsInsideFrustum(candidate.boundsMin.xyz, candidate.boundsMax.xyz))
+        cullState = CULL_STATE_FRUSTUM_CULLED;
+    else if(u_OcclusionCulling && IsOccluded(candidate.boundsMin.xyz, candidate.boundsMax.xyz))
+        cullState = CULL_STATE_OCCLUDED;
+
+    atomicAdd(counters[cullState], 1u);
+    cullStates[candidate.instance] = cullState;
+    if(cullState != CULL_STATE_VISIBLE && !u_DrawCulled)
+        return;
+
+    uint slot = atomicAdd(counters[NUM_OF_STAT_COUNTERS + candidate.counter], 1u);
+    commands[candidate.outputBase + slot] = DrawArraysIndirectCommand(candidate.count, 1u, candidate.first, candidate.instance);
+}
@@ -1,10 +1,3 @@
 #version 420 core
 
-out vec4 o_FragColor;
-
-uniform vec4 u_Color = vec4(1.0);
-
-void main()
-{
-    o_FragColor = u_Color;
-}
\ No newline at end of file
+#include "include/standard.frag.glsl"
\ No newline at end of file
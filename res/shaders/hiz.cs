@@ -0,0 +1,32 @@
+#version 420 core
+// Builds one level of the depth pyramid. Every texel holds the farthest depth of the 2x2 texels under it
+// in the level below, or in the depth buffer for the first level.
+// When the level below has an odd size, the last row and column take in the texels that would be left over as well
+
+#extension GL_ARB_compute_shader : require
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32f, binding = 0) writeonly uniform image2D u_Destination;
+uniform ivec2 u_DestinationSize;
+uniform sampler2D u_Source;
+uniform int u_SourceLevel;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if(any(greaterThanEqual(texel, u_DestinationSize)))
+        return;
+
+    ivec2 sourceSize = textureSize(u_Source, u_SourceLevel);
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1 + ivec2(equal(texel, u_DestinationSize - 1)) * (sourceSize & 1), sourceSize - 1);
+
+    float depth = 0.0;
+    for(int y = first.y; y <= last.y; y++)
+    {
+        for(int x = first.x; x <= last.x; x++)
+            depth = max(depth, texelFetch(u_Source, ivec2(x, y), u_SourceLevel).r);
+    }
+    imageStore(u_Destination, texel, vec4(depth));
+}
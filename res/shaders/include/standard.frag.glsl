@@ -0,0 +1,44 @@
+// Shared fragment stage of the built-in shaders
+// Features: LIT (Phong lighting), TEXTURED (multiplies the color by u_Tex),
+// MULTI_DRAW (tints the instances the GPU culling pass culled while they're being shown)
+
+out vec4 o_FragColor;
+
+#ifdef LIT
+in vec3 o_FragPos;
+in vec3 o_Normal;
+
+#include "lighting.glsl"
+#endif
+
+#ifdef TEXTURED
+in vec2 o_UV;
+
+uniform sampler2D u_Tex;
+#endif
+uniform vec4 u_Color = vec4(1.0);
+
+#ifdef MULTI_DRAW
+flat in uint o_CullState;
+#endif
+
+void main()
+{
+    vec4 color = u_Color;
+#ifdef TEXTURED
+    color *= texture(u_Tex, o_UV);
+#endif
+#ifdef LIT
+    color *= CalculatePhongLight(o_FragPos, normalize(o_Normal));
+#endif
+
+#ifdef MULTI_DRAW
+    // Red for frustum culled, blue for occluded
+    if(o_CullState == 1u)
+        color = mix(color, vec4(1.0, 0.1, 0.1, 1.0), 0.75);
+    else if(o_CullState == 2u)
+        color = mix(color, vec4(0.1, 0.3, 1.0, 1.0), 0.75);
+#endif
+
+    o_FragColor = color;
+}
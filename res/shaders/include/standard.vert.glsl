@@ -0,0 +1,96 @@
+// Shared vertex stage of the built-in shaders
+// Features: LIT (passes the world space position and normal on), TEXTURED (passes the UVs on),
+// INSTANCED (takes the model matrix from a per-instance attribute instead of a uniform),
+// MULTI_DRAW (takes the model matrix from a storage buffer, for multi draw indirect)
+
+#ifdef MULTI_DRAW
+#extension GL_ARB_shader_storage_buffer_object : require
+#endif
+
+#ifdef INSTANCED
+#define PER_INSTANCE_TRANSFORMS
+#endif
+#ifdef MULTI_DRAW
+#define PER_INSTANCE_TRANSFORMS
+#endif
+
+layout(location = 0) in vec3 a_Pos;
+#ifdef TEXTURED
+layout(location = 1) in vec2 a_UV;
+#endif
+#ifdef LIT
+layout(location = 2) in vec3 a_Normal;
+#endif
+#ifdef INSTANCED
+// Takes up locations 3 to 6, one per column
+layout(location = 3) in mat4 a_ModelMatrix;
+#endif
+#ifdef MULTI_DRAW
+// Advances once per instance and starts at the draw command's base instance,
+// which makes it the index of the instance's data across the whole multi draw
+layout(location = 7) in uint a_InstanceIndex;
+
+layout(std430, binding = 0) readonly buffer InstanceData
+{
+    mat4 instanceModelMatrices[];
+};
+// What the GPU culling pass decided for every instance, only bound while the culled instances are being shown
+layout(std430, binding = 1) readonly buffer InstanceCullStates
+{
+    uint instanceCullStates[];
+};
+uniform bool u_ShowCulledInstances = false;
+
+flat out uint o_CullState;
+#endif
+
+#ifdef LIT
+out vec3 o_FragPos;
+out vec3 o_Normal;
+#endif
+#ifdef TEXTURED
+out vec2 o_UV;
+#endif
+
+#ifdef PER_INSTANCE_TRANSFORMS
+// Written once per frame by the renderer, see FrameUniforms
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 u_ViewProjection;
+};
+#else
+#ifdef LIT
+uniform mat4 u_ModelMatrix = mat4(1.0);
+#endif
+uniform mat4 u_MVP = mat4(1.0);
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+    mat4 modelMatrix = a_ModelMatrix;
+#endif
+#ifdef MULTI_DRAW
+    mat4 modelMatrix = instanceModelMatrices[a_InstanceIndex];
+    o_CullState = u_ShowCulledInstances ? instanceCullStates[a_InstanceIndex] : 0u;
+#endif
+#ifndef PER_INSTANCE_TRANSFORMS
+#ifdef LIT
+    mat4 modelMatrix = u_ModelMatrix;
+#endif
+#endif
+
+#ifdef LIT
+    o_FragPos = vec3(modelMatrix * vec4(a_Pos, 1.0));
+    o_Normal = mat3(transpose(inverse(modelMatrix))) * a_Normal;
+#endif
+#ifdef TEXTURED
+    o_UV = a_UV;
+#endif
+
+#ifdef PER_INSTANCE_TRANSFORMS
+    gl_Position = u_ViewProjection * modelMatrix * vec4(a_Pos, 1.0);
+#else
+    gl_Position = u_MVP * vec4(a_Pos, 1.0);
+#endif
+}
@@ -1,12 +1,4 @@
 #version 420 core
 
-in vec2 UV;
-
-out vec4 o_FragColor;
-
-uniform sampler2D u_Tex;
-
-void main()
-{
-    o_FragColor = texture(u_Tex, UV);
-}
\ No newline at end of file
+#define TEXTURED
+#include "include/standard.frag.glsl"
\ No newline at end of file
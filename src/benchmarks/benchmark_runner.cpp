@@ -0,0 +1,198 @@
+#include "benchmark_runner.hpp"
+
+#include "core/log.hpp"
+#include "misc/utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unordered_map>
+
+static double GetMedian(std::vector<double> values)
+{
+    if(values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) * 0.5;
+}
+
+// Reads the number after "key": on a line written by SaveJSON
+static bool ReadJSONNumber(const std::string &line, const char *key, double &value)
+{
+    const std::string quotedKey = "\"" + std::string(key) + "\":";
+    const size_t start = line.find(quotedKey);
+    if(start == std::string::npos)
+        return false;
+
+    value = std::strtod(line.c_str() + start + quotedKey.size(), nullptr);
+    return true;
+}
+
+// Reads the string after "key": on a line written by SaveJSON. The benchmark names never need escaping
+static bool ReadJSONString(const std::string &line, const char *key, std::string &value)
+{
+    const std::string quotedKey = "\"" + std::string(key) + "\": \"";
+    const size_t start = line.find(quotedKey);
+    if(start == std::string::npos)
+        return false;
+
+    const size_t end = line.find('"', start + quotedKey.size());
+    if(end == std::string::npos)
+        return false;
+    value = line.substr(start + quotedKey.size(), end - start - quotedKey.size());
+    return true;
+}
+
+bool BenchmarkRunner::IsEnabled(const std::string &name) const
+{
+    return _settings.filter.empty() || name.find(_settings.filter) != std::string::npos;
+}
+
+bool BenchmarkRunner::Run(const std::string &name, unsigned int iterationsPerSample, const std::function<void()> &body,
+                          const std::function<void()> &setup, const std::function<void()> &teardown)
+{
+    if(!IsEnabled(name))
+        return false;
+
+    iterationsPerSample = std::max(iterationsPerSample, 1u);
+    std::vector<double> samples;
+    samples.reserve(_settings.numOfSamples);
+    for(unsigned int i = 0; i < _settings.numOfWarmupSamples + _settings.numOfSamples; i++)
+    {
+        if(setup)
+            setup();
+
+        const auto start = std::chrono::steady_clock::now();
+        for(unsigned int j = 0; j < iterationsPerSample; j++)
+            body();
+        const double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if(teardown)
+            teardown();
+        if(i >= _settings.numOfWarmupSamples)
+            samples.push_back(time);
+    }
+
+    AddResult(name, std::move(samples), iterationsPerSample);
+    return true;
+}
+
+void BenchmarkRunner::AddResult(const std::string &name, std::vector<double> samples, unsigned int iterationsPerSample)
+{
+    _results.push_back(ComputeResult(name, std::move(samples), iterationsPerSample));
+    PrintResult(_results.back());
+}
+
+bool BenchmarkRunner::SaveJSON(const std::string &path) const
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+    {
+        Log::LogError("Failed to open " + path + " for writing the benchmark results");
+        return false;
+    }
+
+    // Reported the same way as in the render counters dump
+#ifdef NDEBUG
+    const char *buildType = "release";
+#else
+    const char *buildType = "debug";
+#endif
+    file << "{\n";
+    file << "  \"build\": {\"type\": \"" << buildType << "\", \"glErrorCheckLevel\": " << GL_ERROR_CHECK_LEVEL << "},\n";
+    file << "  \"unit\": \"ms\",\n";
+    // One benchmark per line, which is what CompareWithBaseline reads them back as
+    file << "  \"benchmarks\": [\n";
+    for(size_t i = 0; i < _results.size(); i++)
+    {
+        const BenchmarkResult &result = _results[i];
+        char numbers[256];
+        snprintf(numbers, sizeof(numbers), "\"samples\": %u, \"iterationsPerSample\": %u, \"median\": %.6f, \"mad\": %.6f, \"min\": %.6f, \"max\": %.6f",
+                 result.numOfSamples, result.iterationsPerSample, result.median, result.mad, result.min, result.max);
+        file << "    {\"name\": " << ToJSONString(result.name) << ", " << numbers << (i + 1 < _results.size() ? "},\n" : "}\n");
+    }
+    file << "  ]\n";
+    file << "}\n";
+
+    printf("Benchmark results written to %s\n", path.c_str());
+    return true;
+}
+
+int BenchmarkRunner::CompareWithBaseline(const std::string &path, double threshold) const
+{
+    std::ifstream file(path);
+    if(!file.is_open())
+    {
+        Log::LogError("Failed to open the benchmark baseline " + path);
+        return -1;
+    }
+
+    std::unordered_map<std::string, BenchmarkResult> baseline;
+    std::string line;
+    while(std::getline(file, line))
+    {
+        BenchmarkResult result;
+        if(!ReadJSONString(line, "name", result.name) || !ReadJSONNumber(line, "median", result.median) || !ReadJSONNumber(line, "mad", result.mad))
+            continue;
+        baseline[result.name] = result;
+    }
+
+    int numOfRegressions = 0;
+    printf("\nCompared with %s (regression threshold %.1f%%):\n", path.c_str(), threshold * 100.0);
+    printf("%-48s %12s %12s %9s\n", "benchmark", "baseline ms", "current ms", "change");
+    for(const BenchmarkResult &result: _results)
+    {
+        const auto base = baseline.find(result.name);
+        if(base == baseline.end())
+        {
+            printf("%-48s %12s %12.4f %9s\n", result.name.c_str(), "-", result.median, "new");
+            continue;
+        }
+
+        const double difference = result.median - base->second.median;
+        const double change = base->second.median > 0.0 ? difference / base->second.median : 0.0;
+        const bool regressed = change > threshold && difference > 3.0 * std::max(result.mad, base->second.mad);
+        const bool improved = -change > threshold && -difference > 3.0 * std::max(result.mad, base->second.mad);
+        if(regressed)
+            numOfRegressions++;
+        printf("%-48s %12.4f %12.4f %+8.1f%%%s\n", result.name.c_str(), base->second.median, result.median, change * 100.0,
+               regressed ? "  SLOWER" : improved ? "  faster" : "");
+    }
+    printf("%d regression(s)\n", numOfRegressions);
+    return numOfRegressions;
+}
+
+BenchmarkResult BenchmarkRunner::ComputeResult(const std::string &name, std::vector<double> samples, unsigned int iterationsPerSample)
+{
+    BenchmarkResult result;
+    result.name = name;
+    result.numOfSamples = (unsigned int)samples.size();
+    result.iterationsPerSample = iterationsPerSample;
+    if(samples.empty())
+        return result;
+
+    for(double &sample: samples)
+        sample /= iterationsPerSample;
+
+    result.median = GetMedian(samples);
+    std::vector<double> deviations;
+    deviations.reserve(samples.size());
+    for(double sample: samples)
+        deviations.push_back(std::abs(sample - result.median));
+    result.mad = GetMedian(std::move(deviations));
+    result.min = *std::min_element(samples.begin(), samples.end());
+    result.max = *std::max_element(samples.begin(), samples.end());
+    return result;
+}
+
+void BenchmarkRunner::PrintResult(const BenchmarkResult &result)
+{
+    printf("%-48s median %10.4f ms  mad %8.4f ms  min %10.4f ms  max %10.4f ms  (%u x %u)\n", result.name.c_str(),
+           result.median, result.mad, result.min, result.max, result.numOfSamples, result.iterationsPerSample);
+    fflush(stdout);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+struct BenchmarkSettings final
+{
+    // Samples that are run and thrown away before the measured ones, to warm up the caches and the driver
+    unsigned int numOfWarmupSamples = 3;
+    unsigned int numOfSamples = 30;
+    // Only the benchmarks whose name contains this are run, all of them if it's empty
+    std::string filter;
+};
+
+struct BenchmarkResult final
+{
+    std::string name;
+    unsigned int numOfSamples = 0;
+    unsigned int iterationsPerSample = 0;
+    // Over the samples, in milliseconds per iteration
+    double median = 0.0;
+    // Median absolute deviation from the median, which unlike the standard deviation isn't thrown off by the odd slow sample
+    double mad = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+/*
+Times benchmarks as a number of samples of a few iterations each and keeps the median and MAD of the samples,
+which stay put between runs far better than the mean when the OS or the driver gets in the way every now and then.
+The results can be saved to a JSON file and compared against one saved earlier as a baseline.
+*/
+class BenchmarkRunner final
+{
+    private:
+    BenchmarkSettings _settings;
+    std::vector<BenchmarkResult> _results;
+
+    public:
+    explicit BenchmarkRunner(const BenchmarkSettings &settings): _settings(settings) {}
+
+    // Whether the benchmark of the given name passes the filter
+    bool IsEnabled(const std::string &name) const;
+    // Runs the body the given number of times per sample. The setup and teardown run around every sample and aren't timed.
+    // Returns false if the benchmark was filtered out
+    bool Run(const std::string &name, unsigned int iterationsPerSample, const std::function<void()> &body,
+             const std::function<void()> &setup = nullptr, const std::function<void()> &teardown = nullptr);
+    // Adds a result measured some other way, eg. by timing the frames of a render loop
+    void AddResult(const std::string &name, std::vector<double> samples, unsigned int iterationsPerSample = 1);
+
+    bool SaveJSON(const std::string &path) const;
+    // Compares the results with the ones in a file written by SaveJSON and logs the differences.
+    // A benchmark counts as regressed when its median got slower by more than the threshold (0.05 = 5%)
+    // and by more than 3 MADs, so that noisy benchmarks don't get flagged for their noise.
+    // Returns the number of regressed benchmarks, or -1 if the baseline couldn't be read
+    int CompareWithBaseline(const std::string &path, double threshold) const;
+
+    inline const std::vector<BenchmarkResult> &getResults() const { return _results; }
+
+    private:
+    static BenchmarkResult ComputeResult(const std::string &name, std::vector<double> samples, unsigned int iterationsPerSample);
+    static void PrintResult(const BenchmarkResult &result);
+};
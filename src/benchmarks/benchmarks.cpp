@@ -0,0 +1,502 @@
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_runner.hpp"
+#include "headless_context.hpp"
+#include "core/log.hpp"
+#include "core/resource_manager.hpp"
+#include "core/scene.hpp"
+#include "core/stress_scene.hpp"
+#include "core/job_system.hpp"
+#include "rendering/renderer.hpp"
+#include "rendering/frame_profiler.hpp"
+#include "rendering/shader.hpp"
+#include "rendering/shader_compiler.hpp"
+#include "rendering/shader_preprocessor.hpp"
+#include "rendering/gl_extensions.hpp"
+#include "rendering/texture.hpp"
+#include "rendering/model.hpp"
+
+static constexpr unsigned int WINDOW_WIDTH = 1280;
+static constexpr unsigned int WINDOW_HEIGHT = 720;
+// Frames drawn before a draw scene benchmark gets measured, which is also when the shader variants it needs get compiled
+static constexpr unsigned int DRAW_SCENE_WARMUP_FRAMES = 30;
+static constexpr unsigned int DRAW_SCENE_NUM_OF_RENDERABLES[] = { 100, 10000 };
+static constexpr unsigned int UPDATE_UNIFORMS_ITERATIONS = 1000;
+static constexpr unsigned int STRESS_SCENE_NUM_OF_OBJECTS[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+static constexpr unsigned int STRESS_SCENE_TRIANGLES_PER_MODEL = 128;
+// Fewer than for the draw scene benchmarks since the biggest scenes take a while per frame.
+// The materials are compiled while generating, only the per-instance variants are left for these
+static constexpr unsigned int STRESS_SCENE_WARMUP_FRAMES = 5;
+static constexpr unsigned int JOB_SYSTEM_NUM_OF_ITEMS = 1 << 20;
+static constexpr unsigned int JOB_SYSTEM_BATCH_SIZE = 1024;
+static constexpr unsigned int JOB_SYSTEM_NUM_OF_EMPTY_JOBS = 10000;
+
+struct BenchmarkOptions final
+{
+    BenchmarkSettings settings;
+    // Where the results get written to
+    std::string outPath = "benchmark_results.json";
+    // Results of an earlier run to compare with, nothing gets compared if it's empty
+    std::string baselinePath;
+    double threshold = 0.05;
+    // Relative to the working directory, same as the ModelViewer's. The renderer's own shaders are always loaded from ../../../res/
+    std::string resDirectory = "../../../res/";
+};
+
+static void PrintUsage()
+{
+    printf("Usage: ModelViewerBenchmarks [options]\n"
+           "  --filter <text>      only run the benchmarks whose name contains the text\n"
+           "  --samples <n>        measured samples per benchmark (default 30)\n"
+           "  --warmup <n>         samples run before the measured ones (default 3)\n"
+           "  --out <path>         where to write the results (default benchmark_results.json)\n"
+           "  --baseline <path>    results of an earlier run to compare with, exits with 1 on a regression\n"
+           "  --threshold <ratio>  how much slower a median can get before it counts as a regression (default 0.05)\n"
+           "  --res <path>         the res directory (default ../../../res/)\n");
+}
+
+static bool ParseOptions(int argc, char **argv, BenchmarkOptions &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+
+        const char *value = argv[++i];
+        if(arg == "--filter")
+            options.settings.filter = value;
+        else if(arg == "--samples")
+            options.settings.numOfSamples = std::max((unsigned int)std::strtoul(value, nullptr, 10), 1u);
+        else if(arg == "--warmup")
+            options.settings.numOfWarmupSamples = (unsigned int)std::strtoul(value, nullptr, 10);
+        else if(arg == "--out")
+            options.outPath = value;
+        else if(arg == "--baseline")
+            options.baselinePath = value;
+        else if(arg == "--threshold")
+            options.threshold = std::strtod(value, nullptr);
+        else if(arg == "--res")
+            options.resDirectory = std::string(value) + (value[0] != '\0' && value[std::strlen(value) - 1] != '/' ? "/" : "");
+        else
+            return false;
+    }
+    return true;
+}
+
+// The files in the directory with the given extension, sorted so that the benchmarks always run in the same order
+static std::vector<std::string> ListFiles(const std::string &directory, const std::string &extension)
+{
+    std::vector<std::string> files;
+    std::error_code error;
+    for(const auto &entry: std::filesystem::directory_iterator(directory, error))
+    {
+        if(entry.is_regular_file() && entry.path().extension() == extension)
+            files.push_back(entry.path().filename().string());
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+static void BenchmarkModels(BenchmarkRunner &runner, const std::string &resDirectory)
+{
+    const std::string directory = resDirectory + "models/";
+    for(const std::string &file: ListFiles(directory, ".obj"))
+    {
+        // Covers reading the file, parsing it, building the vertices and uploading them
+        Model *model = nullptr;
+        runner.Run("obj_load/" + file, 1,
+            [&]() { model = ResourceManager::getInstance().LoadModelFromOBJFile(directory + file); },
+            nullptr,
+            [&]()
+            {
+                ResourceManager::getInstance().UnloadModel(ResourceManager::ParseFileNameAndExtension(file).first);
+                delete model;
+                model = nullptr;
+            });
+    }
+}
+
+static void BenchmarkTextures(BenchmarkRunner &runner, const std::string &resDirectory)
+{
+    std::vector<std::string> paths;
+    for(const char *directory: { "textures/", "models/" })
+    {
+        for(const char *extension: { ".jpg", ".png" })
+        {
+            for(const std::string &file: ListFiles(resDirectory + directory, extension))
+                paths.push_back(resDirectory + directory + file);
+        }
+    }
+
+    // Tightly packed RGB rows aren't 4 byte aligned unless the width happens to be a multiple of 4
+    GL_CALL(glad_glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    for(const std::string &path: paths)
+    {
+        const std::string file = path.substr(resDirectory.size());
+        int width = 0, height = 0;
+        unsigned char *data = nullptr;
+        runner.Run("texture_decode/" + file, 1,
+            [&]() { data = stbi_load(path.c_str(), &width, &height, nullptr, 3); },
+            nullptr,
+            [&]()
+            {
+                stbi_image_free(data);
+                data = nullptr;
+            });
+
+        if(!runner.IsEnabled("texture_upload/" + file))
+            continue;
+        data = stbi_load(path.c_str(), &width, &height, nullptr, 3);
+        if(data == nullptr)
+        {
+            Log::LogError("Couldn't decode " + path);
+            continue;
+        }
+
+        // Waits for the upload to finish so that drivers that copy the data asynchronously don't get it for free
+        Texture *texture = nullptr;
+        runner.Run("texture_upload/" + file, 1,
+            [&]()
+            {
+                texture = new Texture(GL_TEXTURE_2D, glm::uvec2(width, height), GL_RGB, GL_RGB, (void*)data);
+                GL_CALL(glad_glFinish());
+            },
+            nullptr,
+            [&]()
+            {
+                delete texture;
+                texture = nullptr;
+            });
+        stbi_image_free(data);
+    }
+    GL_CALL(glad_glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+}
+
+static void BenchmarkShaders(BenchmarkRunner &runner, const std::string &resDirectory)
+{
+    const std::string directory = resDirectory + "shaders/";
+    for(const std::string &file: ListFiles(directory, ".vs"))
+    {
+        const std::string name = file.substr(0, file.size() - 3);
+        const std::string vertPath = directory + name + ".vs";
+        const std::string fragPath = directory + name + ".fs";
+        if(!std::filesystem::exists(fragPath))
+            continue;
+
+        PreprocessedShader vertShader, fragShader;
+        runner.Run("shader_preprocess/" + name, 10, [&]()
+        {
+            vertShader = ShaderPreprocessor::ProcessFile(vertPath);
+            fragShader = ShaderPreprocessor::ProcessFile(fragPath);
+        });
+
+        vertShader = ShaderPreprocessor::ProcessFile(vertPath);
+        fragShader = ShaderPreprocessor::ProcessFile(fragPath);
+        if(!vertShader.success || !fragShader.success)
+        {
+            Log::LogError("Couldn't preprocess shader '" + name + "'");
+            continue;
+        }
+
+        // Without the compiler's worker thread the shader gets compiled and linked right away on this thread,
+        // and waiting for it parses its uniforms and reads their defaults back
+        // Every sample's sources differ by a comment so that the driver's shader cache doesn't hand back the previous sample's program
+        unsigned int sample = 0;
+        std::string vertSource, fragSource;
+        Shader *shader = nullptr;
+        runner.Run("shader_compile/" + name, 1,
+            [&]()
+            {
+                shader = new Shader(vertSource.c_str(), fragSource.c_str());
+                ShaderCompiler::getInstance().WaitFor(shader);
+            },
+            [&]()
+            {
+                const std::string salt = "\n// benchmark sample " + std::to_string(sample++) + "\n";
+                vertSource = vertShader.source + salt;
+                fragSource = fragShader.source + salt;
+            },
+            [&]()
+            {
+                delete shader;
+                shader = nullptr;
+            });
+
+        if(!runner.IsEnabled("shader_update_uniforms/" + name))
+            continue;
+        shader = new Shader(vertShader.source.c_str(), fragShader.source.c_str());
+        ShaderCompiler::getInstance().WaitFor(shader);
+        if(!shader->isReady())
+        {
+            Log::LogError("Couldn't compile shader '" + name + "'");
+            delete shader;
+            continue;
+        }
+
+        // The program stays bound the whole time, which leaves uploading the uniform values
+        runner.Run("shader_update_uniforms/" + name, UPDATE_UNIFORMS_ITERATIONS, [&]() { shader->Bind(); });
+        delete shader;
+    }
+}
+
+static void DrawFrame()
+{
+    FrameProfiler::getInstance().BeginFrame();
+    Renderer::getInstance().BeginFrame();
+    ShaderCompiler::getInstance().Update();
+    Renderer::getInstance().DrawScene();
+    Renderer::getInstance().EndFrame();
+    FrameProfiler::getInstance().EndFrame();
+    // There's no swap to pace the frames, so every frame waits for the GPU to finish it instead
+    GL_CALL(glad_glFinish());
+}
+
+struct DrawMode final
+{
+    const char *name;
+    bool instancing;
+    bool multiDrawIndirect;
+};
+static const DrawMode DRAW_MODES[] = { { "individual", false, false }, { "instanced", true, false }, { "multi_draw", true, true } };
+
+static std::string GetDrawSceneName(unsigned int numOfRenderables, const DrawMode &mode)
+{
+    return "draw_scene/" + std::to_string(numOfRenderables) + "_" + mode.name;
+}
+
+static std::string GetStressSceneName(unsigned int numOfObjects, const char *what)
+{
+    return "stress_scene/" + std::to_string(numOfObjects) + "_" + what;
+}
+
+// Whether any of the benchmarks that need the renderer pass the filter
+static bool IsAnyRendererBenchmarkEnabled(const BenchmarkRunner &runner)
+{
+    for(unsigned int numOfRenderables: DRAW_SCENE_NUM_OF_RENDERABLES)
+    {
+        for(const DrawMode &mode: DRAW_MODES)
+        {
+            if(runner.IsEnabled(GetDrawSceneName(numOfRenderables, mode)))
+                return true;
+        }
+    }
+    for(unsigned int numOfObjects: STRESS_SCENE_NUM_OF_OBJECTS)
+    {
+        if(runner.IsEnabled(GetStressSceneName(numOfObjects, "generate")) || runner.IsEnabled(GetStressSceneName(numOfObjects, "frame")))
+            return true;
+    }
+    return false;
+}
+
+static bool InitRenderer(const std::string &resDirectory)
+{
+    ResourceManager &resourceManager = ResourceManager::getInstance();
+    Scene &scene = Scene::getInstance();
+    scene.shader = resourceManager.LoadShaderFromFiles(resDirectory + "shaders/default.vs", resDirectory + "shaders/default.fs");
+    ShaderCompiler::getInstance().WaitFor(scene.shader);
+    resourceManager.LoadTextureFromFile(resDirectory + "textures/tex_missing.jpg");
+    scene.model = resourceManager.LoadModelFromOBJFile(resDirectory + "models/axe.obj");
+    if(scene.shader == nullptr || !scene.shader->isReady() || scene.model == nullptr)
+    {
+        Log::LogError("Couldn't load the draw scene benchmark's resources");
+        return false;
+    }
+
+    Renderer::getInstance().Init();
+    FrameProfiler::getInstance().Init();
+
+    scene.camera.projection = glm::perspective(45.0f, (float)WINDOW_WIDTH/(float)WINDOW_HEIGHT, 0.1f, 100.0f);
+    scene.camera.position = glm::vec3(0.0f, 0.0f, -5.0f);
+    scene.camera.view = glm::translate(glm::mat4(1.0f), scene.camera.position);
+    return true;
+}
+
+static void DeInitRenderer()
+{
+    FrameProfiler::getInstance().DeInit();
+    Renderer::getInstance().DeInit();
+}
+
+static void BenchmarkDrawScene(BenchmarkRunner &runner)
+{
+    Renderer &renderer = Renderer::getInstance();
+    Scene &scene = Scene::getInstance();
+    const RendererSettings defaultSettings = renderer.settings;
+    for(unsigned int numOfRenderables: DRAW_SCENE_NUM_OF_RENDERABLES)
+    {
+        for(const DrawMode &mode: DRAW_MODES)
+        {
+            const std::string name = GetDrawSceneName(numOfRenderables, mode);
+            if(!runner.IsEnabled(name) || (mode.multiDrawIndirect && !GLExtensions::multiDrawIndirect))
+                continue;
+
+            renderer.settings = defaultSettings;
+            renderer.settings.instancing = mode.instancing;
+            renderer.settings.multiDrawIndirect = mode.multiDrawIndirect;
+
+            // The same grid of copies of the model the instancing benchmark draws, all of it in view
+            const unsigned int gridSize = (unsigned int)std::ceil(std::cbrt((float)numOfRenderables));
+            const float spacing = 2.5f / gridSize;
+            const glm::vec3 gridStart = glm::vec3(-1.25f + spacing * 0.5f);
+            scene.transforms.Reserve(numOfRenderables);
+            scene.renderables.reserve(numOfRenderables);
+            for(unsigned int i = 0; i < numOfRenderables; i++)
+            {
+                const glm::vec3 cell = glm::vec3(i % gridSize, (i / gridSize) % gridSize, i / (gridSize * gridSize));
+                const EntityID entity = scene.AddRenderable(nullptr, nullptr);
+                scene.transforms.SetPosition(entity, gridStart + cell * spacing);
+                scene.transforms.SetScale(entity, glm::vec3(spacing * 0.5f));
+            }
+
+            for(unsigned int i = 0; i < DRAW_SCENE_WARMUP_FRAMES; i++)
+                DrawFrame();
+            runner.Run(name, 1, DrawFrame);
+
+            scene.renderables.clear();
+            scene.transforms.Truncate(0);
+        }
+    }
+    renderer.settings = defaultSettings;
+}
+
+// How generating, memory and drawing scale with the number of objects, with the other stress scene settings left at their defaults
+static void BenchmarkStressScenes(BenchmarkRunner &runner)
+{
+    StressScene &stressScene = StressScene::getInstance();
+    for(unsigned int numOfObjects: STRESS_SCENE_NUM_OF_OBJECTS)
+    {
+        const std::string generateName = GetStressSceneName(numOfObjects, "generate");
+        const std::string frameName = GetStressSceneName(numOfObjects, "frame");
+        if(!runner.IsEnabled(generateName) && !runner.IsEnabled(frameName))
+            continue;
+
+        StressSceneSettings settings;
+        settings.numOfObjects = numOfObjects;
+        settings.trianglesPerModel = STRESS_SCENE_TRIANGLES_PER_MODEL;
+        if(!stressScene.Generate(settings))
+            return;
+
+        // Generating the bigger scenes takes seconds, so it's only timed once
+        const StressSceneStats &stats = stressScene.getStats();
+        if(runner.IsEnabled(generateName))
+            runner.AddResult(generateName, { stats.totalTime });
+        printf("%-48s %u objects, %llu triangles, %.1f MB of vertices, %.1f MB of textures, %.1f MB allocated on the CPU\n", "", stats.numOfObjects,
+               stats.numOfTriangles, stats.vertexBytes / (1024.0 * 1024.0), stats.textureBytes / (1024.0 * 1024.0), stats.allocatedBytes / (1024.0 * 1024.0));
+
+        if(runner.IsEnabled(frameName))
+        {
+            for(unsigned int i = 0; i < STRESS_SCENE_WARMUP_FRAMES; i++)
+                DrawFrame();
+            runner.Run(frameName, 1, DrawFrame);
+        }
+        stressScene.Clear();
+    }
+}
+
+// The worker counts the job system gets measured with, doubling from 1 up to one per core
+static std::vector<unsigned int> GetJobSystemWorkerCounts()
+{
+    const unsigned int numOfCores = std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<unsigned int> workerCounts;
+    for(unsigned int numOfWorkers = 1; numOfWorkers < numOfCores; numOfWorkers *= 2)
+        workerCounts.push_back(numOfWorkers);
+    workerCounts.push_back(numOfCores);
+    return workerCounts;
+}
+
+// How a compute-bound parallel for and the overhead of scheduling jobs scale from 1 worker up to one per core
+static void BenchmarkJobSystem(BenchmarkRunner &runner)
+{
+    JobSystem &jobSystem = JobSystem::getInstance();
+    std::vector<float> results(JOB_SYSTEM_NUM_OF_ITEMS);
+    for(unsigned int numOfWorkers: GetJobSystemWorkerCounts())
+    {
+        const std::string parallelForName = "job_system/parallel_for/" + std::to_string(numOfWorkers) + "_workers";
+        const std::string emptyJobsName = "job_system/empty_jobs/" + std::to_string(numOfWorkers) + "_workers";
+        if(!runner.IsEnabled(parallelForName) && !runner.IsEnabled(emptyJobsName))
+            continue;
+
+        // The calling thread is a worker too, so the run with 1 worker spawns no threads and runs every job inline
+        jobSystem.Init(numOfWorkers - 1);
+        runner.Run(parallelForName, 1, [&]()
+        {
+            jobSystem.ParallelFor("Benchmark batch", 0, JOB_SYSTEM_NUM_OF_ITEMS, JOB_SYSTEM_BATCH_SIZE, [&](unsigned int begin, unsigned int end)
+            {
+                for(unsigned int i = begin; i < end; i++)
+                {
+                    float value = (float)i;
+                    for(unsigned int j = 0; j < 16; j++)
+                        value = std::sqrt(value * 1.0001f + 1.0f) + std::sin(value);
+                    results[i] = value;
+                }
+            });
+        });
+        runner.Run(emptyJobsName, 1, [&]()
+        {
+            JobCounter counter;
+            for(unsigned int i = 0; i < JOB_SYSTEM_NUM_OF_EMPTY_JOBS; i++)
+                jobSystem.Run("Benchmark empty job", []{}, &counter);
+            jobSystem.Wait(counter);
+        });
+    }
+    // Back to the workers everything else runs with
+    jobSystem.Init();
+}
+
+int main(int argc, char **argv)
+{
+    // The resource manager logs every load, which would drown out the results
+    Log::SetLogLevelFilter(LogLevel::Warning);
+
+    BenchmarkOptions options;
+    if(!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    // The window is never shown and nothing gets presented
+    if(!HeadlessContext::Init(WINDOW_WIDTH, WINDOW_HEIGHT, false))
+        return -1;
+    // The shader compiler is left without its worker thread on purpose so that compiles happen where they get timed
+    JobSystem::getInstance().Init();
+
+    printf("GL %s, %s\n", (const char*)glad_glGetString(GL_VERSION), (const char*)glad_glGetString(GL_RENDERER));
+    BenchmarkRunner runner(options.settings);
+    BenchmarkModels(runner, options.resDirectory);
+    BenchmarkTextures(runner, options.resDirectory);
+    BenchmarkShaders(runner, options.resDirectory);
+    BenchmarkJobSystem(runner);
+    if(IsAnyRendererBenchmarkEnabled(runner) && InitRenderer(options.resDirectory))
+    {
+        BenchmarkDrawScene(runner);
+        BenchmarkStressScenes(runner);
+        DeInitRenderer();
+    }
+
+    int exitCode = 0;
+    if(!runner.SaveJSON(options.outPath))
+        exitCode = 1;
+    if(!options.baselinePath.empty() && runner.CompareWithBaseline(options.baselinePath, options.threshold) != 0)
+        exitCode = 1;
+
+    JobSystem::getInstance().DeInit();
+    HeadlessContext::DeInit();
+    return exitCode;
+}
@@ -0,0 +1,940 @@
+#include <glad/glad.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "benchmark_runner.hpp"
+#include "headless_context.hpp"
+#include "core/log.hpp"
+#include "rendering/gl_extensions.hpp"
+#include "rendering/gl_trace.hpp"
+
+static constexpr size_t NUM_OF_SLOWEST_CALLS = 20;
+
+struct ReplayOptions final
+{
+    std::string tracePath;
+    unsigned int numOfLoops = 10;
+    bool surfaceless = true;
+    std::string outPath = "replay_results.json";
+    std::string baselinePath;
+    double threshold = 0.05;
+    // Window call indices whose draws, dispatches, clears and copies get left out, to bisect which of them cost the most
+    size_t firstSkippedCall = SIZE_MAX;
+    size_t lastSkippedCall = 0;
+    bool perCall = false;
+    bool list = false;
+    std::string imagePath;
+};
+
+struct LoadedTrace final
+{
+    // The payloads of the calls point into it
+    std::vector<unsigned char> data;
+    GLTraceHeader header;
+    std::vector<GLTraceCall> calls;
+    size_t windowStart = SIZE_MAX;
+    size_t restoreEnd = SIZE_MAX;
+    // One past the last complete frame's FrameEnd
+    size_t framesEnd = 0;
+    unsigned int numOfFrames = 0;
+};
+
+static void PrintUsage()
+{
+    printf("Usage: ModelViewerReplay <trace> [options]\n"
+           "  --loops <n>              how many times to replay the captured frames (default 10)\n"
+           "  --out <file>             where to write the results (default replay_results.json)\n"
+           "  --baseline <file>        results of an earlier run to compare against\n"
+           "  --threshold <r>          how much slower than the baseline counts as a regression (default 0.05)\n"
+           "  --skip <first>-<last>    leave out the draws, dispatches, clears and copies in that range of window call indices\n"
+           "  --per-call               time every call of the frames on its own and list the slowest ones\n"
+           "  --image <png>            save what the last frame drew\n"
+           "  --list                   print the calls in the trace and exit\n"
+           "  --window                 run on a hidden window instead of a surfaceless context\n");
+}
+
+static bool ParseOptions(int argc, char **argv, ReplayOptions &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--window")
+        {
+            options.surfaceless = false;
+            continue;
+        }
+        if(arg == "--per-call")
+        {
+            options.perCall = true;
+            continue;
+        }
+        if(arg == "--list")
+        {
+            options.list = true;
+            continue;
+        }
+        if(arg == "--help" || arg == "-h")
+            return false;
+        if(arg[0] != '-')
+        {
+            options.tracePath = arg;
+            continue;
+        }
+        if(i + 1 >= argc)
+            return false;
+
+        const char *value = argv[++i];
+        if(arg == "--loops")
+            options.numOfLoops = std::max((unsigned int)std::strtoul(value, nullptr, 10), 1u);
+        else if(arg == "--out")
+            options.outPath = value;
+        else if(arg == "--baseline")
+            options.baselinePath = value;
+        else if(arg == "--threshold")
+            options.threshold = std::strtod(value, nullptr);
+        else if(arg == "--skip")
+        {
+            char *last = nullptr;
+            options.firstSkippedCall = (size_t)std::strtoull(value, &last, 10);
+            options.lastSkippedCall = *last == '-' ? (size_t)std::strtoull(last + 1, nullptr, 10) : options.firstSkippedCall;
+        }
+        else if(arg == "--image")
+            options.imagePath = value;
+        else
+            return false;
+    }
+    return !options.tracePath.empty();
+}
+
+static bool LoadTrace(const std::string &path, LoadedTrace &trace)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if(!file.is_open())
+    {
+        Log::LogError("Couldn't open " + path);
+        return false;
+    }
+    trace.data.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read((char*)trace.data.data(), trace.data.size());
+
+    const unsigned char *cursor = trace.data.data();
+    const unsigned char *end = cursor + trace.data.size();
+    if(!GLTrace::ReadHeader(cursor, end, trace.header))
+    {
+        Log::LogError(path + " isn't a version " + std::to_string(GLTrace::VERSION) + " GL trace");
+        return false;
+    }
+
+    GLTraceCall call;
+    while(cursor != end)
+    {
+        if(!GLTrace::ReadCall(cursor, end, call))
+        {
+            Log::LogWarning(path + " is cut off after " + std::to_string(trace.calls.size()) + " calls");
+            break;
+        }
+        if(call.op == GLTraceOp::WindowStart)
+            trace.windowStart = trace.calls.size();
+        else if(call.op == GLTraceOp::RestoreEnd)
+            trace.restoreEnd = trace.calls.size();
+        else if(call.op == GLTraceOp::FrameEnd)
+        {
+            trace.numOfFrames++;
+            trace.framesEnd = trace.calls.size() + 1;
+        }
+        trace.calls.push_back(std::move(call));
+    }
+
+    if(trace.windowStart == SIZE_MAX || trace.restoreEnd == SIZE_MAX || trace.numOfFrames == 0)
+    {
+        Log::LogError(path + " doesn't have any captured frames");
+        return false;
+    }
+    return true;
+}
+
+static void ListTrace(const LoadedTrace &trace)
+{
+    printf("%ux%u, captured on %s, %s\n", trace.header.width, trace.header.height, trace.header.renderer.c_str(), trace.header.version.c_str());
+    for(size_t i = 0; i < trace.calls.size(); i++)
+    {
+        const GLTraceCall &call = trace.calls[i];
+        if(i == trace.restoreEnd + 1)
+            printf("--- frames, the window call indices start here\n");
+
+        printf("%8zu  %s(", i, GLTrace::GetOpInfo(call.op).name);
+        for(size_t j = 0; j < call.values.size(); j++)
+            printf(j == 0 ? "%llu" : ", %llu", (unsigned long long)call.values[j]);
+        for(size_t j = 0; j < call.payloads.size(); j++)
+        {
+            if(call.op == GLTraceOp::BeginMarker)
+                printf("\"%.*s\"", (int)call.payloads[j].size, (const char*)call.payloads[j].data);
+            else
+                printf(call.values.empty() && j == 0 ? "<%zu bytes>" : ", <%zu bytes>", call.payloads[j].size);
+        }
+        printf(")\n");
+
+        if(call.op == GLTraceOp::WindowStart)
+            printf("--- the state the frames start from\n");
+    }
+}
+
+// The calls --skip leaves out, the ones that make the GPU do work without changing any state the calls after them depend on
+static bool IsSkippable(GLTraceOp op)
+{
+    switch(op)
+    {
+        case GLTraceOp::Clear:
+        case GLTraceOp::CopyBufferSubData:
+        case GLTraceOp::CopyTexSubImage2D:
+        case GLTraceOp::DispatchCompute:
+        case GLTraceOp::DrawArrays:
+        case GLTraceOp::DrawArraysInstancedBaseInstance:
+        case GLTraceOp::DrawElements:
+        case GLTraceOp::MultiDrawArraysIndirect:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static GLTraceArg GetObjectKind(GLTraceOp op)
+{
+    switch(op)
+    {
+        case GLTraceOp::GenBuffers: case GLTraceOp::DeleteBuffers: return GLTraceArg::BUFFER;
+        case GLTraceOp::GenTextures: case GLTraceOp::DeleteTextures: return GLTraceArg::TEXTURE;
+        case GLTraceOp::GenVertexArrays: case GLTraceOp::DeleteVertexArrays: return GLTraceArg::VERTEX_ARRAY;
+        case GLTraceOp::GenFramebuffers: case GLTraceOp::DeleteFramebuffers: return GLTraceArg::FRAMEBUFFER;
+        case GLTraceOp::GenRenderbuffers: case GLTraceOp::DeleteRenderbuffers: return GLTraceArg::RENDERBUFFER;
+        case GLTraceOp::GenQueries: case GLTraceOp::DeleteQueries: return GLTraceArg::QUERY;
+        case GLTraceOp::DeleteProgram: return GLTraceArg::PROGRAM;
+        case GLTraceOp::DeleteShader: return GLTraceArg::SHADER;
+        default: return GLTraceArg::NONE;
+    }
+}
+
+static GLuint GenObject(GLTraceArg kind)
+{
+    GLuint name = 0;
+    switch(kind)
+    {
+        case GLTraceArg::BUFFER: GL_CALL(glad_glGenBuffers(1, &name)); break;
+        case GLTraceArg::TEXTURE: GL_CALL(glad_glGenTextures(1, &name)); break;
+        case GLTraceArg::VERTEX_ARRAY: GL_CALL(glad_glGenVertexArrays(1, &name)); break;
+        case GLTraceArg::FRAMEBUFFER: GL_CALL(glad_glGenFramebuffers(1, &name)); break;
+        case GLTraceArg::RENDERBUFFER: GL_CALL(glad_glGenRenderbuffers(1, &name)); break;
+        case GLTraceArg::QUERY: GL_CALL(glad_glGenQueries(1, &name)); break;
+        default: break;
+    }
+    return name;
+}
+
+static void DeleteObject(GLTraceArg kind, GLuint name)
+{
+    switch(kind)
+    {
+        case GLTraceArg::BUFFER: GL_CALL(glad_glDeleteBuffers(1, &name)); break;
+        case GLTraceArg::TEXTURE: GL_CALL(glad_glDeleteTextures(1, &name)); break;
+        case GLTraceArg::VERTEX_ARRAY: GL_CALL(glad_glDeleteVertexArrays(1, &name)); break;
+        case GLTraceArg::FRAMEBUFFER: GL_CALL(glad_glDeleteFramebuffers(1, &name)); break;
+        case GLTraceArg::RENDERBUFFER: GL_CALL(glad_glDeleteRenderbuffers(1, &name)); break;
+        case GLTraceArg::QUERY: GL_CALL(glad_glDeleteQueries(1, &name)); break;
+        case GLTraceArg::PROGRAM: GL_CALL(glad_glDeleteProgram(name)); break;
+        case GLTraceArg::SHADER: GL_CALL(glad_glDeleteShader(name)); break;
+        default: break;
+    }
+}
+
+/*
+Plays the calls of a trace back, translating the names of the objects, the uniform locations and the syncs
+the captured run got into the ones the replay gets.
+Everything made before the window is kept for every loop, everything made during it is deleted after every loop,
+so that every loop starts from the same objects.
+*/
+class GLReplayer final
+{
+    private:
+    struct Mapping final
+    {
+        unsigned char *data;
+        // Where in the buffer the mapping starts
+        size_t offset;
+    };
+
+    // Captured name -> name in the replay, per kind of object
+    std::unordered_map<uint64_t, GLuint> _names[NUM_OF_GL_OBJECT_TYPES];
+    // (captured program, captured location) -> location in the replay
+    std::map<std::pair<uint64_t, GLint>, GLint> _locations;
+    std::unordered_map<uint64_t, GLsync> _syncs;
+    // Keyed by the buffer in the replay
+    std::unordered_map<GLuint, Mapping> _mappings;
+    // Buffers made with glBufferStorage, which glBufferSubData can't write to
+    std::unordered_set<GLuint> _immutableBuffers;
+    // The program in use and the program given to the call that's being replayed, as captured
+    uint64_t _program = 0;
+    uint64_t _callProgram = 0;
+    // Drawn into in place of the default framebuffer
+    GLuint _framebuffer = 0;
+    // Where the calls write what they return through their pointers
+    std::vector<unsigned char> _scratch;
+
+    bool _isInWindow = false;
+    // The captured names of the objects made during the window
+    std::unordered_set<uint64_t> _windowNames[NUM_OF_GL_OBJECT_TYPES];
+    // What the window starts from
+    std::unordered_map<uint64_t, GLuint> _windowStartNames[NUM_OF_GL_OBJECT_TYPES];
+    std::map<std::pair<uint64_t, GLint>, GLint> _windowStartLocations;
+    std::unordered_map<GLuint, Mapping> _windowStartMappings;
+    std::unordered_set<GLuint> _windowStartImmutableBuffers;
+
+    public:
+    explicit GLReplayer(GLuint framebuffer): _framebuffer(framebuffer), _scratch(64 * 1024) {}
+
+    void Replay(const GLTraceCall &call);
+    // Keeps what the prologue made for every loop
+    void BeginWindow();
+    // Deletes what the loop made and goes back to what the window started from
+    void EndLoop();
+
+    GLuint MapName(GLTraceArg kind, uint64_t name) const;
+    // The argument at the index of a generic call, translated if it's an object or a location
+    template<typename T> T GetArg(const GLTraceOpInfo &info, const GLTraceCall &call, size_t argIndex, size_t &valueIndex)
+    {
+        const GLTraceArg kind = info.args[argIndex];
+        if constexpr(std::is_pointer_v<T>)
+        {
+            if(kind == GLTraceArg::OUTPUT)
+                return reinterpret_cast<T>(_scratch.data());
+        }
+
+        const uint64_t value = valueIndex < call.values.size() ? call.values[valueIndex] : 0;
+        valueIndex++;
+        if constexpr(std::is_integral_v<T>)
+        {
+            if(kind == GLTraceArg::PROGRAM)
+                _callProgram = value;
+            if(GLTrace::IsObject(kind))
+                return (T)MapName(kind, value);
+            if(kind == GLTraceArg::LOCATION)
+                return (T)MapLocation(_callProgram, GLTrace::DecodeValue<GLint>(value));
+        }
+        return GLTrace::DecodeValue<T>(value);
+    }
+
+    private:
+    GLint MapLocation(uint64_t program, GLint location) const;
+    void AddObject(GLTraceArg kind, uint64_t capturedName, GLuint name);
+    // Returns false if the object shouldn't be deleted, which is the case for the objects every loop needs
+    bool ReleaseObject(GLTraceArg kind, uint64_t capturedName, GLuint &name);
+    void PrepareScratch(const GLTraceCall &call);
+    void WriteBufferContents(GLuint buffer, size_t offset, const GLTracePayload &data);
+};
+
+// Decodes the values of a generic call into the arguments of its GL function
+template<GLTraceOp op, auto *pointer, typename Function = std::remove_pointer_t<decltype(pointer)>> struct GLGenericReplay;
+template<GLTraceOp op, auto *pointer, typename Ret, typename... Args> struct GLGenericReplay<op, pointer, Ret(APIENTRYP)(Args...)>
+{
+    static void Replay(GLReplayer &replayer, const GLTraceCall &call)
+    {
+        // Extensions the replay's context doesn't have
+        if(*pointer == nullptr)
+            return;
+        ReplayArgs(replayer, call, std::index_sequence_for<Args...>());
+    }
+
+    template<size_t... indices> static void ReplayArgs(GLReplayer &replayer, const GLTraceCall &call, std::index_sequence<indices...>)
+    {
+        // The arguments of a braced list are decoded in order, which the values have to be read in
+        [[maybe_unused]] const GLTraceOpInfo &info = GLTrace::GetOpInfo(op);
+        [[maybe_unused]] size_t valueIndex = 0;
+        const std::tuple<Args...> args{ replayer.GetArg<Args>(info, call, indices, valueIndex)... };
+        GL_CALL(std::apply(*pointer, args));
+    }
+};
+
+using GLReplayFunction = void(*)(GLReplayer&, const GLTraceCall&);
+// The generic calls come first in GLTraceOp
+static const GLReplayFunction GENERIC_REPLAYS[] =
+{
+#define GL_REPLAY_GENERIC(name, function, ...) &GLGenericReplay<GLTraceOp::name, &function>::Replay,
+    GL_TRACE_GENERIC_CALLS(GL_REPLAY_GENERIC)
+#undef GL_REPLAY_GENERIC
+};
+
+void GLReplayer::Replay(const GLTraceCall &call)
+{
+    const std::vector<uint64_t> &values = call.values;
+    if((size_t)call.op < std::size(GENERIC_REPLAYS))
+    {
+        if(call.op == GLTraceOp::DeleteProgram || call.op == GLTraceOp::DeleteShader)
+        {
+            GLuint name = 0;
+            if(ReleaseObject(GetObjectKind(call.op), values[0], name))
+                DeleteObject(GetObjectKind(call.op), name);
+            return;
+        }
+
+        PrepareScratch(call);
+        _callProgram = _program;
+        GENERIC_REPLAYS[(size_t)call.op](*this, call);
+        if(call.op == GLTraceOp::UseProgram)
+            _program = values[0];
+        return;
+    }
+
+    const GLTracePayload payload = call.payloads.empty() ? GLTracePayload() : call.payloads[0];
+    switch(call.op)
+    {
+        case GLTraceOp::GenBuffers:
+        case GLTraceOp::GenTextures:
+        case GLTraceOp::GenVertexArrays:
+        case GLTraceOp::GenFramebuffers:
+        case GLTraceOp::GenRenderbuffers:
+        case GLTraceOp::GenQueries:
+            for(size_t i = 1; i < values.size(); i++)
+                AddObject(GetObjectKind(call.op), values[i], GenObject(GetObjectKind(call.op)));
+            break;
+        case GLTraceOp::DeleteBuffers:
+        case GLTraceOp::DeleteTextures:
+        case GLTraceOp::DeleteVertexArrays:
+        case GLTraceOp::DeleteFramebuffers:
+        case GLTraceOp::DeleteRenderbuffers:
+        case GLTraceOp::DeleteQueries:
+            for(size_t i = 1; i < values.size(); i++)
+            {
+                GLuint name = 0;
+                if(ReleaseObject(GetObjectKind(call.op), values[i], name))
+                    DeleteObject(GetObjectKind(call.op), name);
+            }
+            break;
+        case GLTraceOp::CreateShader:
+        {
+            const GLuint shader = GL_CALL(glad_glCreateShader((GLenum)values[0]));
+            AddObject(GLTraceArg::SHADER, values[1], shader);
+            break;
+        }
+        case GLTraceOp::CreateProgram:
+        {
+            const GLuint program = GL_CALL(glad_glCreateProgram());
+            AddObject(GLTraceArg::PROGRAM, values[0], program);
+            break;
+        }
+        case GLTraceOp::ShaderSource:
+        {
+            std::vector<const GLchar*> sources;
+            std::vector<GLint> lengths;
+            for(const GLTracePayload &source: call.payloads)
+            {
+                sources.push_back((const GLchar*)source.data);
+                lengths.push_back((GLint)source.size);
+            }
+            GL_CALL(glad_glShaderSource(MapName(GLTraceArg::SHADER, values[0]), (GLsizei)sources.size(), sources.data(), lengths.data()));
+            break;
+        }
+        case GLTraceOp::GetUniformLocation:
+        {
+            // The name was recorded along with its null terminator
+            if(payload.size == 0)
+                break;
+            const GLint location = GL_CALL(glad_glGetUniformLocation(MapName(GLTraceArg::PROGRAM, values[0]), (const GLchar*)payload.data));
+            _locations[{ values[0], GLTrace::DecodeValue<GLint>(values[1]) }] = location;
+            break;
+        }
+        case GLTraceOp::BufferData:
+        case GLTraceOp::BufferStorage:
+        {
+            const GLsizeiptr size = GLTrace::DecodeValue<GLsizeiptr>(values[2]);
+            const void *data = payload.size == (size_t)size ? payload.data : nullptr;
+            if(call.op == GLTraceOp::BufferStorage && GLExtensions::glBufferStorage != nullptr)
+            {
+                GL_CALL(GLExtensions::glBufferStorage((GLenum)values[0], size, data, (GLbitfield)values[3]));
+                if((values[3] & GL_DYNAMIC_STORAGE_BIT) == 0)
+                    _immutableBuffers.insert(MapName(GLTraceArg::BUFFER, values[1]));
+            }
+            else
+            {
+                // Without buffer storage in the replay's context the buffer is made the way the ModelViewer would have made it
+                const GLenum usage = call.op == GLTraceOp::BufferData ? (GLenum)values[3] : GL_DYNAMIC_DRAW;
+                GL_CALL(glad_glBufferData((GLenum)values[0], size, data, usage));
+            }
+            break;
+        }
+        case GLTraceOp::BufferSubData:
+            GL_CALL(glad_glBufferSubData((GLenum)values[0], GLTrace::DecodeValue<GLintptr>(values[1]), (GLsizeiptr)payload.size, payload.data));
+            break;
+        case GLTraceOp::ClearBufferData:
+            GL_CALL(glad_glClearBufferData((GLenum)values[0], (GLenum)values[1], (GLenum)values[2], (GLenum)values[3], payload.size > 0 ? payload.data : nullptr));
+            break;
+        case GLTraceOp::TexImage2D:
+        {
+            // Either an offset into the pixel unpack buffer or the pixels themselves
+            const void *pixels = values[8] != 0 ? GLTrace::DecodeValue<const void*>(values[9]) : (payload.size > 0 ? payload.data : nullptr);
+            GL_CALL(glad_glTexImage2D((GLenum)values[0], GLTrace::DecodeValue<GLint>(values[1]), GLTrace::DecodeValue<GLint>(values[2]),
+                                      GLTrace::DecodeValue<GLsizei>(values[3]), GLTrace::DecodeValue<GLsizei>(values[4]), GLTrace::DecodeValue<GLint>(values[5]),
+                                      (GLenum)values[6], (GLenum)values[7], pixels));
+            break;
+        }
+        case GLTraceOp::Uniform2fv:
+        case GLTraceOp::Uniform3fv:
+        case GLTraceOp::Uniform4fv:
+        {
+            const GLint location = MapLocation(_program, GLTrace::DecodeValue<GLint>(values[0]));
+            const GLsizei count = GLTrace::DecodeValue<GLsizei>(values[1]);
+            const GLfloat *data = (const GLfloat*)payload.data;
+            if(call.op == GLTraceOp::Uniform2fv)
+            {
+                GL_CALL(glad_glUniform2fv(location, count, data));
+            }
+            else if(call.op == GLTraceOp::Uniform3fv)
+            {
+                GL_CALL(glad_glUniform3fv(location, count, data));
+            }
+            else
+            {
+                GL_CALL(glad_glUniform4fv(location, count, data));
+            }
+            break;
+        }
+        case GLTraceOp::UniformMatrix2fv:
+        case GLTraceOp::UniformMatrix3fv:
+        case GLTraceOp::UniformMatrix4fv:
+        {
+            const GLint location = MapLocation(_program, GLTrace::DecodeValue<GLint>(values[0]));
+            const GLsizei count = GLTrace::DecodeValue<GLsizei>(values[1]);
+            const GLboolean transpose = (GLboolean)values[2];
+            const GLfloat *data = (const GLfloat*)payload.data;
+            if(call.op == GLTraceOp::UniformMatrix2fv)
+            {
+                GL_CALL(glad_glUniformMatrix2fv(location, count, transpose, data));
+            }
+            else if(call.op == GLTraceOp::UniformMatrix3fv)
+            {
+                GL_CALL(glad_glUniformMatrix3fv(location, count, transpose, data));
+            }
+            else
+            {
+                GL_CALL(glad_glUniformMatrix4fv(location, count, transpose, data));
+            }
+            break;
+        }
+        case GLTraceOp::MapBufferRange:
+        {
+            const GLintptr offset = GLTrace::DecodeValue<GLintptr>(values[2]);
+            void *data = GL_CALL(glad_glMapBufferRange((GLenum)values[0], offset, GLTrace::DecodeValue<GLsizeiptr>(values[3]), (GLbitfield)values[4]));
+            if(data != nullptr)
+                _mappings[MapName(GLTraceArg::BUFFER, values[1])] = { (unsigned char*)data, (size_t)offset };
+            break;
+        }
+        case GLTraceOp::UnmapBuffer:
+            GL_CALL(glad_glUnmapBuffer((GLenum)values[0]));
+            _mappings.erase(MapName(GLTraceArg::BUFFER, values[1]));
+            break;
+        case GLTraceOp::FenceSync:
+        {
+            const GLsync sync = GL_CALL(glad_glFenceSync((GLenum)values[0], (GLbitfield)values[1]));
+            if(values[2] != 0)
+                _syncs[values[2]] = sync;
+            else
+            {
+                GL_CALL(glad_glDeleteSync(sync));
+            }
+            break;
+        }
+        case GLTraceOp::ClientWaitSync:
+        {
+            const auto sync = _syncs.find(values[0]);
+            if(sync != _syncs.end())
+            {
+                GL_CALL(glad_glClientWaitSync(sync->second, (GLbitfield)values[1], values[2]));
+            }
+            break;
+        }
+        case GLTraceOp::DeleteSync:
+        {
+            const auto sync = _syncs.find(values[0]);
+            if(sync != _syncs.end())
+            {
+                GL_CALL(glad_glDeleteSync(sync->second));
+                _syncs.erase(sync);
+            }
+            break;
+        }
+        case GLTraceOp::BufferContents:
+            WriteBufferContents(MapName(GLTraceArg::BUFFER, values[0]), (size_t)values[1], payload);
+            break;
+        default:
+            // The markers are the replay loop's business
+            break;
+    }
+}
+
+void GLReplayer::BeginWindow()
+{
+    _isInWindow = true;
+    std::copy(std::begin(_names), std::end(_names), std::begin(_windowStartNames));
+    _windowStartLocations = _locations;
+    _windowStartMappings = _mappings;
+    _windowStartImmutableBuffers = _immutableBuffers;
+}
+
+void GLReplayer::EndLoop()
+{
+    // The mappings the loop left open, and the ones the window started with that the loop closed, which can't be written through anymore
+    GLint copyWriteBuffer = 0;
+    GL_CALL(glad_glGetIntegerv(GL_COPY_WRITE_BUFFER_BINDING, &copyWriteBuffer));
+    for(auto mapping = _mappings.begin(); mapping != _mappings.end();)
+    {
+        const auto windowStartMapping = _windowStartMappings.find(mapping->first);
+        if(windowStartMapping != _windowStartMappings.end() && windowStartMapping->second.data == mapping->second.data)
+        {
+            mapping++;
+            continue;
+        }
+        GL_CALL(glad_glBindBuffer(GL_COPY_WRITE_BUFFER, mapping->first));
+        GL_CALL(glad_glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+        mapping = _mappings.erase(mapping);
+    }
+    GL_CALL(glad_glBindBuffer(GL_COPY_WRITE_BUFFER, copyWriteBuffer));
+
+    for(unsigned int i = 0; i < NUM_OF_GL_OBJECT_TYPES; i++)
+    {
+        for(uint64_t capturedName: _windowNames[i])
+        {
+            const auto name = _names[i].find(capturedName);
+            if(name != _names[i].end())
+                DeleteObject((GLTraceArg)(i + (unsigned int)GLTraceArg::BUFFER), name->second);
+        }
+        _windowNames[i].clear();
+    }
+    for(const auto &sync: _syncs)
+    {
+        GL_CALL(glad_glDeleteSync(sync.second));
+    }
+    _syncs.clear();
+
+    std::copy(std::begin(_windowStartNames), std::end(_windowStartNames), std::begin(_names));
+    _locations = _windowStartLocations;
+    _immutableBuffers = _windowStartImmutableBuffers;
+}
+
+GLuint GLReplayer::MapName(GLTraceArg kind, uint64_t name) const
+{
+    // The default framebuffer is the replay's own framebuffer
+    if(kind == GLTraceArg::FRAMEBUFFER && name == 0)
+        return _framebuffer;
+    if(name == 0)
+        return 0;
+
+    // Names that were never made in the trace are passed on as they are
+    const std::unordered_map<uint64_t, GLuint> &names = _names[GLTrace::GetObjectIndex(kind)];
+    const auto found = names.find(name);
+    return found != names.end() ? found->second : (GLuint)name;
+}
+
+GLint GLReplayer::MapLocation(uint64_t program, GLint location) const
+{
+    if(location < 0)
+        return location;
+    // Locations that weren't queried in the trace (eg. explicit ones) are the same in the replay
+    const auto found = _locations.find({ program, location });
+    return found != _locations.end() ? found->second : location;
+}
+
+void GLReplayer::AddObject(GLTraceArg kind, uint64_t capturedName, GLuint name)
+{
+    const unsigned int index = GLTrace::GetObjectIndex(kind);
+    _names[index][capturedName] = name;
+    if(_isInWindow)
+        _windowNames[index].insert(capturedName);
+}
+
+bool GLReplayer::ReleaseObject(GLTraceArg kind, uint64_t capturedName, GLuint &name)
+{
+    // Every loop needs the objects made before the window, so they stay alive until the replay is done
+    const unsigned int index = GLTrace::GetObjectIndex(kind);
+    if(_isInWindow && _windowNames[index].erase(capturedName) == 0)
+        return false;
+
+    const auto found = _names[index].find(capturedName);
+    if(found == _names[index].end())
+        return false;
+    name = found->second;
+    _names[index].erase(found);
+    if(kind == GLTraceArg::BUFFER)
+    {
+        _mappings.erase(name);
+        _immutableBuffers.erase(name);
+    }
+    return true;
+}
+
+void GLReplayer::PrepareScratch(const GLTraceCall &call)
+{
+    size_t size = 0;
+    switch(call.op)
+    {
+        case GLTraceOp::GetBufferSubData:
+            size = (size_t)GLTrace::DecodeValue<GLsizeiptr>(call.values[2]);
+            break;
+        case GLTraceOp::ReadPixels:
+            // Enough for 4 floats per pixel with any pack alignment
+            size = ((size_t)GLTrace::DecodeValue<GLsizei>(call.values[2]) * 16 + 8) * GLTrace::DecodeValue<GLsizei>(call.values[3]);
+            break;
+        case GLTraceOp::GetProgramInfoLog:
+        case GLTraceOp::GetShaderInfoLog:
+            size = (size_t)GLTrace::DecodeValue<GLsizei>(call.values[1]) + sizeof(GLsizei);
+            break;
+        default:
+            break;
+    }
+    if(size > _scratch.size())
+        _scratch.resize(size);
+}
+
+void GLReplayer::WriteBufferContents(GLuint buffer, size_t offset, const GLTracePayload &data)
+{
+    const auto mapping = _mappings.find(buffer);
+    if(mapping != _mappings.end() && offset >= mapping->second.offset)
+    {
+        std::memcpy(mapping->second.data + (offset - mapping->second.offset), data.data, data.size);
+        return;
+    }
+
+    GLint copyWriteBuffer = 0;
+    GL_CALL(glad_glGetIntegerv(GL_COPY_WRITE_BUFFER_BINDING, &copyWriteBuffer));
+    GL_CALL(glad_glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+    if(_immutableBuffers.count(buffer) > 0)
+    {
+        // Has to go through a buffer that can be written to
+        GLint copyReadBuffer = 0;
+        GLuint staging = 0;
+        GL_CALL(glad_glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &copyReadBuffer));
+        GL_CALL(glad_glGenBuffers(1, &staging));
+        GL_CALL(glad_glBindBuffer(GL_COPY_READ_BUFFER, staging));
+        GL_CALL(glad_glBufferData(GL_COPY_READ_BUFFER, (GLsizeiptr)data.size, data.data, GL_STREAM_COPY));
+        GL_CALL(glad_glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr)offset, (GLsizeiptr)data.size));
+        GL_CALL(glad_glDeleteBuffers(1, &staging));
+        GL_CALL(glad_glBindBuffer(GL_COPY_READ_BUFFER, copyReadBuffer));
+    }
+    else
+    {
+        GL_CALL(glad_glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)data.size, data.data));
+    }
+    GL_CALL(glad_glBindBuffer(GL_COPY_WRITE_BUFFER, copyWriteBuffer));
+}
+
+static double GetMilliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    Log::SetLogLevelFilter(LogLevel::Warning);
+
+    ReplayOptions options;
+    if(!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    LoadedTrace trace;
+    if(!LoadTrace(options.tracePath, trace))
+        return 1;
+    if(options.list)
+    {
+        ListTrace(trace);
+        return 0;
+    }
+
+    if(!HeadlessContext::Init(trace.header.width, trace.header.height, options.surfaceless))
+        return -1;
+    printf("GL %s, %s, %s\n", (const char*)glad_glGetString(GL_VERSION), (const char*)glad_glGetString(GL_RENDERER), HeadlessContext::GetTypeName());
+    printf("Replaying %u frames of %zu calls, captured on GL %s, %s\n", trace.numOfFrames, trace.framesEnd - trace.restoreEnd - 1,
+           trace.header.version.c_str(), trace.header.renderer.c_str());
+
+    // Stands in for the default framebuffer, which a surfaceless context doesn't have
+    unsigned int framebuffer = 0, colorBuffer = 0, depthBuffer = 0;
+    GL_CALL(glad_glGenFramebuffers(1, &framebuffer));
+    GL_CALL(glad_glGenRenderbuffers(1, &colorBuffer));
+    GL_CALL(glad_glGenRenderbuffers(1, &depthBuffer));
+    GL_CALL(glad_glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer));
+    GL_CALL(glad_glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, trace.header.width, trace.header.height));
+    GL_CALL(glad_glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer));
+    GL_CALL(glad_glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, trace.header.width, trace.header.height));
+    GL_CALL(glad_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+    GL_CALL(glad_glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer));
+    GL_CALL(glad_glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer));
+    GL_CALL(glad_glBindRenderbuffer(GL_RENDERBUFFER, 0));
+    const GLenum framebufferStatus = GL_CALL(glad_glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    if(framebufferStatus != GL_FRAMEBUFFER_COMPLETE)
+    {
+        Log::LogFatal("The replay's framebuffer is incomplete");
+        HeadlessContext::DeInit();
+        return -1;
+    }
+    GL_CALL(glad_glViewport(0, 0, trace.header.width, trace.header.height));
+
+    // The objects and the data the frames use, once
+    GLReplayer replayer(framebuffer);
+    const auto prologueStartTime = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < trace.windowStart; i++)
+        replayer.Replay(trace.calls[i]);
+    GL_CALL(glad_glFinish());
+    printf("Prologue of %zu calls took %.1f ms\n", trace.windowStart, GetMilliseconds(prologueStartTime, std::chrono::steady_clock::now()));
+    replayer.BeginWindow();
+
+    const size_t firstFrameCall = trace.restoreEnd + 1;
+    auto restoreWindowStart = [&]()
+    {
+        for(size_t i = trace.windowStart + 1; i < trace.restoreEnd; i++)
+            replayer.Replay(trace.calls[i]);
+        GL_CALL(glad_glFinish());
+    };
+    auto isSkipped = [&](size_t call)
+    {
+        const size_t windowCall = call - firstFrameCall;
+        return windowCall >= options.firstSkippedCall && windowCall <= options.lastSkippedCall && IsSkippable(trace.calls[call].op);
+    };
+
+    // Timestamps rather than elapsed time queries, since the frames can have time queries of their own
+    std::vector<GLuint> timestampQueries(trace.numOfFrames + 1);
+    GL_CALL(glad_glGenQueries((GLsizei)timestampQueries.size(), timestampQueries.data()));
+
+    std::vector<std::vector<double>> frameCPUTimes(trace.numOfFrames), frameGPUTimes(trace.numOfFrames);
+    std::vector<double> windowCPUTimes, windowGPUTimes;
+    // Average per frame of every profiler scope, per loop
+    std::map<std::string, std::vector<double>> scopeTimes;
+    for(unsigned int loop = 0; loop < options.numOfLoops; loop++)
+    {
+        restoreWindowStart();
+
+        std::map<std::string, double> loopScopeTimes;
+        std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>> openScopes;
+        unsigned int frame = 0;
+        const auto windowStartTime = std::chrono::steady_clock::now();
+        auto frameStartTime = windowStartTime;
+        GL_CALL(glad_glQueryCounter(timestampQueries[0], GL_TIMESTAMP));
+        for(size_t i = firstFrameCall; i < trace.framesEnd; i++)
+        {
+            const GLTraceCall &call = trace.calls[i];
+            if(call.op == GLTraceOp::FrameEnd)
+            {
+                GL_CALL(glad_glQueryCounter(timestampQueries[frame + 1], GL_TIMESTAMP));
+                const auto frameEndTime = std::chrono::steady_clock::now();
+                frameCPUTimes[frame].push_back(GetMilliseconds(frameStartTime, frameEndTime));
+                frameStartTime = frameEndTime;
+                frame++;
+            }
+            else if(call.op == GLTraceOp::BeginMarker)
+                openScopes.push_back({ std::string((const char*)call.payloads[0].data, call.payloads[0].size), std::chrono::steady_clock::now() });
+            else if(call.op == GLTraceOp::EndMarker && !openScopes.empty())
+            {
+                loopScopeTimes[openScopes.back().first] += GetMilliseconds(openScopes.back().second, std::chrono::steady_clock::now());
+                openScopes.pop_back();
+            }
+            else if(!isSkipped(i))
+                replayer.Replay(call);
+        }
+        windowCPUTimes.push_back(GetMilliseconds(windowStartTime, std::chrono::steady_clock::now()));
+
+        GL_CALL(glad_glFinish());
+        std::vector<GLuint64> timestamps(timestampQueries.size());
+        for(size_t i = 0; i < timestampQueries.size(); i++)
+        {
+            GL_CALL(glad_glGetQueryObjectui64v(timestampQueries[i], GL_QUERY_RESULT, &timestamps[i]));
+        }
+        for(unsigned int i = 0; i < trace.numOfFrames; i++)
+            frameGPUTimes[i].push_back((timestamps[i + 1] - timestamps[i]) / 1000000.0);
+        windowGPUTimes.push_back((timestamps.back() - timestamps.front()) / 1000000.0);
+        for(const auto &scope: loopScopeTimes)
+            scopeTimes[scope.first].push_back(scope.second / trace.numOfFrames);
+
+        // The last loop's image is the one that gets saved
+        if(loop + 1 < options.numOfLoops || options.perCall)
+            replayer.EndLoop();
+    }
+
+    BenchmarkSettings settings;
+    BenchmarkRunner runner(settings);
+    for(unsigned int i = 0; i < trace.numOfFrames; i++)
+    {
+        runner.AddResult("replay/frame_" + std::to_string(i) + "_cpu", frameCPUTimes[i]);
+        runner.AddResult("replay/frame_" + std::to_string(i) + "_gpu", frameGPUTimes[i]);
+    }
+    runner.AddResult("replay/window_cpu", windowCPUTimes);
+    runner.AddResult("replay/window_gpu", windowGPUTimes);
+    for(const auto &scope: scopeTimes)
+        runner.AddResult("replay/scope/" + scope.first, scope.second);
+
+    if(options.perCall)
+    {
+        // Every call waits for the one before it and for itself, which is far slower than the frames are,
+        // but tells which calls the time goes to
+        restoreWindowStart();
+        std::vector<std::pair<double, size_t>> callTimes;
+        for(size_t i = firstFrameCall; i < trace.framesEnd; i++)
+        {
+            if(GLTrace::GetOpInfo(trace.calls[i].op).category == GLTraceCategory::MARKER || isSkipped(i))
+                continue;
+            const auto callStartTime = std::chrono::steady_clock::now();
+            replayer.Replay(trace.calls[i]);
+            GL_CALL(glad_glFinish());
+            callTimes.push_back({ GetMilliseconds(callStartTime, std::chrono::steady_clock::now()), i });
+        }
+
+        const size_t numOfSlowestCalls = std::min(callTimes.size(), NUM_OF_SLOWEST_CALLS);
+        std::partial_sort(callTimes.begin(), callTimes.begin() + numOfSlowestCalls, callTimes.end(), std::greater<std::pair<double, size_t>>());
+        printf("\nSlowest calls (window call index, call):\n");
+        for(size_t i = 0; i < numOfSlowestCalls; i++)
+            printf("%10.3f ms  %8zu  %s\n", callTimes[i].first, callTimes[i].second - firstFrameCall, GLTrace::GetOpInfo(trace.calls[callTimes[i].second].op).name);
+    }
+
+    if(!options.imagePath.empty())
+    {
+        std::vector<unsigned char> image((size_t)trace.header.width * trace.header.height * 4);
+        GL_CALL(glad_glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer));
+        GL_CALL(glad_glPixelStorei(GL_PACK_ALIGNMENT, 1));
+        GL_CALL(glad_glReadPixels(0, 0, trace.header.width, trace.header.height, GL_RGBA, GL_UNSIGNED_BYTE, image.data()));
+        // GL's rows go bottom to top
+        stbi_flip_vertically_on_write(1);
+        if(stbi_write_png(options.imagePath.c_str(), trace.header.width, trace.header.height, 4, image.data(), trace.header.width * 4) == 0)
+            Log::LogError("Failed to write " + options.imagePath);
+    }
+
+    replayer.EndLoop();
+    GL_CALL(glad_glDeleteQueries((GLsizei)timestampQueries.size(), timestampQueries.data()));
+    GL_CALL(glad_glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    GL_CALL(glad_glDeleteFramebuffers(1, &framebuffer));
+    GL_CALL(glad_glDeleteRenderbuffers(1, &colorBuffer));
+    GL_CALL(glad_glDeleteRenderbuffers(1, &depthBuffer));
+    HeadlessContext::DeInit();
+
+    runner.SaveJSON(options.outPath);
+    if(options.baselinePath.empty())
+        return 0;
+    const int numOfRegressions = runner.CompareWithBaseline(options.baselinePath, options.threshold);
+    return numOfRegressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include "headless_context.hpp"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "core/log.hpp"
+#include "rendering/gl_extensions.hpp"
+
+bool HeadlessContext::Init(unsigned int width, unsigned int height, bool surfaceless)
+{
+    if(surfaceless)
+    {
+#ifdef GLFW_PLATFORM_NULL
+        if(glfwPlatformSupported(GLFW_PLATFORM_NULL))
+        {
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+            if(glfwInit())
+            {
+                glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+                _window = CreateContextWindow(width, height);
+                _type = HeadlessContextType::SURFACELESS_EGL;
+                if(_window == nullptr)
+                {
+                    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+                    _window = CreateContextWindow(width, height);
+                    _type = HeadlessContextType::OSMESA;
+                }
+
+                if(_window == nullptr)
+                    glfwTerminate();
+            }
+            glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+        }
+#endif
+        if(_window == nullptr)
+            Log::LogWarning("Couldn't create a surfaceless context, falling back to a hidden window");
+    }
+
+    if(_window == nullptr)
+    {
+        if(!glfwInit())
+        {
+            Log::LogFatal("GLFW failed to initialize");
+            return false;
+        }
+
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        _window = CreateContextWindow(width, height);
+        _type = HeadlessContextType::HIDDEN_WINDOW;
+        if(_window == nullptr)
+        {
+            Log::LogFatal("Failed to create a GL context");
+            glfwTerminate();
+            return false;
+        }
+    }
+    glfwMakeContextCurrent(_window);
+
+    if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        Log::LogFatal("glad failed to initialize");
+        DeInit();
+        return false;
+    }
+    GLExtensions::Load((GLADloadproc)glfwGetProcAddress);
+    return true;
+}
+
+void HeadlessContext::DeInit()
+{
+    if(_window != nullptr)
+        glfwDestroyWindow(_window);
+    _window = nullptr;
+    glfwTerminate();
+}
+
+const char *HeadlessContext::GetTypeName()
+{
+    switch(_type)
+    {
+        case HeadlessContextType::SURFACELESS_EGL: return "surfaceless EGL";
+        case HeadlessContextType::OSMESA:          return "OSMesa";
+        case HeadlessContextType::HIDDEN_WINDOW:   return "hidden window";
+    }
+    return "unknown";
+}
+
+GLFWwindow *HeadlessContext::CreateContextWindow(unsigned int width, unsigned int height)
+{
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if defined(GL_NO_ERROR_CONTEXT) && !defined(_DEBUG)
+    glfwWindowHint(GLFW_CONTEXT_NO_ERROR, GLFW_TRUE);
+#endif
+    GLFWwindow *window = glfwCreateWindow(width, height, "ModelViewer", NULL, NULL);
+    if(window == NULL)
+    {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+        window = glfwCreateWindow(width, height, "ModelViewer", NULL, NULL);
+    }
+    return window;
+}
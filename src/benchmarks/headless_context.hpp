@@ -0,0 +1,43 @@
+#pragma once
+
+struct GLFWwindow;
+
+enum class HeadlessContextType
+{
+    // No window system at all: GLFW's null platform with a surfaceless EGL or an OSMesa context,
+    // which is what works on machines without a GPU or a display (eg. Mesa's llvmpipe on a CI runner).
+    // There's no default framebuffer to draw into, everything has to go into framebuffer objects
+    SURFACELESS_EGL = 0,
+    OSMESA,
+    // A window that never gets shown, which needs a display but gets the GPU's driver
+    HIDDEN_WINDOW
+};
+
+/*
+Creates the GL context the benchmarks and the regression tests run on and loads the GL functions for it.
+Prefers a 4.3 core context and falls back to 4.2 the same way the ModelViewer does.
+The surfaceless contexts need GLFW 3.4's null platform, with an older GLFW they fall back to a hidden window.
+*/
+class HeadlessContext final
+{
+    private:
+    inline static GLFWwindow *_window = nullptr;
+    inline static HeadlessContextType _type = HeadlessContextType::HIDDEN_WINDOW;
+
+    private:
+    HeadlessContext() {}
+    ~HeadlessContext() {}
+
+    public:
+    // Initializes GLFW as well. Returns false if no context could be created
+    static bool Init(unsigned int width, unsigned int height, bool surfaceless);
+    static void DeInit();
+
+    static GLFWwindow *getWindow() { return _window; }
+    static HeadlessContextType getType() { return _type; }
+    static const char *GetTypeName();
+
+    private:
+    // Tries the 4.3 context first and 4.2 after it
+    static GLFWwindow *CreateContextWindow(unsigned int width, unsigned int height);
+};
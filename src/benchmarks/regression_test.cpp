@@ -0,0 +1,423 @@
+#include <glad/glad.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <stb/stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "benchmark_runner.hpp"
+#include "headless_context.hpp"
+#include "core/log.hpp"
+#include "core/resource_manager.hpp"
+#include "core/scene.hpp"
+#include "rendering/renderer.hpp"
+#include "rendering/frame_profiler.hpp"
+#include "rendering/shader_compiler.hpp"
+
+// Small enough for a software rasterizer to get through a few hundred frames quickly
+static constexpr unsigned int IMAGE_WIDTH = 640;
+static constexpr unsigned int IMAGE_HEIGHT = 360;
+static constexpr unsigned int GRID_SIZE = 8;
+
+struct RegressionOptions final
+{
+    unsigned int numOfFrames = 300;
+    // Frames left out of the frame time stats, which is when the shader variants get compiled
+    unsigned int numOfWarmupFrames = 30;
+    // Where golden.png and frame_time_baseline.json are read from, and written to with --update
+    std::string goldenDirectory = "../../../res/regression/";
+    // Where this run's image, diff image and frame times get written to
+    std::string outDirectory = "./";
+    bool update = false;
+    bool surfaceless = true;
+    // How much slower the median frame time can get before it counts as a regression
+    double frameTimeThreshold = 0.10;
+    // CIE76 colour difference a pixel can have before it counts as different, 2.3 is about where people start to notice
+    double maxDeltaE = 2.3;
+    // How many of the pixels can be different, as a fraction of all of them
+    double maxDifferentPixels = 0.001;
+    std::string resDirectory = "../../../res/";
+};
+
+struct FrameTimes final
+{
+    std::vector<double> cpu;
+    // Negative for the frames whose GPU times didn't arrive
+    std::vector<double> gpu;
+};
+
+struct ImageComparison final
+{
+    unsigned int numOfDifferentPixels = 0;
+    double maxDeltaE = 0.0;
+    double averageDeltaE = 0.0;
+};
+
+static void PrintUsage()
+{
+    printf("Usage: ModelViewerRegression [options]\n"
+           "  --frames <n>                how many frames of the scripted scene to draw (default 300)\n"
+           "  --warmup <n>                frames left out of the frame time stats (default 30)\n"
+           "  --golden <dir>              where the golden image and frame times are (default ../../../res/regression/)\n"
+           "  --out <dir>                 where to write this run's image, diff and frame times (default ./)\n"
+           "  --update                    write this run's image and frame times as the new golden ones\n"
+           "  --window                    run on a hidden window instead of a surfaceless context\n"
+           "  --frame-time-threshold <r>  how much slower the median frame time can get (default 0.10)\n"
+           "  --max-delta-e <d>           colour difference a pixel can have before it counts as different (default 2.3)\n"
+           "  --max-different <r>         fraction of the pixels that can be different (default 0.001)\n"
+           "  --res <dir>                 the res directory (default ../../../res/)\n");
+}
+
+static std::string AsDirectory(const char *path)
+{
+    std::string directory = path;
+    if(!directory.empty() && directory.back() != '/')
+        directory += '/';
+    return directory;
+}
+
+static bool ParseOptions(int argc, char **argv, RegressionOptions &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        if(arg == "--update")
+        {
+            options.update = true;
+            continue;
+        }
+        if(arg == "--window")
+        {
+            options.surfaceless = false;
+            continue;
+        }
+        if(arg == "--help" || arg == "-h" || i + 1 >= argc)
+            return false;
+
+        const char *value = argv[++i];
+        if(arg == "--frames")
+            options.numOfFrames = std::max((unsigned int)std::strtoul(value, nullptr, 10), 1u);
+        else if(arg == "--warmup")
+            options.numOfWarmupFrames = (unsigned int)std::strtoul(value, nullptr, 10);
+        else if(arg == "--golden")
+            options.goldenDirectory = AsDirectory(value);
+        else if(arg == "--out")
+            options.outDirectory = AsDirectory(value);
+        else if(arg == "--frame-time-threshold")
+            options.frameTimeThreshold = std::strtod(value, nullptr);
+        else if(arg == "--max-delta-e")
+            options.maxDeltaE = std::strtod(value, nullptr);
+        else if(arg == "--max-different")
+            options.maxDifferentPixels = std::strtod(value, nullptr);
+        else if(arg == "--res")
+            options.resDirectory = AsDirectory(value);
+        else
+            return false;
+    }
+    options.numOfWarmupFrames = std::min(options.numOfWarmupFrames, options.numOfFrames - 1);
+    return true;
+}
+
+// sRGB with a D65 white point to CIELAB
+static glm::vec3 ToLab(const unsigned char *pixel)
+{
+    auto toLinear = [](unsigned char value)
+    {
+        const float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    };
+    const float r = toLinear(pixel[0]), g = toLinear(pixel[1]), b = toLinear(pixel[2]);
+    const glm::vec3 xyz = glm::vec3(
+        (0.4124f * r + 0.3576f * g + 0.1805f * b) / 0.95047f,
+        (0.2126f * r + 0.7152f * g + 0.0722f * b),
+        (0.0193f * r + 0.1192f * g + 0.9505f * b) / 1.08883f);
+
+    auto f = [](float t) { return t > 0.008856f ? std::cbrt(t) : 7.787f * t + 16.0f / 116.0f; };
+    const float fx = f(xyz.x), fy = f(xyz.y), fz = f(xyz.z);
+    return glm::vec3(116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz));
+}
+
+// Both images are RGBA. The diff image shows the golden image in grey with the pixels that are different in red
+static ImageComparison CompareImages(const unsigned char *image, const unsigned char *golden, unsigned int numOfPixels, double maxDeltaE, std::vector<unsigned char> &diff)
+{
+    ImageComparison comparison;
+    diff.resize((size_t)numOfPixels * 4);
+    double deltaESum = 0.0;
+    for(unsigned int i = 0; i < numOfPixels; i++)
+    {
+        const double deltaE = glm::length(ToLab(image + i * 4) - ToLab(golden + i * 4));
+        deltaESum += deltaE;
+        comparison.maxDeltaE = std::max(comparison.maxDeltaE, deltaE);
+
+        unsigned char *diffPixel = &diff[(size_t)i * 4];
+        if(deltaE > maxDeltaE)
+        {
+            comparison.numOfDifferentPixels++;
+            diffPixel[0] = 255; diffPixel[1] = 0; diffPixel[2] = 0;
+        }
+        else
+        {
+            const unsigned char grey = (unsigned char)((golden[i * 4] * 2 + golden[i * 4 + 1] * 5 + golden[i * 4 + 2]) / 8 / 2);
+            diffPixel[0] = grey; diffPixel[1] = grey; diffPixel[2] = grey;
+        }
+        diffPixel[3] = 255;
+    }
+    comparison.averageDeltaE = numOfPixels > 0 ? deltaESum / numOfPixels : 0.0;
+    return comparison;
+}
+
+static bool WritePNG(const std::string &path, const std::vector<unsigned char> &pixels)
+{
+    // GL's rows go bottom to top
+    stbi_flip_vertically_on_write(1);
+    if(stbi_write_png(path.c_str(), IMAGE_WIDTH, IMAGE_HEIGHT, 4, pixels.data(), IMAGE_WIDTH * 4) == 0)
+    {
+        Log::LogError("Failed to write " + path);
+        return false;
+    }
+    return true;
+}
+
+static bool WriteFrameTimes(const std::string &path, const FrameTimes &frameTimes)
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+    {
+        Log::LogError("Failed to open " + path + " for writing the frame times");
+        return false;
+    }
+
+    auto writeTimes = [&](const char *name, const std::vector<double> &times, bool isLast)
+    {
+        file << "  \"" << name << "\": [";
+        for(size_t i = 0; i < times.size(); i++)
+        {
+            char time[32];
+            snprintf(time, sizeof(time), "%.4f", times[i]);
+            file << (i == 0 ? "" : ", ") << time;
+        }
+        file << (isLast ? "]\n" : "],\n");
+    };
+
+    file << "{\n";
+    file << "  \"unit\": \"ms\",\n";
+    writeTimes("cpu", frameTimes.cpu, false);
+    writeTimes("gpu", frameTimes.gpu, true);
+    file << "}\n";
+    return true;
+}
+
+// The scene is driven by the frame number rather than the clock so that every run ends up with the same image
+static void SetUpScene(const std::string &resDirectory)
+{
+    ResourceManager &resourceManager = ResourceManager::getInstance();
+    Scene &scene = Scene::getInstance();
+    scene.shader = resourceManager.LoadShaderFromFiles(resDirectory + "shaders/default.vs", resDirectory + "shaders/default.fs");
+    ShaderCompiler::getInstance().WaitFor(scene.shader);
+    resourceManager.LoadTextureFromFile(resDirectory + "textures/tex_missing.jpg");
+    scene.model = resourceManager.LoadModelFromOBJFile(resDirectory + "models/axe.obj");
+
+    scene.camera.projection = glm::perspective(45.0f, (float)IMAGE_WIDTH/(float)IMAGE_HEIGHT, 0.1f, 100.0f);
+
+    // A grid of copies of the model with one of them in the middle drawn bigger, which hides some of the others
+    const float spacing = 2.5f / GRID_SIZE;
+    const glm::vec3 gridStart = glm::vec3(-1.25f + spacing * 0.5f);
+    for(unsigned int i = 0; i < GRID_SIZE * GRID_SIZE * GRID_SIZE; i++)
+    {
+        const glm::vec3 cell = glm::vec3(i % GRID_SIZE, (i / GRID_SIZE) % GRID_SIZE, i / (GRID_SIZE * GRID_SIZE));
+        const EntityID entity = scene.AddRenderable(nullptr, nullptr);
+        scene.transforms.SetPosition(entity, gridStart + cell * spacing);
+        scene.transforms.SetScale(entity, glm::vec3(spacing * 0.5f));
+    }
+    const EntityID centre = scene.AddRenderable(nullptr, nullptr);
+    scene.transforms.SetScale(centre, glm::vec3(1.5f));
+    scene.renderables.back().occluder = true;
+}
+
+static void UpdateScene(unsigned int frame)
+{
+    Scene &scene = Scene::getInstance();
+    const float angle = frame * 0.01f;
+    scene.camera.position = glm::vec3(std::sin(angle) * 5.0f, -0.5f, -std::cos(angle) * 5.0f);
+    scene.camera.view = glm::lookAt(scene.camera.position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // Every tenth copy spins, so that the transforms and the BVH have some work to do every frame
+    for(size_t i = 0; i < scene.renderables.size(); i += 10)
+    {
+        const glm::quat rotation = glm::angleAxis(frame * 0.02f + i, glm::vec3(0.0f, 1.0f, 0.0f));
+        scene.transforms.SetRotation(scene.renderables[i].entity, rotation);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // The resource manager logs every load, which would drown out the results
+    Log::SetLogLevelFilter(LogLevel::Warning);
+
+    RegressionOptions options;
+    if(!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    if(!HeadlessContext::Init(IMAGE_WIDTH, IMAGE_HEIGHT, options.surfaceless))
+        return -1;
+    printf("GL %s, %s, %s\n", (const char*)glad_glGetString(GL_VERSION), (const char*)glad_glGetString(GL_RENDERER), HeadlessContext::GetTypeName());
+
+    // Surfaceless contexts don't have a default framebuffer and the default framebuffer of a hidden window
+    // doesn't have to keep what gets drawn into it, so the scene gets drawn into a framebuffer of its own
+    unsigned int framebuffer = 0, colorBuffer = 0, depthBuffer = 0;
+    GL_CALL(glad_glGenFramebuffers(1, &framebuffer));
+    GL_CALL(glad_glGenRenderbuffers(1, &colorBuffer));
+    GL_CALL(glad_glGenRenderbuffers(1, &depthBuffer));
+    GL_CALL(glad_glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer));
+    GL_CALL(glad_glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, IMAGE_WIDTH, IMAGE_HEIGHT));
+    GL_CALL(glad_glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer));
+    GL_CALL(glad_glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IMAGE_WIDTH, IMAGE_HEIGHT));
+    GL_CALL(glad_glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+    GL_CALL(glad_glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer));
+    GL_CALL(glad_glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer));
+    const GLenum framebufferStatus = GL_CALL(glad_glCheckFramebufferStatus(GL_FRAMEBUFFER));
+    if(framebufferStatus != GL_FRAMEBUFFER_COMPLETE)
+    {
+        Log::LogFatal("The regression test's framebuffer is incomplete");
+        HeadlessContext::DeInit();
+        return -1;
+    }
+    GL_CALL(glad_glViewport(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT));
+
+    SetUpScene(options.resDirectory);
+    Scene &scene = Scene::getInstance();
+    if(scene.shader == nullptr || !scene.shader->isReady() || scene.model == nullptr)
+    {
+        Log::LogFatal("Couldn't load the regression test's resources");
+        HeadlessContext::DeInit();
+        return -1;
+    }
+    Renderer &renderer = Renderer::getInstance();
+    FrameProfiler &profiler = FrameProfiler::getInstance();
+    renderer.Init();
+    profiler.Init();
+
+    // The profiler hands the frames over once their GPU times have arrived, which is a frame or two late.
+    // The extra frame at the end draws nothing and only picks up the last frame's times
+    FrameTimes frameTimes;
+    unsigned int numOfRecordedFrames = 0;
+    auto recordArrivedFrames = [&]()
+    {
+        unsigned int firstArrivedFrame = profiler.getNumOfFrames();
+        while(firstArrivedFrame > 0 && profiler.GetFrame(firstArrivedFrame - 1).frameIndex >= numOfRecordedFrames)
+            firstArrivedFrame--;
+
+        for(unsigned int i = firstArrivedFrame; i < profiler.getNumOfFrames(); i++)
+        {
+            const ProfiledFrame &frame = profiler.GetFrame(i);
+            frameTimes.cpu.push_back(frame.cpuTime);
+            frameTimes.gpu.push_back(frame.gpuTime);
+            numOfRecordedFrames = frame.frameIndex + 1;
+        }
+    };
+    for(unsigned int frame = 0; frame < options.numOfFrames; frame++)
+    {
+        profiler.BeginFrame();
+        renderer.BeginFrame();
+        ShaderCompiler::getInstance().Update();
+        UpdateScene(frame);
+        renderer.DrawScene();
+        renderer.EndFrame();
+        profiler.EndFrame();
+        // Nothing gets presented, so every frame waits for the GPU to finish it instead
+        GL_CALL(glad_glFinish());
+        recordArrivedFrames();
+    }
+
+    std::vector<unsigned char> image((size_t)IMAGE_WIDTH * IMAGE_HEIGHT * 4);
+    GL_CALL(glad_glPixelStorei(GL_PACK_ALIGNMENT, 1));
+    GL_CALL(glad_glReadPixels(0, 0, IMAGE_WIDTH, IMAGE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, image.data()));
+    profiler.BeginFrame();
+    profiler.EndFrame();
+    recordArrivedFrames();
+
+    // The warmup frames stay in the written frame times, they're only left out of the stats
+    BenchmarkSettings settings;
+    BenchmarkRunner runner(settings);
+    const size_t firstMeasuredFrame = std::min((size_t)options.numOfWarmupFrames, frameTimes.cpu.size());
+    std::vector<double> gpuTimes;
+    for(size_t i = firstMeasuredFrame; i < frameTimes.gpu.size(); i++)
+    {
+        if(frameTimes.gpu[i] >= 0.0)
+            gpuTimes.push_back(frameTimes.gpu[i]);
+    }
+    runner.AddResult("frame_cpu", std::vector<double>(frameTimes.cpu.begin() + firstMeasuredFrame, frameTimes.cpu.end()));
+    if(!gpuTimes.empty())
+        runner.AddResult("frame_gpu", gpuTimes);
+
+    profiler.DeInit();
+    renderer.DeInit();
+    GL_CALL(glad_glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    GL_CALL(glad_glDeleteFramebuffers(1, &framebuffer));
+    GL_CALL(glad_glDeleteRenderbuffers(1, &colorBuffer));
+    GL_CALL(glad_glDeleteRenderbuffers(1, &depthBuffer));
+    HeadlessContext::DeInit();
+
+    WritePNG(options.outDirectory + "regression_image.png", image);
+    WriteFrameTimes(options.outDirectory + "regression_frame_times.json", frameTimes);
+    runner.SaveJSON(options.outDirectory + "regression_results.json");
+    if(options.update)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(options.goldenDirectory, error);
+        const bool updated = WritePNG(options.goldenDirectory + "golden.png", image) && runner.SaveJSON(options.goldenDirectory + "frame_time_baseline.json");
+        printf(updated ? "Golden image and frame times updated in %s\n" : "Failed to update the golden files in %s\n", options.goldenDirectory.c_str());
+        return updated ? 0 : 1;
+    }
+
+    bool passed = true;
+
+    int goldenWidth = 0, goldenHeight = 0;
+    stbi_set_flip_vertically_on_load(1);
+    unsigned char *golden = stbi_load((options.goldenDirectory + "golden.png").c_str(), &goldenWidth, &goldenHeight, nullptr, 4);
+    stbi_set_flip_vertically_on_load(0);
+    if(golden == nullptr || goldenWidth != (int)IMAGE_WIDTH || goldenHeight != (int)IMAGE_HEIGHT)
+    {
+        printf("\nNo %ux%u golden image in %s, run with --update on the reference machine to make one\n", IMAGE_WIDTH, IMAGE_HEIGHT, options.goldenDirectory.c_str());
+        passed = false;
+    }
+    else
+    {
+        std::vector<unsigned char> diff;
+        const unsigned int numOfPixels = IMAGE_WIDTH * IMAGE_HEIGHT;
+        const ImageComparison comparison = CompareImages(image.data(), golden, numOfPixels, options.maxDeltaE, diff);
+        const double differentPixels = (double)comparison.numOfDifferentPixels / numOfPixels;
+        const bool imagePassed = differentPixels <= options.maxDifferentPixels;
+        printf("\nImage: %u different pixels (%.3f%%, %.3f%% allowed), average delta E %.3f, max %.3f: %s\n", comparison.numOfDifferentPixels,
+               differentPixels * 100.0, options.maxDifferentPixels * 100.0, comparison.averageDeltaE, comparison.maxDeltaE, imagePassed ? "passed" : "FAILED");
+        if(!imagePassed)
+        {
+            WritePNG(options.outDirectory + "regression_diff.png", diff);
+            passed = false;
+        }
+    }
+    stbi_image_free(golden);
+
+    const int numOfRegressions = runner.CompareWithBaseline(options.goldenDirectory + "frame_time_baseline.json", options.frameTimeThreshold);
+    if(numOfRegressions != 0)
+        passed = false;
+
+    printf("%s\n", passed ? "Regression test passed" : "Regression test FAILED");
+    return passed ? 0 : 1;
+}
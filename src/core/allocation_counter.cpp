@@ -0,0 +1,53 @@
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Replacements of the global allocation functions, the aligned ones are left to the standard library
+void *operator new(std::size_t size)
+{
+    AllocationCounter::OnAllocation(size);
+    // Zero sized allocations still have to return a unique pointer
+    void *pointer = std::malloc(size == 0 ? 1 : size);
+    if(pointer == nullptr)
+        throw std::bad_alloc();
+    return pointer;
+}
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    AllocationCounter::OnAllocation(size);
+    return std::malloc(size == 0 ? 1 : size);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    std::free(pointer);
+}
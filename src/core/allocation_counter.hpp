@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/*
+Counts the allocations that go through the global operator new, which allocation_counter.cpp replaces.
+Allocations made straight through malloc (eg. by stb_image) or by the driver aren't counted.
+The counts only ever go up, compare two reads of them to get the allocations in between.
+*/
+class AllocationCounter final
+{
+    private:
+    inline static std::atomic<unsigned long long> _numOfAllocations{0};
+    inline static std::atomic<unsigned long long> _allocatedBytes{0};
+
+    private:
+    AllocationCounter() {}
+    ~AllocationCounter() {}
+
+    public:
+    static unsigned long long getNumOfAllocations() { return _numOfAllocations.load(std::memory_order_relaxed); }
+    static unsigned long long getAllocatedBytes() { return _allocatedBytes.load(std::memory_order_relaxed); }
+
+    static void OnAllocation(size_t size)
+    {
+        _numOfAllocations.fetch_add(1, std::memory_order_relaxed);
+        _allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,265 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+void BVH::Build(const std::vector<AABB> &primitiveBounds)
+{
+    _primitiveBounds = primitiveBounds;
+    Rebuild();
+}
+
+void BVH::Clear()
+{
+    _nodes.clear();
+    _primitiveBounds.clear();
+    _primitiveOrder.clear();
+    _primitiveNodes.clear();
+    _dirtyNodes.clear();
+    _lastDirtyNode = 0;
+    _hasDirtyNodes = false;
+    _cost = 0.0f;
+    _buildCost = 0.0f;
+}
+
+void BVH::Rebuild()
+{
+    const unsigned int numOfPrimitives = (unsigned int)_primitiveBounds.size();
+
+    _nodes.clear();
+    _primitiveOrder.resize(numOfPrimitives);
+    std::iota(_primitiveOrder.begin(), _primitiveOrder.end(), 0);
+    _primitiveNodes.assign(numOfPrimitives, INVALID_NODE);
+    _cost = 0.0f;
+
+    if(numOfPrimitives != 0)
+        BuildNode(0, numOfPrimitives, INVALID_NODE);
+
+    _dirtyNodes.assign(_nodes.size(), false);
+    _lastDirtyNode = 0;
+    _hasDirtyNodes = false;
+    _buildCost = _cost;
+    _numOfRebuilds++;
+}
+
+unsigned int BVH::BuildNode(unsigned int firstPrimitive, unsigned int numOfPrimitives, unsigned int parent)
+{
+    const unsigned int nodeIndex = (unsigned int)_nodes.size();
+    _nodes.emplace_back();
+    _nodes[nodeIndex].parent = parent;
+
+    // Splits a range in half at the median of the primitive centers along the axis they're the most spread out on
+    auto splitRange = [this](unsigned int first, unsigned int count)
+    {
+        glm::vec3 minCenter = _primitiveBounds[_primitiveOrder[first]].GetCenter();
+        glm::vec3 maxCenter = minCenter;
+        for(unsigned int i = first + 1; i < first + count; i++)
+        {
+            const glm::vec3 center = _primitiveBounds[_primitiveOrder[i]].GetCenter();
+            minCenter = glm::min(minCenter, center);
+            maxCenter = glm::max(maxCenter, center);
+        }
+        const glm::vec3 spread = maxCenter - minCenter;
+        const int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+
+        const unsigned int half = count / 2;
+        std::nth_element(_primitiveOrder.begin() + first, _primitiveOrder.begin() + first + half, _primitiveOrder.begin() + first + count,
+            [this, axis](unsigned int a, unsigned int b)
+            {
+                return _primitiveBounds[a].min[axis] + _primitiveBounds[a].max[axis] < _primitiveBounds[b].min[axis] + _primitiveBounds[b].max[axis];
+            });
+        return half;
+    };
+
+    // Up to 4 children, made by splitting the range in half and then splitting the halves that are too big for a leaf again
+    unsigned int childFirst[4], childCount[4];
+    unsigned int numOfChildren = 0;
+    if(numOfPrimitives <= MAX_LEAF_SIZE)
+    {
+        childFirst[numOfChildren] = firstPrimitive;
+        childCount[numOfChildren++] = numOfPrimitives;
+    }
+    else
+    {
+        const unsigned int half = splitRange(firstPrimitive, numOfPrimitives);
+        const unsigned int halfFirst[2] = { firstPrimitive, firstPrimitive + half };
+        const unsigned int halfCount[2] = { half, numOfPrimitives - half };
+        for(int i = 0; i < 2; i++)
+        {
+            if(halfCount[i] <= MAX_LEAF_SIZE)
+            {
+                childFirst[numOfChildren] = halfFirst[i];
+                childCount[numOfChildren++] = halfCount[i];
+                continue;
+            }
+
+            const unsigned int quarter = splitRange(halfFirst[i], halfCount[i]);
+            childFirst[numOfChildren] = halfFirst[i];
+            childCount[numOfChildren++] = quarter;
+            childFirst[numOfChildren] = halfFirst[i] + quarter;
+            childCount[numOfChildren++] = halfCount[i] - quarter;
+        }
+    }
+
+    for(unsigned int child = 0; child < 4; child++)
+    {
+        // Building the children can move the nodes around in memory, so no holding on to a reference
+        if(child >= numOfChildren)
+        {
+            _nodes[nodeIndex].children[child] = INVALID_NODE;
+            _nodes[nodeIndex].firstPrimitive[child] = 0;
+            _nodes[nodeIndex].numOfPrimitives[child] = 0;
+            _nodes[nodeIndex].childBounds.Set(child, AABB());
+            continue;
+        }
+
+        unsigned int childNode = INVALID_NODE;
+        AABB bounds;
+        if(childCount[child] <= MAX_LEAF_SIZE)
+        {
+            for(unsigned int i = childFirst[child]; i < childFirst[child] + childCount[child]; i++)
+                _primitiveNodes[_primitiveOrder[i]] = nodeIndex;
+            bounds = GetRangeBounds(childFirst[child], childCount[child]);
+        }
+        else
+        {
+            childNode = BuildNode(childFirst[child], childCount[child], nodeIndex);
+            bounds = GetNodeBounds(_nodes[childNode]);
+        }
+
+        Node &node = _nodes[nodeIndex];
+        node.children[child] = childNode;
+        node.firstPrimitive[child] = childFirst[child];
+        node.numOfPrimitives[child] = childCount[child];
+        node.childBounds.Set(child, bounds);
+        _cost += bounds.GetHalfArea();
+    }
+    _nodes[nodeIndex].numOfChildren = numOfChildren;
+
+    return nodeIndex;
+}
+
+AABB BVH::GetRangeBounds(unsigned int firstPrimitive, unsigned int numOfPrimitives) const
+{
+    AABB bounds = _primitiveBounds[_primitiveOrder[firstPrimitive]];
+    for(unsigned int i = firstPrimitive + 1; i < firstPrimitive + numOfPrimitives; i++)
+        bounds = MergeAABBs(bounds, _primitiveBounds[_primitiveOrder[i]]);
+    return bounds;
+}
+
+AABB BVH::GetNodeBounds(const Node &node) const
+{
+    AABB bounds = node.childBounds.Get(0);
+    for(unsigned int child = 1; child < node.numOfChildren; child++)
+        bounds = MergeAABBs(bounds, node.childBounds.Get(child));
+    return bounds;
+}
+
+void BVH::UpdatePrimitive(unsigned int primitive, const AABB &bounds)
+{
+    _primitiveBounds[primitive] = bounds;
+    MarkDirty(_primitiveNodes[primitive]);
+}
+
+void BVH::MarkDirty(unsigned int node)
+{
+    _dirtyNodes[node] = true;
+    _lastDirtyNode = _hasDirtyNodes ? std::max(_lastDirtyNode, node) : node;
+    _hasDirtyNodes = true;
+}
+
+bool BVH::Refit()
+{
+    if(!_hasDirtyNodes)
+        return false;
+
+    // Backwards, so that every node is refit after all of its children. The parents are always before their children,
+    // so the dirty flags only ever spread towards the nodes that haven't been visited yet
+    for(unsigned int nodeIndex = _lastDirtyNode + 1; nodeIndex-- > 0;)
+    {
+        if(!_dirtyNodes[nodeIndex])
+            continue;
+        _dirtyNodes[nodeIndex] = false;
+
+        Node &node = _nodes[nodeIndex];
+        for(unsigned int child = 0; child < node.numOfChildren; child++)
+        {
+            const AABB bounds = node.children[child] == INVALID_NODE ? GetRangeBounds(node.firstPrimitive[child], node.numOfPrimitives[child]) : GetNodeBounds(_nodes[node.children[child]]);
+            _cost += bounds.GetHalfArea() - node.childBounds.Get(child).GetHalfArea();
+            node.childBounds.Set(child, bounds);
+        }
+
+        if(node.parent != INVALID_NODE)
+            _dirtyNodes[node.parent] = true;
+    }
+    _hasDirtyNodes = false;
+
+    // Objects that moved apart from the ones they were grouped with make the boxes above them big and mostly empty
+    if(_cost > _buildCost * REBUILD_COST_RATIO)
+    {
+        Rebuild();
+        return true;
+    }
+    return false;
+}
+
+void BVH::AppendRange(const Node &node, unsigned int child, std::vector<unsigned int> &visiblePrimitives) const
+{
+    const unsigned int first = node.firstPrimitive[child];
+    visiblePrimitives.insert(visiblePrimitives.end(), _primitiveOrder.begin() + first, _primitiveOrder.begin() + first + node.numOfPrimitives[child]);
+}
+
+void BVH::Cull(const Frustum &frustum, std::vector<unsigned int> &visiblePrimitives) const
+{
+    if(_nodes.empty())
+        return;
+
+    // Every level pushes at most 4 nodes and the median splits keep the depth logarithmic
+    unsigned int stack[128];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize != 0)
+    {
+        const Node &node = _nodes[stack[--stackSize]];
+
+        int insideMask;
+        const int visibleMask = FrustumTestAABBs4(frustum, node.childBounds, insideMask) & ((1 << node.numOfChildren) - 1);
+        for(unsigned int child = 0; child < node.numOfChildren; child++)
+        {
+            if(!(visibleMask & (1 << child)))
+                continue;
+
+            // Everything under a box that's fully inside is visible without testing any further
+            if(insideMask & (1 << child))
+            {
+                AppendRange(node, child, visiblePrimitives);
+            }
+            else if(node.children[child] != INVALID_NODE)
+            {
+                stack[stackSize++] = node.children[child];
+            }
+            else if(node.numOfPrimitives[child] == 1)
+            {
+                visiblePrimitives.push_back(_primitiveOrder[node.firstPrimitive[child]]);
+            }
+            else
+            {
+                // A leaf that's only partially inside, test its primitives on their own
+                const unsigned int first = node.firstPrimitive[child];
+                const unsigned int count = node.numOfPrimitives[child];
+                AABB4 primitiveBounds;
+                for(unsigned int lane = 0; lane < 4; lane++)
+                    primitiveBounds.Set(lane, _primitiveBounds[_primitiveOrder[first + std::min(lane, count - 1)]]);
+
+                int primitivesInsideMask;
+                const int primitivesVisibleMask = FrustumTestAABBs4(frustum, primitiveBounds, primitivesInsideMask);
+                for(unsigned int lane = 0; lane < count; lane++)
+                {
+                    if(primitivesVisibleMask & (1 << lane))
+                        visiblePrimitives.push_back(_primitiveOrder[first + lane]);
+                }
+            }
+        }
+    }
+}
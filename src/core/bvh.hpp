@@ -0,0 +1,82 @@
+#pragma once
+
+#include "misc/bounds.hpp"
+
+#include <vector>
+
+/*
+Bounding volume hierarchy over the world space boxes of a set of primitives (eg. the scene's renderables),
+used to frustum cull whole groups of them at once.
+Every node has up to 4 children whose boxes are stored next to each other, so that one SIMD test covers all of them.
+A child is either another node or a leaf of up to MAX_LEAF_SIZE primitives.
+The nodes are stored parents before children, so moving primitives only refits the nodes above them
+in a single backwards pass. Refitting makes the boxes looser over time, so the tree gets rebuilt
+once its cost grows too far past what it was right after the last build.
+*/
+class BVH final
+{
+    public:
+    static constexpr unsigned int MAX_LEAF_SIZE = 4;
+    // How much worse than right after the build the tree can get before it gets rebuilt
+    static constexpr float REBUILD_COST_RATIO = 2.0f;
+
+    private:
+    static constexpr unsigned int INVALID_NODE = 0xFFFFFFFF;
+
+    struct Node final
+    {
+        AABB4 childBounds;
+        // The index of the child node, or INVALID_NODE if the child is a leaf
+        unsigned int children[4];
+        // The range of _primitiveOrder every child covers, which for nodes is the whole subtree
+        unsigned int firstPrimitive[4];
+        unsigned int numOfPrimitives[4];
+        unsigned int numOfChildren;
+        unsigned int parent;
+    };
+
+    std::vector<Node> _nodes;
+    std::vector<AABB> _primitiveBounds;
+    // The primitives in the order the leaves refer to them in
+    std::vector<unsigned int> _primitiveOrder;
+    // The node each primitive's leaf is in
+    std::vector<unsigned int> _primitiveNodes;
+
+    std::vector<unsigned char> _dirtyNodes;
+    // No node after this one is dirty
+    unsigned int _lastDirtyNode = 0;
+    bool _hasDirtyNodes = false;
+
+    // Sum of the surface areas of every child box
+    float _cost = 0.0f;
+    float _buildCost = 0.0f;
+    unsigned int _numOfRebuilds = 0;
+
+    public:
+    // Builds the tree from scratch over the given primitive boxes
+    void Build(const std::vector<AABB> &primitiveBounds);
+    void Clear();
+
+    // Changes the box of a primitive, the tree gets refit on the next Refit()
+    void UpdatePrimitive(unsigned int primitive, const AABB &bounds);
+    // Refits the nodes above the primitives that changed, or rebuilds the whole tree if it got too loose.
+    // Returns whether it had to be rebuilt
+    bool Refit();
+
+    // Appends the primitives whose boxes are at least partially inside the frustum
+    void Cull(const Frustum &frustum, std::vector<unsigned int> &visiblePrimitives) const;
+
+    inline size_t getNumOfPrimitives() const { return _primitiveBounds.size(); }
+    inline size_t getNumOfNodes() const { return _nodes.size(); }
+    inline unsigned int getNumOfRebuilds() const { return _numOfRebuilds; }
+    inline const AABB &getPrimitiveBounds(unsigned int primitive) const { return _primitiveBounds[primitive]; }
+
+    private:
+    void Rebuild();
+    // Splits the range of _primitiveOrder into a node, returns its index
+    unsigned int BuildNode(unsigned int firstPrimitive, unsigned int numOfPrimitives, unsigned int parent);
+    AABB GetRangeBounds(unsigned int firstPrimitive, unsigned int numOfPrimitives) const;
+    AABB GetNodeBounds(const Node &node) const;
+    void MarkDirty(unsigned int node);
+    void AppendRange(const Node &node, unsigned int child, std::vector<unsigned int> &visiblePrimitives) const;
+};
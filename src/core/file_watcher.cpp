@@ -0,0 +1,106 @@
+#include "file_watcher.hpp"
+
+#include "log.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+static std::string GetDirectory(const std::string &path)
+{
+    size_t lastSlash = path.find_last_of("/\\");
+    return lastSlash == std::string::npos ? "." : path.substr(0, lastSlash);
+}
+
+void FileWatcher::Init()
+{
+#ifdef __linux__
+    _inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(_inotifyFD == -1)
+        Log::LogWarning("Couldn't initialize inotify, resources won't be hot reloaded");
+#else
+    Log::LogInfo("File watching isn't supported on this platform, resources won't be hot reloaded");
+#endif
+}
+void FileWatcher::DeInit()
+{
+#ifdef __linux__
+    if(_inotifyFD != -1)
+        close(_inotifyFD);
+#endif
+    _inotifyFD = -1;
+    _watchedDirectories.clear();
+    _watchedFiles.clear();
+    _pendingChanges.clear();
+}
+
+void FileWatcher::Watch(const std::string &path)
+{
+    if(_inotifyFD == -1 || !_watchedFiles.insert(path).second)
+        return;
+
+#ifdef __linux__
+    const std::string directory = GetDirectory(path);
+    for(const auto &watchedDirectory: _watchedDirectories)
+    {
+        if(watchedDirectory.second == directory)
+            return;
+    }
+
+    int watchDescriptor = inotify_add_watch(_inotifyFD, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if(watchDescriptor == -1)
+    {
+        Log::LogWarning("Couldn't watch directory '" + directory + "' for changes");
+        return;
+    }
+    _watchedDirectories[watchDescriptor] = directory;
+#endif
+}
+
+std::vector<std::string> FileWatcher::PollChanges()
+{
+    std::vector<std::string> changedFiles;
+    if(_inotifyFD == -1)
+        return changedFiles;
+
+#ifdef __linux__
+    // Drain every event that has queued up since the last poll
+    alignas(inotify_event) char buffer[4096];
+    while(true)
+    {
+        ssize_t length = read(_inotifyFD, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+
+        for(char *eventPtr = buffer; eventPtr < buffer + length;)
+        {
+            const inotify_event *event = (const inotify_event*)eventPtr;
+            eventPtr += sizeof(inotify_event) + event->len;
+
+            auto directory = _watchedDirectories.find(event->wd);
+            if(event->len == 0 || directory == _watchedDirectories.end())
+                continue;
+
+            std::string path = directory->second + "/" + event->name;
+            if(_watchedFiles.count(path) != 0)
+                _pendingChanges[path] = Clock::now();
+        }
+    }
+#endif
+
+    const Clock::time_point now = Clock::now();
+    for(auto it = _pendingChanges.begin(); it != _pendingChanges.end();)
+    {
+        if(now - it->second >= debounceTime)
+        {
+            changedFiles.push_back(it->first);
+            it = _pendingChanges.erase(it);
+        }
+        else
+            it++;
+    }
+
+    return changedFiles;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+Watches files for changes so that resources can be reloaded while the app is running.
+The directories containing the files are watched rather than the files themselves
+because many editors save by writing a new file and renaming it over the old one.
+Only implemented on Linux (inotify), elsewhere nothing is ever reported as changed.
+*/
+class FileWatcher final : public Singleton<FileWatcher>
+{
+    friend class Singleton<FileWatcher>;
+
+    private:
+    using Clock = std::chrono::steady_clock;
+
+    int _inotifyFD = -1;
+    // inotify watch descriptor -> watched directory
+    std::unordered_map<int, std::string> _watchedDirectories;
+    std::unordered_set<std::string> _watchedFiles;
+    // Changed files and when the last change to them happened.
+    // A file only gets reported once it's been quiet for the debounce time
+    // because saving a file usually fires several events in a row
+    std::unordered_map<std::string, Clock::time_point> _pendingChanges;
+
+    public:
+    std::chrono::milliseconds debounceTime = std::chrono::milliseconds(200);
+
+    private:
+    FileWatcher() = default;
+    ~FileWatcher() = default;
+
+    public:
+    void Init();
+    void DeInit();
+
+    void Watch(const std::string &path);
+    // Returns the watched files that changed and have settled since the last call. Never blocks
+    std::vector<std::string> PollChanges();
+};
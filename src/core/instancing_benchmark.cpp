@@ -0,0 +1,114 @@
+#include "instancing_benchmark.hpp"
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "core/log.hpp"
+#include "core/scene.hpp"
+#include "rendering/renderer.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+void InstancingBenchmark::Start()
+{
+    if(_isRunning)
+        return;
+
+    Scene &scene = Scene::getInstance();
+    RendererSettings &settings = Renderer::getInstance().settings;
+    _numOfSceneRenderables = scene.renderables.size();
+    _numOfSceneEntities = scene.transforms.getNumOfEntities();
+    _wasInstancing = settings.instancing;
+    _wasFrustumCulling = settings.frustumCulling;
+
+    _results.clear();
+    _step = 0;
+    _isRunning = true;
+    BeginStep();
+}
+
+void InstancingBenchmark::Stop()
+{
+    if(!_isRunning)
+        return;
+
+    RestoreScene();
+    _isRunning = false;
+}
+
+void InstancingBenchmark::Update()
+{
+    if(!_isRunning)
+        return;
+
+    // The stats are of the previous frame, which is fine as long as it was drawn with the current step's setup
+    _frame++;
+    if(_frame <= WARMUP_FRAMES)
+        return;
+
+    const RendererStats &stats = Renderer::getInstance().stats;
+    _currentResult.cpuFrameTime += stats.frameTime / MEASURED_FRAMES;
+    _currentResult.gpuScenePassTime += stats.scenePassTime / MEASURED_FRAMES;
+    _currentResult.numOfDrawCalls += (float)stats.numOfDrawCalls / MEASURED_FRAMES;
+    if(_frame < WARMUP_FRAMES + MEASURED_FRAMES)
+        return;
+
+    _results.push_back(_currentResult);
+    _step++;
+    if(_step < NUM_OF_INSTANCE_COUNTS * 2)
+    {
+        BeginStep();
+        return;
+    }
+
+    Stop();
+    Log::LogInfo("Instancing benchmark results (instances, instanced, CPU frame ms, GPU scene pass ms, draw calls):");
+    for(const InstancingBenchmarkResult &result: _results)
+    {
+        char line[128];
+        snprintf(line, sizeof(line), "%6u  %-3s  %8.3f  %8.3f  %8.1f", result.numOfInstances, result.instanced ? "yes" : "no", result.cpuFrameTime, result.gpuScenePassTime, result.numOfDrawCalls);
+        Log::LogInfo(line);
+    }
+}
+
+void InstancingBenchmark::BeginStep()
+{
+    RestoreScene();
+
+    Scene &scene = Scene::getInstance();
+    RendererSettings &settings = Renderer::getInstance().settings;
+    settings.instancing = isCurrentStepInstanced();
+    settings.frustumCulling = false;
+
+    // A cube shaped grid of copies of the scene's model that fits into a 2.5 unit cube around the origin
+    const unsigned int numOfInstances = getCurrentNumOfInstances();
+    const unsigned int gridSize = (unsigned int)std::ceil(std::cbrt((float)numOfInstances));
+    const float spacing = 2.5f / gridSize;
+    const glm::vec3 scale = glm::vec3(spacing * 0.5f);
+    const glm::vec3 gridStart = glm::vec3(-1.25f + spacing * 0.5f);
+
+    scene.transforms.Reserve(_numOfSceneEntities + numOfInstances);
+    scene.renderables.reserve(_numOfSceneRenderables + numOfInstances);
+    for(unsigned int i = 0; i < numOfInstances; i++)
+    {
+        const glm::vec3 cell = glm::vec3(i % gridSize, (i / gridSize) % gridSize, i / (gridSize * gridSize));
+        const EntityID entity = scene.AddRenderable(nullptr, nullptr);
+        scene.transforms.SetPosition(entity, gridStart + cell * spacing);
+        scene.transforms.SetScale(entity, scale);
+    }
+
+    _currentResult = { numOfInstances, isCurrentStepInstanced(), 0.0f, 0.0f, 0.0f };
+    _frame = 0;
+}
+
+void InstancingBenchmark::RestoreScene()
+{
+    Scene &scene = Scene::getInstance();
+    scene.renderables.resize(_numOfSceneRenderables);
+    scene.transforms.Truncate(_numOfSceneEntities);
+
+    RendererSettings &settings = Renderer::getInstance().settings;
+    settings.instancing = _wasInstancing;
+    settings.frustumCulling = _wasFrustumCulling;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+
+#include <cstddef>
+#include <vector>
+
+struct InstancingBenchmarkResult final
+{
+    unsigned int numOfInstances;
+    bool instanced;
+    // Averages over the measured frames, in milliseconds
+    float cpuFrameTime;
+    float gpuScenePassTime;
+    float numOfDrawCalls;
+};
+
+/*
+Measures how drawing scales with the number of copies of the scene's model, with and without instancing.
+Every instance count gets drawn for a few frames to warm up (and for the instanced shader variant to compile)
+and then measured for a fixed number of frames. The copies are laid out in a grid in front of the camera
+and frustum culling is turned off for the duration so that all of them get drawn.
+The scene and renderer settings are put back the way they were once it's done and the results get logged.
+*/
+class InstancingBenchmark final : public Singleton<InstancingBenchmark>
+{
+    friend class Singleton<InstancingBenchmark>;
+
+    public:
+    static constexpr unsigned int INSTANCE_COUNTS[] = { 1, 10, 100, 1000, 10000, 100000 };
+    static constexpr unsigned int NUM_OF_INSTANCE_COUNTS = sizeof(INSTANCE_COUNTS) / sizeof(INSTANCE_COUNTS[0]);
+    static constexpr unsigned int WARMUP_FRAMES = 30;
+    static constexpr unsigned int MEASURED_FRAMES = 120;
+
+    private:
+    bool _isRunning = false;
+    // Every instance count is run twice, without and then with instancing
+    unsigned int _step = 0;
+    unsigned int _frame = 0;
+    InstancingBenchmarkResult _currentResult;
+
+    // What gets restored afterwards
+    size_t _numOfSceneRenderables = 0;
+    size_t _numOfSceneEntities = 0;
+    bool _wasInstancing = true;
+    bool _wasFrustumCulling = true;
+
+    std::vector<InstancingBenchmarkResult> _results;
+
+    private:
+    InstancingBenchmark() = default;
+    ~InstancingBenchmark() = default;
+
+    public:
+    void Start();
+    void Stop();
+    // Advances the benchmark, called once per frame before the scene is drawn
+    void Update();
+
+    inline bool isRunning() const { return _isRunning; }
+    inline unsigned int getCurrentNumOfInstances() const { return INSTANCE_COUNTS[_step / 2]; }
+    inline bool isCurrentStepInstanced() const { return _step % 2 == 1; }
+    inline const std::vector<InstancingBenchmarkResult> &getResults() const { return _results; }
+
+    private:
+    void BeginStep();
+    // Removes the copies and puts the settings back
+    void RestoreScene();
+};
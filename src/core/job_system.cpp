@@ -0,0 +1,319 @@
+#include "job_system.hpp"
+
+#include "core/trace.hpp"
+
+#include <algorithm>
+
+// Which worker the calling thread is, 0 for the threads that aren't workers
+static thread_local unsigned int t_workerIndex = 0;
+
+bool JobCounter::IsDone() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numOfPending == 0;
+}
+
+JobSystem::~JobSystem()
+{
+    DeInit();
+}
+
+void JobSystem::Init(unsigned int numOfThreads)
+{
+    DeInit();
+
+    if(numOfThreads == AUTO_NUM_OF_THREADS)
+    {
+        const unsigned int numOfCores = std::thread::hardware_concurrency();
+        numOfThreads = numOfCores > 1 ? numOfCores - 1 : 0;
+    }
+    numOfThreads = std::min(numOfThreads, MAX_WORKERS - 1);
+
+    _queues.clear();
+    for(unsigned int i = 0; i < numOfThreads + 1; i++)
+        _queues.push_back(std::make_unique<WorkerQueue>());
+    SetGLThread();
+
+    _stopWorkers = false;
+    for(unsigned int i = 0; i < numOfThreads; i++)
+        _workerThreads.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+}
+
+void JobSystem::DeInit()
+{
+    // Whatever's still queued gets run by the calling thread, the GL thread's jobs included if it's the GL thread
+    while(TryRunJob())
+        ;
+
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stopWorkers = true;
+    }
+    _workAvailable.notify_all();
+    for(std::thread &thread: _workerThreads)
+        thread.join();
+
+    _workerThreads.clear();
+    _queues.clear();
+}
+
+void JobSystem::Run(const char *name, std::function<void()> function, JobCounter *counter)
+{
+    AddPending(counter);
+    Job job = { name, std::move(function), counter };
+    // Without workers there's nothing to hand the job to
+    if(_workerThreads.empty())
+    {
+        Execute(job);
+        return;
+    }
+    Push(std::move(job));
+}
+
+void JobSystem::RunAfter(JobCounter &dependency, const char *name, std::function<void()> function, JobCounter *counter)
+{
+    AddPending(counter);
+    {
+        std::lock_guard<std::mutex> lock(dependency._mutex);
+        if(dependency._numOfPending > 0)
+        {
+            dependency._continuations.push_back({ name, std::move(function), counter });
+            return;
+        }
+    }
+
+    Job job = { name, std::move(function), counter };
+    if(_workerThreads.empty())
+        Execute(job);
+    else
+        Push(std::move(job));
+}
+
+void JobSystem::RunOnGLThread(const char *name, std::function<void()> function, JobCounter *counter)
+{
+    AddPending(counter);
+    std::lock_guard<std::mutex> lock(_glThreadMutex);
+    _glThreadJobs.push_back({ name, std::move(function), counter });
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+    TRACE_ZONE("Wait for jobs");
+    while(!counter.IsDone())
+    {
+        // Nothing left to help with, the last jobs are still running on the other threads
+        if(!TryRunJob())
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor(const char *name, unsigned int begin, unsigned int end, unsigned int minBatchSize,
+                            const std::function<void(unsigned int begin, unsigned int end)> &function)
+{
+    if(begin >= end)
+        return;
+
+    // A few batches per worker so that the ones that finish early can steal from the ones that don't
+    const unsigned int numOfItems = end - begin;
+    const unsigned int maxNumOfBatches = getNumOfWorkers() == 1 ? 1 : getNumOfWorkers() * 4;
+    const unsigned int numOfBatches = std::max(1u, std::min(numOfItems / std::max(minBatchSize, 1u), maxNumOfBatches));
+    if(numOfBatches == 1)
+    {
+        function(begin, end);
+        return;
+    }
+
+    JobCounter counter;
+    for(unsigned int batch = 1; batch < numOfBatches; batch++)
+    {
+        const unsigned int batchBegin = begin + (unsigned int)((unsigned long long)numOfItems * batch / numOfBatches);
+        const unsigned int batchEnd = begin + (unsigned int)((unsigned long long)numOfItems * (batch + 1) / numOfBatches);
+        Run(name, [&function, batchBegin, batchEnd]{ function(batchBegin, batchEnd); }, &counter);
+    }
+    function(begin, begin + (unsigned int)(numOfItems / numOfBatches));
+    Wait(counter);
+}
+
+void JobSystem::SetGLThread()
+{
+    std::lock_guard<std::mutex> lock(_glThreadMutex);
+    _glThread = std::this_thread::get_id();
+}
+
+bool JobSystem::IsGLThread() const
+{
+    // Before Init() there's nothing that could run the GL jobs other than the thread that waits for them
+    return _glThread == std::thread::id() || std::this_thread::get_id() == _glThread;
+}
+
+void JobSystem::ExecuteGLThreadJobs()
+{
+    TRACE_ZONE("GL thread jobs");
+    std::deque<Job> jobs;
+    {
+        std::lock_guard<std::mutex> lock(_glThreadMutex);
+        jobs.swap(_glThreadJobs);
+    }
+    for(Job &job: jobs)
+    {
+        Execute(job);
+        _numOfGLThreadJobs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void JobSystem::EndFrame()
+{
+    _lastFrameStats.numOfJobs = _numOfJobs.exchange(0, std::memory_order_relaxed);
+    _lastFrameStats.numOfStolenJobs = _numOfStolenJobs.exchange(0, std::memory_order_relaxed);
+    _lastFrameStats.numOfGLThreadJobs = _numOfGLThreadJobs.exchange(0, std::memory_order_relaxed);
+}
+
+unsigned int JobSystem::GetWorkerIndex()
+{
+    return t_workerIndex;
+}
+
+void JobSystem::WorkerLoop(unsigned int worker)
+{
+    TRACE_THREAD_NAME("Job worker");
+    t_workerIndex = worker;
+
+    Job job;
+    while(true)
+    {
+        if(TryPop(worker, job))
+        {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _workAvailable.wait(lock, [this]{ return _stopWorkers || _numOfQueuedJobs.load() > 0; });
+        if(_stopWorkers && _numOfQueuedJobs.load() == 0)
+            return;
+    }
+}
+
+void JobSystem::Push(Job &&job)
+{
+    WorkerQueue &queue = *_queues[t_workerIndex];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    // Taking the lock makes sure a worker that's about to sleep either sees the job or gets the notification
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _numOfQueuedJobs++;
+    }
+    _workAvailable.notify_one();
+}
+
+bool JobSystem::TryPop(unsigned int worker, Job &job)
+{
+    if(_numOfQueuedJobs.load() == 0)
+        return false;
+
+    // The newest job of the worker's own queue first
+    {
+        WorkerQueue &queue = *_queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty())
+        {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            _numOfQueuedJobs--;
+            return true;
+        }
+    }
+
+    // Then the oldest job of any other queue, starting after the worker's own so that the workers don't all go for the same one
+    const unsigned int numOfQueues = (unsigned int)_queues.size();
+    for(unsigned int i = 1; i < numOfQueues; i++)
+    {
+        WorkerQueue &queue = *_queues[(worker + i) % numOfQueues];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.jobs.empty())
+        {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            _numOfQueuedJobs--;
+            _numOfStolenJobs.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::TryRunJob()
+{
+    if(IsGLThread())
+    {
+        Job job;
+        bool hasJob = false;
+        {
+            std::lock_guard<std::mutex> lock(_glThreadMutex);
+            if(!_glThreadJobs.empty())
+            {
+                job = std::move(_glThreadJobs.front());
+                _glThreadJobs.pop_front();
+                hasJob = true;
+            }
+        }
+        if(hasJob)
+        {
+            Execute(job);
+            _numOfGLThreadJobs.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    if(_queues.empty())
+        return false;
+    Job job;
+    if(!TryPop(t_workerIndex, job))
+        return false;
+    Execute(job);
+    return true;
+}
+
+void JobSystem::Execute(Job &job)
+{
+    {
+        TRACE_ZONE(job.name);
+        job.function();
+    }
+    _numOfJobs.fetch_add(1, std::memory_order_relaxed);
+    FinishPending(job.counter);
+    job.function = nullptr;
+}
+
+void JobSystem::AddPending(JobCounter *counter)
+{
+    if(counter == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(counter->_mutex);
+    counter->_numOfPending++;
+}
+
+void JobSystem::FinishPending(JobCounter *counter)
+{
+    if(counter == nullptr)
+        return;
+
+    std::vector<Job> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->_mutex);
+        // The continuations are taken out under the same lock that makes the counter done,
+        // a waiter can destroy the counter as soon as it's let go of
+        if(--counter->_numOfPending == 0)
+            continuations.swap(counter->_continuations);
+    }
+    for(Job &continuation: continuations)
+    {
+        if(_workerThreads.empty())
+            Execute(continuation);
+        else
+            Push(std::move(continuation));
+    }
+}
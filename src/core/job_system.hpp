@@ -0,0 +1,146 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobCounter;
+
+struct Job final
+{
+    // Shows up in the trace. Has to be a string literal
+    const char *name = nullptr;
+    std::function<void()> function;
+    // Counted down once the job has finished, can be nullptr
+    JobCounter *counter = nullptr;
+};
+
+/*
+Counts the jobs that were started with it and haven't finished yet, so that they can be waited on
+or made the dependency of other jobs (see JobSystem::RunAfter()). Has to outlive the jobs it counts.
+*/
+class JobCounter final
+{
+    friend class JobSystem;
+
+    private:
+    mutable std::mutex _mutex;
+    unsigned int _numOfPending = 0;
+    // The jobs that get started once the count drops to 0
+    std::vector<Job> _continuations;
+
+    public:
+    JobCounter() = default;
+    // Copy
+    JobCounter(const JobCounter &other) = delete;
+    JobCounter &operator=(const JobCounter &other) = delete;
+
+    bool IsDone() const;
+};
+
+struct JobSystemStats final
+{
+    unsigned int numOfJobs = 0;
+    // The jobs a worker took from another worker's queue
+    unsigned int numOfStolenJobs = 0;
+    unsigned int numOfGLThreadJobs = 0;
+};
+
+/*
+Runs jobs across a fixed set of worker threads. Every worker has a queue of its own that it pushes onto and pops from the back of,
+so the jobs it started itself run while their data is still in its caches. A worker that runs out of jobs steals from the front
+of the others' queues, which is where the oldest (and usually biggest) jobs are. The threads that aren't workers share queue 0.
+Waiting on a counter never blocks: the waiting thread keeps running jobs until the ones it waits for are done, so waiting
+from within a job can't deadlock.
+Jobs that have to touch GL get queued for the GL thread, which runs them in ExecuteGLThreadJobs() once a frame
+and whenever it waits on a counter.
+Without worker threads (eg. before Init()) everything runs on the thread that starts it.
+*/
+class JobSystem final : public Singleton<JobSystem>
+{
+    friend class Singleton<JobSystem>;
+
+    public:
+    static constexpr unsigned int MAX_WORKERS = 64;
+    // Picks one worker thread less than there are cores when passed to Init()
+    static constexpr unsigned int AUTO_NUM_OF_THREADS = ~0u;
+
+    private:
+    struct WorkerQueue final
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // Queue 0 is shared by the threads that aren't workers, the worker threads are workers 1 and up
+    std::vector<std::unique_ptr<WorkerQueue>> _queues;
+    std::vector<std::thread> _workerThreads;
+    std::mutex _sleepMutex;
+    std::condition_variable _workAvailable;
+    std::atomic<unsigned int> _numOfQueuedJobs{0};
+    bool _stopWorkers = false;
+
+    std::mutex _glThreadMutex;
+    std::deque<Job> _glThreadJobs;
+    std::thread::id _glThread;
+
+    std::atomic<unsigned int> _numOfJobs{0};
+    std::atomic<unsigned int> _numOfStolenJobs{0};
+    std::atomic<unsigned int> _numOfGLThreadJobs{0};
+    JobSystemStats _lastFrameStats;
+
+    private:
+    JobSystem() = default;
+    ~JobSystem();
+
+    public:
+    // Spawns the worker threads (up to MAX_WORKERS - 1). AUTO_NUM_OF_THREADS leaves the calling thread a core of its own,
+    // 0 spawns none and runs every job inline on the thread that starts it. The calling thread becomes the GL thread
+    void Init(unsigned int numOfThreads = AUTO_NUM_OF_THREADS);
+    // Finishes the queued jobs and stops the worker threads
+    void DeInit();
+
+    void Run(const char *name, std::function<void()> function, JobCounter *counter = nullptr);
+    // Starts the job once every job of the dependency has finished
+    void RunAfter(JobCounter &dependency, const char *name, std::function<void()> function, JobCounter *counter = nullptr);
+    void RunOnGLThread(const char *name, std::function<void()> function, JobCounter *counter = nullptr);
+    // Runs jobs until every job of the counter has finished
+    void Wait(JobCounter &counter);
+    // Splits [begin, end) into ranges of at least minBatchSize and calls the function with each of them across the workers,
+    // the calling thread included. Returns once all of them are done
+    void ParallelFor(const char *name, unsigned int begin, unsigned int end, unsigned int minBatchSize,
+                     const std::function<void(unsigned int begin, unsigned int end)> &function);
+
+    // Makes the calling thread the one the GL jobs run on, eg. after the GL context was moved to another thread
+    void SetGLThread();
+    // Always true before Init()
+    bool IsGLThread() const;
+    // Runs the jobs that were queued for the GL thread, has to be called on it
+    void ExecuteGLThreadJobs();
+
+    // Called on the GL thread once at the end of every frame
+    void EndFrame();
+
+    inline unsigned int getNumOfWorkers() const { return (unsigned int)_workerThreads.size() + 1; }
+    inline const JobSystemStats &getLastFrameStats() const { return _lastFrameStats; }
+    // 0 on the threads that aren't workers
+    static unsigned int GetWorkerIndex();
+
+    private:
+    void WorkerLoop(unsigned int worker);
+    void Push(Job &&job);
+    // Pops a job off the worker's own queue, or steals one from another queue. Returns false if every queue is empty
+    bool TryPop(unsigned int worker, Job &job);
+    // Runs a job if there's one, the GL thread's included when called on it. Returns false if there wasn't any
+    bool TryRunJob();
+    void Execute(Job &job);
+    static void AddPending(JobCounter *counter);
+    void FinishPending(JobCounter *counter);
+};
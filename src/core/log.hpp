@@ -2,6 +2,7 @@
 
 #include <glad/glad.h>
 
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -102,14 +103,87 @@ class Log final
     }
 };
 
-static bool CheckError(char const* file, char const* function, int line)
+// How often glGetError() gets called. Each call can force a sync with the driver, so checking after every call isn't free
+enum class GLErrorCheckMode
 {
-    if (auto error = glGetError(); error != GL_NO_ERROR)
+    OFF = 0,
+    // Once at the end of every frame, only tells that something went wrong during the frame
+    PER_FRAME,
+    // After every GL_CALL, tells exactly which call went wrong
+    PER_CALL
+};
+
+// The most thorough error checking compiled in, set through the GL_ERROR_CHECKS CMake option (0 = off, 1 = per frame, 2 = per call).
+// Below 2, GL_CALL compiles down to the bare call
+#ifndef GL_ERROR_CHECK_LEVEL
+#ifdef _DEBUG
+#define GL_ERROR_CHECK_LEVEL 2
+#elif defined(GL_NO_ERROR_CONTEXT)
+// A KHR_no_error context doesn't report anything anyway
+#define GL_ERROR_CHECK_LEVEL 0
+#else
+#define GL_ERROR_CHECK_LEVEL 1
+#endif
+#endif
+
+// Reports every queued GL error. The message only gets built once there actually is an error
+inline bool CheckError(char const* file, char const* function, int line);
+
+class GLErrorChecks final
+{
+    private:
+    inline static GLErrorCheckMode _mode = (GLErrorCheckMode)GL_ERROR_CHECK_LEVEL;
+    // Every glGetError() call so far, the shader compiler's worker thread makes some too
+    inline static std::atomic<unsigned long long> _numOfErrorQueries{0};
+
+    private:
+    GLErrorChecks() {}
+    ~GLErrorChecks() {}
+
+    public:
+    // The mode can't be more thorough than what was compiled in
+    static void SetMode(GLErrorCheckMode mode)
+    {
+        _mode = (int)mode > GL_ERROR_CHECK_LEVEL ? (GLErrorCheckMode)GL_ERROR_CHECK_LEVEL : mode;
+    }
+    static GLErrorCheckMode GetMode() { return _mode; }
+    static unsigned long long GetNumOfErrorQueries() { return _numOfErrorQueries.load(std::memory_order_relaxed); }
+    static void OnErrorQueried() { _numOfErrorQueries.fetch_add(1, std::memory_order_relaxed); }
+
+    static void CheckCall(char const* file, char const* function, int line)
+    {
+        if(_mode == GLErrorCheckMode::PER_CALL)
+            CheckError(file, function, line);
+    }
+    // Called once at the end of every frame
+    static void CheckFrame()
+    {
+#if GL_ERROR_CHECK_LEVEL >= 1
+        if(_mode == GLErrorCheckMode::PER_FRAME)
+            CheckError(__FILE__, "end of frame (switch to per call checks to find the call)", __LINE__);
+#endif
+    }
+};
+
+inline bool CheckError(char const* file, char const* function, int line)
+{
+    bool success = true;
+    // Capped because a lost context keeps reporting an error forever
+    for(int i = 0; i < 16; i++)
     {
+        const GLenum error = glGetError();
+        GLErrorChecks::OnErrorQueried();
+        if(error == GL_NO_ERROR)
+            break;
+
         Log::LogError("OpenGL Error: " + std::to_string(error) + " : " + file + ":" + function + ":" + std::to_string(line));
-        return false;
+        success = false;
     }
-    return true;
+    return success;
 }
 
-#define GL_CALL(x) x; CheckError(__FILE__, #x, __LINE__);
\ No newline at end of file
+#if GL_ERROR_CHECK_LEVEL >= 2
+#define GL_CALL(x) x; GLErrorChecks::CheckCall(__FILE__, #x, __LINE__);
+#else
+#define GL_CALL(x) x;
+#endif
\ No newline at end of file
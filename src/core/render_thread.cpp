@@ -0,0 +1,83 @@
+#include "render_thread.hpp"
+
+#include "core/job_system.hpp"
+#include "core/trace.hpp"
+
+#include <utility>
+
+void RenderThread::Start(GLFWwindow *window, const DrawFunction &drawFrame)
+{
+    Stop();
+
+    _window = window;
+    _drawFrame = drawFrame;
+    _isBackPublished = false;
+    _stop = false;
+
+    // A context can only be current on one thread at a time
+    glfwMakeContextCurrent(NULL);
+    _thread = std::thread(&RenderThread::Run, this);
+}
+
+void RenderThread::Stop()
+{
+    if(!_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _snapshotPublished.notify_one();
+    _thread.join();
+
+    glfwMakeContextCurrent(_window);
+    JobSystem::getInstance().SetGLThread();
+}
+
+bool RenderThread::CanPublish()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_isBackPublished;
+}
+
+void RenderThread::Publish(FrameSnapshot &snapshot)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::swap(_snapshots[1 - _frontSnapshot], snapshot);
+        _isBackPublished = true;
+    }
+    _snapshotPublished.notify_one();
+}
+
+void RenderThread::Run()
+{
+    TRACE_THREAD_NAME("Render");
+    glfwMakeContextCurrent(_window);
+    JobSystem::getInstance().SetGLThread();
+
+    while(true)
+    {
+        {
+            TRACE_ZONE("Wait for snapshot");
+            std::unique_lock<std::mutex> lock(_mutex);
+            _snapshotPublished.wait(lock, [this]{ return _stop || _isBackPublished; });
+            if(_stop)
+                break;
+            _frontSnapshot = 1 - _frontSnapshot;
+            _isBackPublished = false;
+        }
+        // The main thread might be waiting for events until it can publish the next one
+        glfwPostEmptyEvent();
+
+        _drawFrame(_snapshots[_frontSnapshot]);
+        {
+            TRACE_ZONE("Swap buffers");
+            glfwSwapBuffers(_window);
+        }
+        Trace::EndFrame();
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <glm/gtc/quaternion.hpp>
+
+#include "misc/singleton.hpp"
+#include "core/ui_manager.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Everything the main thread hands over to the render thread for a frame. Never changed once it's been published
+struct FrameSnapshot final
+{
+    // The rotation of the model picked through the UI
+    glm::quat modelRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    // The UI's input since the last snapshot, in the order it arrived in
+    std::vector<UIInputEvent> uiInput;
+    // The window's size when the UI's input was taken
+    UIWindowState uiWindow;
+};
+
+/*
+Owns the GL context and draws the frames on a thread of its own, so that the main thread can keep handling the window's events
+and updating while the render thread waits on the GPU or for vsync.
+The snapshots are double-buffered: the main thread can publish one while the render thread draws the one before it,
+and has to wait for the render thread to pick that one up before it can publish the next.
+Everything that touches GL (loading, hot reloading, the UI) happens on the render thread once it's been started.
+*/
+class RenderThread final : public Singleton<RenderThread>
+{
+    friend class Singleton<RenderThread>;
+
+    public:
+    // Draws the frame, the buffers get swapped afterwards
+    using DrawFunction = std::function<void(const FrameSnapshot &frame)>;
+
+    private:
+    GLFWwindow *_window = nullptr;
+    DrawFunction _drawFrame;
+    std::thread _thread;
+
+    std::mutex _mutex;
+    std::condition_variable _snapshotPublished;
+    // The render thread draws the front one while the back one waits to be picked up
+    FrameSnapshot _snapshots[2];
+    unsigned int _frontSnapshot = 0;
+    bool _isBackPublished = false;
+    bool _stop = false;
+
+    private:
+    RenderThread() = default;
+    ~RenderThread() = default;
+
+    public:
+    // Moves the window's context over to the render thread, which calls the function for every snapshot that gets published.
+    // The context can't be current on the calling thread anymore
+    void Start(GLFWwindow *window, const DrawFunction &drawFrame);
+    // Lets the frame that's being drawn finish and makes the context current on the calling thread again
+    void Stop();
+
+    // Whether the last published snapshot has been picked up, so that another one can be published
+    bool CanPublish();
+    // Swaps the snapshot with the back one and wakes up the render thread. The snapshot that comes back is one that has been drawn already
+    void Publish(FrameSnapshot &snapshot);
+
+    inline bool isRunning() const { return _thread.joinable(); }
+
+    private:
+    void Run();
+};
@@ -8,7 +8,15 @@
 
 #include "log.hpp"
 #include "misc/utils.hpp"
+#include "file_watcher.hpp"
+#include "job_system.hpp"
+#include "scene.hpp"
+#include "trace.hpp"
+#include "rendering/shader_preprocessor.hpp"
+#include "rendering/shader_specializer.hpp"
+#include "rendering/renderer.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -50,6 +58,8 @@ std::pair<std::string, std::string> ResourceManager::ParseFileNameAndExtension(c
 #pragma region Shaders
 Shader* ResourceManager::LoadShaderFromFiles(const std::string &vertShaderPath, const std::string &fragShaderPath)
 {
+    TRACE_ZONE_DETAIL("Load shader", vertShaderPath);
+
     // Get rid of the file extension and get the name of the shader
     std::vector<std::string> splitVertPath = SplitString(vertShaderPath, '/');
     std::string shaderName = SplitString(splitVertPath[splitVertPath.size() - 1], '.')[0];
@@ -60,15 +70,78 @@ Shader* ResourceManager::LoadShaderFromFiles(const std::string &vertShaderPath,
         return const_cast<Shader*>(GetShader(shaderName));
     }
 
-    std::string vertShaderSource = ReadFile(vertShaderPath);
-    std::string fragShaderSource = ReadFile(fragShaderPath);
+    // The shader only gets submitted for compilation here,
+    // it becomes usable once the ShaderCompiler finishes it
+    Shader *shader = CreateShaderVariant(shaderName, vertShaderPath, fragShaderPath, {});
+    if(shader == nullptr)
+        return nullptr;
 
-    Shader *shader = new Shader(vertShaderSource.c_str(), fragShaderSource.c_str());
+    _shaderSourcePaths[shaderName] = std::make_pair(vertShaderPath, fragShaderPath);
     AddLoadedShader(shader, shaderName);
     Log::LogInfo("Loaded new shader, name: '" + shaderName + "'");
     return shader;
 }
 
+Shader *ResourceManager::GetShaderVariant(const std::string &name, const ShaderDefines &defines)
+{
+    std::string variantKey = name + "|" + ShaderPreprocessor::GetDefinesKey(defines);
+
+    auto variant = _shaderVariants.find(variantKey);
+    if(variant != _shaderVariants.end())
+        return variant->second;
+
+    auto paths = _shaderSourcePaths.find(name);
+    if(paths == _shaderSourcePaths.end())
+    {
+        Log::LogWarning("Couldn't create a variant of shader '" + name + "' because it isn't loaded");
+        return nullptr;
+    }
+
+    Shader *shader = CreateShaderVariant(name, paths->second.first, paths->second.second, defines);
+    if(shader != nullptr)
+        Log::LogInfo("Created variant of shader '" + name + "' with defines '" + ShaderPreprocessor::GetDefinesKey(defines) + "'");
+    return shader;
+}
+
+Shader *ResourceManager::CreateShaderVariant(const std::string &name, const std::string &vertShaderPath, const std::string &fragShaderPath, const ShaderDefines &defines)
+{
+    std::vector<std::string> files;
+    Shader *shader = CompileShaderVariant(name, vertShaderPath, fragShaderPath, defines, files);
+    if(shader == nullptr)
+        return nullptr;
+
+    _shaderVariants.insert(std::make_pair(name + "|" + ShaderPreprocessor::GetDefinesKey(defines), shader));
+
+    // Recompile the variant whenever any of the files it's made of changes
+    _shaderFiles[shader] = files;
+    for(const std::string &file: files)
+        FileWatcher::getInstance().Watch(file);
+
+    return shader;
+}
+Shader *ResourceManager::CompileShaderVariant(const std::string &name, const std::string &vertShaderPath, const std::string &fragShaderPath, const ShaderDefines &defines, std::vector<std::string> &files)
+{
+    TRACE_ZONE_DETAIL("Preprocess shader", name);
+
+    PreprocessedShader vertShader = ShaderPreprocessor::ProcessFile(vertShaderPath, defines);
+    PreprocessedShader fragShader = ShaderPreprocessor::ProcessFile(fragShaderPath, defines);
+    if(!vertShader.success || !fragShader.success)
+    {
+        Log::LogError("Couldn't preprocess shader '" + name + "'");
+        return nullptr;
+    }
+
+    std::set<std::string> keywords = vertShader.keywords;
+    keywords.insert(fragShader.keywords.begin(), fragShader.keywords.end());
+
+    files = vertShader.files;
+    files.insert(files.end(), fragShader.files.begin(), fragShader.files.end());
+
+    Shader *shader = new Shader(vertShader.source.c_str(), fragShader.source.c_str());
+    shader->setVariantInfo(name, defines, keywords);
+    return shader;
+}
+
 const Shader* const ResourceManager::GetShader(const std::string &name)
 {
     for(const auto &shader: _loadedShaders)
@@ -91,33 +164,68 @@ void ResourceManager::AddLoadedShader(Shader *shader, std::string name)
 }
 void ResourceManager::UnloadShader(const std::string &name)
 {
-    for(const auto &shader: _loadedShaders)
+    auto loadedShader = _loadedShaders.find(name);
+    if(loadedShader == _loadedShaders.end())
     {
-        if(shader.first.compare(name) == 0)
+        Log::LogInfo("Failed unloading shader '" + name +"', shader not among loaded shaders");
+        return;
+    }
+    loadedShader->second->Unbind();
+    _loadedShaders.erase(loadedShader);
+
+    // The variants can't be rebuilt without the shader, so they go as well. The shader itself is the variant without defines
+    std::vector<Shader*> unloadedShaders;
+    for(auto it = _shaderVariants.begin(); it != _shaderVariants.end();)
+    {
+        if(it->second->getName() == name)
         {
-            shader.second->Unbind();
-            _loadedShaders.erase(shader.first);
-            Log::LogInfo("Unloaded shader '" + name + "'");
-            return;
+            unloadedShaders.push_back(it->second);
+            it = _shaderVariants.erase(it);
         }
+        else
+            it++;
     }
+    _shaderSourcePaths.erase(name);
 
-    Log::LogInfo("Failed unloading shader '" + name +"', shader not among loaded shaders");
+    Scene &scene = Scene::getInstance();
+    for(Shader *shader: unloadedShaders)
+    {
+        _shaderFiles.erase(shader);
+        for(auto it = _pendingShaderReloads.begin(); it != _pendingShaderReloads.end(); it++)
+        {
+            if(it->first == shader)
+            {
+                delete it->second;
+                _pendingShaderReloads.erase(it);
+                break;
+            }
+        }
+
+        // Nothing may point at the shader once it's deleted, whatever drew with it falls back onto the scene's or default shader
+        if(scene.shader == shader)
+            scene.shader = nullptr;
+        for(Renderable &renderable: scene.renderables)
+        {
+            if(renderable.shader == shader)
+                renderable.shader = nullptr;
+        }
+        ShaderSpecializer::getInstance().Invalidate(shader);
+        Renderer::getInstance().OnShaderUnloaded(shader);
+        delete shader;
+    }
+    Log::LogInfo("Unloaded shader '" + name + "'");
 }
 #pragma endregion
 
 #pragma region Textures
 Texture* ResourceManager::LoadTextureFromFile(const std::string &path)
 {
-    std::vector<std::string> splitPath = SplitString(path, '/');
-    
-    auto fileNameAndExtension = ParseFileNameAndExtension(path);
-    if(fileNameAndExtension.second.compare("jpg") != 0 && fileNameAndExtension.second.compare("png") != 0)
-    {
-        Log::LogError("Texture loading failed, please provide a file of an image file type (JPEG, PNG)\n Provided file: " + path);
+    TRACE_ZONE_DETAIL("Load texture", path);
+
+    if(!IsTextureFile(path))
         return nullptr;
-    }
 
+    auto fileNameAndExtension = ParseFileNameAndExtension(path);
     if(GetTexture(fileNameAndExtension.first) != nullptr)
     {
         Log::LogWarning("Stopped loading texture '" + fileNameAndExtension.first + "' because it's been loaded already");
@@ -126,9 +234,66 @@ Texture* ResourceManager::LoadTextureFromFile(const std::string &path)
 
     int width, height;
     unsigned char *data = stbi_load(path.c_str(), &width, &height, nullptr, 0);
+    return CreateTexture(path, width, height, data);
+}
+
+std::vector<Texture*> ResourceManager::LoadTexturesFromFiles(const std::vector<std::string> &paths)
+{
+    TRACE_ZONE("Load textures");
+
+    JobSystem &jobSystem = JobSystem::getInstance();
+    std::vector<Texture*> textures(paths.size(), nullptr);
+    JobCounter counter;
+    for(size_t i = 0; i < paths.size(); i++)
+    {
+        if(!IsTextureFile(paths[i]))
+            continue;
+
+        // Decoding is where the time goes and doesn't touch anything shared, the texture itself has to be created on the GL thread
+        jobSystem.Run("Decode texture", [this, &jobSystem, &paths, &textures, &counter, i]
+        {
+            int width, height;
+            unsigned char *data = stbi_load(paths[i].c_str(), &width, &height, nullptr, 0);
+            jobSystem.RunOnGLThread("Create texture", [this, &paths, &textures, i, width, height, data]
+            {
+                const std::string name = ParseFileNameAndExtension(paths[i]).first;
+                if(_loadedTextures.find(name) != _loadedTextures.end())
+                {
+                    Log::LogWarning("Stopped loading texture '" + name + "' because it's been loaded already");
+                    textures[i] = _loadedTextures[name];
+                    stbi_image_free(data);
+                    return;
+                }
+                textures[i] = CreateTexture(paths[i], width, height, data);
+            }, &counter);
+        }, &counter);
+    }
+    jobSystem.Wait(counter);
+
+    textures.erase(std::remove(textures.begin(), textures.end(), nullptr), textures.end());
+    return textures;
+}
+
+bool ResourceManager::IsTextureFile(const std::string &path)
+{
+    auto fileNameAndExtension = ParseFileNameAndExtension(path);
+    if(fileNameAndExtension.second.compare("jpg") != 0 && fileNameAndExtension.second.compare("png") != 0)
+    {
+        Log::LogError("Texture loading failed, please provide a file of an image file type (JPEG, PNG)\n Provided file: " + path);
+        return false;
+    }
+    return true;
+}
+
+Texture *ResourceManager::CreateTexture(const std::string &path, int width, int height, unsigned char *data)
+{
+    auto fileNameAndExtension = ParseFileNameAndExtension(path);
     Texture *tex = new Texture(GL_TEXTURE_2D, glm::vec2(width, height), GL_RGB, GL_RGB, (void*)data);
+    tex->setOwnsData(true);
     
     AddLoadedTexture(tex, fileNameAndExtension.first);
+    _texturePaths[fileNameAndExtension.first] = path;
+    FileWatcher::getInstance().Watch(path);
     Log::LogInfo("Loaded new texture '" + fileNameAndExtension.first + "'");
     return tex;
 }
@@ -162,6 +327,7 @@ void ResourceManager::UnloadTexture(const std::string &name)
         {
             // delete tex.second.get();
             _loadedTextures.erase(name);
+            _texturePaths.erase(name);
             Log::LogInfo("Unloaded texture '" + name + "'");
             return;
         }
@@ -171,9 +337,113 @@ void ResourceManager::UnloadTexture(const std::string &name)
 }
 #pragma endregion
 
+#pragma region Hot reloading
+void ResourceManager::HotReload()
+{
+    TRACE_ZONE("Hot reload");
+
+    for(const std::string &path: FileWatcher::getInstance().PollChanges())
+        ReloadFile(path);
+
+    // Swap in the recompiled shaders that are done
+    for(auto it = _pendingShaderReloads.begin(); it != _pendingShaderReloads.end();)
+    {
+        Shader *shader = it->first;
+        Shader *replacement = it->second;
+
+        if(replacement->getStatus() == ShaderStatus::PENDING)
+        {
+            it++;
+            continue;
+        }
+
+        if(replacement->isReady())
+        {
+            shader->ReplaceProgram(*replacement);
+            // Anything derived from the old program is out of date now
+            ShaderSpecializer::getInstance().Invalidate(shader);
+            Log::LogInfo("Reloaded shader '" + shader->getName() + "'");
+        }
+        else
+            Log::LogError("Reloading shader '" + shader->getName() + "' failed, keeping the previous version");
+
+        // After the swap the replacement holds the old program
+        delete replacement;
+        it = _pendingShaderReloads.erase(it);
+    }
+}
+
+void ResourceManager::ReloadFile(const std::string &path)
+{
+    TRACE_ZONE_DETAIL("Reload file", path);
+
+    // Textures get their new image uploaded into the same texture object
+    for(const auto &texturePath: _texturePaths)
+    {
+        if(texturePath.second != path)
+            continue;
+
+        auto tex = _loadedTextures.find(texturePath.first);
+        if(tex == _loadedTextures.end())
+            continue;
+
+        int width, height;
+        unsigned char *data = stbi_load(path.c_str(), &width, &height, nullptr, 0);
+        if(data == nullptr)
+        {
+            Log::LogError("Reloading texture '" + texturePath.first + "' failed, keeping the previous version");
+            continue;
+        }
+
+        tex->second->UpdateData(glm::uvec2(width, height), (void*)data, true);
+        Log::LogInfo("Reloaded texture '" + texturePath.first + "'");
+    }
+
+    // Shaders get recompiled in the background and keep drawing with the old program until the new one is ready
+    for(auto &shaderFiles: _shaderFiles)
+    {
+        Shader *shader = shaderFiles.first;
+        if(std::find(shaderFiles.second.begin(), shaderFiles.second.end(), path) == shaderFiles.second.end())
+            continue;
+
+        auto paths = _shaderSourcePaths.find(shader->getName());
+        if(paths == _shaderSourcePaths.end())
+            continue;
+
+        // A reload that's still compiling is superseded by this one
+        for(auto it = _pendingShaderReloads.begin(); it != _pendingShaderReloads.end(); it++)
+        {
+            if(it->first == shader)
+            {
+                delete it->second;
+                _pendingShaderReloads.erase(it);
+                break;
+            }
+        }
+
+        std::vector<std::string> files;
+        Shader *replacement = CompileShaderVariant(shader->getName(), paths->second.first, paths->second.second, shader->getDefines(), files);
+        if(replacement == nullptr)
+        {
+            Log::LogError("Reloading shader '" + shader->getName() + "' failed, keeping the previous version");
+            continue;
+        }
+
+        // The edit may have added new includes
+        shaderFiles.second = files;
+        for(const std::string &file: files)
+            FileWatcher::getInstance().Watch(file);
+
+        _pendingShaderReloads.push_back(std::make_pair(shader, replacement));
+    }
+}
+#pragma endregion
+
 #pragma region Models
 Model *ResourceManager::LoadModelFromOBJFile(const std::string &path)
 {
+    TRACE_ZONE_DETAIL("Load model", path);
+
     std::string objFileContents = ReadFile(path);
     
     tinyobj::ObjReaderConfig config;
@@ -189,48 +459,62 @@ Model *ResourceManager::LoadModelFromOBJFile(const std::string &path)
         auto &attrib = reader.GetAttrib();
         auto &shapes = reader.GetShapes();
 
-        std::vector<Vertex> vertices;
+        // Every index makes a vertex, so where each shape's vertices go is known up front
+        // and the shapes' indices can be split up across the workers
+        std::vector<size_t> shapeOffsets;
+        size_t numOfVertices = 0;
+        for(const auto &shape: shapes)
+        {
+            shapeOffsets.push_back(numOfVertices);
+            numOfVertices += shape.mesh.indices.size();
+        }
+        std::vector<Vertex> vertices(numOfVertices, Vertex(glm::vec3(0.0f), glm::vec2(0.0f), glm::vec3(0.0f)));
 
         // Loop through each shape
-        for(const auto &shape: shapes)
+        for(size_t shapeIndex = 0; shapeIndex < shapes.size(); shapeIndex++)
         {
+            const auto &indices = shapes[shapeIndex].mesh.indices;
+            Vertex *shapeVertices = vertices.data() + shapeOffsets[shapeIndex];
             // Loop through all of the indices of the given shape to construct Vertices
-            for(const auto &index: shape.mesh.indices)
+            JobSystem::getInstance().ParallelFor("Build OBJ vertices", 0, (unsigned int)indices.size(), 16384, [&](unsigned int begin, unsigned int end)
             {
-                glm::vec3 pos(0.0f);
-                // 3 * index is here because each vertex has 3 position coordinates
-                // Acts basically the same way as the stride for OpenGL vert attrib ptrs
+                for(unsigned int i = begin; i < end; i++)
                 {
-                    float x = attrib.vertices[(3 * index.vertex_index) + 0];
-                    float y = attrib.vertices[(3 * index.vertex_index) + 1];
-                    float z = attrib.vertices[(3 * index.vertex_index) + 2];
-                    pos = glm::vec3(x, y, z);
-                }
+                    const auto &index = indices[i];
+                    glm::vec3 pos(0.0f);
+                    // 3 * index is here because each vertex has 3 position coordinates
+                    // Acts basically the same way as the stride for OpenGL vert attrib ptrs
+                    {
+                        float x = attrib.vertices[(3 * index.vertex_index) + 0];
+                        float y = attrib.vertices[(3 * index.vertex_index) + 1];
+                        float z = attrib.vertices[(3 * index.vertex_index) + 2];
+                        pos = glm::vec3(x, y, z);
+                    }
 
-                glm::vec2 uv(0.0f);
-                // Only include UV coordinates if they are present
-                if(index.texcoord_index >= 0)
-                {
-                    // The OBJ file format uses the coordinate system of 0 being the bottom of the image.
-                    // OpenGL uses a system where 1 is the bottom of the image, therefore the
-                    // vertical UV coordinate must be flipped
-                    float u = attrib.texcoords[(2 * index.texcoord_index) + 0];
-                    float v = 1.0f - attrib.texcoords[(2 * index.texcoord_index) + 1];
-                    uv = glm::vec2(u, v);
-                }
+                    glm::vec2 uv(0.0f);
+                    // Only include UV coordinates if they are present
+                    if(index.texcoord_index >= 0)
+                    {
+                        // The OBJ file format uses the coordinate system of 0 being the bottom of the image.
+                        // OpenGL uses a system where 1 is the bottom of the image, therefore the
+                        // vertical UV coordinate must be flipped
+                        float u = attrib.texcoords[(2 * index.texcoord_index) + 0];
+                        float v = 1.0f - attrib.texcoords[(2 * index.texcoord_index) + 1];
+                        uv = glm::vec2(u, v);
+                    }
 
-                glm::vec3 normal(0.0f);
-                if(index.normal_index >= 0)
-                {
-                    float x = attrib.normals[(3 * index.normal_index) + 0];
-                    float y = attrib.normals[(3 * index.normal_index) + 1]; 
-                    float z = attrib.normals[(3 * index.normal_index) + 2]; 
-                    normal = glm::vec3(x, y, z);
-                }
+                    glm::vec3 normal(0.0f);
+                    if(index.normal_index >= 0)
+                    {
+                        float x = attrib.normals[(3 * index.normal_index) + 0];
+                        float y = attrib.normals[(3 * index.normal_index) + 1]; 
+                        float z = attrib.normals[(3 * index.normal_index) + 2]; 
+                        normal = glm::vec3(x, y, z);
+                    }
 
-                Vertex newVert(pos, uv, normal);
-                vertices.push_back(std::move(newVert));
-            }
+                    shapeVertices[i] = Vertex(pos, uv, normal);
+                }
+            });
         }
 
         std::string name = ParseFileNameAndExtension(path).first;
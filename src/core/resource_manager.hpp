@@ -9,8 +9,11 @@
 #include <string>
 #include <memory>
 #include <utility>
+#include <vector>
 
 using LoadedShadersMap = std::unordered_map<std::string, Shader*>;
+// Shader name + defines key -> shader variant
+using ShaderVariantsMap = std::unordered_map<std::string, Shader*>;
 using LoadedTexturesMap = std::unordered_map<std::string, Texture*>;
 using LoadedModelsMap = std::unordered_map<std::string, Model*>;
 
@@ -20,6 +23,15 @@ class ResourceManager final : public Singleton<ResourceManager>
 
     private:
     LoadedShadersMap _loadedShaders;
+    ShaderVariantsMap _shaderVariants;
+    // Shader name -> paths to its vertex and fragment shader files, needed to build more variants later on
+    std::unordered_map<std::string, std::pair<std::string, std::string>> _shaderSourcePaths;
+    // Every file each shader variant was assembled from, including the #included ones
+    std::unordered_map<Shader*, std::vector<std::string>> _shaderFiles;
+    // Shaders being recompiled after their files changed, paired with the shader that will replace them once ready
+    std::vector<std::pair<Shader*, Shader*>> _pendingShaderReloads;
+    // Texture name -> path of the image it was loaded from
+    std::unordered_map<std::string, std::string> _texturePaths;
     LoadedTexturesMap _loadedTextures;
     LoadedModelsMap _loadedModels;
 
@@ -46,8 +58,14 @@ class ResourceManager final : public Singleton<ResourceManager>
     const Shader* const GetShader(const std::string &name);
     void AddLoadedShader(Shader *shader, std::string name);
     void UnloadShader(const std::string &name);
+    // Returns the variant of a loaded shader built with the given defines, compiling it first if it's not cached yet.
+    // The variant with no defines is the shader itself
+    Shader *GetShaderVariant(const std::string &name, const ShaderDefines &defines);
 
     Texture *LoadTextureFromFile(const std::string &path);
+    // Decodes the images in parallel on the job system's workers and creates the textures on the GL thread,
+    // has to be called on it. Returns once all of them are loaded, the ones that failed are left out
+    std::vector<Texture*> LoadTexturesFromFiles(const std::vector<std::string> &paths);
     const Texture* const GetTexture(const std::string &name);
     void AddLoadedTexture(Texture *texture, std::string name);
     void UnloadTexture(const std::string &name);
@@ -56,4 +74,18 @@ class ResourceManager final : public Singleton<ResourceManager>
     const Model* const GetModel(const std::string &name);
     void AddLoadedModel(Model *model, std::string name);
     void UnloadModel(const std::string &name);
+
+    // Reloads the resources whose files were changed on disk. Called once per frame
+    void HotReload();
+
+    private:
+    // Compiles the variant and adds it to the cache
+    Shader *CreateShaderVariant(const std::string &name, const std::string &vertShaderPath, const std::string &fragShaderPath, const ShaderDefines &defines);
+    // Runs both stages through the preprocessor and submits the result for compilation
+    Shader *CompileShaderVariant(const std::string &name, const std::string &vertShaderPath, const std::string &fragShaderPath, const ShaderDefines &defines, std::vector<std::string> &files);
+    void ReloadFile(const std::string &path);
+    // Whether the path is of an image that can be loaded as a texture, logs why not if it isn't
+    static bool IsTextureFile(const std::string &path);
+    // Takes over the decoded image and registers the texture under the file's name
+    Texture *CreateTexture(const std::string &path, int width, int height, unsigned char *data);
 };
\ No newline at end of file
@@ -1,12 +1,36 @@
 #pragma once
 
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
 #include "misc/singleton.hpp"
+#include "core/transform_hierarchy.hpp"
 #include "rendering/shader.hpp"
 #include "rendering/texture.hpp"
 #include "rendering/model.hpp"
 
 #include <vector>
 
+// An entity that gets drawn
+struct Renderable final
+{
+    EntityID entity = INVALID_ENTITY;
+    // nullptr stands for the scene's model/shader, which are the ones picked through the UI
+    Model *model = nullptr;
+    Shader *shader = nullptr;
+    // Drawn after everything opaque, back to front and alpha blended
+    bool transparent = false;
+    // Gets rasterized into the software occlusion culler's depth buffer, which works best with a few big, simple models
+    bool occluder = false;
+};
+
+struct Camera final
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+};
+
 struct Scene final: public Singleton<Scene>
 {
     friend class Singleton<Scene>;
@@ -15,6 +39,18 @@ struct Scene final: public Singleton<Scene>
     Shader *shader = nullptr;
     std::vector<Texture*> textures;
 
+    TransformHierarchy transforms;
+    std::vector<Renderable> renderables;
+    Camera camera;
+
+    // Creates an entity with a renderable attached to it
+    EntityID AddRenderable(Model *model, Shader *shader, EntityID parent = INVALID_ENTITY)
+    {
+        EntityID entity = transforms.CreateEntity(parent);
+        renderables.push_back({ entity, model, shader });
+        return entity;
+    }
+
     private:
     Scene() = default;
     ~Scene()
@@ -22,5 +58,7 @@ struct Scene final: public Singleton<Scene>
         model = nullptr;
         shader = nullptr;
         textures.clear();
+        renderables.clear();
+        transforms.Clear();
     }
-};
\ No newline at end of file
+};
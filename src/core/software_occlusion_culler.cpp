@@ -0,0 +1,375 @@
+#include "software_occlusion_culler.hpp"
+
+#include "misc/simd_math.hpp"
+#include "core/job_system.hpp"
+#include "core/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef SIMD_MATH_SSE
+static inline float HorizontalMin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+static inline float HorizontalMax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(v);
+}
+#endif
+
+void SoftwareOcclusionCuller::Init()
+{
+    _depth.assign(WIDTH * HEIGHT, 1.0f);
+    std::fill(std::begin(_tileMaxDepth), std::end(_tileMaxDepth), 1.0f);
+    _workerBins.resize(JobSystem::MAX_WORKERS);
+}
+
+void SoftwareOcclusionCuller::DeInit()
+{
+    _workerBins.clear();
+    _numOfUsedBins = 0;
+    _occluders.clear();
+}
+
+void SoftwareOcclusionCuller::BeginFrame(const glm::mat4 &viewProjection)
+{
+    _viewProjection = viewProjection;
+    _occluders.clear();
+}
+
+void SoftwareOcclusionCuller::AddOccluder(const glm::mat4 &modelMatrix, const glm::vec3 *positions, size_t stride, size_t numOfVertices)
+{
+    _occluders.push_back({ modelMatrix, (const unsigned char*)positions, stride, numOfVertices });
+}
+
+void SoftwareOcclusionCuller::Rasterize()
+{
+    // Not initialized
+    if(_workerBins.empty())
+        return;
+
+    // Only the bins the last frame filled, the job system may have been started with a different number of workers since
+    for(unsigned int i = 0; i < _numOfUsedBins; i++)
+    {
+        WorkerBins &bins = _workerBins[i];
+        bins.triangles.clear();
+        for(std::vector<unsigned int> &tile: bins.tiles)
+            tile.clear();
+    }
+    _numOfTriangles = 0;
+    _numOfUsedBins = GetNumOfWorkers();
+
+    _nextWorkItem = 0;
+    RunPhase(&SoftwareOcclusionCuller::BinOccluders);
+    _nextWorkItem = 0;
+    RunPhase(&SoftwareOcclusionCuller::RasterizeTiles);
+}
+
+bool SoftwareOcclusionCuller::IsVisible(const AABB &bounds) const
+{
+    // Not initialized
+    if(_depth.empty())
+        return true;
+
+    float minX, minY, maxX, maxY, nearestDepth;
+    // Part of the box is in front of the near plane, the camera might be inside of it
+    if(!ProjectBox(bounds, minX, minY, maxX, maxY, nearestDepth))
+        return true;
+
+    // The occluders only cover the pixels whose centers they cover, so a pixel along an occluder's edge holds its depth
+    // even where the rest of the pixel is open. Growing the rectangle by half a pixel takes in the pixels next to those,
+    // which keeps a box that only peeks out past an edge from being reported as hidden.
+    // Every pixel the grown rectangle touches is tested, so that rounding never makes it smaller
+    const int x0 = std::max(0, (int)std::floor(minX - 0.5f)), x1 = std::min(WIDTH - 1, (int)std::floor(maxX + 0.5f));
+    const int y0 = std::max(0, (int)std::floor(minY - 0.5f)), y1 = std::min(HEIGHT - 1, (int)std::floor(maxY + 0.5f));
+    if(x0 > x1 || y0 > y1)
+        return false;
+
+    for(int tileY = y0 / TILE_HEIGHT; tileY <= y1 / TILE_HEIGHT; tileY++)
+    {
+        for(int tileX = x0 / TILE_WIDTH; tileX <= x1 / TILE_WIDTH; tileX++)
+        {
+            // Nothing in the tile is farther than the box
+            if(_tileMaxDepth[tileY * NUM_OF_TILES_X + tileX] <= nearestDepth)
+                continue;
+
+            const int startX = std::max(x0, tileX * TILE_WIDTH), endX = std::min(x1, tileX * TILE_WIDTH + TILE_WIDTH - 1);
+            const int startY = std::max(y0, tileY * TILE_HEIGHT), endY = std::min(y1, tileY * TILE_HEIGHT + TILE_HEIGHT - 1);
+            for(int y = startY; y <= endY; y++)
+            {
+                const float *row = &_depth[y * WIDTH];
+                int x = startX;
+#ifdef SIMD_MATH_SSE
+                const __m128 nearest = _mm_set1_ps(nearestDepth);
+                for(; x + 3 <= endX; x += 4)
+                {
+                    if(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(row + x), nearest)) != 0)
+                        return true;
+                }
+#endif
+                for(; x <= endX; x++)
+                {
+                    if(row[x] > nearestDepth)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool SoftwareOcclusionCuller::ProjectBox(const AABB &bounds, float &minX, float &minY, float &maxX, float &maxY, float &nearestDepth) const
+{
+    // The corners are the min corner plus any combination of the box's size along each axis,
+    // which after the transform is the same combination of the matrix's scaled columns
+    const glm::vec3 size = bounds.max - bounds.min;
+    const glm::vec4 minCorner = _viewProjection * glm::vec4(bounds.min, 1.0f);
+    const glm::vec4 axes[3] = { _viewProjection[0] * size.x, _viewProjection[1] * size.y, _viewProjection[2] * size.z };
+
+#ifdef SIMD_MATH_SSE
+    // All 8 corners at once, split into the 4 without the z axis and the 4 with it
+    const __m128 selectX = _mm_setr_ps(0.0f, 1.0f, 0.0f, 1.0f);
+    const __m128 selectY = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    __m128 clip[4][2];
+    for(int component = 0; component < 4; component++)
+    {
+        clip[component][0] = _mm_add_ps(_mm_set1_ps(minCorner[component]),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(axes[0][component]), selectX), _mm_mul_ps(_mm_set1_ps(axes[1][component]), selectY)));
+        clip[component][1] = _mm_add_ps(clip[component][0], _mm_set1_ps(axes[2][component]));
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 minXs = _mm_set1_ps((float)WIDTH), minYs = _mm_set1_ps((float)HEIGHT), nearest = _mm_set1_ps(1.0f);
+    __m128 maxXs = zero, maxYs = zero;
+    for(int i = 0; i < 2; i++)
+    {
+        const __m128 x = clip[0][i], y = clip[1][i], z = clip[2][i], w = clip[3][i];
+        const __m128 inFront = _mm_or_ps(_mm_cmple_ps(w, zero), _mm_cmplt_ps(z, _mm_sub_ps(zero, w)));
+        if(_mm_movemask_ps(inFront) != 0)
+            return false;
+
+        const __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), w);
+        const __m128 screenX = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(x, invW), half), half), _mm_set1_ps((float)WIDTH));
+        const __m128 screenY = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, invW), half), half), _mm_set1_ps((float)HEIGHT));
+        minXs = _mm_min_ps(minXs, screenX); maxXs = _mm_max_ps(maxXs, screenX);
+        minYs = _mm_min_ps(minYs, screenY); maxYs = _mm_max_ps(maxYs, screenY);
+        nearest = _mm_min_ps(nearest, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(z, invW), half), half));
+    }
+
+    minX = HorizontalMin(minXs); maxX = HorizontalMax(maxXs);
+    minY = HorizontalMin(minYs); maxY = HorizontalMax(maxYs);
+    nearestDepth = HorizontalMin(nearest);
+#else
+    minX = (float)WIDTH; minY = (float)HEIGHT;
+    maxX = 0.0f; maxY = 0.0f;
+    nearestDepth = 1.0f;
+    for(int i = 0; i < 8; i++)
+    {
+        glm::vec4 clip = minCorner;
+        for(int axis = 0; axis < 3; axis++)
+        {
+            if(i & (1 << axis))
+                clip += axes[axis];
+        }
+        if(clip.w <= 0.0f || clip.z < -clip.w)
+            return false;
+
+        const float invW = 1.0f / clip.w;
+        const float x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+        const float y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+        nearestDepth = std::min(nearestDepth, clip.z * invW * 0.5f + 0.5f);
+    }
+#endif
+    return true;
+}
+
+unsigned int SoftwareOcclusionCuller::GetNumOfWorkers() const
+{
+    return std::min(JobSystem::getInstance().getNumOfWorkers(), (unsigned int)_workerBins.size());
+}
+
+void SoftwareOcclusionCuller::RunPhase(void (SoftwareOcclusionCuller::*phase)(unsigned int worker))
+{
+    // Every job gets bins of its own, the work items themselves are handed out through _nextWorkItem
+    JobSystem::getInstance().ParallelFor("Occlusion culling", 0, _numOfUsedBins, 1, [this, phase](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int worker = begin; worker < end; worker++)
+            (this->*phase)(worker);
+    });
+}
+
+void SoftwareOcclusionCuller::BinOccluders(unsigned int worker)
+{
+    TRACE_ZONE("Bin occluders");
+    WorkerBins &bins = _workerBins[worker];
+    unsigned int numOfTriangles = 0;
+
+    // Occluders are handed out one at a time since they can differ a lot in size
+    for(unsigned int i = _nextWorkItem++; i < _occluders.size(); i = _nextWorkItem++)
+    {
+        const Occluder &occluder = _occluders[i];
+        glm::mat4 mvp;
+        MultiplyMat4(_viewProjection, occluder.modelMatrix, mvp);
+
+        for(size_t first = 0; first + 2 < occluder.numOfVertices; first += 3)
+        {
+            float x[3], y[3], z[3];
+            bool crossesNearPlane = false;
+            for(int k = 0; k < 3; k++)
+            {
+                const glm::vec3 &position = *(const glm::vec3*)(occluder.positions + (first + k) * occluder.stride);
+                const glm::vec4 clip = mvp * glm::vec4(position, 1.0f);
+                if(clip.w <= 0.0f || clip.z < -clip.w)
+                {
+                    crossesNearPlane = true;
+                    break;
+                }
+
+                const float invW = 1.0f / clip.w;
+                x[k] = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+                y[k] = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+                z[k] = clip.z * invW * 0.5f + 0.5f;
+            }
+            if(crossesNearPlane || std::min({ z[0], z[1], z[2] }) > 1.0f)
+                continue;
+
+            // Both sides get rasterized, so the winding is flipped to make the area positive
+            float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+            if(std::abs(area) < 1e-6f)
+                continue;
+            if(area < 0.0f)
+            {
+                std::swap(x[1], x[2]); std::swap(y[1], y[2]); std::swap(z[1], z[2]);
+                area = -area;
+            }
+
+            ScreenTriangle triangle;
+            triangle.minX = std::max(0, (int)std::floor(std::min({ x[0], x[1], x[2] })));
+            triangle.minY = std::max(0, (int)std::floor(std::min({ y[0], y[1], y[2] })));
+            triangle.maxX = std::min(WIDTH - 1, (int)std::ceil(std::max({ x[0], x[1], x[2] })));
+            triangle.maxY = std::min(HEIGHT - 1, (int)std::ceil(std::max({ y[0], y[1], y[2] })));
+            if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+                continue;
+
+            // Edge i goes from vertex i to the next one and is positive on the inside
+            for(int k = 0; k < 3; k++)
+            {
+                const int next = (k + 1) % 3;
+                triangle.edgeA[k] = y[k] - y[next];
+                triangle.edgeB[k] = x[next] - x[k];
+                triangle.edgeC[k] = x[k] * y[next] - y[k] * x[next];
+            }
+            // The barycentric weight of a vertex is the edge across from it over the area
+            const float invArea = 1.0f / area;
+            const float dz1 = (z[1] - z[0]) * invArea, dz2 = (z[2] - z[0]) * invArea;
+            triangle.depthA = triangle.edgeA[2] * dz1 + triangle.edgeA[0] * dz2;
+            triangle.depthB = triangle.edgeB[2] * dz1 + triangle.edgeB[0] * dz2;
+            triangle.depthC = z[0] + triangle.edgeC[2] * dz1 + triangle.edgeC[0] * dz2;
+
+            const unsigned int index = (unsigned int)bins.triangles.size();
+            bins.triangles.push_back(triangle);
+            for(int tileY = triangle.minY / TILE_HEIGHT; tileY <= triangle.maxY / TILE_HEIGHT; tileY++)
+            {
+                for(int tileX = triangle.minX / TILE_WIDTH; tileX <= triangle.maxX / TILE_WIDTH; tileX++)
+                    bins.tiles[tileY * NUM_OF_TILES_X + tileX].push_back(index);
+            }
+            numOfTriangles++;
+        }
+    }
+
+    _numOfTriangles += numOfTriangles;
+}
+
+void SoftwareOcclusionCuller::RasterizeTiles(unsigned int worker)
+{
+    TRACE_ZONE("Rasterize occluder tiles");
+    for(unsigned int tile = _nextWorkItem++; tile < NUM_OF_TILES; tile = _nextWorkItem++)
+    {
+        const int tileMinX = (tile % NUM_OF_TILES_X) * TILE_WIDTH;
+        const int tileMinY = (tile / NUM_OF_TILES_X) * TILE_HEIGHT;
+        const int tileMaxX = tileMinX + TILE_WIDTH - 1;
+        const int tileMaxY = tileMinY + TILE_HEIGHT - 1;
+
+        for(int y = tileMinY; y <= tileMaxY; y++)
+            std::fill_n(&_depth[y * WIDTH + tileMinX], TILE_WIDTH, 1.0f);
+
+        for(unsigned int i = 0; i < _numOfUsedBins; i++)
+        {
+            const WorkerBins &bins = _workerBins[i];
+            for(const unsigned int index: bins.tiles[tile])
+                RasterizeTriangle(bins.triangles[index], tileMinX, tileMinY, tileMaxX, tileMaxY);
+        }
+
+        float maxDepth = 0.0f;
+        for(int y = tileMinY; y <= tileMaxY; y++)
+        {
+            const float *row = &_depth[y * WIDTH + tileMinX];
+            maxDepth = std::max(maxDepth, *std::max_element(row, row + TILE_WIDTH));
+        }
+        _tileMaxDepth[tile] = maxDepth;
+    }
+}
+
+void SoftwareOcclusionCuller::RasterizeTriangle(const ScreenTriangle &triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY)
+{
+    // Starts on a multiple of 4 so that the 4 pixel steps never leave the tile
+    const int minX = std::max(triangle.minX, tileMinX) & ~3;
+    const int maxX = std::min(triangle.maxX, tileMaxX);
+    const int minY = std::max(triangle.minY, tileMinY);
+    const int maxY = std::min(triangle.maxY, tileMaxY);
+
+    // Everything is evaluated at the pixel centers
+    for(int y = minY; y <= maxY; y++)
+    {
+        const float centerY = y + 0.5f;
+        float *row = &_depth[y * WIDTH];
+#ifdef SIMD_MATH_SSE
+        const __m128 centersX = _mm_add_ps(_mm_set1_ps((float)minX), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+        __m128 edges[3], edgeSteps[3];
+        for(int k = 0; k < 3; k++)
+        {
+            const __m128 a = _mm_set1_ps(triangle.edgeA[k]);
+            edges[k] = _mm_add_ps(_mm_mul_ps(a, centersX), _mm_set1_ps(triangle.edgeB[k] * centerY + triangle.edgeC[k]));
+            edgeSteps[k] = _mm_mul_ps(a, _mm_set1_ps(4.0f));
+        }
+        const __m128 depthA = _mm_set1_ps(triangle.depthA);
+        __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, centersX), _mm_set1_ps(triangle.depthB * centerY + triangle.depthC));
+        const __m128 depthStep = _mm_mul_ps(depthA, _mm_set1_ps(4.0f));
+        const __m128 zero = _mm_setzero_ps();
+
+        for(int x = minX; x <= maxX; x += 4)
+        {
+            const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edges[0], zero), _mm_cmpge_ps(edges[1], zero)), _mm_cmpge_ps(edges[2], zero));
+            if(_mm_movemask_ps(inside) != 0)
+            {
+                const __m128 current = _mm_loadu_ps(row + x);
+                const __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(depth, current));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(nearer, depth), _mm_andnot_ps(nearer, current)));
+            }
+
+            for(int k = 0; k < 3; k++)
+                edges[k] = _mm_add_ps(edges[k], edgeSteps[k]);
+            depth = _mm_add_ps(depth, depthStep);
+        }
+#else
+        for(int x = minX; x <= maxX; x++)
+        {
+            const float centerX = x + 0.5f;
+            bool inside = true;
+            for(int k = 0; k < 3; k++)
+                inside &= triangle.edgeA[k] * centerX + triangle.edgeB[k] * centerY + triangle.edgeC[k] >= 0.0f;
+            const float depth = triangle.depthA * centerX + triangle.depthB * centerY + triangle.depthC;
+            if(inside && depth < row[x])
+                row[x] = depth;
+        }
+#endif
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "misc/bounds.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/*
+Occlusion culling against a small depth buffer that's rasterized on the CPU, so the results are there
+in the same frame without reading anything back from the GPU.
+The designated occluders' triangles get transformed and binned into screen tiles, then every tile is rasterized on its own,
+4 pixels at a time, which lets the job system's workers share the work without ever writing to the same pixels.
+Triangles that cross the near plane are dropped rather than clipped, which can only make the buffer occlude less.
+The occluders are sampled at the pixel centers, so an occluder thinner than a pixel can fall between the samples
+and not occlude anything there, which again only makes the buffer occlude less.
+A box is occluded if every pixel its screen rectangle, grown by half a pixel, touches holds a depth nearer than the box's nearest point.
+The growing makes up for the pixels an occluder's edge only partly covers, which it still writes its depth into.
+Doesn't touch GL at all, so it also runs headless.
+*/
+class SoftwareOcclusionCuller final
+{
+    public:
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 128;
+    static constexpr int TILE_WIDTH = 64;
+    static constexpr int TILE_HEIGHT = 32;
+    static constexpr int NUM_OF_TILES_X = WIDTH / TILE_WIDTH;
+    static constexpr int NUM_OF_TILES_Y = HEIGHT / TILE_HEIGHT;
+    static constexpr int NUM_OF_TILES = NUM_OF_TILES_X * NUM_OF_TILES_Y;
+
+    private:
+    struct Occluder final
+    {
+        glm::mat4 modelMatrix;
+        const unsigned char *positions;
+        size_t stride;
+        size_t numOfVertices;
+    };
+
+    // In pixels, with the depth mapped to [0, 1] the same way GL does.
+    // The edges and depth are stored as plane equations over the pixel coordinates
+    struct ScreenTriangle final
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    // Everything a thread writes while binning, so that the threads never share anything until the tiles get rasterized
+    struct WorkerBins final
+    {
+        std::vector<ScreenTriangle> triangles;
+        std::vector<unsigned int> tiles[NUM_OF_TILES];
+    };
+
+    std::vector<float> _depth;
+    // The farthest depth in every tile, lets the visibility test skip whole tiles
+    float _tileMaxDepth[NUM_OF_TILES];
+    glm::mat4 _viewProjection = glm::mat4(1.0f);
+
+    std::vector<Occluder> _occluders;
+    // One per worker the job system can have, only the first _numOfUsedBins are filled in a frame
+    std::vector<WorkerBins> _workerBins;
+    unsigned int _numOfUsedBins = 0;
+    std::atomic<unsigned int> _nextWorkItem{0};
+    std::atomic<unsigned int> _numOfTriangles{0};
+
+    public:
+    SoftwareOcclusionCuller() = default;
+    ~SoftwareOcclusionCuller() = default;
+    // Copy
+    SoftwareOcclusionCuller(const SoftwareOcclusionCuller &other) = delete;
+    SoftwareOcclusionCuller &operator=(const SoftwareOcclusionCuller &other) = delete;
+
+    void Init();
+    void DeInit();
+
+    // Starts a frame with an empty depth buffer and forgets the occluders of the last one
+    void BeginFrame(const glm::mat4 &viewProjection);
+    // Every 3 consecutive positions make a triangle. They're read with the given stride so that they can be taken straight
+    // out of an array of vertices, which has to stay alive until Rasterize() is done
+    void AddOccluder(const glm::mat4 &modelMatrix, const glm::vec3 *positions, size_t stride, size_t numOfVertices);
+    // Bins and rasterizes the occluders across the job system's workers
+    void Rasterize();
+
+    // Whether any part of the box could be visible past the occluders
+    bool IsVisible(const AABB &bounds) const;
+
+    inline size_t getNumOfOccluders() const { return _occluders.size(); }
+    // The triangles that made it into the depth buffer during the last Rasterize()
+    inline unsigned int getNumOfTriangles() const { return _numOfTriangles; }
+    unsigned int GetNumOfWorkers() const;
+    inline const float *getDepth() const { return _depth.data(); }
+
+    private:
+    // Runs the phase as a job per worker, including the calling thread, and waits for all of them to finish
+    void RunPhase(void (SoftwareOcclusionCuller::*phase)(unsigned int worker));
+
+    void BinOccluders(unsigned int worker);
+    void RasterizeTiles(unsigned int worker);
+    void RasterizeTriangle(const ScreenTriangle &triangle, int tileMinX, int tileMinY, int tileMaxX, int tileMaxY);
+    // The screen rectangle and nearest depth of the box. Returns false if part of it is in front of the near plane
+    bool ProjectBox(const AABB &bounds, float &minX, float &minY, float &maxX, float &maxY, float &nearestDepth) const;
+};
@@ -0,0 +1,383 @@
+#include "stress_scene.hpp"
+
+#include <glad/glad.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "core/log.hpp"
+#include "core/trace.hpp"
+#include "core/scene.hpp"
+#include "core/resource_manager.hpp"
+#include "core/allocation_counter.hpp"
+#include "core/job_system.hpp"
+#include "rendering/shader_compiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+static constexpr float PI = 3.14159265358979f;
+
+// xorshift32, which makes the same numbers on every platform unlike the standard distributions
+static unsigned int NextRandom(unsigned int &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float NextRandomFloat(unsigned int &state)
+{
+    return (NextRandom(state) >> 8) / 16777216.0f;
+}
+
+// A value in [0, 1) for every integer lattice point
+static float HashLattice(int x, int y, int z, unsigned int seed)
+{
+    unsigned int hash = seed * 0x9E3779B9u ^ (unsigned int)x * 0x85EBCA6Bu ^ (unsigned int)y * 0xC2B2AE35u ^ (unsigned int)z * 0x27D4EB2Fu;
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+    return (hash >> 8) / 16777216.0f;
+}
+
+// Value noise in [0, 1), smoothly interpolated between the lattice points
+static float ValueNoise(const glm::vec3 &point, unsigned int seed)
+{
+    const glm::vec3 cell = glm::floor(point);
+    const glm::vec3 t = point - cell;
+    const glm::vec3 s = t * t * (3.0f - 2.0f * t);
+    const int x = (int)cell.x, y = (int)cell.y, z = (int)cell.z;
+
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    const float x00 = lerp(HashLattice(x, y, z, seed),         HashLattice(x + 1, y, z, seed),         s.x);
+    const float x10 = lerp(HashLattice(x, y + 1, z, seed),     HashLattice(x + 1, y + 1, z, seed),     s.x);
+    const float x01 = lerp(HashLattice(x, y, z + 1, seed),     HashLattice(x + 1, y, z + 1, seed),     s.x);
+    const float x11 = lerp(HashLattice(x, y + 1, z + 1, seed), HashLattice(x + 1, y + 1, z + 1, seed), s.x);
+    return lerp(lerp(x00, x10, s.y), lerp(x01, x11, s.y), s.z);
+}
+
+// A few octaves of value noise, in [0, 1)
+static float FractalNoise(glm::vec3 point, unsigned int seed)
+{
+    float value = 0.0f, amplitude = 0.5f, sum = 0.0f;
+    for(unsigned int octave = 0; octave < 3; octave++)
+    {
+        value += ValueNoise(point, seed + octave) * amplitude;
+        sum += amplitude;
+        point *= 2.0f;
+        amplitude *= 0.5f;
+    }
+    return value / sum;
+}
+
+// Flat shaded, wound counter-clockwise when looked at from the side the outward vector points to
+static void AddTriangle(std::vector<Vertex> &vertices, const Vertex &a, const Vertex &b, const Vertex &c, const glm::vec3 &outward)
+{
+    glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+    const float length = glm::length(normal);
+    normal = length > 0.0f ? normal / length : outward;
+
+    const bool flip = glm::dot(normal, outward) < 0.0f;
+    if(flip)
+        normal = -normal;
+    vertices.push_back(Vertex(a.position, a.uv, normal));
+    vertices.push_back(Vertex(flip ? c.position : b.position, flip ? c.uv : b.uv, normal));
+    vertices.push_back(Vertex(flip ? b.position : c.position, flip ? b.uv : c.uv, normal));
+}
+
+// A UV sphere of diameter 1 with its radius displaced by noise. Makes 4 * rings * (rings - 1) triangles
+static std::vector<Vertex> GenerateSphere(unsigned int numOfTriangles, unsigned int seed)
+{
+    const unsigned int numOfRings = std::max(3u, (unsigned int)std::lround(std::sqrt(numOfTriangles / 4.0f)));
+    const unsigned int numOfSegments = numOfRings * 2;
+
+    auto getVertex = [&](unsigned int ring, unsigned int segment)
+    {
+        const float theta = PI * ring / numOfRings;
+        const float phi = 2.0f * PI * segment / numOfSegments;
+        const glm::vec3 direction = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        const float radius = 0.5f * (0.85f + 0.3f * FractalNoise(direction * 2.0f + 4.0f, seed));
+        return Vertex(direction * radius, glm::vec2((float)segment / numOfSegments, (float)ring / numOfRings));
+    };
+
+    std::vector<Vertex> vertices;
+    vertices.reserve((size_t)numOfSegments * (numOfRings - 1) * 2 * 3);
+    for(unsigned int ring = 0; ring < numOfRings; ring++)
+    {
+        for(unsigned int segment = 0; segment < numOfSegments; segment++)
+        {
+            const Vertex topLeft = getVertex(ring, segment), topRight = getVertex(ring, segment + 1);
+            const Vertex bottomLeft = getVertex(ring + 1, segment), bottomRight = getVertex(ring + 1, segment + 1);
+            const glm::vec3 outward = topLeft.position + bottomRight.position;
+            // The rings at the poles are made of one triangle per segment
+            if(ring != 0)
+                AddTriangle(vertices, topLeft, topRight, bottomRight, outward);
+            if(ring != numOfRings - 1)
+                AddTriangle(vertices, topLeft, bottomRight, bottomLeft, outward);
+        }
+    }
+    return vertices;
+}
+
+// A 1x1 grid on the XZ plane with its height displaced by noise. Makes 2 * cells^2 triangles
+static std::vector<Vertex> GenerateNoiseGrid(unsigned int numOfTriangles, unsigned int seed)
+{
+    const unsigned int numOfCells = std::max(1u, (unsigned int)std::lround(std::sqrt(numOfTriangles / 2.0f)));
+
+    auto getVertex = [&](unsigned int x, unsigned int z)
+    {
+        const glm::vec2 uv = glm::vec2((float)x / numOfCells, (float)z / numOfCells);
+        const float height = 0.4f * (FractalNoise(glm::vec3(uv.x * 4.0f, 0.0f, uv.y * 4.0f), seed) - 0.5f);
+        return Vertex(glm::vec3(uv.x - 0.5f, height, uv.y - 0.5f), uv);
+    };
+
+    std::vector<Vertex> vertices;
+    vertices.reserve((size_t)numOfCells * numOfCells * 2 * 3);
+    const glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    for(unsigned int z = 0; z < numOfCells; z++)
+    {
+        for(unsigned int x = 0; x < numOfCells; x++)
+        {
+            const Vertex a = getVertex(x, z), b = getVertex(x + 1, z), c = getVertex(x + 1, z + 1), d = getVertex(x, z + 1);
+            AddTriangle(vertices, a, b, c, up);
+            AddTriangle(vertices, a, c, d, up);
+        }
+    }
+    return vertices;
+}
+
+bool StressScene::Generate(const StressSceneSettings &settings)
+{
+    TRACE_ZONE("Generate stress scene");
+
+    Clear();
+    _settings = settings;
+    _settings.numOfModels = std::max(_settings.numOfModels, 1u);
+    _settings.numOfMaterials = std::max(_settings.numOfMaterials, 1u);
+    _settings.numOfShaderVariants = std::clamp(_settings.numOfShaderVariants, 1u, MAX_SHADER_VARIANTS);
+    _settings.textureSize = std::max((_settings.textureSize + 3) / 4 * 4, 4u);
+    _stats = StressSceneStats();
+
+    Scene &scene = Scene::getInstance();
+    _numOfSceneRenderables = scene.renderables.size();
+    _numOfSceneEntities = scene.transforms.getNumOfEntities();
+    _numOfSceneTextures = scene.textures.size();
+
+    // Zero would get xorshift stuck
+    unsigned int random = _settings.seed * 2654435761u + 1;
+    const unsigned long long allocatedBytes = AllocationCounter::getAllocatedBytes();
+    auto start = std::chrono::steady_clock::now();
+    auto measure = [&start]()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const float time = std::chrono::duration<float, std::milli>(now - start).count();
+        start = now;
+        return time;
+    };
+
+    GenerateModels(random);
+    _stats.modelTime = measure();
+    GenerateTextures(random);
+    _stats.textureTime = measure();
+    if(!GenerateMaterials(random))
+    {
+        Clear();
+        return false;
+    }
+    _stats.materialTime = measure();
+    GenerateObjects(random);
+    _stats.objectTime = measure();
+
+    _stats.totalTime = _stats.modelTime + _stats.textureTime + _stats.materialTime + _stats.objectTime;
+    _stats.allocatedBytes = AllocationCounter::getAllocatedBytes() - allocatedBytes;
+    _isGenerated = true;
+
+    char message[256];
+    snprintf(message, sizeof(message), "Generated a stress scene of %u objects (%llu triangles, %u models, %u materials, %u textures) in %.1f ms",
+             _stats.numOfObjects, _stats.numOfTriangles, _settings.numOfModels, _settings.numOfMaterials, _settings.numOfTextures, _stats.totalTime);
+    Log::LogInfo(message);
+    return true;
+}
+
+void StressScene::Clear()
+{
+    if(!_isGenerated && _models.empty() && _materials.empty() && _textures.empty())
+        return;
+
+    Scene &scene = Scene::getInstance();
+    if(_isGenerated)
+    {
+        scene.renderables.resize(std::min(scene.renderables.size(), _numOfSceneRenderables));
+        scene.transforms.Truncate(std::min(scene.transforms.getNumOfEntities(), _numOfSceneEntities));
+        scene.textures.resize(std::min(scene.textures.size(), _numOfSceneTextures));
+    }
+
+    for(Shader *material: _materials)
+        delete material;
+    for(Texture *texture: _textures)
+        delete texture;
+    for(Model *model: _models)
+        delete model;
+    _materials.clear();
+    _materialColors.clear();
+    _textures.clear();
+    _textureData.clear();
+    _models.clear();
+    _isGenerated = false;
+}
+
+void StressScene::GenerateModels(unsigned int &random)
+{
+    TRACE_ZONE("Generate stress models");
+
+    // The seeds are drawn up front so that the scene comes out the same no matter how the jobs get scheduled
+    std::vector<unsigned int> seeds(_settings.numOfModels);
+    for(unsigned int &seed: seeds)
+        seed = NextRandom(random);
+
+    std::vector<std::vector<Vertex>> modelVertices(_settings.numOfModels);
+    JobSystem::getInstance().ParallelFor("Generate stress model", 0, _settings.numOfModels, 1, [&](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i = begin; i < end; i++)
+        {
+            const bool sphere = _settings.shape == StressShape::SPHERES || (_settings.shape == StressShape::MIXED && i % 2 == 0);
+            modelVertices[i] = sphere ? GenerateSphere(_settings.trianglesPerModel, seeds[i]) : GenerateNoiseGrid(_settings.trianglesPerModel, seeds[i]);
+        }
+    });
+
+    _models.reserve(_settings.numOfModels);
+    for(std::vector<Vertex> &vertices: modelVertices)
+    {
+        _stats.vertexBytes += vertices.size() * sizeof(Vertex);
+        _models.push_back(new Model(std::move(vertices)));
+    }
+}
+
+void StressScene::GenerateTextures(unsigned int &random)
+{
+    TRACE_ZONE("Generate stress textures");
+
+    const unsigned int size = _settings.textureSize;
+    const unsigned int cellSize = std::max(size / 8, 1u);
+    // A checkerboard of two random colors with some noise over it.
+    // The random numbers are drawn up front so that the scene comes out the same no matter how the jobs get scheduled
+    struct TextureParams final
+    {
+        unsigned int seed;
+        glm::vec3 colors[2];
+    };
+    std::vector<TextureParams> params(_settings.numOfTextures);
+    for(TextureParams &texture: params)
+    {
+        texture.seed = NextRandom(random);
+        texture.colors[0] = glm::vec3(NextRandomFloat(random), NextRandomFloat(random), NextRandomFloat(random));
+        texture.colors[1] = glm::vec3(NextRandomFloat(random), NextRandomFloat(random), NextRandomFloat(random));
+    }
+
+    _textureData.resize(_settings.numOfTextures);
+    JobSystem::getInstance().ParallelFor("Generate stress texture", 0, _settings.numOfTextures, 1, [&](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int i = begin; i < end; i++)
+        {
+            const TextureParams &texture = params[i];
+            std::vector<unsigned char> &data = _textureData[i];
+            data.resize((size_t)size * size * 3);
+            for(unsigned int y = 0; y < size; y++)
+            {
+                for(unsigned int x = 0; x < size; x++)
+                {
+                    const float noise = 0.75f + 0.5f * ValueNoise(glm::vec3(x, y, 0.0f) * (16.0f / size), texture.seed);
+                    const glm::vec3 color = glm::clamp(texture.colors[(x / cellSize + y / cellSize) % 2] * noise, 0.0f, 1.0f);
+                    unsigned char *pixel = &data[((size_t)y * size + x) * 3];
+                    pixel[0] = (unsigned char)(color.x * 255.0f);
+                    pixel[1] = (unsigned char)(color.y * 255.0f);
+                    pixel[2] = (unsigned char)(color.z * 255.0f);
+                }
+            }
+        }
+    });
+
+    _textures.reserve(_settings.numOfTextures);
+    for(const std::vector<unsigned char> &data: _textureData)
+    {
+        _textures.push_back(new Texture(GL_TEXTURE_2D, glm::uvec2(size, size), GL_RGB, GL_RGB, (void*)data.data()));
+        _stats.textureBytes += data.size();
+    }
+}
+
+bool StressScene::GenerateMaterials(unsigned int &random)
+{
+    TRACE_ZONE("Generate stress materials");
+
+    const ShaderDefines variantDefines[MAX_SHADER_VARIANTS] = { {}, { { "LIT", "" } }, { { "TEXTURED", "" } }, { { "LIT", "" }, { "TEXTURED", "" } } };
+    Shader *variants[MAX_SHADER_VARIANTS] = {};
+    for(unsigned int i = 0; i < _settings.numOfShaderVariants; i++)
+    {
+        variants[i] = ResourceManager::getInstance().GetShaderVariant("default", variantDefines[i]);
+        if(variants[i] != nullptr)
+            ShaderCompiler::getInstance().WaitFor(variants[i]);
+        if(variants[i] == nullptr || !variants[i]->isReady())
+        {
+            Log::LogError("Couldn't generate the stress scene's materials, the default shader or one of its variants isn't usable");
+            return false;
+        }
+    }
+
+    // All of them get submitted before any is waited for so that the compiles can overlap
+    _materials.reserve(_settings.numOfMaterials);
+    _materialColors.reserve(_settings.numOfMaterials);
+    for(unsigned int i = 0; i < _settings.numOfMaterials; i++)
+    {
+        const Shader &variant = *variants[i % _settings.numOfShaderVariants];
+        Shader *material = new Shader(variant.getVertSource().c_str(), variant.getFragSource().c_str());
+        material->setVariantInfo(variant.getName(), variant.getDefines(), variant.getKeywords());
+        _materials.push_back(material);
+        _materialColors.push_back(glm::vec4(0.25f + 0.75f * NextRandomFloat(random), 0.25f + 0.75f * NextRandomFloat(random), 0.25f + 0.75f * NextRandomFloat(random), 1.0f));
+    }
+
+    for(unsigned int i = 0; i < _settings.numOfMaterials; i++)
+    {
+        Shader *material = _materials[i];
+        ShaderCompiler::getInstance().WaitFor(material);
+        if(!material->isReady())
+            continue;
+
+        material->InheritUniformValues(variants[i % _settings.numOfShaderVariants]);
+        material->SetUniform("u_Color", (void*)&_materialColors[i]);
+        if(!_textures.empty())
+            material->SetUniform("u_Tex", (void*)_textures[i % _textures.size()]);
+    }
+    return true;
+}
+
+void StressScene::GenerateObjects(unsigned int &random)
+{
+    TRACE_ZONE("Generate stress objects");
+
+    Scene &scene = Scene::getInstance();
+    scene.textures.insert(scene.textures.end(), _textures.begin(), _textures.end());
+
+    const unsigned int numOfObjects = _settings.numOfObjects;
+    const unsigned int gridSize = std::max((unsigned int)std::ceil(std::cbrt((float)numOfObjects)), 1u);
+    const glm::vec3 gridStart = glm::vec3(-0.5f * (gridSize - 1) * _settings.spacing);
+    const glm::vec3 scale = glm::vec3(_settings.spacing * 0.8f);
+    scene.transforms.Reserve(_numOfSceneEntities + numOfObjects);
+    scene.renderables.reserve(_numOfSceneRenderables + numOfObjects);
+    for(unsigned int i = 0; i < numOfObjects; i++)
+    {
+        Model *model = _models[NextRandom(random) % _models.size()];
+        Shader *material = _materials[NextRandom(random) % _materials.size()];
+        const glm::vec3 cell = glm::vec3(i % gridSize, (i / gridSize) % gridSize, i / (gridSize * gridSize));
+        const EntityID entity = scene.AddRenderable(model, material);
+        scene.transforms.SetPosition(entity, gridStart + cell * _settings.spacing);
+        scene.transforms.SetRotation(entity, glm::angleAxis(NextRandomFloat(random) * 2.0f * PI, glm::vec3(0.0f, 1.0f, 0.0f)));
+        scene.transforms.SetScale(entity, scale);
+        _stats.numOfTriangles += model->getVertices().size() / 3;
+    }
+    _stats.numOfObjects = numOfObjects;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <glm/vec4.hpp>
+
+#include "misc/singleton.hpp"
+#include "rendering/shader.hpp"
+#include "rendering/texture.hpp"
+#include "rendering/model.hpp"
+
+#include <cstddef>
+#include <vector>
+
+enum class StressShape
+{
+    SPHERES = 0,
+    NOISE_GRIDS,
+    // Every other model is a sphere
+    MIXED
+};
+
+struct StressSceneSettings final
+{
+    unsigned int numOfObjects = 1000;
+    // Every model gets about this many triangles
+    unsigned int trianglesPerModel = 512;
+    // The objects share this many different models between them
+    unsigned int numOfModels = 4;
+    // Every material is a shader of its own with its own color and texture, so the objects can only be batched together within a material
+    unsigned int numOfMaterials = 8;
+    unsigned int numOfTextures = 4;
+    // Width and height of the textures, rounded up to a multiple of 4
+    unsigned int textureSize = 256;
+    // How many of the default shader's variants the materials are spread across: unlit, LIT, TEXTURED, LIT and TEXTURED
+    unsigned int numOfShaderVariants = 4;
+    StressShape shape = StressShape::MIXED;
+    // The same seed and settings always make the same scene
+    unsigned int seed = 1;
+    // Distance between the objects, which sit in a cube shaped grid around the origin
+    float spacing = 0.5f;
+};
+
+// What generating the scene took, the times are in milliseconds
+struct StressSceneStats final
+{
+    float modelTime = 0.0f;
+    float textureTime = 0.0f;
+    // Includes waiting for the materials' shaders to compile
+    float materialTime = 0.0f;
+    float objectTime = 0.0f;
+    float totalTime = 0.0f;
+
+    unsigned int numOfObjects = 0;
+    // Over all of the objects
+    unsigned long long numOfTriangles = 0;
+    // Uploaded to the GPU for the models and the textures
+    size_t vertexBytes = 0;
+    size_t textureBytes = 0;
+    // Allocated on the CPU while generating, see AllocationCounter
+    unsigned long long allocatedBytes = 0;
+};
+
+/*
+Fills the scene with procedurally generated objects for seeing how loading, memory and drawing scale with the size of the scene.
+The models are spheres and grids displaced by value noise, the textures are noisy checkerboards and the materials are copies of
+the default shader's variants with a color and a texture of their own. The objects are spread across the models and materials
+and laid out in a grid around the origin.
+Generating compiles the materials right away, so with many materials it takes a while. The generated scene gets added on top
+of what the scene already has and Clear() takes it back off, along with everything that was added to the scene after it.
+*/
+class StressScene final : public Singleton<StressScene>
+{
+    friend class Singleton<StressScene>;
+
+    public:
+    static constexpr unsigned int MAX_SHADER_VARIANTS = 4;
+
+    private:
+    StressSceneSettings _settings;
+    StressSceneStats _stats;
+    bool _isGenerated = false;
+
+    std::vector<Model*> _models;
+    std::vector<Texture*> _textures;
+    std::vector<std::vector<unsigned char>> _textureData;
+    std::vector<Shader*> _materials;
+    // The materials' u_Color values, which the shaders point into
+    std::vector<glm::vec4> _materialColors;
+
+    // What the scene had before the objects were added, which Clear() puts it back to
+    size_t _numOfSceneRenderables = 0;
+    size_t _numOfSceneEntities = 0;
+    size_t _numOfSceneTextures = 0;
+
+    private:
+    StressScene() = default;
+    ~StressScene() = default;
+
+    public:
+    // Replaces the previously generated scene, if there is one. Needs the default shader to be loaded
+    bool Generate(const StressSceneSettings &settings);
+    void Clear();
+
+    inline bool isGenerated() const { return _isGenerated; }
+    inline const StressSceneSettings &getSettings() const { return _settings; }
+    inline const StressSceneStats &getStats() const { return _stats; }
+
+    private:
+    void GenerateModels(unsigned int &random);
+    void GenerateTextures(unsigned int &random);
+    bool GenerateMaterials(unsigned int &random);
+    void GenerateObjects(unsigned int &random);
+};
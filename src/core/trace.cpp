@@ -0,0 +1,209 @@
+#include "trace.hpp"
+
+#include "core/log.hpp"
+#include "misc/utils.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+static const std::chrono::steady_clock::time_point TRACE_EPOCH = std::chrono::steady_clock::now();
+
+static void CopyDetail(char *destination, const char *detail)
+{
+    if(detail == nullptr)
+    {
+        destination[0] = '\0';
+        return;
+    }
+    // Long paths keep their end, which is the part that tells them apart
+    const size_t length = std::strlen(detail);
+    const size_t start = length >= TraceEvent::MAX_DETAIL_LENGTH ? length - (TraceEvent::MAX_DETAIL_LENGTH - 1) : 0;
+    std::memcpy(destination, detail + start, length - start + 1);
+}
+
+TraceZone::TraceZone(const char *name, const char *detail)
+{
+    if(!Trace::isCapturing())
+        return;
+
+    _name = name;
+    CopyDetail(_detail, detail);
+    _begin = Trace::Now();
+}
+
+TraceZone::~TraceZone()
+{
+    if(_name != nullptr)
+        Trace::Record(_name, _begin, Trace::Now(), _detail);
+}
+
+void Trace::Start()
+{
+    if(_isCapturing)
+        return;
+
+    // The threads notice the new capture the next time they record something and start over
+    _capture++;
+    _isCapturing = true;
+    _numOfFramesLeft = 0;
+    _frameStartTime = Now();
+    Log::LogInfo("Trace capture started");
+}
+
+bool Trace::Stop()
+{
+    if(!_isCapturing)
+        return false;
+    _isCapturing = false;
+
+    char timestamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    // Captures stopped within the same second get numbered instead of overwriting each other
+    std::string path = "trace_" + std::string(timestamp) + ".json";
+    for(unsigned int i = 2; std::ifstream(path).good(); i++)
+        path = "trace_" + std::string(timestamp) + "_" + std::to_string(i) + ".json";
+    if(!Write(path))
+        return false;
+
+    _lastTracePath = path;
+    Log::LogInfo("Trace written to " + _lastTracePath);
+    return true;
+}
+
+void Trace::CaptureFrames(unsigned int numOfFrames)
+{
+    if(numOfFrames == 0)
+        return;
+
+    Start();
+    _numOfFramesLeft = numOfFrames;
+}
+
+void Trace::EndFrame()
+{
+    const long long now = Now();
+    Record("Frame", _frameStartTime, now, "");
+    _frameStartTime = now;
+
+    if(_numOfFramesLeft == 0)
+        return;
+
+    _numOfFramesLeft--;
+    if(_numOfFramesLeft == 0)
+        Stop();
+}
+
+void Trace::SetThreadName(const char *name)
+{
+    ThreadBuffer &buffer = GetThreadBuffer();
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    buffer.threadName = name;
+}
+
+void Trace::Record(const char *name, long long begin, long long end, const char *detail)
+{
+    if(!isCapturing())
+        return;
+
+    ThreadBuffer &buffer = GetThreadBuffer();
+    const unsigned int capture = _capture.load(std::memory_order_acquire);
+    if(buffer.capture.load(std::memory_order_relaxed) != capture)
+    {
+        buffer.numOfEvents.store(0, std::memory_order_relaxed);
+        buffer.numOfDroppedEvents.store(0, std::memory_order_relaxed);
+        buffer.capture.store(capture, std::memory_order_release);
+    }
+
+    const size_t index = buffer.numOfEvents.load(std::memory_order_relaxed);
+    if(index >= MAX_EVENTS_PER_THREAD)
+    {
+        buffer.numOfDroppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent &event = buffer.events[index];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    std::memcpy(event.detail, detail, std::strlen(detail) + 1);
+    // Publishes the event to the thread writing the trace out
+    buffer.numOfEvents.store(index + 1, std::memory_order_release);
+}
+
+long long Trace::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - TRACE_EPOCH).count();
+}
+
+Trace::ThreadBuffer &Trace::GetThreadBuffer()
+{
+    thread_local ThreadBuffer *threadBuffer = nullptr;
+    if(threadBuffer != nullptr)
+        return *threadBuffer;
+
+    // Owned by the list so that the events of threads that have exited can still be written out
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    _buffers.push_back(std::make_unique<ThreadBuffer>());
+    threadBuffer = _buffers.back().get();
+    threadBuffer->events.resize(MAX_EVENTS_PER_THREAD);
+    threadBuffer->threadID = (unsigned int)_buffers.size();
+    threadBuffer->threadName = "Thread " + std::to_string(threadBuffer->threadID);
+    return *threadBuffer;
+}
+
+bool Trace::Write(const std::string &path)
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+    {
+        Log::LogError("Failed to open " + path + " for writing the trace");
+        return false;
+    }
+
+    const unsigned int capture = _capture.load(std::memory_order_acquire);
+    unsigned int numOfDroppedEvents = 0;
+    bool isFirstEvent = true;
+    auto beginEvent = [&]()
+    {
+        file << (isFirstEvent ? "\n" : ",\n");
+        isFirstEvent = false;
+    };
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    std::lock_guard<std::mutex> lock(_buffersMutex);
+    for(const std::unique_ptr<ThreadBuffer> &buffer: _buffers)
+    {
+        beginEvent();
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID << ",\"args\":{\"name\":" << ToJSONString(buffer->threadName) << "}}";
+
+        // Threads that haven't recorded anything since the capture started still hold the last capture's events
+        if(buffer->capture.load(std::memory_order_acquire) != capture)
+            continue;
+
+        const size_t numOfEvents = buffer->numOfEvents.load(std::memory_order_acquire);
+        numOfDroppedEvents += buffer->numOfDroppedEvents.load(std::memory_order_relaxed);
+        for(size_t i = 0; i < numOfEvents; i++)
+        {
+            const TraceEvent &event = buffer->events[i];
+            char times[96];
+            snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+
+            beginEvent();
+            file << "{\"name\":" << ToJSONString(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadID << ',' << times;
+            if(event.detail[0] != '\0')
+            {
+                file << ",\"args\":{\"detail\":" << ToJSONString(event.detail) << '}';
+            }
+            file << '}';
+        }
+    }
+    file << "\n]}\n";
+
+    if(numOfDroppedEvents > 0)
+        Log::LogWarning("The trace's thread buffers filled up, " + std::to_string(numOfDroppedEvents) + " zones were dropped");
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Instrumentation zones, only compiled in with TRACE_ZONES (see the CMake option of the same name).
+// Without it the macros expand to nothing and their arguments aren't even evaluated
+#ifdef TRACE_ZONES
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Times the rest of the block. The name has to be a string literal
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(_traceZone, __LINE__)(name)
+// Same as TRACE_ZONE with a bit of text (eg. a file path) that gets copied into the trace
+#define TRACE_ZONE_DETAIL(name, detail) TraceZone TRACE_CONCAT(_traceZone, __LINE__)(name, detail)
+// Names the calling thread in the trace
+#define TRACE_THREAD_NAME(name) Trace::SetThreadName(name)
+#else
+#define TRACE_ZONE(name)
+#define TRACE_ZONE_DETAIL(name, detail)
+#define TRACE_THREAD_NAME(name)
+#endif
+
+struct TraceEvent final
+{
+    static constexpr size_t MAX_DETAIL_LENGTH = 64;
+
+    const char *name;
+    // Nanoseconds since the trace clock started
+    long long begin;
+    long long end;
+    char detail[MAX_DETAIL_LENGTH];
+};
+
+/*
+Records the zones of every thread while a capture is running and writes them out as a Chrome trace event file
+(chrome://tracing, ui.perfetto.dev) when it's stopped.
+Every thread writes into a buffer of its own, so recording a zone never takes a lock. The buffer gets registered the first
+time the thread records something, which is the only time a lock is taken. A buffer only ever gets appended to by its thread
+and only gets read up to what the thread has published, so a capture can be written out while the other threads keep going.
+Once a buffer is full, the rest of the thread's zones for that capture are dropped.
+*/
+class Trace final
+{
+    public:
+    static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 16;
+
+    private:
+    struct ThreadBuffer final
+    {
+        std::vector<TraceEvent> events;
+        std::atomic<size_t> numOfEvents{0};
+        // The capture the events are from, a new capture makes the thread start over the next time it records something
+        std::atomic<unsigned int> capture{0};
+        std::atomic<unsigned int> numOfDroppedEvents{0};
+        unsigned int threadID = 0;
+        std::string threadName;
+    };
+
+    inline static std::mutex _buffersMutex;
+    inline static std::vector<std::unique_ptr<ThreadBuffer>> _buffers;
+    inline static std::atomic<bool> _isCapturing{false};
+    inline static std::atomic<unsigned int> _capture{0};
+
+    // Only touched by the render (GL) thread, or by the main thread while the render thread isn't running
+    inline static unsigned int _numOfFramesLeft = 0;
+    inline static long long _frameStartTime = 0;
+    inline static std::string _lastTracePath;
+
+    private:
+    Trace() {}
+    ~Trace() {}
+
+    public:
+    static constexpr bool IsCompiledIn()
+    {
+#ifdef TRACE_ZONES
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static void Start();
+    // Writes the capture to a trace_<date>_<time>.json file in the working directory, returns false if there was nothing to stop
+    static bool Stop();
+    // Starts a capture that stops on its own after the given number of frames
+    static void CaptureFrames(unsigned int numOfFrames);
+    // Called by the render (GL) thread once at the end of every frame, records the frame as a zone of its own
+    static void EndFrame();
+
+    static void SetThreadName(const char *name);
+    static void Record(const char *name, long long begin, long long end, const char *detail);
+    static long long Now();
+
+    static bool isCapturing() { return _isCapturing.load(std::memory_order_relaxed); }
+    static unsigned int getNumOfFramesLeft() { return _numOfFramesLeft; }
+    static const std::string &getLastTracePath() { return _lastTracePath; }
+
+    private:
+    static ThreadBuffer &GetThreadBuffer();
+    static bool Write(const std::string &path);
+};
+
+// Records the time between its construction and destruction as a zone, if a capture is running when it's constructed
+class TraceZone final
+{
+    private:
+    const char *_name = nullptr;
+    long long _begin = 0;
+    char _detail[TraceEvent::MAX_DETAIL_LENGTH];
+
+    public:
+    explicit TraceZone(const char *name, const char *detail = nullptr);
+    TraceZone(const char *name, const std::string &detail): TraceZone(name, detail.c_str()) {}
+    ~TraceZone();
+    TraceZone(const TraceZone &other) = delete;
+    TraceZone &operator=(const TraceZone &other) = delete;
+};
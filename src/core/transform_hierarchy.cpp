@@ -0,0 +1,151 @@
+#include "transform_hierarchy.hpp"
+
+#include "misc/simd_math.hpp"
+
+#include <algorithm>
+
+EntityID TransformHierarchy::CreateEntity(EntityID parent, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    const EntityID entity = (EntityID)_parents.size();
+    // Parenting to an entity that doesn't exist yet would break the parents before children order
+    _parents.push_back(parent < entity ? parent : INVALID_ENTITY);
+    _positions.push_back(position);
+    _rotations.push_back(rotation);
+    _scales.push_back(scale);
+    _worldMatrices.push_back(glm::mat4(1.0f));
+    _dirty.push_back(false);
+
+    MarkDirty(entity);
+    return entity;
+}
+
+void TransformHierarchy::Clear()
+{
+    _parents.clear();
+    _positions.clear();
+    _rotations.clear();
+    _scales.clear();
+    _worldMatrices.clear();
+    _dirty.clear();
+    _updatedEntities.clear();
+    _firstDirty = 0;
+}
+
+void TransformHierarchy::Truncate(size_t numOfEntities)
+{
+    if(numOfEntities >= _parents.size())
+        return;
+
+    _parents.resize(numOfEntities);
+    _positions.resize(numOfEntities);
+    _rotations.resize(numOfEntities);
+    _scales.resize(numOfEntities);
+    _worldMatrices.resize(numOfEntities);
+    _dirty.resize(numOfEntities);
+    _updatedEntities.erase(std::remove_if(_updatedEntities.begin(), _updatedEntities.end(), [numOfEntities](EntityID entity) { return entity >= numOfEntities; }), _updatedEntities.end());
+    _firstDirty = std::min(_firstDirty, (EntityID)numOfEntities);
+}
+
+void TransformHierarchy::Reserve(size_t numOfEntities)
+{
+    _parents.reserve(numOfEntities);
+    _positions.reserve(numOfEntities);
+    _rotations.reserve(numOfEntities);
+    _scales.reserve(numOfEntities);
+    _worldMatrices.reserve(numOfEntities);
+    _dirty.reserve(numOfEntities);
+}
+
+void TransformHierarchy::SetPosition(EntityID entity, const glm::vec3 &position)
+{
+    _positions[entity] = position;
+    MarkDirty(entity);
+}
+void TransformHierarchy::SetRotation(EntityID entity, const glm::quat &rotation)
+{
+    _rotations[entity] = rotation;
+    MarkDirty(entity);
+}
+void TransformHierarchy::SetScale(EntityID entity, const glm::vec3 &scale)
+{
+    _scales[entity] = scale;
+    MarkDirty(entity);
+}
+
+void TransformHierarchy::MarkDirty(EntityID entity)
+{
+    _dirty[entity] = true;
+    _firstDirty = std::min(_firstDirty, entity);
+}
+
+unsigned int TransformHierarchy::UpdateWorldMatrices()
+{
+    const EntityID numOfEntities = (EntityID)_parents.size();
+    _updatedEntities.clear();
+    if(_firstDirty >= numOfEntities)
+        return 0;
+
+    // Single pass over everything after the first changed entity. The dirty flags spread down to the children on the way,
+    // which works because the parents are always visited (and finished) before their children
+    unsigned int numOfUpdated = 0;
+    EntityID batch[4];
+    unsigned int batchSize = 0;
+    for(EntityID entity = _firstDirty; entity < numOfEntities; entity++)
+    {
+        const EntityID parent = _parents[entity];
+        if(parent != INVALID_ENTITY && _dirty[parent])
+            _dirty[entity] = true;
+        if(!_dirty[entity])
+            continue;
+
+        batch[batchSize++] = entity;
+        _updatedEntities.push_back(entity);
+        if(batchSize == 4)
+        {
+            UpdateBatch(batch, batchSize);
+            numOfUpdated += batchSize;
+            batchSize = 0;
+        }
+    }
+    if(batchSize != 0)
+    {
+        UpdateBatch(batch, batchSize);
+        numOfUpdated += batchSize;
+    }
+
+    // The flags can only be cleared at the end, the children look at their parent's flag on the way
+    std::fill(_dirty.begin() + _firstDirty, _dirty.end(), false);
+    _firstDirty = numOfEntities;
+
+    return numOfUpdated;
+}
+
+void TransformHierarchy::UpdateBatch(const EntityID batch[4], unsigned int batchSize)
+{
+    // The local matrices of the whole batch at once, a partial batch repeats its last entity
+    const glm::vec3 *positions[4];
+    const glm::quat *rotations[4];
+    const glm::vec3 *scales[4];
+    glm::mat4 localMatrices[4];
+    glm::mat4 *out[4];
+    for(unsigned int lane = 0; lane < 4; lane++)
+    {
+        const EntityID entity = batch[lane < batchSize ? lane : batchSize - 1];
+        positions[lane] = &_positions[entity];
+        rotations[lane] = &_rotations[entity];
+        scales[lane] = &_scales[entity];
+        out[lane] = &localMatrices[lane];
+    }
+    ComposeTransforms4(positions, rotations, scales, out);
+
+    // In order, a parent can be earlier in the same batch
+    for(unsigned int lane = 0; lane < batchSize; lane++)
+    {
+        const EntityID entity = batch[lane];
+        const EntityID parent = _parents[entity];
+        if(parent != INVALID_ENTITY)
+            MultiplyMat4(_worldMatrices[parent], localMatrices[lane], _worldMatrices[entity]);
+        else
+            _worldMatrices[entity] = localMatrices[lane];
+    }
+}
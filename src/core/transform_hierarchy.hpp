@@ -0,0 +1,62 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+using EntityID = unsigned int;
+static constexpr EntityID INVALID_ENTITY = 0xFFFFFFFF;
+
+/*
+The parent/child transforms of every entity in the scene, stored as structure of arrays indexed by the entity ID.
+An entity can only be parented to an entity that already exists, so parents always come before their children.
+That lets the world matrices be recomputed in a single pass over the arrays without any recursion,
+starting at the first entity that changed and only touching the changed entities and everything below them.
+*/
+class TransformHierarchy final
+{
+    private:
+    std::vector<EntityID> _parents;
+    std::vector<glm::vec3> _positions;
+    std::vector<glm::quat> _rotations;
+    std::vector<glm::vec3> _scales;
+    std::vector<glm::mat4> _worldMatrices;
+    std::vector<unsigned char> _dirty;
+    // The entities the last UpdateWorldMatrices() recomputed
+    std::vector<EntityID> _updatedEntities;
+    // No entity before this one is dirty
+    EntityID _firstDirty = 0;
+
+    public:
+    EntityID CreateEntity(EntityID parent = INVALID_ENTITY, const glm::vec3 &position = glm::vec3(0.0f), const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3 &scale = glm::vec3(1.0f));
+    void Clear();
+    // Removes every entity from the given one onwards. Children always come after their parents,
+    // so none of the remaining entities can lose its parent
+    void Truncate(size_t numOfEntities);
+    void Reserve(size_t numOfEntities);
+
+    void SetPosition(EntityID entity, const glm::vec3 &position);
+    void SetRotation(EntityID entity, const glm::quat &rotation);
+    void SetScale(EntityID entity, const glm::vec3 &scale);
+
+    inline EntityID getParent(EntityID entity) const { return _parents[entity]; }
+    inline const glm::vec3 &getPosition(EntityID entity) const { return _positions[entity]; }
+    inline const glm::quat &getRotation(EntityID entity) const { return _rotations[entity]; }
+    inline const glm::vec3 &getScale(EntityID entity) const { return _scales[entity]; }
+    // Only up to date after UpdateWorldMatrices()
+    inline const glm::mat4 &getWorldMatrix(EntityID entity) const { return _worldMatrices[entity]; }
+    inline const std::vector<glm::mat4> &getWorldMatrices() const { return _worldMatrices; }
+    inline size_t getNumOfEntities() const { return _parents.size(); }
+    inline const std::vector<EntityID> &getUpdatedEntities() const { return _updatedEntities; }
+
+    // Recomputes the world matrices of the changed entities and their descendants.
+    // Returns how many of them got recomputed
+    unsigned int UpdateWorldMatrices();
+
+    private:
+    void MarkDirty(EntityID entity);
+    // Computes the world matrices of up to 4 dirty entities, given in parents before children order
+    void UpdateBatch(const EntityID batch[4], unsigned int batchSize);
+};
@@ -1,19 +1,119 @@
 #include "ui_manager.hpp"
 
-#include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_opengl3.h>
 #include <pfd/portable-file-dialogs.h>
 
 #include "core/log.hpp"
 #include "core/resource_manager.hpp"
+#include "core/instancing_benchmark.hpp"
+#include "core/stress_scene.hpp"
+#include "core/job_system.hpp"
+#include "core/trace.hpp"
+#include "rendering/gl_state.hpp"
+#include "rendering/gl_extensions.hpp"
+#include "rendering/gl_debug_output.hpp"
+#include "rendering/gl_capture.hpp"
+#include "rendering/frame_profiler.hpp"
+#include "rendering/render_counters.hpp"
 #include "misc/utils.hpp"
 
+#include <algorithm>
+#include <cfloat>
 #include <utility>
+#include <vector>
 
 #define ARRAY_SIZE(x) sizeof(x)/sizeof(x[0]) 
 
 static constexpr char* GLSL_VERSION = "#version 420"; 
 
+static ImGuiKey TranslateKey(int key)
+{
+    switch(key)
+    {
+        case GLFW_KEY_TAB: return ImGuiKey_Tab;
+        case GLFW_KEY_LEFT: return ImGuiKey_LeftArrow;
+        case GLFW_KEY_RIGHT: return ImGuiKey_RightArrow;
+        case GLFW_KEY_UP: return ImGuiKey_UpArrow;
+        case GLFW_KEY_DOWN: return ImGuiKey_DownArrow;
+        case GLFW_KEY_PAGE_UP: return ImGuiKey_PageUp;
+        case GLFW_KEY_PAGE_DOWN: return ImGuiKey_PageDown;
+        case GLFW_KEY_HOME: return ImGuiKey_Home;
+        case GLFW_KEY_END: return ImGuiKey_End;
+        case GLFW_KEY_INSERT: return ImGuiKey_Insert;
+        case GLFW_KEY_DELETE: return ImGuiKey_Delete;
+        case GLFW_KEY_BACKSPACE: return ImGuiKey_Backspace;
+        case GLFW_KEY_SPACE: return ImGuiKey_Space;
+        case GLFW_KEY_ENTER: return ImGuiKey_Enter;
+        case GLFW_KEY_ESCAPE: return ImGuiKey_Escape;
+        case GLFW_KEY_APOSTROPHE: return ImGuiKey_Apostrophe;
+        case GLFW_KEY_COMMA: return ImGuiKey_Comma;
+        case GLFW_KEY_MINUS: return ImGuiKey_Minus;
+        case GLFW_KEY_PERIOD: return ImGuiKey_Period;
+        case GLFW_KEY_SLASH: return ImGuiKey_Slash;
+        case GLFW_KEY_SEMICOLON: return ImGuiKey_Semicolon;
+        case GLFW_KEY_EQUAL: return ImGuiKey_Equal;
+        case GLFW_KEY_LEFT_BRACKET: return ImGuiKey_LeftBracket;
+        case GLFW_KEY_BACKSLASH: return ImGuiKey_Backslash;
+        case GLFW_KEY_RIGHT_BRACKET: return ImGuiKey_RightBracket;
+        case GLFW_KEY_GRAVE_ACCENT: return ImGuiKey_GraveAccent;
+        case GLFW_KEY_CAPS_LOCK: return ImGuiKey_CapsLock;
+        case GLFW_KEY_SCROLL_LOCK: return ImGuiKey_ScrollLock;
+        case GLFW_KEY_NUM_LOCK: return ImGuiKey_NumLock;
+        case GLFW_KEY_PRINT_SCREEN: return ImGuiKey_PrintScreen;
+        case GLFW_KEY_PAUSE: return ImGuiKey_Pause;
+        case GLFW_KEY_KP_DECIMAL: return ImGuiKey_KeypadDecimal;
+        case GLFW_KEY_KP_DIVIDE: return ImGuiKey_KeypadDivide;
+        case GLFW_KEY_KP_MULTIPLY: return ImGuiKey_KeypadMultiply;
+        case GLFW_KEY_KP_SUBTRACT: return ImGuiKey_KeypadSubtract;
+        case GLFW_KEY_KP_ADD: return ImGuiKey_KeypadAdd;
+        case GLFW_KEY_KP_ENTER: return ImGuiKey_KeypadEnter;
+        case GLFW_KEY_KP_EQUAL: return ImGuiKey_KeypadEqual;
+        case GLFW_KEY_LEFT_SHIFT: return ImGuiKey_LeftShift;
+        case GLFW_KEY_LEFT_CONTROL: return ImGuiKey_LeftCtrl;
+        case GLFW_KEY_LEFT_ALT: return ImGuiKey_LeftAlt;
+        case GLFW_KEY_LEFT_SUPER: return ImGuiKey_LeftSuper;
+        case GLFW_KEY_RIGHT_SHIFT: return ImGuiKey_RightShift;
+        case GLFW_KEY_RIGHT_CONTROL: return ImGuiKey_RightCtrl;
+        case GLFW_KEY_RIGHT_ALT: return ImGuiKey_RightAlt;
+        case GLFW_KEY_RIGHT_SUPER: return ImGuiKey_RightSuper;
+        case GLFW_KEY_MENU: return ImGuiKey_Menu;
+    }
+
+    // The letters, digits and function keys are contiguous on both sides
+    if(key >= GLFW_KEY_0 && key <= GLFW_KEY_9)
+        return (ImGuiKey)(ImGuiKey_0 + (key - GLFW_KEY_0));
+    if(key >= GLFW_KEY_A && key <= GLFW_KEY_Z)
+        return (ImGuiKey)(ImGuiKey_A + (key - GLFW_KEY_A));
+    if(key >= GLFW_KEY_F1 && key <= GLFW_KEY_F12)
+        return (ImGuiKey)(ImGuiKey_F1 + (key - GLFW_KEY_F1));
+    if(key >= GLFW_KEY_KP_0 && key <= GLFW_KEY_KP_9)
+        return (ImGuiKey)(ImGuiKey_Keypad0 + (key - GLFW_KEY_KP_0));
+    return ImGuiKey_None;
+}
+
+// Asks for the keys themselves instead of trusting the callbacks' mods, which leave out the modifier that was just pressed on X11
+static int GetKeyMods(GLFWwindow *window)
+{
+    int mods = 0;
+    if(glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS)
+        mods |= ImGuiMod_Ctrl;
+    if(glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS)
+        mods |= ImGuiMod_Shift;
+    if(glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_ALT) == GLFW_PRESS)
+        mods |= ImGuiMod_Alt;
+    if(glfwGetKey(window, GLFW_KEY_LEFT_SUPER) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_SUPER) == GLFW_PRESS)
+        mods |= ImGuiMod_Super;
+    return mods;
+}
+
+static void AddModEvents(ImGuiIO &io, int mods)
+{
+    io.AddKeyEvent(ImGuiMod_Ctrl, (mods & ImGuiMod_Ctrl) != 0);
+    io.AddKeyEvent(ImGuiMod_Shift, (mods & ImGuiMod_Shift) != 0);
+    io.AddKeyEvent(ImGuiMod_Alt, (mods & ImGuiMod_Alt) != 0);
+    io.AddKeyEvent(ImGuiMod_Super, (mods & ImGuiMod_Super) != 0);
+}
+
 void UIManager::Init(GLFWwindow* const window)
 {
     // Init ImGui
@@ -23,21 +123,156 @@ void UIManager::Init(GLFWwindow* const window)
     
     ImGui::StyleColorsDark();
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    // ImGui's GLFW backend isn't used, the main thread translates the input and samples the window in TakeInput()
+    // and the render thread hands them to ImGui in ReplayInput()
+    _window = window;
+    io.BackendPlatformName = "GLFW (render thread)";
+    io.BackendFlags |= ImGuiBackendFlags_HasMouseCursors;
     ImGui_ImplOpenGL3_Init(GLSL_VERSION);
+    glfwSetWindowFocusCallback(window, WindowFocusCallback);
+    glfwSetCursorEnterCallback(window, CursorEnterCallback);
+    glfwSetCursorPosCallback(window, CursorPosCallback);
+    glfwSetMouseButtonCallback(window, MouseButtonCallback);
+    glfwSetScrollCallback(window, ScrollCallback);
+    glfwSetKeyCallback(window, KeyCallback);
+    glfwSetCharCallback(window, CharCallback);
+
+    _cursors[ImGuiMouseCursor_Arrow] = glfwCreateStandardCursor(GLFW_ARROW_CURSOR);
+    _cursors[ImGuiMouseCursor_TextInput] = glfwCreateStandardCursor(GLFW_IBEAM_CURSOR);
+    _cursors[ImGuiMouseCursor_ResizeNS] = glfwCreateStandardCursor(GLFW_VRESIZE_CURSOR);
+    _cursors[ImGuiMouseCursor_ResizeEW] = glfwCreateStandardCursor(GLFW_HRESIZE_CURSOR);
+    _cursors[ImGuiMouseCursor_Hand] = glfwCreateStandardCursor(GLFW_HAND_CURSOR);
 }
 void UIManager::DeInit()
 {
     // Deinit ImGui
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
+
+    for(GLFWcursor *&cursor: _cursors)
+    {
+        if(cursor != nullptr)
+            glfwDestroyCursor(cursor);
+        cursor = nullptr;
+    }
+}
+
+void UIManager::TakeInput(std::vector<UIInputEvent> &events, UIWindowState &window)
+{
+    events.insert(events.end(), _pendingInput.begin(), _pendingInput.end());
+    _pendingInput.clear();
+
+    int width, height, framebufferWidth, framebufferHeight;
+    glfwGetWindowSize(_window, &width, &height);
+    glfwGetFramebufferSize(_window, &framebufferWidth, &framebufferHeight);
+    window.width = (float)width;
+    window.height = (float)height;
+    // Stays as it was while the window is minimized
+    if(width > 0 && height > 0)
+    {
+        window.framebufferScaleX = (float)framebufferWidth / width;
+        window.framebufferScaleY = (float)framebufferHeight / height;
+    }
+
+    const ImGuiMouseCursor cursor = _requestedCursor.load();
+    if(cursor == _currentCursor)
+        return;
+    _currentCursor = cursor;
+    if(cursor == ImGuiMouseCursor_None)
+    {
+        glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
+        return;
+    }
+    glfwSetCursor(_window, _cursors[cursor] != nullptr ? _cursors[cursor] : _cursors[ImGuiMouseCursor_Arrow]);
+    glfwSetInputMode(_window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+}
+
+void UIManager::ReplayInput(const std::vector<UIInputEvent> &events, const UIWindowState &window)
+{
+    ImGuiIO &io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(window.width, window.height);
+    io.DisplayFramebufferScale = ImVec2(window.framebufferScaleX, window.framebufferScaleY);
+
+    // glfwGetTime() is the one GLFW function that's fine to call from any thread. ImGui doesn't take a delta time of 0
+    double time = glfwGetTime();
+    if(_lastFrameTime > 0.0 && time <= _lastFrameTime)
+        time = _lastFrameTime + 0.00001;
+    io.DeltaTime = _lastFrameTime > 0.0 ? (float)(time - _lastFrameTime) : 1.0f / 60.0f;
+    _lastFrameTime = time;
+
+    for(const UIInputEvent &event: events)
+    {
+        switch(event.type)
+        {
+            case UIInputEventType::WINDOW_FOCUS: io.AddFocusEvent(event.ints[0] != 0); break;
+            case UIInputEventType::MOUSE_POS: io.AddMousePosEvent(event.floats[0], event.floats[1]); break;
+            case UIInputEventType::MOUSE_BUTTON:
+                AddModEvents(io, event.mods);
+                io.AddMouseButtonEvent(event.ints[0], event.ints[1] != 0);
+                break;
+            case UIInputEventType::MOUSE_WHEEL: io.AddMouseWheelEvent(event.floats[0], event.floats[1]); break;
+            case UIInputEventType::KEY:
+                AddModEvents(io, event.mods);
+                io.AddKeyEvent((ImGuiKey)event.ints[0], event.ints[1] != 0);
+                break;
+            case UIInputEventType::CHAR: io.AddInputCharacter((unsigned int)event.ints[0]); break;
+        }
+    }
+}
+
+void UIManager::WindowFocusCallback(GLFWwindow *window, int focused)
+{
+    getInstance()._pendingInput.push_back({ UIInputEventType::WINDOW_FOCUS, { focused, 0 }, {}, 0 });
+}
+void UIManager::CursorEnterCallback(GLFWwindow *window, int entered)
+{
+    // Moves the mouse out of ImGui's reach while it's outside of the window and back to where it is once it's entered again
+    float x = -FLT_MAX, y = -FLT_MAX;
+    if(entered)
+    {
+        double cursorX, cursorY;
+        glfwGetCursorPos(window, &cursorX, &cursorY);
+        x = (float)cursorX;
+        y = (float)cursorY;
+    }
+    getInstance()._pendingInput.push_back({ UIInputEventType::MOUSE_POS, {}, { x, y }, 0 });
+}
+void UIManager::CursorPosCallback(GLFWwindow *window, double x, double y)
+{
+    getInstance()._pendingInput.push_back({ UIInputEventType::MOUSE_POS, {}, { (float)x, (float)y }, 0 });
+}
+void UIManager::MouseButtonCallback(GLFWwindow *window, int button, int action, int mods)
+{
+    // ImGui only knows about the first 5 buttons
+    if(button < 0 || button >= 5)
+        return;
+    getInstance()._pendingInput.push_back({ UIInputEventType::MOUSE_BUTTON, { button, action == GLFW_PRESS }, {}, GetKeyMods(window) });
+}
+void UIManager::ScrollCallback(GLFWwindow *window, double xOffset, double yOffset)
+{
+    getInstance()._pendingInput.push_back({ UIInputEventType::MOUSE_WHEEL, {}, { (float)xOffset, (float)yOffset }, 0 });
+}
+void UIManager::KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+    // ImGui repeats the keys that are held down on its own
+    if(action != GLFW_PRESS && action != GLFW_RELEASE)
+        return;
+    const ImGuiKey imguiKey = TranslateKey(key);
+    if(imguiKey == ImGuiKey_None)
+        return;
+    getInstance()._pendingInput.push_back({ UIInputEventType::KEY, { imguiKey, action == GLFW_PRESS }, {}, GetKeyMods(window) });
+}
+void UIManager::CharCallback(GLFWwindow *window, unsigned int c)
+{
+    getInstance()._pendingInput.push_back({ UIInputEventType::CHAR, { (int)c, 0 }, {}, 0 });
 }
 
 void UIManager::DrawUI()
 {
+    TRACE_ZONE("Draw UI");
+    ProfileScope uiScope(UI_PASS_SCOPE, true);
+
     ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
 
@@ -46,14 +281,24 @@ void UIManager::DrawUI()
         DrawRendererPropertiesWindow();
     if(_showShaderProperties)
         DrawShaderPropertiesWindow();
+    if(_showProfiler)
+        DrawProfilerWindow();
+    if(_showRenderStats)
+        DrawRenderStatsOverlay();
     
     #ifdef _DEBUG
     if(_showImGuiDemoWindow)
         ImGui::ShowDemoWindow();
     #endif
 
+    TRACE_ZONE("Render UI");
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    // The main thread puts it on the window the next time it takes the input
+    const ImGuiIO &io = ImGui::GetIO();
+    if(!(io.ConfigFlags & ImGuiConfigFlags_NoMouseCursorChange))
+        _requestedCursor.store(io.MouseDrawCursor ? ImGuiMouseCursor_None : ImGui::GetMouseCursor());
 }
 
 std::vector<std::string> UIManager::ShowFileDialog(const std::string &title, const std::vector<std::string> &filters, bool allowMultiSelect)
@@ -128,6 +373,8 @@ void UIManager::DrawMainMenuBar()
     {
         ImGui::MenuItem("Renderer properties", "", &_showRendererProperties, true);
         ImGui::MenuItem("Shader properties", "", &_showShaderProperties, true);
+        ImGui::MenuItem("Profiler", "", &_showProfiler, true);
+        ImGui::MenuItem("Render stats", "", &_showRenderStats, true);
         #ifdef _DEBUG
         ImGui::Separator();
         ImGui::MenuItem("ImGui demo", "", &_showImGuiDemoWindow, true);
@@ -141,6 +388,7 @@ void UIManager::DrawMainMenuBar()
 
 void UIManager::DrawRendererPropertiesWindow()
 {
+    TRACE_ZONE("Renderer properties window");
     if(ImGui::Begin("Renderer properties", &_showRendererProperties, _windowFlags))
     {
         static RendererSettings &rendererSettings = Renderer::getInstance().settings;
@@ -150,11 +398,151 @@ void UIManager::DrawRendererPropertiesWindow()
         static bool renderWireframe = false;
         UIManager::DrawWidgetCheckbox("Draw wireframe", &renderWireframe);
         rendererSettings.renderMode = renderWireframe ? RenderMode::WIREFRAME : RenderMode::TRIANGLES;
+
+        ImGui::Separator();
+
+        UIManager::DrawWidgetCheckbox("Frustum culling", &rendererSettings.frustumCulling);
+        UIManager::DrawWidgetCheckbox("Instancing", &rendererSettings.instancing);
+        UIManager::DrawWidgetInt("Min instanced batch size", &rendererSettings.minInstancedBatchSize);
+        if(rendererSettings.minInstancedBatchSize < 1)
+            rendererSettings.minInstancedBatchSize = 1;
+        if(GLExtensions::multiDrawIndirect)
+            UIManager::DrawWidgetCheckbox("Multi draw indirect", &rendererSettings.multiDrawIndirect);
+        else
+            ImGui::TextDisabled("Multi draw indirect: not supported");
+        if(GLExtensions::computeShaders)
+        {
+            UIManager::DrawWidgetCheckbox("GPU culling", &rendererSettings.gpuCulling);
+            UIManager::DrawWidgetCheckbox("Occlusion culling", &rendererSettings.occlusionCulling);
+            UIManager::DrawWidgetCheckbox("Show GPU culled", &rendererSettings.showGPUCulled);
+            UIManager::DrawWidgetCheckbox("Freeze GPU culling", &rendererSettings.freezeGPUCulling);
+        }
+        else
+        {
+            ImGui::TextDisabled("GPU culling: not supported");
+        }
+        UIManager::DrawWidgetCheckbox("Software occlusion culling", &rendererSettings.softwareOcclusionCulling);
+        UIManager::DrawWidgetCheckbox("Sort render queue", &rendererSettings.sortRenderQueue);
+        UIManager::DrawWidgetCheckbox("Parallel draw recording", &rendererSettings.parallelRecording);
+        UIManager::DrawWidgetCheckbox("Specialize static uniforms", &rendererSettings.specializeStaticUniforms);
+        UIManager::DrawWidgetInt("Frames until static", &rendererSettings.specializationFrameThreshold);
+        if(rendererSettings.specializationFrameThreshold < 1)
+            rendererSettings.specializationFrameThreshold = 1;
+
+        const RendererStats &rendererStats = Renderer::getInstance().stats;
+        ImGui::Text("Scene pass GPU time: %.3f ms (%s)", rendererStats.scenePassTime, rendererStats.isShaderSpecialized ? "specialized" : "generic");
+        ImGui::Text("Average generic: %.3f ms, specialized: %.3f ms", rendererStats.genericScenePassTime, rendererStats.specializedScenePassTime);
+        ImGui::Text("Transform update: %.3f ms (%u of %zu entities), %u draw calls", rendererStats.transformUpdateTime, rendererStats.numOfUpdatedTransforms, Scene::getInstance().transforms.getNumOfEntities(), rendererStats.numOfDrawCalls);
+        ImGui::Text("Culling: %.3f ms, %u visible, %u culled", rendererStats.cullTime, rendererStats.numOfVisibleRenderables, rendererStats.numOfCulledRenderables);
+        ImGui::Text("Instancing: %u batches, %u of %u renderables", rendererStats.numOfInstancedBatches, rendererStats.numOfInstances, rendererStats.numOfVisibleRenderables);
+        ImGui::Text("Multi draw indirect: %u commands", rendererStats.numOfMultiDrawCommands);
+        if(rendererSettings.gpuCulling)
+        {
+            const GPUCullStats &gpuCulling = rendererStats.gpuCulling;
+            ImGui::Text("GPU culling: %u visible, %u frustum culled, %u occluded (%u frames old)", gpuCulling.numOfVisible, gpuCulling.numOfFrustumCulled, gpuCulling.numOfOcclusionCulled, gpuCulling.latency);
+        }
+        if(rendererSettings.softwareOcclusionCulling)
+        {
+            const float cullRate = rendererStats.numOfOcclusionTested > 0 ? 100.0f * rendererStats.numOfSoftwareOccluded / rendererStats.numOfOcclusionTested : 0.0f;
+            ImGui::Text("Software occlusion: %u occluders (%u triangles) rasterized in %.3f ms", rendererStats.numOfOccluders, rendererStats.numOfOccluderTriangles, rendererStats.occluderRasterTime);
+            ImGui::Text("%u of %u occluded (%.1f%%), tested in %.3f ms", rendererStats.numOfSoftwareOccluded, rendererStats.numOfOcclusionTested, cullRate, rendererStats.occlusionTestTime);
+        }
+        const RenderQueueStateChanges &unsorted = rendererStats.stateChangesUnsorted;
+        const RenderQueueStateChanges &submitted = rendererStats.stateChangesSubmitted;
+        ImGui::Text("Render queue sort: %.3f ms", rendererStats.sortTime);
+        ImGui::Text("Draw recording: %.3f ms into %u lists (%zu commands), submitted in %.3f ms", rendererStats.recordTime,
+                    rendererStats.numOfRecordedLists, rendererStats.numOfRecordedCommands, rendererStats.submitTime);
+        const JobSystemStats &jobStats = JobSystem::getInstance().getLastFrameStats();
+        ImGui::Text("Jobs: %u on %u workers (%u stolen), %u on the GL thread", jobStats.numOfJobs, JobSystem::getInstance().getNumOfWorkers(),
+                    jobStats.numOfStolenJobs, jobStats.numOfGLThreadJobs);
+        ImGui::Text("Streamed: %.1f of %.1f KB (%s), waited %.3f ms on the GPU", rendererStats.streamedBytes / 1024.0f, rendererStats.streamingSegmentSize / 1024.0f,
+                    GLExtensions::bufferStorage ? "persistently mapped" : "mapped per frame", rendererStats.streamingWaitTime);
+        ImGui::Text("Program/texture/mesh changes: %u/%u/%u unsorted, %u/%u/%u submitted", unsorted.programs, unsorted.textures, unsorted.meshes, submitted.programs, submitted.textures, submitted.meshes);
+
+        InstancingBenchmark &instancingBenchmark = InstancingBenchmark::getInstance();
+        if(instancingBenchmark.isRunning())
+        {
+            ImGui::Text("Benchmarking %u instances (%s)...", instancingBenchmark.getCurrentNumOfInstances(), instancingBenchmark.isCurrentStepInstanced() ? "instanced" : "not instanced");
+            if(ImGui::Button("Stop instancing benchmark"))
+                instancingBenchmark.Stop();
+        }
+        else if(ImGui::Button("Run instancing benchmark"))
+        {
+            instancingBenchmark.Start();
+        }
+        for(const InstancingBenchmarkResult &result: instancingBenchmark.getResults())
+            ImGui::Text("%6u %-3s  CPU %.3f ms, GPU %.3f ms, %.0f draw calls", result.numOfInstances, result.instanced ? "yes" : "no", result.cpuFrameTime, result.gpuScenePassTime, result.numOfDrawCalls);
+
+        if(ImGui::CollapsingHeader("Stress scene"))
+        {
+            static StressSceneSettings stressSettings;
+            static const char *shapes[] = { "Spheres", "Noise grids", "Mixed" };
+            UIManager::DrawWidgetUnsignedInt("Objects", &stressSettings.numOfObjects);
+            UIManager::DrawWidgetUnsignedInt("Triangles per model", &stressSettings.trianglesPerModel);
+            UIManager::DrawWidgetUnsignedInt("Models", &stressSettings.numOfModels);
+            UIManager::DrawWidgetUnsignedInt("Materials", &stressSettings.numOfMaterials);
+            UIManager::DrawWidgetUnsignedInt("Textures", &stressSettings.numOfTextures);
+            UIManager::DrawWidgetUnsignedInt("Texture size", &stressSettings.textureSize);
+            UIManager::DrawWidgetUnsignedInt("Shader variants", &stressSettings.numOfShaderVariants);
+            ImGui::Combo("Shape", (int*)&stressSettings.shape, shapes, 3);
+            UIManager::DrawWidgetUnsignedInt("Seed", &stressSettings.seed);
+            UIManager::DrawWidgetFloat("Spacing", &stressSettings.spacing);
+
+            StressScene &stressScene = StressScene::getInstance();
+            if(ImGui::Button("Generate"))
+                stressScene.Generate(stressSettings);
+            if(stressScene.isGenerated())
+            {
+                ImGui::SameLine();
+                if(ImGui::Button("Clear"))
+                    stressScene.Clear();
+
+                const StressSceneStats &stressStats = stressScene.getStats();
+                ImGui::Text("%u objects, %llu triangles", stressStats.numOfObjects, stressStats.numOfTriangles);
+                ImGui::Text("Generated in %.1f ms: models %.1f, textures %.1f, materials %.1f, objects %.1f", stressStats.totalTime,
+                            stressStats.modelTime, stressStats.textureTime, stressStats.materialTime, stressStats.objectTime);
+                ImGui::Text("Vertices %.1f MB, textures %.1f MB, %.1f MB allocated on the CPU", stressStats.vertexBytes / (1024.0f * 1024.0f),
+                            stressStats.textureBytes / (1024.0f * 1024.0f), stressStats.allocatedBytes / (1024.0f * 1024.0f));
+            }
+        }
+
+        const GLStateCounters &stateCounters = GLState::getInstance().getLastFrameCounters();
+        ImGui::Text("GL state calls: %u issued, %u redundant (skipped)", stateCounters.issuedCalls, stateCounters.redundantCalls);
+        const PipelineStateCache &pipelineStateCache = PipelineStateCache::getInstance();
+        ImGui::Text("Pipeline states: %u, cached transitions: %zu", pipelineStateCache.getNumOfStates(), pipelineStateCache.getNumOfTransitions());
+
+        ImGui::Separator();
+
+        // Only the modes that were compiled in can be picked
+        static const char *errorCheckModes[] = { "Off", "Per frame", "Per call" };
+        int errorCheckMode = (int)GLErrorChecks::GetMode();
+        if(ImGui::Combo("GL error checks", &errorCheckMode, errorCheckModes, GL_ERROR_CHECK_LEVEL + 1))
+            GLErrorChecks::SetMode((GLErrorCheckMode)errorCheckMode);
+
+        if(GLDebugOutput::IsSupported())
+        {
+            bool debugOutputEnabled = GLDebugOutput::IsEnabled();
+            UIManager::DrawWidgetCheckbox("GL debug output", &debugOutputEnabled);
+            if(debugOutputEnabled != GLDebugOutput::IsEnabled())
+                GLDebugOutput::SetEnabled(debugOutputEnabled);
+
+            if(debugOutputEnabled)
+            {
+                static const char *severities[] = { "Notification", "Low", "Medium", "High" };
+                ImGui::Combo("Min severity", &GLDebugOutput::minSeverity, severities, GLDebugOutput::SEVERITIES.size());
+                for(size_t i = 0; i < GLDebugOutput::SOURCES.size(); i++)
+                    UIManager::DrawWidgetCheckbox(GLDebugOutput::GetSourceName(GLDebugOutput::SOURCES[i]), &GLDebugOutput::enabledSources[i]);
+            }
+        }
+
+        ImGui::Text("CPU frame time: %.3f ms", rendererStats.frameTime);
+        ImGui::Text("Average off: %.3f ms, per frame: %.3f ms, per call: %.3f ms", rendererStats.frameTimeByErrorCheckMode[0], rendererStats.frameTimeByErrorCheckMode[1], rendererStats.frameTimeByErrorCheckMode[2]);
     }
     ImGui::End();
 }
 void UIManager::DrawShaderPropertiesWindow()
 {
+    TRACE_ZONE("Shader properties window");
     if(ImGui::Begin("Shader properties", &_showShaderProperties, _windowFlags))
     {
         
@@ -344,10 +732,59 @@ void UIManager::DrawShaderPropertiesWindow()
             }
         }
 
+        // Feature toggles of the current shader. Every combination of features is a separately compiled variant
+        // so that the shader only pays for what is actually used instead of branching at runtime
+        Shader *sceneShader = Scene::getInstance().shader;
+        if(sceneShader != nullptr && !sceneShader->getKeywords().empty())
+        {
+            ImGui::Separator();
+
+            ImGui::Text("Shader features:");
+            for(const std::string &keyword: sceneShader->getKeywords())
+            {
+                // Picked by the renderer for the renderables it draws instanced or through multi draw indirect
+                if(keyword == Renderer::INSTANCING_KEYWORD || keyword == Renderer::MULTI_DRAW_KEYWORD)
+                    continue;
+
+                bool isEnabled = sceneShader->getDefines().count(keyword) != 0;
+                const bool wasEnabled = isEnabled;
+                DrawWidgetCheckbox(keyword.c_str(), &isEnabled);
+
+                if(isEnabled != wasEnabled)
+                {
+                    ShaderDefines defines = sceneShader->getDefines();
+                    if(isEnabled)
+                        defines[keyword] = "";
+                    else
+                        defines.erase(keyword);
+
+                    Shader *variant = ResourceManager::getInstance().GetShaderVariant(sceneShader->getName(), defines);
+                    if(variant != nullptr)
+                    {
+                        // Carry over whatever was set up in the previous variant
+                        variant->InheritUniformValues(sceneShader);
+                        Scene::getInstance().shader = variant;
+                        // The variant may use a different number of textures, the slots get preallocated again once it's ready
+                        Scene::getInstance().textures.clear();
+                    }
+                    // The keywords belong to the previous variant, stop iterating over them
+                    break;
+                }
+            }
+        }
+
         ImGui::Separator();
 
         ImGui::Text("Shader uniforms:");
-        if(Scene::getInstance().shader != nullptr)
+        // The uniforms are only known once the shader has finished compiling
+        if(Scene::getInstance().shader != nullptr && !Scene::getInstance().shader->isReady())
+        {
+            if(Scene::getInstance().shader->getStatus() == ShaderStatus::PENDING)
+                ImGui::Text("Compiling...");
+            else
+                ImGui::Text("Shader failed to compile, check the log for details");
+        }
+        else if(Scene::getInstance().shader != nullptr)
         {
             // Shader uniforms display and editing
             const std::vector<ShaderUniform*> &shaderUniforms = Scene::getInstance().shader->getUniforms();          
@@ -357,6 +794,17 @@ void UIManager::DrawShaderPropertiesWindow()
             // so that the entire list doesn't have to be looped over all the time
             std::vector<ShaderUniform*> texUniforms = Scene::getInstance().shader->getUniformsOfType(ShaderUniformType::TEX2D);  
 
+            // The shader might have still been compiling when it got selected,
+            // in which case the texture slots couldn't be preallocated in the scene back then
+            auto &texturesInScene = Scene::getInstance().textures;
+            if(texturesInScene.empty())
+            {
+                for (int i = 0; i < texUniforms.size(); i++)
+                {
+                    texturesInScene.push_back(new Texture());
+                }
+            }
+
             // Draw the appropriate UI control widget for each uniform present in the shader given its type
             for(ShaderUniform* const uniform: shaderUniforms)
             {
@@ -411,13 +859,10 @@ void UIManager::DrawShaderPropertiesWindow()
                         // This means that textures will get the bind target by the way they are declared (eg. the first declared sampler2D uniform will be GL_TEXTURE0, the next one GL_TEXTURE1 and so on)
                         unsigned int texBindTarget = FindIndexOfElement<ShaderUniform*>(texUniforms, uniform);
                         Texture *newTex = DrawWidgetTex2D(uniform->getName().c_str(), (Texture*)uniform->value, texBindTarget);
-                        // If a new texture was loaded using the Tex2D widget, delete the default empty texture and set the uniform's value to be the newly loaded texture
+                        // If a new texture was loaded using the Tex2D widget, set the uniform's value to be the newly loaded texture.
+                        // The uniform doesn't own either of them, so the previous one stays where it is
                         if(newTex != nullptr)
                         {
-                            if(((Texture*)(uniform->value))->getID() == 0)
-                            {
-                                delete((Texture*)(uniform->value));
-                            }
                             uniform->value = (void*)newTex;
                         }
                     break;
@@ -427,6 +872,210 @@ void UIManager::DrawShaderPropertiesWindow()
     }
     ImGui::End();
 }
+
+void UIManager::DrawProfilerWindow()
+{
+    TRACE_ZONE("Profiler window");
+    const FrameProfiler &profiler = FrameProfiler::getInstance();
+    if(ImGui::Begin("Profiler", &_showProfiler, _windowFlags))
+    {
+        const ProfiledTimeStats cpuStats = profiler.GetFrameTimeStats(false);
+        const ProfiledTimeStats gpuStats = profiler.GetFrameTimeStats(true);
+        ImGui::Text("CPU frame: p50 %.3f, p95 %.3f, p99 %.3f, max %.3f ms", cpuStats.p50, cpuStats.p95, cpuStats.p99, cpuStats.max);
+        ImGui::Text("GPU frame: p50 %.3f, p95 %.3f, p99 %.3f, max %.3f ms", gpuStats.p50, gpuStats.p95, gpuStats.p99, gpuStats.max);
+        ImGui::Text("Over the last %u frames, %u frames' GPU times arrived too late", profiler.getNumOfFrames(), profiler.getNumOfDroppedGPUFrames());
+
+        // Captures of every thread's trace zones, written out as Chrome trace files
+        if(!Trace::IsCompiledIn())
+            ImGui::TextDisabled("Trace zones: not compiled in");
+        else if(Trace::isCapturing())
+        {
+            if(Trace::getNumOfFramesLeft() > 0)
+                ImGui::Text("Tracing, %u frames left...", Trace::getNumOfFramesLeft());
+            else
+                ImGui::Text("Tracing...");
+            ImGui::SameLine();
+            if(ImGui::Button("Stop trace"))
+                Trace::Stop();
+        }
+        else
+        {
+            if(ImGui::Button("Start trace"))
+                Trace::Start();
+            ImGui::SameLine();
+            if(ImGui::Button("Trace frames"))
+                Trace::CaptureFrames((unsigned int)std::max(_numOfTraceFrames, 1));
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(100.0f);
+            ImGui::InputInt("##NumOfTraceFrames", &_numOfTraceFrames);
+            if(!Trace::getLastTracePath().empty())
+                ImGui::Text("Last trace: %s", Trace::getLastTracePath().c_str());
+        }
+
+        // GL call captures for ModelViewerReplay, which have to be armed at startup
+        GLCapture &glCapture = GLCapture::getInstance();
+        switch(glCapture.getState())
+        {
+            case GLCaptureState::DISARMED:
+                ImGui::TextDisabled("GL capture: set MODELVIEWER_GL_CAPTURE=<frames> to arm it");
+                break;
+            case GLCaptureState::ARMED:
+                if(ImGui::Button("Capture GL frames"))
+                    glCapture.Start();
+                ImGui::SameLine();
+                ImGui::Text("%u frames", glCapture.getNumOfFrames());
+                break;
+            case GLCaptureState::CAPTURING:
+                ImGui::Text("Capturing GL calls, %u frames left...", glCapture.getNumOfFramesLeft());
+                break;
+            case GLCaptureState::DONE:
+                ImGui::Text("Last GL capture: %s", glCapture.getLastCapturePath().c_str());
+                break;
+        }
+
+        // Rolling graphs of the whole history
+        const unsigned int numOfFrames = profiler.getNumOfFrames();
+        std::vector<float> cpuTimes(numOfFrames), gpuTimes(numOfFrames);
+        for(unsigned int i = 0; i < numOfFrames; i++)
+        {
+            cpuTimes[i] = profiler.GetFrame(i).cpuTime;
+            gpuTimes[i] = std::max(profiler.GetFrame(i).gpuTime, 0.0f);
+        }
+        const float graphWidth = ImGui::GetContentRegionAvail().x;
+        const float graphMax = std::max(cpuStats.max, gpuStats.max) * 1.1f;
+        ImGui::PlotLines("##CPUFrameTimes", cpuTimes.data(), (int)numOfFrames, 0, "CPU ms", 0.0f, graphMax, ImVec2(graphWidth, 60.0f));
+        ImGui::PlotLines("##GPUFrameTimes", gpuTimes.data(), (int)numOfFrames, 0, "GPU ms", 0.0f, graphMax, ImVec2(graphWidth, 60.0f));
+
+        // Timeline of a single frame, the CPU scopes nested by depth and the GPU scopes in a row under them.
+        // The GPU has no notion of when the CPU submitted the work, so the GPU scopes are drawn from where their CPU scope started
+        ImGui::Checkbox("Pause timeline", &_pauseProfilerTimeline);
+        const ProfiledFrame *latestFrame = profiler.GetLatestFrame();
+        if(!_pauseProfilerTimeline && latestFrame != nullptr)
+            _profilerTimelineFrame = *latestFrame;
+        const ProfiledFrame &frame = _profilerTimelineFrame;
+        ImGui::Text("Frame %u: CPU %.3f ms, GPU %.3f ms", frame.frameIndex, frame.cpuTime, std::max(frame.gpuTime, 0.0f));
+
+        unsigned int numOfRows = 1;
+        for(const ProfiledScope &scope: frame.scopes)
+            numOfRows = std::max(numOfRows, scope.depth + 2);
+        const float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+        const float timelineWidth = ImGui::GetContentRegionAvail().x;
+        const float scale = frame.cpuTime > 0.0f ? timelineWidth / frame.cpuTime : 0.0f;
+        ImDrawList *drawList = ImGui::GetWindowDrawList();
+        drawList->AddRectFilled(origin, ImVec2(origin.x + timelineWidth, origin.y + numOfRows * rowHeight), IM_COL32(30, 30, 34, 255));
+
+        const ProfiledScope *hoveredScope = nullptr;
+        bool isGPUScopeHovered = false;
+        auto drawBar = [&](const ProfiledScope &scope, float start, float duration, unsigned int row, ImU32 color, bool gpu)
+        {
+            const ImVec2 min = ImVec2(origin.x + start * scale, origin.y + row * rowHeight);
+            const ImVec2 max = ImVec2(std::max(min.x + 1.0f, origin.x + (start + duration) * scale), min.y + rowHeight - 1.0f);
+            drawList->AddRectFilled(min, max, color);
+            if(max.x - min.x > ImGui::CalcTextSize(scope.name).x + 4.0f)
+                drawList->AddText(ImVec2(min.x + 2.0f, min.y), IM_COL32(255, 255, 255, 255), scope.name);
+            if(ImGui::IsMouseHoveringRect(min, max))
+            {
+                hoveredScope = &scope;
+                isGPUScopeHovered = gpu;
+            }
+        };
+        for(const ProfiledScope &scope: frame.scopes)
+        {
+            const ImU32 color = scope.depth % 2 == 0 ? IM_COL32(70, 110, 170, 255) : IM_COL32(90, 140, 200, 255);
+            drawBar(scope, scope.cpuStart, scope.cpuEnd - scope.cpuStart, scope.depth, color, false);
+            if(scope.gpuTime >= 0.0f)
+                drawBar(scope, scope.cpuStart, scope.gpuTime, numOfRows - 1, IM_COL32(170, 100, 60, 255), true);
+        }
+        ImGui::Dummy(ImVec2(timelineWidth, numOfRows * rowHeight));
+        if(hoveredScope != nullptr)
+        {
+            if(isGPUScopeHovered)
+                ImGui::SetTooltip("%s (GPU): %.3f ms", hoveredScope->name, hoveredScope->gpuTime);
+            else
+                ImGui::SetTooltip("%s: %.3f ms", hoveredScope->name, hoveredScope->cpuEnd - hoveredScope->cpuStart);
+        }
+
+        // The percentiles of every scope of the frame on the timeline
+        if(ImGui::BeginTable("Scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+        {
+            ImGui::TableSetupColumn("Scope");
+            ImGui::TableSetupColumn("CPU p50");
+            ImGui::TableSetupColumn("CPU p95");
+            ImGui::TableSetupColumn("GPU p50");
+            ImGui::TableSetupColumn("GPU p95");
+            ImGui::TableHeadersRow();
+            for(const ProfiledScope &scope: frame.scopes)
+            {
+                const ProfiledTimeStats cpuScopeStats = profiler.GetScopeTimeStats(scope.name, false);
+                const ProfiledTimeStats gpuScopeStats = profiler.GetScopeTimeStats(scope.name, true);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%*s%s", scope.depth * 2, "", scope.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", cpuScopeStats.p50);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", cpuScopeStats.p95);
+                ImGui::TableNextColumn();
+                if(gpuScopeStats.numOfSamples > 0)
+                    ImGui::Text("%.3f", gpuScopeStats.p50);
+                ImGui::TableNextColumn();
+                if(gpuScopeStats.numOfSamples > 0)
+                    ImGui::Text("%.3f", gpuScopeStats.p95);
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+void UIManager::DrawRenderStatsOverlay()
+{
+    TRACE_ZONE("Render stats overlay");
+    RenderCounters &renderCounters = RenderCounters::getInstance();
+
+    const ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings |
+                                   ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav | ImGuiWindowFlags_NoMove;
+    // Just under the main menu bar
+    ImGui::SetNextWindowPos(ImVec2(ImGui::GetIO().DisplaySize.x - 10.0f, 30.0f), ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+    ImGui::SetNextWindowBgAlpha(0.6f);
+    if(ImGui::Begin("Render stats", &_showRenderStats, flags))
+    {
+        const RenderCounterValues &lastFrame = renderCounters.getLastFrameCounters();
+        const RenderCounterValues average = renderCounters.GetAverageCounters();
+        const RenderCounterValues max = renderCounters.GetMaxCounters();
+        if(ImGui::BeginTable("RenderCounters", 4))
+        {
+            ImGui::TableSetupColumn("");
+            ImGui::TableSetupColumn("Frame");
+            ImGui::TableSetupColumn("Average");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+            for(const RenderCounterField &field: RenderCounters::FIELDS)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", field.label);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", lastFrame.*field.value);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", average.*field.value);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", max.*field.value);
+            }
+            ImGui::EndTable();
+        }
+
+        if(ImGui::Button("Dump JSON"))
+            renderCounters.Dump();
+        if(!renderCounters.getLastDumpPath().empty())
+        {
+            ImGui::SameLine();
+            ImGui::Text("%s", renderCounters.getLastDumpPath().c_str());
+        }
+    }
+    ImGui::End();
+}
 #pragma endregion
 
 #pragma region Widgets
@@ -8,32 +8,101 @@
 #include "rendering/renderer.hpp"
 #include "rendering/shader.hpp"
 #include "rendering/texture.hpp"
+#include "rendering/frame_profiler.hpp"
+
+#include <atomic>
+
+enum class UIInputEventType
+{
+    WINDOW_FOCUS = 0,
+    MOUSE_POS,
+    MOUSE_BUTTON,
+    MOUSE_WHEEL,
+    KEY,
+    CHAR
+};
+// An input event that was already translated for ImGui on the main thread, kept until it can be handed to ImGui on the render thread
+struct UIInputEvent final
+{
+    UIInputEventType type;
+    // The ImGuiKey or mouse button and whether it's down, whether the window is focused or the character
+    int ints[2];
+    // The mouse position or the wheel's offsets
+    float floats[2];
+    // The ImGuiMod_ flags of the modifier keys that were held down
+    int mods;
+};
+// What ImGui needs to know about the window every frame, since only the main thread is allowed to ask GLFW about it
+struct UIWindowState final
+{
+    float width = 0.0f;
+    float height = 0.0f;
+    float framebufferScaleX = 1.0f;
+    float framebufferScaleY = 1.0f;
+};
 
 class UIManager : public Singleton<UIManager>
 {
     private:
     ImGuiWindowFlags _windowFlags = 0;
+    GLFWwindow *_window = nullptr;
+    // The input that arrived on the main thread since the last TakeInput()
+    std::vector<UIInputEvent> _pendingInput;
+    double _lastFrameTime = 0.0;
+    // Picked by ImGui on the render thread and put on the window by the main thread in TakeInput()
+    std::atomic<ImGuiMouseCursor> _requestedCursor{ImGuiMouseCursor_Arrow};
+    ImGuiMouseCursor _currentCursor = ImGuiMouseCursor_Arrow;
+    // nullptr for the cursors GLFW doesn't have, those fall back to the arrow
+    GLFWcursor *_cursors[ImGuiMouseCursor_COUNT] = {};
 
     bool _showRendererProperties = false;
     bool _showShaderProperties = false;
+    bool _showProfiler = false;
+    bool _showRenderStats = false;
+    // Keeps showing the same frame on the profiler's timeline
+    bool _pauseProfilerTimeline = false;
+    ProfiledFrame _profilerTimelineFrame;
+    int _numOfTraceFrames = 60;
     #ifdef _DEBUG
     bool _showImGuiDemoWindow = false;
     #endif
 
+    public:
+    // The profiler scope timed on the GPU around the UI
+    static constexpr const char *UI_PASS_SCOPE = "UI pass";
+
     public:
     void Init(GLFWwindow* const window);
     void DeInit();
     
+    // Moves the input that arrived since the last call to the end of the events and samples the window's state.
+    // Also puts the cursor ImGui asked for during the last frame on the window. Main thread only
+    void TakeInput(std::vector<UIInputEvent> &events, UIWindowState &window);
+    // Hands the input and the window's state over to ImGui, has to be called on the thread that draws the UI before DrawUI()
+    void ReplayInput(const std::vector<UIInputEvent> &events, const UIWindowState &window);
     // Draws all of the UI to the screen
     void DrawUI();
 
 
     private:
+    // Installed instead of ImGui's GLFW backend, which would touch ImGui from the main thread while the render thread is drawing the UI
+    // and ask GLFW about the window from the render thread
+    static void WindowFocusCallback(GLFWwindow *window, int focused);
+    static void CursorEnterCallback(GLFWwindow *window, int entered);
+    static void CursorPosCallback(GLFWwindow *window, double x, double y);
+    static void MouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
+    static void ScrollCallback(GLFWwindow *window, double xOffset, double yOffset);
+    static void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+    static void CharCallback(GLFWwindow *window, unsigned int c);
+
     std::vector<std::string> ShowFileDialog(const std::string &title, const std::vector<std::string> &filters = {"All files", "*"}, bool allowMultiSelect = false);
 
     void DrawMainMenuBar();
     void DrawRendererPropertiesWindow();
     void DrawShaderPropertiesWindow();
+    void DrawProfilerWindow();
+    // Pinned to the top right corner over the scene
+    void DrawRenderStatsOverlay();
 
     void DrawWidgetInt(const char* const label, int* const value);
     void DrawWidgetUnsignedInt(const char* const label, unsigned int* const value);
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "misc/simd_math.hpp"
+
+#include <cmath>
+
+// Axis aligned bounding box
+struct AABB final
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    // Half of the surface area, which is all the BVH needs to compare boxes
+    inline float GetHalfArea() const
+    {
+        const glm::vec3 size = max - min;
+        return size.x * size.y + size.y * size.z + size.z * size.x;
+    }
+    inline glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+};
+
+inline AABB MergeAABBs(const AABB &a, const AABB &b)
+{
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+// The box that encloses the given box after it has been transformed by the matrix
+inline AABB TransformAABB(const AABB &box, const glm::mat4 &matrix)
+{
+    // Transform the center and grow the extents by the absolute values of the rotation/scale part (Arvo's method)
+    const glm::vec3 center = box.GetCenter();
+    const glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+    glm::vec3 newCenter = glm::vec3(matrix[3].x, matrix[3].y, matrix[3].z);
+    glm::vec3 newExtents = glm::vec3(0.0f);
+    for(int column = 0; column < 3; column++)
+    {
+        for(int row = 0; row < 3; row++)
+        {
+            newCenter[row] += matrix[column][row] * center[column];
+            newExtents[row] += std::abs(matrix[column][row]) * extents[column];
+        }
+    }
+
+    return { newCenter - newExtents, newCenter + newExtents };
+}
+
+// The 6 planes of a view frustum as (normal, distance), with the normals pointing inwards
+struct Frustum final
+{
+    glm::vec4 planes[6];
+
+    // Extracts the planes from a view projection matrix (Gribb & Hartmann)
+    static Frustum FromMatrix(const glm::mat4 &viewProjection)
+    {
+        Frustum frustum;
+        for(int i = 0; i < 3; i++)
+        {
+            for(int column = 0; column < 4; column++)
+            {
+                frustum.planes[i * 2 + 0][column] = viewProjection[column].w + viewProjection[column][i];
+                frustum.planes[i * 2 + 1][column] = viewProjection[column].w - viewProjection[column][i];
+            }
+        }
+        return frustum;
+    }
+};
+
+// Whether the box is at least partially inside the frustum, for testing boxes one at a time
+inline bool FrustumTestAABB(const Frustum &frustum, const AABB &box)
+{
+    for(const glm::vec4 &plane: frustum.planes)
+    {
+        const glm::vec3 furthest = glm::vec3(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y, plane.z >= 0.0f ? box.max.z : box.min.z);
+        if(plane.x * furthest.x + plane.y * furthest.y + plane.z * furthest.z + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// 4 boxes stored as structure of arrays, so that they can be tested against a plane all at once
+struct alignas(16) AABB4 final
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+
+    inline void Set(unsigned int lane, const AABB &box)
+    {
+        minX[lane] = box.min.x; minY[lane] = box.min.y; minZ[lane] = box.min.z;
+        maxX[lane] = box.max.x; maxY[lane] = box.max.y; maxZ[lane] = box.max.z;
+    }
+    inline AABB Get(unsigned int lane) const
+    {
+        return { glm::vec3(minX[lane], minY[lane], minZ[lane]), glm::vec3(maxX[lane], maxY[lane], maxZ[lane]) };
+    }
+};
+
+/*
+Tests 4 boxes against the frustum at once. Bit N of the result is set if box N is at least partially inside
+and bit N of insideMask is set if it's fully inside, which means that nothing the box encloses has to be tested anymore.
+For every plane the corner furthest along the normal decides whether the box is outside
+and the nearest one whether it's fully inside. Picking them per axis is the same as taking
+the max/min of the normal times the min and max of the box, so there's no branching
+*/
+inline int FrustumTestAABBs4(const Frustum &frustum, const AABB4 &boxes, int &insideMask)
+{
+#ifdef SIMD_MATH_SSE
+    const __m128 minX = _mm_load_ps(boxes.minX), minY = _mm_load_ps(boxes.minY), minZ = _mm_load_ps(boxes.minZ);
+    const __m128 maxX = _mm_load_ps(boxes.maxX), maxY = _mm_load_ps(boxes.maxY), maxZ = _mm_load_ps(boxes.maxZ);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 outside = _mm_setzero_ps();
+    __m128 intersecting = _mm_setzero_ps();
+    for(const glm::vec4 &plane: frustum.planes)
+    {
+        const __m128 nx = _mm_set1_ps(plane.x), ny = _mm_set1_ps(plane.y), nz = _mm_set1_ps(plane.z);
+        const __m128 d = _mm_set1_ps(plane.w);
+
+        const __m128 xMin = _mm_mul_ps(nx, minX), xMax = _mm_mul_ps(nx, maxX);
+        const __m128 yMin = _mm_mul_ps(ny, minY), yMax = _mm_mul_ps(ny, maxY);
+        const __m128 zMin = _mm_mul_ps(nz, minZ), zMax = _mm_mul_ps(nz, maxZ);
+
+        const __m128 furthest = _mm_add_ps(_mm_add_ps(_mm_max_ps(xMin, xMax), _mm_max_ps(yMin, yMax)), _mm_add_ps(_mm_max_ps(zMin, zMax), d));
+        const __m128 nearest = _mm_add_ps(_mm_add_ps(_mm_min_ps(xMin, xMax), _mm_min_ps(yMin, yMax)), _mm_add_ps(_mm_min_ps(zMin, zMax), d));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(furthest, zero));
+        intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(nearest, zero));
+    }
+
+    const int outsideMask = _mm_movemask_ps(outside);
+    insideMask = ~(outsideMask | _mm_movemask_ps(intersecting)) & 0xF;
+    return ~outsideMask & 0xF;
+#else
+    int visibleMask = 0;
+    insideMask = 0;
+    for(int lane = 0; lane < 4; lane++)
+    {
+        bool outside = false, intersecting = false;
+        for(const glm::vec4 &plane: frustum.planes)
+        {
+            const float xMin = plane.x * boxes.minX[lane], xMax = plane.x * boxes.maxX[lane];
+            const float yMin = plane.y * boxes.minY[lane], yMax = plane.y * boxes.maxY[lane];
+            const float zMin = plane.z * boxes.minZ[lane], zMax = plane.z * boxes.maxZ[lane];
+            outside |= std::fmax(xMin, xMax) + std::fmax(yMin, yMax) + std::fmax(zMin, zMax) + plane.w < 0.0f;
+            intersecting |= std::fmin(xMin, xMax) + std::fmin(yMin, yMax) + std::fmin(zMin, zMax) + plane.w < 0.0f;
+        }
+        if(!outside)
+            visibleMask |= 1 << lane;
+        if(!outside && !intersecting)
+            insideMask |= 1 << lane;
+    }
+    return visibleMask;
+#endif
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SIMD_MATH_SSE
+#endif
+
+// SSE versions of the math that runs over lots of objects every frame.
+// glm stores matrices as 4 contiguous column vec4s and quaternions as x, y, z, w, which is what the kernels rely on.
+// Without SSE they fall back onto plain glm
+
+// out = a * b. out may alias a or b
+inline void MultiplyMat4(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out)
+{
+#ifdef SIMD_MATH_SSE
+    const float *aPtr = &a[0][0];
+    const float *bPtr = &b[0][0];
+    const __m128 aCol0 = _mm_loadu_ps(aPtr + 0);
+    const __m128 aCol1 = _mm_loadu_ps(aPtr + 4);
+    const __m128 aCol2 = _mm_loadu_ps(aPtr + 8);
+    const __m128 aCol3 = _mm_loadu_ps(aPtr + 12);
+
+    // Every column of the result is the columns of a weighted by the matching column of b
+    __m128 result[4];
+    for(int i = 0; i < 4; i++)
+    {
+        const __m128 bCol = _mm_loadu_ps(bPtr + i * 4);
+        __m128 column = _mm_mul_ps(aCol0, _mm_shuffle_ps(bCol, bCol, _MM_SHUFFLE(0, 0, 0, 0)));
+        column = _mm_add_ps(column, _mm_mul_ps(aCol1, _mm_shuffle_ps(bCol, bCol, _MM_SHUFFLE(1, 1, 1, 1))));
+        column = _mm_add_ps(column, _mm_mul_ps(aCol2, _mm_shuffle_ps(bCol, bCol, _MM_SHUFFLE(2, 2, 2, 2))));
+        column = _mm_add_ps(column, _mm_mul_ps(aCol3, _mm_shuffle_ps(bCol, bCol, _MM_SHUFFLE(3, 3, 3, 3))));
+        result[i] = column;
+    }
+
+    float *outPtr = &out[0][0];
+    for(int i = 0; i < 4; i++)
+        _mm_storeu_ps(outPtr + i * 4, result[i]);
+#else
+    out = a * b;
+#endif
+}
+
+// Builds translation * rotation * scale matrices for 4 transforms at once.
+// Takes pointers so that the transforms don't have to be next to each other
+inline void ComposeTransforms4(const glm::vec3 *const positions[4], const glm::quat *const rotations[4], const glm::vec3 *const scales[4], glm::mat4 *const out[4])
+{
+#ifdef SIMD_MATH_SSE
+    // Transpose the 4 quaternions so that each register holds one component of all of them
+    __m128 qx = _mm_loadu_ps(&rotations[0]->x);
+    __m128 qy = _mm_loadu_ps(&rotations[1]->x);
+    __m128 qz = _mm_loadu_ps(&rotations[2]->x);
+    __m128 qw = _mm_loadu_ps(&rotations[3]->x);
+    _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+    const __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+    const __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+    // Same formulas as glm::mat4_cast, rXY being column X, row Y
+    __m128 r00 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+    __m128 r01 = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+    __m128 r02 = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+    __m128 r10 = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+    __m128 r11 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+    __m128 r12 = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+    __m128 r20 = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+    __m128 r21 = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+    __m128 r22 = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+
+    // vec3s are only 12 bytes, so they can't be loaded as a whole without reading past the last one
+    const __m128 sx = _mm_set_ps(scales[3]->x, scales[2]->x, scales[1]->x, scales[0]->x);
+    const __m128 sy = _mm_set_ps(scales[3]->y, scales[2]->y, scales[1]->y, scales[0]->y);
+    const __m128 sz = _mm_set_ps(scales[3]->z, scales[2]->z, scales[1]->z, scales[0]->z);
+    r00 = _mm_mul_ps(r00, sx); r01 = _mm_mul_ps(r01, sx); r02 = _mm_mul_ps(r02, sx);
+    r10 = _mm_mul_ps(r10, sy); r11 = _mm_mul_ps(r11, sy); r12 = _mm_mul_ps(r12, sy);
+    r20 = _mm_mul_ps(r20, sz); r21 = _mm_mul_ps(r21, sz); r22 = _mm_mul_ps(r22, sz);
+
+    __m128 tx = _mm_set_ps(positions[3]->x, positions[2]->x, positions[1]->x, positions[0]->x);
+    __m128 ty = _mm_set_ps(positions[3]->y, positions[2]->y, positions[1]->y, positions[0]->y);
+    __m128 tz = _mm_set_ps(positions[3]->z, positions[2]->z, positions[1]->z, positions[0]->z);
+    __m128 tw = one;
+
+    // Transpose back so that each register holds one column of one of the matrices
+    __m128 zero0 = _mm_setzero_ps(), zero1 = _mm_setzero_ps(), zero2 = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(r00, r01, r02, zero0);
+    _MM_TRANSPOSE4_PS(r10, r11, r12, zero1);
+    _MM_TRANSPOSE4_PS(r20, r21, r22, zero2);
+    _MM_TRANSPOSE4_PS(tx, ty, tz, tw);
+
+    const __m128 columns[4][4] =
+    {
+        { r00, r10, r20, tx },
+        { r01, r11, r21, ty },
+        { r02, r12, r22, tz },
+        { zero0, zero1, zero2, tw }
+    };
+    for(int i = 0; i < 4; i++)
+    {
+        float *outPtr = &(*out[i])[0][0];
+        for(int column = 0; column < 4; column++)
+            _mm_storeu_ps(outPtr + column * 4, columns[i][column]);
+    }
+#else
+    for(int i = 0; i < 4; i++)
+        *out[i] = glm::scale(glm::translate(glm::mat4(1.0f), *positions[i]) * glm::mat4_cast(*rotations[i]), *scales[i]);
+#endif
+}
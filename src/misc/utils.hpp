@@ -3,6 +3,8 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <functional>
+#include <cstdio>
 
 // Code from https://www.fluentcpp.com/2017/04/21/how-to-split-a-string-in-c/
 // Splits the string into parts according to the delim character
@@ -38,4 +40,39 @@ inline int FindIndexOfElement(const std::vector<T> &vector, const T &value)
    
    return index;   
 }
-// NOTE: Having the same func for maps and arrays would be handy 
\ No newline at end of file
+// NOTE: Having the same func for maps and arrays would be handy 
+
+// Code from boost::hash_combine
+// Mixes the hash of the value into the seed so that several values can be hashed together
+template<typename T>
+inline void HashCombine(size_t &seed, const T &value)
+{
+   seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+// Puts the text in quotes, escaped so that it can go into a JSON file as a string
+inline std::string ToJSONString(const std::string &text)
+{
+   std::string result = "\"";
+   for(const char c: text)
+   {
+      switch(c)
+      {
+         case '"':  result += "\\\""; break;
+         case '\\': result += "\\\\"; break;
+         case '\n': result += "\\n"; break;
+         case '\t': result += "\\t"; break;
+         default:
+            if((unsigned char)c < 0x20)
+            {
+               char escaped[8];
+               snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)c);
+               result += escaped;
+            }
+            else
+               result += c;
+         break;
+      }
+   }
+   return result + "\"";
+}
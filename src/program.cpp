@@ -3,17 +3,30 @@
 
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <pfd/portable-file-dialogs.h>
 
+#include <cstdlib>
 #include <string>
 
 #include "core/log.hpp"
+#include "core/trace.hpp"
 #include "core/resource_manager.hpp"
+#include "core/file_watcher.hpp"
 #include "core/ui_manager.hpp"
 #include "core/scene.hpp"
+#include "core/instancing_benchmark.hpp"
+#include "core/render_thread.hpp"
+#include "core/job_system.hpp"
 #include "rendering/renderer.hpp"
+#include "rendering/frame_profiler.hpp"
+#include "rendering/render_counters.hpp"
 #include "rendering/shader.hpp"
+#include "rendering/shader_compiler.hpp"
+#include "rendering/gl_extensions.hpp"
+#include "rendering/gl_capture.hpp"
+#include "rendering/gl_debug_output.hpp"
 #include "rendering/texture.hpp"
 
 static constexpr unsigned int WINDOW_WIDTH = 1270; 
@@ -28,6 +41,19 @@ int main()
     Log::SetLogLevelFilter(LogLevel::Info);
 #endif
 
+    TRACE_THREAD_NAME("Main");
+    // Traces the startup and the first N frames when set
+    if(const char *numOfTraceFrames = std::getenv("MODELVIEWER_TRACE_FRAMES"))
+    {
+        if(Trace::IsCompiledIn())
+            Trace::CaptureFrames((unsigned int)std::strtoul(numOfTraceFrames, nullptr, 10));
+        else
+            Log::LogWarning("MODELVIEWER_TRACE_FRAMES is set but the trace zones weren't compiled in");
+    }
+    // Dumps the render stats to a JSON file after N frames when set
+    if(const char *numOfFramesUntilDump = std::getenv("MODELVIEWER_RENDER_STATS_DUMP"))
+        RenderCounters::getInstance().DumpAfterFrames((unsigned int)std::strtoul(numOfFramesUntilDump, nullptr, 10));
+
     // GLFW init
     if(!glfwInit())
     {
@@ -36,12 +62,26 @@ int main()
     }
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    // 4.3 for multi draw indirect and storage buffers, the renderer falls back to a 4.2 context and the extensions otherwise
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef _DEBUG
+    // Drivers only report everything through the debug output in a debug context
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#elif defined(GL_NO_ERROR_CONTEXT)
+    // KHR_no_error: errors become undefined behaviour instead of being tracked by the driver
+    glfwWindowHint(GLFW_CONTEXT_NO_ERROR, GLFW_TRUE);
+#endif
     // TODO: Implement viewport scaling
     glfwWindowHint(GLFW_RESIZABLE, false);
 
     GLFWwindow* window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE.c_str(), NULL, NULL);
+    if(window == NULL)
+    {
+        Log::LogWarning("Failed to create a GL 4.3 context, trying 4.2");
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+        window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE.c_str(), NULL, NULL);
+    }
     glfwMakeContextCurrent(window);
 
     // glad init
@@ -51,6 +91,23 @@ int main()
         return -1;
     }
 
+    GLExtensions::Load((GLADloadproc)glfwGetProcAddress);
+#ifdef _DEBUG
+    GLDebugOutput::Init(true, true);
+#else
+    GLDebugOutput::Init(false, false);
+#endif
+    // Captures the GL calls of N frames into a trace for ModelViewerReplay when set, starting at the given frame
+    // or when it's started from the profiler window. Has to be armed before anything gets created
+    if(const char *captureFrames = std::getenv("MODELVIEWER_GL_CAPTURE"))
+    {
+        char *startFrame = nullptr;
+        const unsigned int numOfCaptureFrames = (unsigned int)std::strtoul(captureFrames, &startFrame, 10);
+        GLCapture::getInstance().Arm(WINDOW_WIDTH, WINDOW_HEIGHT, numOfCaptureFrames,
+                                     *startFrame == '@' ? (unsigned int)std::strtoul(startFrame + 1, nullptr, 10) : 0);
+    }
+    ShaderCompiler::getInstance().Init(window);
+
     // Check if the system has something to open file dialogs with
     if(!pfd::settings::available())
     {
@@ -58,31 +115,71 @@ int main()
         return -1;
     }
 
+    // Loading already splits its work up into jobs
+    JobSystem::getInstance().Init();
+
     // Resource loading
+    // The watcher has to be running before anything gets loaded so that the loaded files can be watched for changes
+    FileWatcher::getInstance().Init();
     Scene::getInstance().shader = ResourceManager::getInstance().LoadShaderFromFiles("../../../res/shaders/default.vs", "../../../res/shaders/default.fs");
+    // Everything falls back onto the default shader while other shaders are compiling,
+    // so it has to be usable before the first frame
+    ShaderCompiler::getInstance().WaitFor(Scene::getInstance().shader);
     
-    ResourceManager::getInstance().LoadTextureFromFile("../../../res/textures/ui_image_missing.jpg");
-    ResourceManager::getInstance().LoadTextureFromFile("../../../res/textures/tex_missing.jpg");
+    ResourceManager::getInstance().LoadTexturesFromFiles({ "../../../res/textures/ui_image_missing.jpg", "../../../res/textures/tex_missing.jpg" });
     
     // Scene::getInstance().model = ResourceManager::getInstance().LoadModelFromOBJFile("../../../res/models/axe.obj");
 
     // Rendering init
     UIManager::getInstance().Init(window);
     Renderer::getInstance().Init();
+    FrameProfiler::getInstance().Init();
 
-    // MVP calculation
+    // Camera setup
     // NOTE: The projection matrix should react to the changes in resolution
     // and change accordingly
-    glm::mat4 projMatrix = glm::perspective(45.0f, (float)WINDOW_WIDTH/(float)WINDOW_HEIGHT, 0.1f, 100.0f);
+    Scene &scene = Scene::getInstance();
+    scene.camera.projection = glm::perspective(45.0f, (float)WINDOW_WIDTH/(float)WINDOW_HEIGHT, 0.1f, 100.0f);
 
-    glm::vec3 viewPos = glm::vec3(0.0f, -1.25f, -5.0f);
-    glm::mat4 viewMatrix = glm::mat4(1.0f);
-    viewMatrix = glm::translate(viewMatrix, viewPos);
+    scene.camera.position = glm::vec3(0.0f, -1.25f, -5.0f);
+    scene.camera.view = glm::translate(glm::mat4(1.0f), scene.camera.position);
     
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
+    // The model picked through the UI, drawn with the shader picked through the UI
+    const EntityID modelEntity = scene.AddRenderable(nullptr, nullptr);
+    glm::quat modelRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+
+    // Everything from here on that touches GL happens on the render thread, the main thread only handles the window's events
+    // and the updates, and hands over what it came up with through the frame snapshots
+    RenderThread &renderThread = RenderThread::getInstance();
+    renderThread.Start(window, [modelEntity](const FrameSnapshot &frame)
+    {
+        static Scene &scene = Scene::getInstance();
+        FrameProfiler::getInstance().BeginFrame();
+        Renderer::getInstance().BeginFrame();
+
+        // Pick up the shaders that finished compiling since the last frame
+        ShaderCompiler::getInstance().Update();
+        // Reload the shaders and textures whose files were edited
+        ResourceManager::getInstance().HotReload();
+        // Create the GL objects for what the workers finished loading
+        JobSystem::getInstance().ExecuteGLThreadJobs();
 
-    glm::mat4 MVP = glm::mat4(1.0f);
+        scene.transforms.SetRotation(modelEntity, frame.modelRotation);
+        InstancingBenchmark::getInstance().Update();
 
+        // Render the scene and UI
+        {
+            TRACE_ZONE("Draw scene");
+            Renderer::getInstance().DrawScene();
+        }
+        UIManager::getInstance().ReplayInput(frame.uiInput, frame.uiWindow);
+        UIManager::getInstance().DrawUI();
+        Renderer::getInstance().EndFrame();
+        FrameProfiler::getInstance().EndFrame();
+        GLCapture::getInstance().EndFrame();
+        JobSystem::getInstance().EndFrame();
+    });
 
     float deltaTime = 0.0f;
     float lastTime = 0.0f;
@@ -90,9 +187,22 @@ int main()
     constexpr float rotSpeed = -1.0f;
     float rotation = 0.0f; 
     
+    FrameSnapshot snapshot;
     while(!glfwWindowShouldClose(window))
     {
-        glfwPollEvents();
+        // Only sleeps while the render thread is still busy with the last snapshot,
+        // picking it up wakes the main thread so that it can get the next one ready
+        if(renderThread.CanPublish())
+        {
+            TRACE_ZONE("Poll events");
+            glfwPollEvents();
+        }
+        else
+        {
+            TRACE_ZONE("Wait events");
+            glfwWaitEvents();
+            continue;
+        }
 
         // Delta time calculation
         static float currentTime = glfwGetTime();
@@ -101,26 +211,26 @@ int main()
 
         // Spinning of cube
         rotation = sin(rotSpeed * currentTime);
-        modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation), glm::vec3(0.0f, 1.0f, 0.0f));
-        
-        // Updating the MVP uniform of the currently used shader
-        MVP = projMatrix * viewMatrix * modelMatrix;
-        if(Scene::getInstance().shader != nullptr)
-        {
-            Scene::getInstance().shader->SetUniform("u_ModelMatrix", (void*)&modelMatrix);
-            Scene::getInstance().shader->SetUniform("u_MVP", (void*)&MVP);  
-            Scene::getInstance().shader->SetUniform("u_ViewPos", (void*)&viewPos);
-        }
-        
-        // Render the scene and UI
-        Renderer::getInstance().DrawScene();
-        UIManager::getInstance().DrawUI();
-        
-        glfwSwapBuffers(window);
-    }
+        modelRotation = glm::normalize(modelRotation * glm::angleAxis(glm::radians(rotation), glm::vec3(0.0f, 1.0f, 0.0f)));
 
+        snapshot.modelRotation = modelRotation;
+        snapshot.uiInput.clear();
+        UIManager::getInstance().TakeInput(snapshot.uiInput, snapshot.uiWindow);
+        renderThread.Publish(snapshot);
+    }
+    // Lets the last frame finish and brings the context back for the shutdown
+    renderThread.Stop();
+    // Writes out a capture that's still running
+    Trace::Stop();
+
+    // Runs the jobs that are still queued while everything they could touch is still around
+    JobSystem::getInstance().DeInit();
+    FrameProfiler::getInstance().DeInit();
     Renderer::getInstance().DeInit();
     UIManager::getInstance().DeInit();
+    ShaderCompiler::getInstance().DeInit();
+    FileWatcher::getInstance().DeInit();
+    GLCapture::getInstance().DeInit();
     
     glfwDestroyWindow(window);
     glfwTerminate();
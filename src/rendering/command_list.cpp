@@ -0,0 +1,183 @@
+#include "command_list.hpp"
+
+#include "core/job_system.hpp"
+#include "core/log.hpp"
+#include "gl_state.hpp"
+#include "render_counters.hpp"
+
+#include <algorithm>
+
+void CommandList::Clear()
+{
+    _commands.clear();
+    _textures.clear();
+    _buffers.clear();
+    _uniformValues.clear();
+}
+
+void CommandList::BindPipeline(const PipelineState *pipelineState)
+{
+    RenderCommand command;
+    command.type = RenderCommandType::BIND_PIPELINE;
+    command.pipelineState = pipelineState;
+    _commands.push_back(command);
+}
+
+void CommandList::SetBindings(unsigned int vertexArray, const RenderTextureBinding *textures, unsigned int numOfTextures,
+                              const RenderBufferBinding *buffers, unsigned int numOfBuffers)
+{
+    RenderCommand command;
+    command.type = RenderCommandType::SET_BINDINGS;
+    command.bindings = { vertexArray, (unsigned int)_textures.size(), numOfTextures, (unsigned int)_buffers.size(), numOfBuffers };
+    _textures.insert(_textures.end(), textures, textures + numOfTextures);
+    _buffers.insert(_buffers.end(), buffers, buffers + numOfBuffers);
+    _commands.push_back(command);
+}
+
+void CommandList::SetUniforms(Shader &shader, const Shader &program, const RenderUniformValue *values, unsigned int numOfValues)
+{
+    RenderCommand command;
+    command.type = RenderCommandType::SET_UNIFORMS;
+    command.uniforms = { &shader, &program, (unsigned int)_uniformValues.size(), numOfValues };
+    _uniformValues.insert(_uniformValues.end(), values, values + numOfValues);
+    _commands.push_back(command);
+}
+
+void CommandList::Draw(unsigned int numOfVertices)
+{
+    RenderCommand command;
+    command.type = RenderCommandType::DRAW;
+    command.draw = { numOfVertices, 1, 0 };
+    _commands.push_back(command);
+}
+
+void CommandList::DrawInstanced(unsigned int numOfVertices, unsigned int numOfInstances, unsigned int baseInstance)
+{
+    RenderCommand command;
+    command.type = RenderCommandType::DRAW_INSTANCED;
+    command.draw = { numOfVertices, numOfInstances, baseInstance };
+    _commands.push_back(command);
+}
+
+void CommandList::MultiDrawIndirect(size_t commandsOffset, unsigned int numOfCommands, unsigned long long numOfVertices)
+{
+    RenderCommand command;
+    command.type = RenderCommandType::MULTI_DRAW_INDIRECT;
+    command.multiDraw = { commandsOffset, numOfCommands, numOfVertices };
+    _commands.push_back(command);
+}
+
+void CommandList::Execute() const
+{
+    GLState &glState = GLState::getInstance();
+    PipelineStateCache &pipelineStateCache = PipelineStateCache::getInstance();
+    RenderCounters &renderCounters = RenderCounters::getInstance();
+
+    for(const RenderCommand &command: _commands)
+    {
+        switch(command.type)
+        {
+            case RenderCommandType::BIND_PIPELINE:
+                pipelineStateCache.Apply(command.pipelineState);
+            break;
+
+            case RenderCommandType::SET_BINDINGS:
+            {
+                const RenderCommand::Bindings &bindings = command.bindings;
+                glState.BindVertexArray(bindings.vertexArray);
+                for(unsigned int i = bindings.firstTexture; i < bindings.firstTexture + bindings.numOfTextures; i++)
+                    glState.BindTextureToUnit(_textures[i].unit, _textures[i].target, _textures[i].texture);
+                for(unsigned int i = bindings.firstBuffer; i < bindings.firstBuffer + bindings.numOfBuffers; i++)
+                {
+                    const RenderBufferBinding &buffer = _buffers[i];
+                    switch(buffer.type)
+                    {
+                        case RenderBufferBindingType::BUFFER: glState.BindBuffer(buffer.target, buffer.buffer); break;
+                        case RenderBufferBindingType::BASE: glState.BindBufferBase(buffer.target, buffer.index, buffer.buffer); break;
+                        case RenderBufferBindingType::RANGE: glState.BindBufferRange(buffer.target, buffer.index, buffer.buffer, buffer.offset, buffer.size); break;
+                    }
+                }
+            }
+            break;
+
+            case RenderCommandType::SET_UNIFORMS:
+            {
+                const RenderCommand::Uniforms &uniforms = command.uniforms;
+                for(unsigned int i = uniforms.firstValue; i < uniforms.firstValue + uniforms.numOfValues; i++)
+                    uniforms.shader->SetUniform(_uniformValues[i].name, _uniformValues[i].value);
+
+                // The pipeline state has made the program current already, this only uploads the uniforms
+                if(uniforms.program != uniforms.shader)
+                    uniforms.shader->BindSpecialization(*uniforms.program);
+                else
+                    uniforms.shader->Bind();
+            }
+            break;
+
+            case RenderCommandType::DRAW:
+                GL_CALL(glad_glDrawArrays(GL_TRIANGLES, 0, command.draw.numOfVertices));
+                renderCounters.CountDraw(command.draw.numOfVertices);
+            break;
+
+            case RenderCommandType::DRAW_INSTANCED:
+                GL_CALL(glad_glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, command.draw.numOfVertices, command.draw.numOfInstances, command.draw.baseInstance));
+                renderCounters.CountDraw(command.draw.numOfVertices, command.draw.numOfInstances);
+            break;
+
+            case RenderCommandType::MULTI_DRAW_INDIRECT:
+                GL_CALL(glad_glMultiDrawArraysIndirect(GL_TRIANGLES, (const void*)command.multiDraw.commandsOffset, command.multiDraw.numOfCommands, 0));
+                renderCounters.CountDraw(command.multiDraw.numOfVertices);
+            break;
+        }
+    }
+}
+
+void CommandListRecorder::Init()
+{
+    _commandLists.resize(JobSystem::MAX_WORKERS);
+    _numOfRecordedLists = 0;
+}
+
+void CommandListRecorder::DeInit()
+{
+    _commandLists.clear();
+    _numOfRecordedLists = 0;
+}
+
+void CommandListRecorder::Record(unsigned int numOfSlices, const RecordFunction &record)
+{
+    // Without Init() there's still the calling thread to record on
+    if(_commandLists.empty())
+        _commandLists.resize(1);
+
+    numOfSlices = std::max(1u, std::min({ numOfSlices, GetNumOfWorkers(), (unsigned int)_commandLists.size() }));
+    for(unsigned int i = 0; i < numOfSlices; i++)
+        _commandLists[i].Clear();
+    _numOfRecordedLists = numOfSlices;
+
+    // There's at most one slice per worker and each of them becomes a job of its own, the first one runs on the calling thread
+    JobSystem::getInstance().ParallelFor("Record commands", 0, numOfSlices, 1, [&](unsigned int begin, unsigned int end)
+    {
+        for(unsigned int slice = begin; slice < end; slice++)
+            record(_commandLists[slice], slice, numOfSlices);
+    });
+}
+
+void CommandListRecorder::Execute() const
+{
+    for(unsigned int i = 0; i < _numOfRecordedLists; i++)
+        _commandLists[i].Execute();
+}
+
+unsigned int CommandListRecorder::GetNumOfWorkers() const
+{
+    return std::min(JobSystem::getInstance().getNumOfWorkers(), (unsigned int)_commandLists.size());
+}
+
+size_t CommandListRecorder::GetNumOfRecordedCommands() const
+{
+    size_t numOfCommands = 0;
+    for(unsigned int i = 0; i < _numOfRecordedLists; i++)
+        numOfCommands += _commandLists[i].getNumOfCommands();
+    return numOfCommands;
+}
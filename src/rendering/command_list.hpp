@@ -0,0 +1,161 @@
+#pragma once
+
+#include "pipeline_state.hpp"
+#include "shader.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+enum class RenderCommandType
+{
+    BIND_PIPELINE = 0,
+    SET_BINDINGS,
+    SET_UNIFORMS,
+    DRAW,
+    DRAW_INSTANCED,
+    MULTI_DRAW_INDIRECT
+};
+
+struct RenderTextureBinding final
+{
+    unsigned int unit;
+    unsigned int target;
+    unsigned int texture;
+};
+
+enum class RenderBufferBindingType
+{
+    // Bound to the target itself
+    BUFFER = 0,
+    // Bound to the target's index as a whole
+    BASE,
+    // Bound to the target's index from the offset on
+    RANGE
+};
+struct RenderBufferBinding final
+{
+    RenderBufferBindingType type;
+    unsigned int target;
+    unsigned int index;
+    unsigned int buffer;
+    size_t offset;
+    size_t size;
+};
+
+// A uniform the draw points somewhere else before the shader's uniforms get uploaded.
+// The value has to stay alive until the command list has been executed
+struct RenderUniformValue final
+{
+    const char *name;
+    const void *value;
+};
+
+struct RenderCommand final
+{
+    // The textures, buffers and uniform values of a command are kept in the list's arrays, the command only knows where they start
+    struct Bindings final
+    {
+        unsigned int vertexArray;
+        unsigned int firstTexture, numOfTextures;
+        unsigned int firstBuffer, numOfBuffers;
+    };
+    struct Uniforms final
+    {
+        Shader *shader;
+        // The shader itself or a program derived from it
+        const Shader *program;
+        unsigned int firstValue, numOfValues;
+    };
+    struct Draw final
+    {
+        unsigned int numOfVertices;
+        unsigned int numOfInstances;
+        unsigned int baseInstance;
+    };
+    struct MultiDraw final
+    {
+        // Into the bound GL_DRAW_INDIRECT_BUFFER
+        size_t commandsOffset;
+        unsigned int numOfCommands;
+        // Only for the render counters, the GPU reads the actual counts from the commands
+        unsigned long long numOfVertices;
+    };
+
+    RenderCommandType type;
+    union
+    {
+        const PipelineState *pipelineState;
+        Bindings bindings;
+        Uniforms uniforms;
+        Draw draw;
+        MultiDraw multiDraw;
+    };
+};
+
+/*
+A recording of the draws of part of a frame that can be made on any thread, since recording doesn't touch GL at all.
+Everything it refers to has been resolved up front (pipeline states, GL object names, pointers to uniform values),
+so executing it later on the GL thread only has to hand the commands to GLState and the PipelineStateCache.
+Every draw is of triangles.
+*/
+class CommandList final
+{
+    private:
+    std::vector<RenderCommand> _commands;
+    std::vector<RenderTextureBinding> _textures;
+    std::vector<RenderBufferBinding> _buffers;
+    std::vector<RenderUniformValue> _uniformValues;
+
+    public:
+    // Forgets the commands while keeping the memory for the next recording
+    void Clear();
+
+    void BindPipeline(const PipelineState *pipelineState);
+    void SetBindings(unsigned int vertexArray, const RenderTextureBinding *textures, unsigned int numOfTextures,
+                     const RenderBufferBinding *buffers = nullptr, unsigned int numOfBuffers = 0);
+    // Points the uniforms at the values, then uploads the shader's uniforms to the program
+    void SetUniforms(Shader &shader, const Shader &program, const RenderUniformValue *values = nullptr, unsigned int numOfValues = 0);
+    void Draw(unsigned int numOfVertices);
+    void DrawInstanced(unsigned int numOfVertices, unsigned int numOfInstances, unsigned int baseInstance);
+    void MultiDrawIndirect(size_t commandsOffset, unsigned int numOfCommands, unsigned long long numOfVertices);
+
+    // Issues the commands, has to be called on the GL thread
+    void Execute() const;
+
+    inline size_t getNumOfCommands() const { return _commands.size(); }
+};
+
+/*
+Records command lists on the job system's workers, one list per slice of the work, and executes them on the GL thread in slice order.
+*/
+class CommandListRecorder final
+{
+    public:
+    // Records the given slice of the work into the list
+    using RecordFunction = std::function<void(CommandList &commands, unsigned int slice, unsigned int numOfSlices)>;
+
+    private:
+    std::vector<CommandList> _commandLists;
+    unsigned int _numOfRecordedLists = 0;
+
+    public:
+    CommandListRecorder() = default;
+    ~CommandListRecorder() = default;
+    // Copy
+    CommandListRecorder(const CommandListRecorder &other) = delete;
+    CommandListRecorder &operator=(const CommandListRecorder &other) = delete;
+
+    void Init();
+    void DeInit();
+
+    // Records the slices as jobs across the job system's workers, the calling thread included, and waits for all of them to finish.
+    // The number of slices is clamped to the number of workers, a single slice gets recorded on the calling thread alone
+    void Record(unsigned int numOfSlices, const RecordFunction &record);
+    // Executes the lists of the last Record() in slice order, has to be called on the GL thread
+    void Execute() const;
+
+    unsigned int GetNumOfWorkers() const;
+    inline unsigned int getNumOfRecordedLists() const { return _numOfRecordedLists; }
+    size_t GetNumOfRecordedCommands() const;
+};
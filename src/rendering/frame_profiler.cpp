@@ -0,0 +1,229 @@
+#include "frame_profiler.hpp"
+
+#include <glad/glad.h>
+
+#include "core/log.hpp"
+#include "gl_capture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+const ProfiledScope *ProfiledFrame::FindScope(const char *name) const
+{
+    for(const ProfiledScope &scope: scopes)
+    {
+        if(scope.name == name || std::strcmp(scope.name, name) == 0)
+            return &scope;
+    }
+    return nullptr;
+}
+
+void FrameProfiler::Init()
+{
+    GL_CALL(glad_glGenQueries(NUM_OF_PENDING_FRAMES * MAX_GPU_SCOPES, &_queries[0][0]));
+    _history.reserve(HISTORY_SIZE);
+}
+
+void FrameProfiler::DeInit()
+{
+    GL_CALL(glad_glDeleteQueries(NUM_OF_PENDING_FRAMES * MAX_GPU_SCOPES, &_queries[0][0]));
+    for(PendingFrame &pending: _pendingFrames)
+        pending.isWaiting = false;
+    _history.clear();
+    _historyStart = 0;
+}
+
+void FrameProfiler::BeginFrame()
+{
+    // Frames finish on the GPU in order, so it's enough to stop at the first one that hasn't
+    for(unsigned int i = 0; i < NUM_OF_PENDING_FRAMES; i++)
+    {
+        PendingFrame &pending = _pendingFrames[(_frameIndex + i) % NUM_OF_PENDING_FRAMES];
+        if(pending.isWaiting && !TryResolve(pending, false))
+            break;
+    }
+
+    // The queries this frame is about to reuse are still in flight, the frame they're from goes without its GPU times
+    PendingFrame &pending = _pendingFrames[_frameIndex % NUM_OF_PENDING_FRAMES];
+    if(pending.isWaiting)
+    {
+        TryResolve(pending, true);
+        _numOfDroppedGPUFrames++;
+    }
+
+    pending.frame.frameIndex = _frameIndex;
+    pending.frame.scopes.clear();
+    pending.gpuScopes.clear();
+    _openScopes.clear();
+    _activeGPUScope = -1;
+    _frameStartTime = std::chrono::steady_clock::now();
+    _isFrameOpen = true;
+}
+
+void FrameProfiler::EndFrame()
+{
+    if(!_isFrameOpen)
+        return;
+
+    while(!_openScopes.empty())
+    {
+        Log::LogWarning("Profiler scope " + std::string(_pendingFrames[_frameIndex % NUM_OF_PENDING_FRAMES].frame.scopes[_openScopes.back()].name) + " wasn't ended before the frame was");
+        EndScope();
+    }
+
+    PendingFrame &pending = _pendingFrames[_frameIndex % NUM_OF_PENDING_FRAMES];
+    pending.frame.cpuTime = GetCurrentTime();
+    pending.isWaiting = true;
+    _isFrameOpen = false;
+    _frameIndex++;
+}
+
+void FrameProfiler::BeginScope(const char *name, bool gpu)
+{
+    if(!_isFrameOpen)
+        return;
+
+    PendingFrame &pending = _pendingFrames[_frameIndex % NUM_OF_PENDING_FRAMES];
+    const unsigned int scope = (unsigned int)pending.frame.scopes.size();
+    pending.frame.scopes.push_back({ name, (unsigned int)_openScopes.size(), GetCurrentTime(), 0.0f, -1.0f });
+    _openScopes.push_back(scope);
+    GLCapture::getInstance().BeginMarker(name);
+
+    if(gpu && _activeGPUScope == -1 && pending.gpuScopes.size() < MAX_GPU_SCOPES)
+    {
+        GL_CALL(glad_glBeginQuery(GL_TIME_ELAPSED, _queries[_frameIndex % NUM_OF_PENDING_FRAMES][pending.gpuScopes.size()]));
+        pending.gpuScopes.push_back(scope);
+        _activeGPUScope = (int)scope;
+    }
+}
+
+void FrameProfiler::EndScope()
+{
+    if(!_isFrameOpen || _openScopes.empty())
+        return;
+
+    PendingFrame &pending = _pendingFrames[_frameIndex % NUM_OF_PENDING_FRAMES];
+    const unsigned int scope = _openScopes.back();
+    _openScopes.pop_back();
+    pending.frame.scopes[scope].cpuEnd = GetCurrentTime();
+    GLCapture::getInstance().EndMarker();
+
+    if(_activeGPUScope == (int)scope)
+    {
+        GL_CALL(glad_glEndQuery(GL_TIME_ELAPSED));
+        _activeGPUScope = -1;
+    }
+}
+
+const ProfiledFrame &FrameProfiler::GetFrame(unsigned int index) const
+{
+    return _history[(_historyStart + index) % _history.size()];
+}
+
+const ProfiledFrame *FrameProfiler::GetLatestFrame() const
+{
+    return _history.empty() ? nullptr : &GetFrame(getNumOfFrames() - 1);
+}
+
+ProfiledTimeStats FrameProfiler::GetFrameTimeStats(bool gpu) const
+{
+    std::vector<float> samples;
+    samples.reserve(_history.size());
+    for(const ProfiledFrame &frame: _history)
+    {
+        const float time = gpu ? frame.gpuTime : frame.cpuTime;
+        if(time >= 0.0f)
+            samples.push_back(time);
+    }
+    return CalculateStats(samples);
+}
+
+ProfiledTimeStats FrameProfiler::GetScopeTimeStats(const char *name, bool gpu) const
+{
+    std::vector<float> samples;
+    samples.reserve(_history.size());
+    for(const ProfiledFrame &frame: _history)
+    {
+        const ProfiledScope *scope = frame.FindScope(name);
+        if(scope == nullptr)
+            continue;
+        const float time = gpu ? scope->gpuTime : scope->cpuEnd - scope->cpuStart;
+        if(time >= 0.0f)
+            samples.push_back(time);
+    }
+    return CalculateStats(samples);
+}
+
+bool FrameProfiler::TryResolve(PendingFrame &pending, bool force)
+{
+    const unsigned int slot = pending.frame.frameIndex % NUM_OF_PENDING_FRAMES;
+    const size_t numOfGPUScopes = pending.gpuScopes.size();
+
+    // The queries finish in the order they were issued in, so the last one being done means they all are
+    bool isAvailable = numOfGPUScopes == 0;
+    if(!isAvailable)
+    {
+        int lastAvailable = GL_FALSE;
+        GL_CALL(glad_glGetQueryObjectiv(_queries[slot][numOfGPUScopes - 1], GL_QUERY_RESULT_AVAILABLE, &lastAvailable));
+        isAvailable = lastAvailable == GL_TRUE;
+    }
+    if(!isAvailable && !force)
+        return false;
+
+    pending.frame.gpuTime = -1.0f;
+    if(isAvailable)
+    {
+        for(size_t i = 0; i < numOfGPUScopes; i++)
+        {
+            GLuint64 elapsedTime = 0;
+            GL_CALL(glad_glGetQueryObjectui64v(_queries[slot][i], GL_QUERY_RESULT, &elapsedTime));
+            const float time = elapsedTime / 1000000.0f;
+            pending.frame.scopes[pending.gpuScopes[i]].gpuTime = time;
+            pending.frame.gpuTime = std::max(pending.frame.gpuTime, 0.0f) + time;
+        }
+    }
+
+    AddToHistory(pending.frame);
+    pending.isWaiting = false;
+    return true;
+}
+
+void FrameProfiler::AddToHistory(const ProfiledFrame &frame)
+{
+    if(_history.size() < HISTORY_SIZE)
+    {
+        _history.push_back(frame);
+        return;
+    }
+
+    // Overwrites the oldest frame, which keeps the capacity of its scopes around
+    _history[_historyStart] = frame;
+    _historyStart = (_historyStart + 1) % HISTORY_SIZE;
+}
+
+float FrameProfiler::GetCurrentTime() const
+{
+    return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _frameStartTime).count();
+}
+
+ProfiledTimeStats FrameProfiler::CalculateStats(std::vector<float> &samples)
+{
+    ProfiledTimeStats stats;
+    if(samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+    // Nearest rank
+    auto percentile = [&](float p) { return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))]; };
+
+    stats.numOfSamples = (unsigned int)samples.size();
+    for(const float sample: samples)
+        stats.average += sample;
+    stats.average /= samples.size();
+    stats.p50 = percentile(0.50f);
+    stats.p95 = percentile(0.95f);
+    stats.p99 = percentile(0.99f);
+    stats.max = samples.back();
+    return stats;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+
+#include <chrono>
+#include <vector>
+
+// One scope of a profiled frame. Times are in milliseconds, relative to the start of the frame
+struct ProfiledScope final
+{
+    const char *name;
+    // How many scopes it's nested in
+    unsigned int depth;
+    float cpuStart;
+    float cpuEnd;
+    // Negative if the scope wasn't timed on the GPU or its result didn't arrive in time
+    float gpuTime;
+};
+
+struct ProfiledFrame final
+{
+    unsigned int frameIndex = 0;
+    float cpuTime = 0.0f;
+    // Sum of the GPU scopes, negative if the frame didn't have any that arrived
+    float gpuTime = -1.0f;
+    std::vector<ProfiledScope> scopes;
+
+    // The first scope with the name, nullptr if there's none
+    const ProfiledScope *FindScope(const char *name) const;
+};
+
+// Over the frames in the profiler's history, in milliseconds
+struct ProfiledTimeStats final
+{
+    unsigned int numOfSamples = 0;
+    float average = 0.0f;
+    float p50 = 0.0f;
+    float p95 = 0.0f;
+    float p99 = 0.0f;
+    float max = 0.0f;
+};
+
+/*
+Times named scopes of every frame on the CPU and, for the ones that ask for it, on the GPU through GL_TIME_ELAPSED queries.
+The queries of a frame are only read once they're available, which usually takes a frame or two, so the frames end up
+in the history a little late but reading them never stalls. There's a set of queries for each of the last
+NUM_OF_PENDING_FRAMES frames, when the oldest one still hasn't arrived by the time its queries are needed again
+the frame goes into the history without its GPU times.
+GL_TIME_ELAPSED queries can't overlap, so a GPU scope inside of another one is only timed on the CPU.
+Only meant to be used from the thread that owns the GL context.
+*/
+class FrameProfiler final : public Singleton<FrameProfiler>
+{
+    friend class Singleton<FrameProfiler>;
+
+    public:
+    static constexpr unsigned int NUM_OF_PENDING_FRAMES = 3;
+    static constexpr unsigned int MAX_GPU_SCOPES = 8;
+    static constexpr unsigned int HISTORY_SIZE = 300;
+
+    private:
+    struct PendingFrame final
+    {
+        ProfiledFrame frame;
+        // The query of each GPU scope, in the order they were begun
+        std::vector<unsigned int> gpuScopes;
+        bool isWaiting = false;
+    };
+
+    unsigned int _queries[NUM_OF_PENDING_FRAMES][MAX_GPU_SCOPES] = {};
+    PendingFrame _pendingFrames[NUM_OF_PENDING_FRAMES];
+    unsigned int _frameIndex = 0;
+    std::chrono::steady_clock::time_point _frameStartTime;
+    bool _isFrameOpen = false;
+
+    // Indices into the current frame's scopes
+    std::vector<unsigned int> _openScopes;
+    // The scope whose query is running, -1 if none is
+    int _activeGPUScope = -1;
+
+    std::vector<ProfiledFrame> _history;
+    unsigned int _historyStart = 0;
+    unsigned int _numOfDroppedGPUFrames = 0;
+
+    private:
+    FrameProfiler() = default;
+    ~FrameProfiler() = default;
+
+    public:
+    void Init();
+    void DeInit();
+
+    // Picks up the GPU times that have arrived and starts timing a new frame
+    void BeginFrame();
+    void EndFrame();
+
+    // The name has to outlive the profiler's history, string literals are what it's meant for
+    void BeginScope(const char *name, bool gpu = false);
+    void EndScope();
+
+    // The frames whose GPU times have arrived, oldest first
+    inline unsigned int getNumOfFrames() const { return (unsigned int)_history.size(); }
+    const ProfiledFrame &GetFrame(unsigned int index) const;
+    // nullptr before any frame has arrived
+    const ProfiledFrame *GetLatestFrame() const;
+    ProfiledTimeStats GetFrameTimeStats(bool gpu) const;
+    ProfiledTimeStats GetScopeTimeStats(const char *name, bool gpu) const;
+
+    // The frame that's being recorded
+    inline unsigned int getFrameIndex() const { return _frameIndex; }
+    inline unsigned int getNumOfDroppedGPUFrames() const { return _numOfDroppedGPUFrames; }
+
+    private:
+    // Returns false if the frame's queries haven't all finished yet
+    bool TryResolve(PendingFrame &pending, bool force);
+    void AddToHistory(const ProfiledFrame &frame);
+    float GetCurrentTime() const;
+    static ProfiledTimeStats CalculateStats(std::vector<float> &samples);
+};
+
+// Times the rest of the block it's declared in
+class ProfileScope final
+{
+    public:
+    ProfileScope(const char *name, bool gpu = false) { FrameProfiler::getInstance().BeginScope(name, gpu); }
+    ~ProfileScope() { FrameProfiler::getInstance().EndScope(); }
+    ProfileScope(const ProfileScope &other) = delete;
+    ProfileScope &operator=(const ProfileScope &other) = delete;
+};
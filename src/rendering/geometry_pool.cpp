@@ -0,0 +1,145 @@
+#include "geometry_pool.hpp"
+
+#include <glad/glad.h>
+
+#include "core/log.hpp"
+#include "gl_state.hpp"
+#include "render_counters.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+void GeometryPool::Init()
+{
+    GL_CALL(glad_glGenVertexArrays(1, &_VAO));
+}
+
+void GeometryPool::DeInit()
+{
+    GLState &glState = GLState::getInstance();
+    GL_CALL(glad_glDeleteBuffers(1, &_VBO));
+    GL_CALL(glad_glDeleteBuffers(1, &_instanceIndexBuffer));
+    GL_CALL(glad_glDeleteVertexArrays(1, &_VAO));
+    glState.OnBufferDeleted(_VBO);
+    glState.OnBufferDeleted(_instanceIndexBuffer);
+    glState.OnVertexArrayDeleted(_VAO);
+
+    _VAO = _VBO = _instanceIndexBuffer = 0;
+    _numOfVertices = _vertexCapacity = _numOfWastedVertices = _instanceIndexCapacity = 0;
+    _firstVertices.clear();
+}
+
+unsigned int GeometryPool::GetFirstVertex(const Model &model)
+{
+    auto firstVertex = _firstVertices.find(&model);
+    if(firstVertex != _firstVertices.end())
+        return firstVertex->second;
+
+    const std::vector<Vertex> &vertices = model.getVertices();
+    ReserveVertices(_numOfVertices + vertices.size());
+
+    GLState::getInstance().BindBuffer(GL_ARRAY_BUFFER, _VBO);
+    GL_CALL(glad_glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * _numOfVertices, sizeof(Vertex) * vertices.size(), (void*)vertices.data()));
+    RenderCounters::getInstance().CountBufferUpload(sizeof(Vertex) * vertices.size());
+
+    const unsigned int first = (unsigned int)_numOfVertices;
+    _numOfVertices += vertices.size();
+    _firstVertices.emplace(&model, first);
+    return first;
+}
+
+void GeometryPool::Trim()
+{
+    // Most of the pool belongs to models that were deleted, start over and let the models that are still around get added again
+    if(_numOfWastedVertices <= _numOfVertices / 2)
+        return;
+
+    _firstVertices.clear();
+    _numOfVertices = 0;
+    _numOfWastedVertices = 0;
+}
+
+void GeometryPool::OnModelDeleted(const Model *model)
+{
+    auto firstVertex = _firstVertices.find(model);
+    if(firstVertex == _firstVertices.end())
+        return;
+
+    _numOfWastedVertices += model->getVertices().size();
+    _firstVertices.erase(firstVertex);
+}
+
+void GeometryPool::ReserveVertices(size_t numOfVertices)
+{
+    if(numOfVertices <= _vertexCapacity)
+        return;
+
+    // Grow geometrically so that loading models one by one doesn't copy the whole pool every time
+    const size_t newCapacity = std::max({ numOfVertices, _vertexCapacity * 2, (size_t)4096 });
+    GLState &glState = GLState::getInstance();
+
+    unsigned int newVBO;
+    GL_CALL(glad_glGenBuffers(1, &newVBO));
+    glState.BindBuffer(GL_COPY_WRITE_BUFFER, newVBO);
+    GL_CALL(glad_glBufferData(GL_COPY_WRITE_BUFFER, sizeof(Vertex) * newCapacity, nullptr, GL_STATIC_DRAW));
+    if(_numOfVertices != 0)
+    {
+        glState.BindBuffer(GL_COPY_READ_BUFFER, _VBO);
+        GL_CALL(glad_glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(Vertex) * _numOfVertices));
+    }
+
+    GL_CALL(glad_glDeleteBuffers(1, &_VBO));
+    glState.OnBufferDeleted(_VBO);
+    _VBO = newVBO;
+    _vertexCapacity = newCapacity;
+
+    SetUpVertexArray();
+}
+
+void GeometryPool::ReserveInstanceIndices(size_t numOfInstances)
+{
+    if(numOfInstances <= _instanceIndexCapacity)
+        return;
+
+    const size_t newCapacity = std::max({ numOfInstances, _instanceIndexCapacity * 2, (size_t)1024 });
+    std::vector<unsigned int> indices(newCapacity);
+    std::iota(indices.begin(), indices.end(), 0);
+
+    if(_instanceIndexBuffer == 0)
+    {
+        GL_CALL(glad_glGenBuffers(1, &_instanceIndexBuffer));
+    }
+    GLState::getInstance().BindBuffer(GL_ARRAY_BUFFER, _instanceIndexBuffer);
+    GL_CALL(glad_glBufferData(GL_ARRAY_BUFFER, sizeof(unsigned int) * newCapacity, (void*)indices.data(), GL_STATIC_DRAW));
+    RenderCounters::getInstance().CountBufferUpload(sizeof(unsigned int) * newCapacity);
+    _instanceIndexCapacity = newCapacity;
+
+    SetUpVertexArray();
+}
+
+void GeometryPool::SetUpVertexArray()
+{
+    GLState &glState = GLState::getInstance();
+    glState.BindVertexArray(_VAO);
+
+    if(_VBO != 0)
+    {
+        glState.BindBuffer(GL_ARRAY_BUFFER, _VBO);
+        const VertexLayout &layout = Model::GetVertexLayout();
+        for(const VertexAttribute &attribute: layout.attributes)
+        {
+            GL_CALL(glad_glVertexAttribPointer(attribute.location, attribute.numOfComponents, attribute.type, attribute.normalized, layout.stride, (void*)(size_t)attribute.offset));
+            GL_CALL(glad_glEnableVertexAttribArray(attribute.location));
+        }
+    }
+
+    if(_instanceIndexBuffer != 0)
+    {
+        glState.BindBuffer(GL_ARRAY_BUFFER, _instanceIndexBuffer);
+        // The I variant keeps the index an integer rather than converting it to a float
+        GL_CALL(glad_glVertexAttribIPointer(INSTANCE_INDEX_LOCATION, 1, GL_UNSIGNED_INT, 0, (void*)0));
+        GL_CALL(glad_glEnableVertexAttribArray(INSTANCE_INDEX_LOCATION));
+        GL_CALL(glad_glVertexAttribDivisor(INSTANCE_INDEX_LOCATION, 1));
+    }
+}
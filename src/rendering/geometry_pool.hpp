@@ -0,0 +1,59 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+#include "model.hpp"
+
+#include <unordered_map>
+
+/*
+A copy of the vertices of every model drawn through multi draw indirect, all in one vertex buffer behind one VAO,
+so that the draws of different models can go into the same glMultiDrawArraysIndirect call.
+Models are added the first time they're asked for. The space of deleted models isn't reused,
+the pool just starts over (see Trim()) once most of it is taken up by models that are gone.
+The VAO also feeds the index of every instance (the draw command's base instance plus the instance's index within the draw)
+to the shaders through a per-instance attribute, which they use to look up the instance's data.
+*/
+class GeometryPool final : public Singleton<GeometryPool>
+{
+    friend class Singleton<GeometryPool>;
+
+    public:
+    static constexpr unsigned int INSTANCE_INDEX_LOCATION = 7;
+
+    private:
+    unsigned int _VAO = 0;
+    unsigned int _VBO = 0;
+    size_t _numOfVertices = 0;
+    size_t _vertexCapacity = 0;
+    size_t _numOfWastedVertices = 0;
+    // Model -> index of its first vertex in the pool
+    std::unordered_map<const Model*, unsigned int> _firstVertices;
+
+    // Holds 0, 1, 2... with a divisor of 1, so each instance reads its own index
+    unsigned int _instanceIndexBuffer = 0;
+    size_t _instanceIndexCapacity = 0;
+
+    private:
+    GeometryPool() = default;
+    ~GeometryPool() = default;
+
+    public:
+    void Init();
+    void DeInit();
+
+    // Returns where the model's vertices start in the pool, copying them in first if they aren't there yet
+    unsigned int GetFirstVertex(const Model &model);
+    // Makes sure there are instance indices for at least this many instances
+    void ReserveInstanceIndices(size_t numOfInstances);
+    // Starts over if most of the pool is taken up by deleted models.
+    // Invalidates every first vertex handed out so far, so it can't be called while draws are being put together
+    void Trim();
+    void OnModelDeleted(const Model *model);
+
+    inline unsigned int getVAO() const { return _VAO; }
+    inline size_t getNumOfVertices() const { return _numOfVertices; }
+
+    private:
+    void ReserveVertices(size_t numOfVertices);
+    void SetUpVertexArray();
+};
@@ -0,0 +1,842 @@
+#include "gl_capture.hpp"
+
+#include "core/log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <type_traits>
+
+namespace
+{
+    template<typename T> uint64_t Encode(T value) { return GLTrace::EncodeValue(value); }
+
+    // The function a hooked pointer pointed to before it got hooked
+    template<auto *pointer> struct GLCaptureOriginal
+    {
+        inline static std::remove_pointer_t<decltype(pointer)> function = nullptr;
+    };
+
+    template<auto *pointer> void InstallHook(std::remove_pointer_t<decltype(pointer)> hook)
+    {
+        // Functions the context doesn't have are left alone so that the checks for them keep working
+        if(*pointer == nullptr || GLCaptureOriginal<pointer>::function != nullptr)
+            return;
+        GLCaptureOriginal<pointer>::function = *pointer;
+        *pointer = hook;
+    }
+
+    template<auto *pointer> void UninstallHook()
+    {
+        if(GLCaptureOriginal<pointer>::function == nullptr)
+            return;
+        *pointer = GLCaptureOriginal<pointer>::function;
+        GLCaptureOriginal<pointer>::function = nullptr;
+    }
+
+    // Records every argument that isn't an OUTPUT as it is
+    template<GLTraceOp op, auto *pointer, typename Function = std::remove_pointer_t<decltype(pointer)>> struct GLGenericHook;
+    template<GLTraceOp op, auto *pointer, typename Ret, typename... Args> struct GLGenericHook<op, pointer, Ret(APIENTRYP)(Args...)>
+    {
+        static Ret APIENTRY Hook(Args... args)
+        {
+            GLCapture &capture = GLCapture::getInstance();
+            if(capture.isRecording())
+            {
+                const GLTraceOpInfo &info = GLTrace::GetOpInfo(op);
+                const uint64_t argValues[sizeof...(Args) + 1] = { Encode(args)..., 0 };
+                uint64_t values[GLTraceOpInfo::MAX_ARGS];
+                size_t numOfValues = 0;
+                for(size_t i = 0; i < sizeof...(Args); i++)
+                {
+                    if(info.args[i] != GLTraceArg::OUTPUT)
+                        values[numOfValues++] = argValues[i];
+                }
+                capture.Record(op, values, numOfValues);
+            }
+            return GLCaptureOriginal<pointer>::function(args...);
+        }
+    };
+
+    template<GLTraceOp op, auto *pointer> void APIENTRY GenHook(GLsizei n, GLuint *names)
+    {
+        GLCaptureOriginal<pointer>::function(n, names);
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording() && n > 0)
+        {
+            std::vector<uint64_t> values(n + 1);
+            values[0] = n;
+            for(GLsizei i = 0; i < n; i++)
+                values[i + 1] = names[i];
+            capture.Record(op, values.data(), values.size());
+        }
+    }
+
+    template<GLTraceOp op, auto *pointer> void APIENTRY DeleteHook(GLsizei n, const GLuint *names)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording() && n > 0)
+        {
+            std::vector<uint64_t> values(n + 1);
+            values[0] = n;
+            for(GLsizei i = 0; i < n; i++)
+                values[i + 1] = names[i];
+            capture.Record(op, values.data(), values.size());
+        }
+        GLCaptureOriginal<pointer>::function(n, names);
+    }
+
+    GLuint APIENTRY CreateShaderHook(GLenum type)
+    {
+        const GLuint shader = GLCaptureOriginal<&glad_glCreateShader>::function(type);
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(type), Encode(shader) };
+            capture.Record(GLTraceOp::CreateShader, values, 2);
+        }
+        return shader;
+    }
+
+    GLuint APIENTRY CreateProgramHook()
+    {
+        const GLuint program = GLCaptureOriginal<&glad_glCreateProgram>::function();
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(program) };
+            capture.Record(GLTraceOp::CreateProgram, values, 1);
+        }
+        return program;
+    }
+
+    void APIENTRY ShaderSourceHook(GLuint shader, GLsizei count, const GLchar *const *strings, const GLint *lengths)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording() && count >= 0)
+        {
+            const uint64_t values[] = { Encode(shader), Encode(count) };
+            std::vector<GLTracePayload> sources(count);
+            for(GLsizei i = 0; i < count; i++)
+            {
+                const bool isTerminated = lengths == nullptr || lengths[i] < 0;
+                sources[i] = { strings[i], isTerminated ? std::strlen(strings[i]) : (size_t)lengths[i] };
+            }
+            capture.Record(GLTraceOp::ShaderSource, values, 2, sources.data(), sources.size());
+        }
+        GLCaptureOriginal<&glad_glShaderSource>::function(shader, count, strings, lengths);
+    }
+
+    GLint APIENTRY GetUniformLocationHook(GLuint program, const GLchar *name)
+    {
+        const GLint location = GLCaptureOriginal<&glad_glGetUniformLocation>::function(program, name);
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(program), Encode(location) };
+            const GLTracePayload payload = { name, std::strlen(name) + 1 };
+            capture.Record(GLTraceOp::GetUniformLocation, values, 2, &payload, 1);
+        }
+        return location;
+    }
+
+    template<GLTraceOp op, auto *pointer> void APIENTRY BufferDataHook(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(target), Encode(capture.GetBoundBuffer(target)), Encode(size), Encode(usage) };
+            // Before the frames start the contents get read back when they do start, so that the data that gets replaced doesn't pile up
+            const GLTracePayload payload = { data, data != nullptr && capture.isCapturingFrames() ? (size_t)size : 0 };
+            capture.Record(op, values, 4, &payload, 1);
+        }
+        GLCaptureOriginal<pointer>::function(target, size, data, usage);
+    }
+
+    void APIENTRY BufferSubDataHook(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isCapturingFrames())
+        {
+            const uint64_t values[] = { Encode(target), Encode(offset) };
+            const GLTracePayload payload = { data, (size_t)size };
+            capture.Record(GLTraceOp::BufferSubData, values, 2, &payload, 1);
+        }
+        GLCaptureOriginal<&glad_glBufferSubData>::function(target, offset, size, data);
+    }
+
+    void APIENTRY ClearBufferDataHook(GLenum target, GLenum internalFormat, GLenum format, GLenum type, const void *data)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isCapturingFrames())
+        {
+            const uint64_t values[] = { Encode(target), Encode(internalFormat), Encode(format), Encode(type) };
+            const GLTracePayload payload = { data, data != nullptr ? GLTrace::GetPixelSize(format, type) : 0 };
+            capture.Record(GLTraceOp::ClearBufferData, values, 4, &payload, 1);
+        }
+        GLCaptureOriginal<&glad_glClearBufferData>::function(target, internalFormat, format, type, data);
+    }
+
+    void APIENTRY TexImage2DHook(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border,
+                                 GLenum format, GLenum type, const void *pixels)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            // With a pixel unpack buffer bound the pointer is an offset into it
+            const bool isFromBuffer = capture.GetBoundBuffer(GL_PIXEL_UNPACK_BUFFER) != 0;
+            const uint64_t values[] = { Encode(target), Encode(level), Encode(internalFormat), Encode(width), Encode(height), Encode(border),
+                                        Encode(format), Encode(type), Encode(isFromBuffer), isFromBuffer ? Encode(pixels) : 0 };
+            GLTracePayload payload;
+            if(!isFromBuffer && pixels != nullptr)
+                payload = { pixels, GLTrace::GetImageSize(width, height, format, type, capture.getUnpackAlignment()) };
+            capture.Record(GLTraceOp::TexImage2D, values, 10, &payload, 1);
+        }
+        GLCaptureOriginal<&glad_glTexImage2D>::function(target, level, internalFormat, width, height, border, format, type, pixels);
+    }
+
+    template<GLTraceOp op, auto *pointer, size_t numOfComponents> void APIENTRY UniformVectorHook(GLint location, GLsizei count, const GLfloat *value)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(location), Encode(count) };
+            const GLTracePayload payload = { value, sizeof(GLfloat) * numOfComponents * std::max(count, 0) };
+            capture.Record(op, values, 2, &payload, 1);
+        }
+        GLCaptureOriginal<pointer>::function(location, count, value);
+    }
+
+    template<GLTraceOp op, auto *pointer, size_t numOfComponents> void APIENTRY UniformMatrixHook(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(location), Encode(count), Encode(transpose) };
+            const GLTracePayload payload = { value, sizeof(GLfloat) * numOfComponents * std::max(count, 0) };
+            capture.Record(op, values, 3, &payload, 1);
+        }
+        GLCaptureOriginal<pointer>::function(location, count, transpose, value);
+    }
+
+    void *APIENTRY MapBufferRangeHook(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(target), Encode(capture.GetBoundBuffer(target)), Encode(offset), Encode(length), Encode(access) };
+            capture.Record(GLTraceOp::MapBufferRange, values, 5);
+        }
+        return GLCaptureOriginal<&glad_glMapBufferRange>::function(target, offset, length, access);
+    }
+
+    GLboolean APIENTRY UnmapBufferHook(GLenum target)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isRecording())
+        {
+            const uint64_t values[] = { Encode(target), Encode(capture.GetBoundBuffer(target)) };
+            capture.Record(GLTraceOp::UnmapBuffer, values, 2);
+        }
+        return GLCaptureOriginal<&glad_glUnmapBuffer>::function(target);
+    }
+
+    GLsync APIENTRY FenceSyncHook(GLenum condition, GLbitfield flags)
+    {
+        const GLsync sync = GLCaptureOriginal<&glad_glFenceSync>::function(condition, flags);
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isCapturingFrames())
+        {
+            const uint64_t values[] = { Encode(condition), Encode(flags), capture.GetSyncID(sync, true) };
+            capture.Record(GLTraceOp::FenceSync, values, 3);
+        }
+        return sync;
+    }
+
+    GLenum APIENTRY ClientWaitSyncHook(GLsync sync, GLbitfield flags, GLuint64 timeout)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isCapturingFrames())
+        {
+            const uint64_t values[] = { capture.GetSyncID(sync, false), Encode(flags), Encode(timeout) };
+            capture.Record(GLTraceOp::ClientWaitSync, values, 3);
+        }
+        return GLCaptureOriginal<&glad_glClientWaitSync>::function(sync, flags, timeout);
+    }
+
+    void APIENTRY DeleteSyncHook(GLsync sync)
+    {
+        GLCapture &capture = GLCapture::getInstance();
+        if(capture.isCapturingFrames())
+        {
+            const uint64_t values[] = { capture.GetSyncID(sync, false) };
+            capture.Record(GLTraceOp::DeleteSync, values, 1);
+        }
+        capture.ForgetSync(sync);
+        GLCaptureOriginal<&glad_glDeleteSync>::function(sync);
+    }
+
+    // Priority (the order the state gets written out in), op and up to two more things that tell entries apart, eg. the target
+    uint64_t GetStateKey(unsigned int priority, GLTraceOp op, uint64_t a = 0, uint64_t b = 0)
+    {
+        return ((uint64_t)priority << 56) | ((uint64_t)op << 40) | ((a & 0xFFFFF) << 20) | (b & 0xFFFFF);
+    }
+}
+
+void GLCapture::Arm(unsigned int width, unsigned int height, unsigned int numOfFrames, unsigned int startFrame)
+{
+    if(getState() != GLCaptureState::DISARMED || numOfFrames == 0)
+        return;
+
+    char timestamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    _path = "gl_capture_" + std::string(timestamp) + ".mvtrace";
+    for(unsigned int i = 2; std::ifstream(_path).good(); i++)
+        _path = "gl_capture_" + std::string(timestamp) + "_" + std::to_string(i) + ".mvtrace";
+    _file = std::fopen(_path.c_str(), "wb");
+    if(_file == nullptr)
+    {
+        Log::LogError("Couldn't open " + _path + " for the GL capture");
+        return;
+    }
+
+    GLTraceHeader header;
+    header.width = width;
+    header.height = height;
+    const GLubyte *renderer = glad_glGetString(GL_RENDERER);
+    const GLubyte *version = glad_glGetString(GL_VERSION);
+    header.renderer = renderer != nullptr ? (const char*)renderer : "";
+    header.version = version != nullptr ? (const char*)version : "";
+    GLTrace::WriteHeader(_writeBuffer, header);
+
+    _numOfFrames = numOfFrames;
+    _startFrame = startFrame;
+    _frameIndex = 0;
+    // GL starts out with the first texture unit active, the rest of the state entries get made as the state gets set
+    const uint64_t activeTexture = Encode((GLenum)GL_TEXTURE0);
+    UpdateStateEntry(GLTraceOp::ActiveTexture, &activeTexture, 1);
+    _stateEntries.begin()->second.dirty = false;
+
+    InstallHooks();
+    _state = GLCaptureState::ARMED;
+    if(_startFrame > 0)
+        Log::LogInfo("Capturing the GL calls of " + std::to_string(_numOfFrames) + " frames from frame " + std::to_string(_startFrame) + " into " + _path);
+    else
+        Log::LogInfo("Recording GL calls for a capture of " + std::to_string(_numOfFrames) + " frames, start it from the profiler window");
+}
+
+void GLCapture::DeInit()
+{
+    const GLCaptureState state = getState();
+    if(state == GLCaptureState::DISARMED)
+        return;
+
+    if(state == GLCaptureState::CAPTURING)
+    {
+        Log::LogWarning("Stopped the GL capture " + std::to_string(_numOfFramesLeft) + " frames early");
+        Finish();
+    }
+    else if(state == GLCaptureState::ARMED)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::fclose(_file);
+        _file = nullptr;
+        std::remove(_path.c_str());
+    }
+    _state = GLCaptureState::DISARMED;
+    UninstallHooks();
+}
+
+void GLCapture::Start()
+{
+    if(getState() == GLCaptureState::ARMED)
+        _isStartRequested = true;
+}
+
+void GLCapture::EndFrame()
+{
+    const GLCaptureState state = getState();
+    if(state == GLCaptureState::ARMED)
+    {
+        _frameIndex++;
+        if(_isStartRequested || (_startFrame > 0 && _frameIndex >= _startFrame))
+            BeginFrames();
+    }
+    else if(state == GLCaptureState::CAPTURING)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            Write(GLTraceOp::FrameEnd, nullptr, 0);
+        }
+        if(--_numOfFramesLeft == 0)
+            Finish();
+    }
+}
+
+void GLCapture::BeginMarker(const char *name)
+{
+    if(!isCapturingFrames())
+        return;
+    const GLTracePayload payload = { name, std::strlen(name) };
+    Record(GLTraceOp::BeginMarker, nullptr, 0, &payload, 1);
+}
+
+void GLCapture::EndMarker()
+{
+    if(isCapturingFrames())
+        Record(GLTraceOp::EndMarker, nullptr, 0);
+}
+
+void GLCapture::RecordBufferContents(unsigned int buffer, size_t offset, size_t size, const void *data)
+{
+    if(!isCapturingFrames() || size == 0)
+        return;
+    const uint64_t values[] = { Encode(buffer), Encode(offset) };
+    const GLTracePayload payload = { data, size };
+    Record(GLTraceOp::BufferContents, values, 2, &payload, 1);
+}
+
+void GLCapture::Record(GLTraceOp op, const uint64_t *values, size_t numOfValues, const GLTracePayload *payloads, size_t numOfPayloads)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const GLCaptureState state = getState();
+    if(state != GLCaptureState::ARMED && state != GLCaptureState::CAPTURING)
+        return;
+
+    Track(op, values, numOfValues);
+    if(state == GLCaptureState::CAPTURING)
+    {
+        Write(op, values, numOfValues, payloads, numOfPayloads);
+        return;
+    }
+
+    switch(GLTrace::GetOpInfo(op).category)
+    {
+        case GLTraceCategory::FRAME:
+        case GLTraceCategory::MARKER:
+            return;
+        case GLTraceCategory::STATE:
+            if(UpdateStateEntry(op, values, numOfValues))
+                return;
+            break;
+        case GLTraceCategory::UNIFORM:
+        {
+            std::vector<unsigned char> &uniform = _uniforms[{ _program, GLTrace::DecodeValue<GLint>(values[0]) }];
+            uniform.clear();
+            GLTrace::WriteCall(uniform, op, values, numOfValues, payloads, numOfPayloads);
+            return;
+        }
+        case GLTraceCategory::RESOURCE:
+            break;
+    }
+
+    // Whatever the call works on has to be bound in the replay as well
+    WriteState(false);
+    Write(op, values, numOfValues, payloads, numOfPayloads);
+}
+
+unsigned int GLCapture::GetBoundBuffer(GLenum target)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(target == GL_ELEMENT_ARRAY_BUFFER)
+    {
+        const auto element = _elementBuffers.find(_vertexArray);
+        return element != _elementBuffers.end() ? element->second : 0;
+    }
+    const auto binding = _bufferBindings.find(target);
+    return binding != _bufferBindings.end() ? binding->second : 0;
+}
+
+uint64_t GLCapture::GetSyncID(GLsync sync, bool create)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto id = _syncs.find(sync);
+    if(id != _syncs.end())
+        return id->second;
+    if(!create)
+        return 0;
+    _syncs[sync] = _nextSync;
+    return _nextSync++;
+}
+
+void GLCapture::ForgetSync(GLsync sync)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _syncs.erase(sync);
+}
+
+int GLCapture::getUnpackAlignment()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _unpackAlignment;
+}
+
+void GLCapture::InstallHooks()
+{
+#define GL_CAPTURE_INSTALL_GENERIC(name, function, ...) InstallHook<&function>(&GLGenericHook<GLTraceOp::name, &function>::Hook);
+    GL_TRACE_GENERIC_CALLS(GL_CAPTURE_INSTALL_GENERIC)
+#undef GL_CAPTURE_INSTALL_GENERIC
+
+    InstallHook<&glad_glGenBuffers>(&GenHook<GLTraceOp::GenBuffers, &glad_glGenBuffers>);
+    InstallHook<&glad_glGenTextures>(&GenHook<GLTraceOp::GenTextures, &glad_glGenTextures>);
+    InstallHook<&glad_glGenVertexArrays>(&GenHook<GLTraceOp::GenVertexArrays, &glad_glGenVertexArrays>);
+    InstallHook<&glad_glGenFramebuffers>(&GenHook<GLTraceOp::GenFramebuffers, &glad_glGenFramebuffers>);
+    InstallHook<&glad_glGenRenderbuffers>(&GenHook<GLTraceOp::GenRenderbuffers, &glad_glGenRenderbuffers>);
+    InstallHook<&glad_glGenQueries>(&GenHook<GLTraceOp::GenQueries, &glad_glGenQueries>);
+    InstallHook<&glad_glDeleteBuffers>(&DeleteHook<GLTraceOp::DeleteBuffers, &glad_glDeleteBuffers>);
+    InstallHook<&glad_glDeleteTextures>(&DeleteHook<GLTraceOp::DeleteTextures, &glad_glDeleteTextures>);
+    InstallHook<&glad_glDeleteVertexArrays>(&DeleteHook<GLTraceOp::DeleteVertexArrays, &glad_glDeleteVertexArrays>);
+    InstallHook<&glad_glDeleteFramebuffers>(&DeleteHook<GLTraceOp::DeleteFramebuffers, &glad_glDeleteFramebuffers>);
+    InstallHook<&glad_glDeleteRenderbuffers>(&DeleteHook<GLTraceOp::DeleteRenderbuffers, &glad_glDeleteRenderbuffers>);
+    InstallHook<&glad_glDeleteQueries>(&DeleteHook<GLTraceOp::DeleteQueries, &glad_glDeleteQueries>);
+    InstallHook<&glad_glCreateShader>(&CreateShaderHook);
+    InstallHook<&glad_glCreateProgram>(&CreateProgramHook);
+    InstallHook<&glad_glShaderSource>(&ShaderSourceHook);
+    InstallHook<&glad_glGetUniformLocation>(&GetUniformLocationHook);
+    InstallHook<&glad_glBufferData>(&BufferDataHook<GLTraceOp::BufferData, &glad_glBufferData>);
+    InstallHook<&GLExtensions::glBufferStorage>(&BufferDataHook<GLTraceOp::BufferStorage, &GLExtensions::glBufferStorage>);
+    InstallHook<&glad_glBufferSubData>(&BufferSubDataHook);
+    InstallHook<&glad_glClearBufferData>(&ClearBufferDataHook);
+    InstallHook<&glad_glTexImage2D>(&TexImage2DHook);
+    InstallHook<&glad_glUniform2fv>(&UniformVectorHook<GLTraceOp::Uniform2fv, &glad_glUniform2fv, 2>);
+    InstallHook<&glad_glUniform3fv>(&UniformVectorHook<GLTraceOp::Uniform3fv, &glad_glUniform3fv, 3>);
+    InstallHook<&glad_glUniform4fv>(&UniformVectorHook<GLTraceOp::Uniform4fv, &glad_glUniform4fv, 4>);
+    InstallHook<&glad_glUniformMatrix2fv>(&UniformMatrixHook<GLTraceOp::UniformMatrix2fv, &glad_glUniformMatrix2fv, 4>);
+    InstallHook<&glad_glUniformMatrix3fv>(&UniformMatrixHook<GLTraceOp::UniformMatrix3fv, &glad_glUniformMatrix3fv, 9>);
+    InstallHook<&glad_glUniformMatrix4fv>(&UniformMatrixHook<GLTraceOp::UniformMatrix4fv, &glad_glUniformMatrix4fv, 16>);
+    InstallHook<&glad_glMapBufferRange>(&MapBufferRangeHook);
+    InstallHook<&glad_glUnmapBuffer>(&UnmapBufferHook);
+    InstallHook<&glad_glFenceSync>(&FenceSyncHook);
+    InstallHook<&glad_glClientWaitSync>(&ClientWaitSyncHook);
+    InstallHook<&glad_glDeleteSync>(&DeleteSyncHook);
+}
+
+void GLCapture::UninstallHooks()
+{
+#define GL_CAPTURE_UNINSTALL_GENERIC(name, function, ...) UninstallHook<&function>();
+    GL_TRACE_GENERIC_CALLS(GL_CAPTURE_UNINSTALL_GENERIC)
+#undef GL_CAPTURE_UNINSTALL_GENERIC
+
+    UninstallHook<&glad_glGenBuffers>();
+    UninstallHook<&glad_glGenTextures>();
+    UninstallHook<&glad_glGenVertexArrays>();
+    UninstallHook<&glad_glGenFramebuffers>();
+    UninstallHook<&glad_glGenRenderbuffers>();
+    UninstallHook<&glad_glGenQueries>();
+    UninstallHook<&glad_glDeleteBuffers>();
+    UninstallHook<&glad_glDeleteTextures>();
+    UninstallHook<&glad_glDeleteVertexArrays>();
+    UninstallHook<&glad_glDeleteFramebuffers>();
+    UninstallHook<&glad_glDeleteRenderbuffers>();
+    UninstallHook<&glad_glDeleteQueries>();
+    UninstallHook<&glad_glCreateShader>();
+    UninstallHook<&glad_glCreateProgram>();
+    UninstallHook<&glad_glShaderSource>();
+    UninstallHook<&glad_glGetUniformLocation>();
+    UninstallHook<&glad_glBufferData>();
+    UninstallHook<&GLExtensions::glBufferStorage>();
+    UninstallHook<&glad_glBufferSubData>();
+    UninstallHook<&glad_glClearBufferData>();
+    UninstallHook<&glad_glTexImage2D>();
+    UninstallHook<&glad_glUniform2fv>();
+    UninstallHook<&glad_glUniform3fv>();
+    UninstallHook<&glad_glUniform4fv>();
+    UninstallHook<&glad_glUniformMatrix2fv>();
+    UninstallHook<&glad_glUniformMatrix3fv>();
+    UninstallHook<&glad_glUniformMatrix4fv>();
+    UninstallHook<&glad_glMapBufferRange>();
+    UninstallHook<&glad_glUnmapBuffer>();
+    UninstallHook<&glad_glFenceSync>();
+    UninstallHook<&glad_glClientWaitSync>();
+    UninstallHook<&glad_glDeleteSync>();
+}
+
+void GLCapture::Track(GLTraceOp op, const uint64_t *values, size_t numOfValues)
+{
+    switch(op)
+    {
+        case GLTraceOp::UseProgram:
+            _program = (unsigned int)values[0];
+            break;
+        case GLTraceOp::BindVertexArray:
+            _vertexArray = (unsigned int)values[0];
+            break;
+        case GLTraceOp::ActiveTexture:
+            _activeTextureUnit = (unsigned int)values[0] - GL_TEXTURE0;
+            break;
+        case GLTraceOp::BindBuffer:
+            if(values[0] == GL_ELEMENT_ARRAY_BUFFER)
+                _elementBuffers[_vertexArray] = (unsigned int)values[1];
+            else
+                _bufferBindings[(GLenum)values[0]] = (unsigned int)values[1];
+            break;
+        case GLTraceOp::BindBufferBase:
+        case GLTraceOp::BindBufferRange:
+            _bufferBindings[(GLenum)values[0]] = (unsigned int)values[2];
+            break;
+        case GLTraceOp::PixelStorei:
+            if(values[0] == GL_UNPACK_ALIGNMENT)
+                _unpackAlignment = GLTrace::DecodeValue<GLint>(values[1]);
+            break;
+        case GLTraceOp::BufferData:
+        case GLTraceOp::BufferStorage:
+            _bufferSizes[(unsigned int)values[1]] = (size_t)GLTrace::DecodeValue<GLsizeiptr>(values[2]);
+            break;
+        case GLTraceOp::MapBufferRange:
+            _mappedBuffers[(unsigned int)values[1]] = (values[4] & GL_MAP_PERSISTENT_BIT) != 0;
+            break;
+        case GLTraceOp::UnmapBuffer:
+            _mappedBuffers.erase((unsigned int)values[1]);
+            break;
+        case GLTraceOp::DeleteBuffers:
+            for(size_t i = 1; i < numOfValues; i++)
+            {
+                const unsigned int buffer = (unsigned int)values[i];
+                _bufferSizes.erase(buffer);
+                _mappedBuffers.erase(buffer);
+                for(auto &binding: _bufferBindings)
+                {
+                    if(binding.second == buffer)
+                        binding.second = 0;
+                }
+                for(auto &element: _elementBuffers)
+                {
+                    if(element.second == buffer)
+                        element.second = 0;
+                }
+                OnObjectDeleted(GLTraceArg::BUFFER, buffer);
+            }
+            break;
+        case GLTraceOp::DeleteTextures:
+            for(size_t i = 1; i < numOfValues; i++)
+                OnObjectDeleted(GLTraceArg::TEXTURE, values[i]);
+            break;
+        case GLTraceOp::DeleteVertexArrays:
+            for(size_t i = 1; i < numOfValues; i++)
+            {
+                _elementBuffers.erase((unsigned int)values[i]);
+                if(_vertexArray == values[i])
+                    _vertexArray = 0;
+                OnObjectDeleted(GLTraceArg::VERTEX_ARRAY, values[i]);
+            }
+            break;
+        case GLTraceOp::DeleteFramebuffers:
+            for(size_t i = 1; i < numOfValues; i++)
+                OnObjectDeleted(GLTraceArg::FRAMEBUFFER, values[i]);
+            break;
+        case GLTraceOp::DeleteRenderbuffers:
+            for(size_t i = 1; i < numOfValues; i++)
+                OnObjectDeleted(GLTraceArg::RENDERBUFFER, values[i]);
+            break;
+        case GLTraceOp::DeleteProgram:
+        {
+            // A program that's in use stays bound (and alive) until something else gets used, so only its uniforms go
+            const unsigned int program = (unsigned int)values[0];
+            for(auto uniform = _uniforms.begin(); uniform != _uniforms.end();)
+                uniform = uniform->first.first == program ? _uniforms.erase(uniform) : std::next(uniform);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void GLCapture::OnObjectDeleted(GLTraceArg type, uint64_t name)
+{
+    // GL unbinds deleted objects everywhere they're bound
+    for(auto &entry: _stateEntries)
+    {
+        StateEntry &state = entry.second;
+        if(state.objectType == type && state.objectIndex >= 0 && state.values[state.objectIndex] == name)
+        {
+            state.values[state.objectIndex] = 0;
+            state.dirty = true;
+        }
+    }
+}
+
+bool GLCapture::UpdateStateEntry(GLTraceOp op, const uint64_t *values, size_t numOfValues)
+{
+    StateEntry entry = { op, {}, std::min(numOfValues, GLTraceOpInfo::MAX_ARGS), -1, -1, GLTraceArg::NONE, true };
+    std::copy(values, values + entry.numOfValues, entry.values);
+
+    uint64_t key = 0;
+    switch(op)
+    {
+        case GLTraceOp::BindFramebuffer:
+        case GLTraceOp::BindRenderbuffer:
+            key = GetStateKey(0, op, values[0]);
+            entry.objectIndex = 1;
+            entry.objectType = op == GLTraceOp::BindFramebuffer ? GLTraceArg::FRAMEBUFFER : GLTraceArg::RENDERBUFFER;
+            break;
+        case GLTraceOp::UseProgram:
+            // Deleting the program in use doesn't unbind it, so it isn't treated as an object
+            key = GetStateKey(1, op);
+            break;
+        case GLTraceOp::BindVertexArray:
+            key = GetStateKey(2, op);
+            entry.objectIndex = 0;
+            entry.objectType = GLTraceArg::VERTEX_ARRAY;
+            break;
+        case GLTraceOp::BindBufferBase:
+        case GLTraceOp::BindBufferRange:
+        {
+            key = GetStateKey(3, GLTraceOp::BindBufferBase, values[0], values[1]);
+            entry.objectIndex = 2;
+            entry.objectType = GLTraceArg::BUFFER;
+            // Binds the buffer to the target itself as well
+            const uint64_t binding[] = { values[0], values[2] };
+            UpdateStateEntry(GLTraceOp::BindBuffer, binding, 2);
+            break;
+        }
+        case GLTraceOp::BindBuffer:
+            // Part of the vertex array, so it has to go out in order with the calls that set the vertex array up
+            if(values[0] == GL_ELEMENT_ARRAY_BUFFER)
+                return false;
+            key = GetStateKey(4, op, values[0]);
+            entry.objectIndex = 1;
+            entry.objectType = GLTraceArg::BUFFER;
+            break;
+        case GLTraceOp::BindTexture:
+            key = GetStateKey(5, op, _activeTextureUnit, values[0]);
+            entry.textureUnit = (int)_activeTextureUnit;
+            entry.objectIndex = 1;
+            entry.objectType = GLTraceArg::TEXTURE;
+            break;
+        case GLTraceOp::BindImageTexture:
+            key = GetStateKey(6, op, values[0]);
+            entry.objectIndex = 1;
+            entry.objectType = GLTraceArg::TEXTURE;
+            break;
+        case GLTraceOp::ActiveTexture:
+            key = GetStateKey(7, op);
+            break;
+        case GLTraceOp::Enable:
+        case GLTraceOp::Disable:
+            key = GetStateKey(8, GLTraceOp::Enable, values[0]);
+            break;
+        case GLTraceOp::PixelStorei:
+        case GLTraceOp::PolygonMode:
+            key = GetStateKey(8, op, values[0]);
+            break;
+        default:
+            key = GetStateKey(8, op);
+            break;
+    }
+    _stateEntries[key] = entry;
+    return true;
+}
+
+void GLCapture::WriteState(bool all)
+{
+    for(auto &entry: _stateEntries)
+    {
+        StateEntry &state = entry.second;
+        if(!all && !state.dirty)
+            continue;
+
+        if(state.textureUnit >= 0)
+        {
+            // The active unit gets put back once all the textures have been bound, it comes after them
+            const uint64_t unit = Encode((GLenum)(GL_TEXTURE0 + state.textureUnit));
+            Write(GLTraceOp::ActiveTexture, &unit, 1);
+            _stateEntries[GetStateKey(7, GLTraceOp::ActiveTexture)].dirty = true;
+        }
+        if(state.op == GLTraceOp::BindBufferBase || state.op == GLTraceOp::BindBufferRange)
+        {
+            // Same for the target's own binding, which comes after the indexed ones
+            const auto binding = _stateEntries.find(GetStateKey(4, GLTraceOp::BindBuffer, state.values[0]));
+            if(binding != _stateEntries.end())
+                binding->second.dirty = true;
+        }
+        Write(state.op, state.values, state.numOfValues);
+        state.dirty = false;
+    }
+}
+
+void GLCapture::BeginFrames()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Write(GLTraceOp::WindowStart, nullptr, 0);
+
+    // The latest value of every uniform, program by program
+    unsigned int program = 0;
+    bool isProgramUsed = false;
+    for(const auto &uniform: _uniforms)
+    {
+        if(!isProgramUsed || uniform.first.first != program)
+        {
+            isProgramUsed = true;
+            program = uniform.first.first;
+            const uint64_t value = Encode(program);
+            Write(GLTraceOp::UseProgram, &value, 1);
+        }
+        _writeBuffer.insert(_writeBuffer.end(), uniform.second.begin(), uniform.second.end());
+    }
+
+    // What's in the buffers right now. Mapped buffers can't be read unless they're mapped persistently,
+    // the only ones that get mapped otherwise are the ring buffer's, which get written every frame anyway
+    auto bindBuffer = GLCaptureOriginal<&glad_glBindBuffer>::function;
+    auto getBufferSubData = GLCaptureOriginal<&glad_glGetBufferSubData>::function;
+    std::vector<unsigned char> data;
+    size_t numOfSnapshotBytes = 0;
+    for(const auto &buffer: _bufferSizes)
+    {
+        const auto mapped = _mappedBuffers.find(buffer.first);
+        if(buffer.second == 0 || (mapped != _mappedBuffers.end() && !mapped->second))
+            continue;
+
+        data.resize(buffer.second);
+        bindBuffer(GL_COPY_READ_BUFFER, buffer.first);
+        getBufferSubData(GL_COPY_READ_BUFFER, 0, buffer.second, data.data());
+        const uint64_t values[] = { Encode(buffer.first), 0 };
+        const GLTracePayload payload = { data.data(), data.size() };
+        Write(GLTraceOp::BufferContents, values, 2, &payload, 1);
+        numOfSnapshotBytes += buffer.second;
+    }
+    const auto copyReadBinding = _bufferBindings.find(GL_COPY_READ_BUFFER);
+    bindBuffer(GL_COPY_READ_BUFFER, copyReadBinding != _bufferBindings.end() ? copyReadBinding->second : 0);
+
+    WriteState(true);
+    Write(GLTraceOp::RestoreEnd, nullptr, 0);
+
+    _isStartRequested = false;
+    _numOfFramesLeft = _numOfFrames;
+    _state = GLCaptureState::CAPTURING;
+    Log::LogInfo("GL capture started, " + std::to_string((_numOfBytesWritten + _writeBuffer.size()) / 1024) + " KB of setup, " +
+                 std::to_string(numOfSnapshotBytes / 1024) + " KB of it buffer contents");
+}
+
+void GLCapture::Finish()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    FlushWriteBuffer();
+    std::fclose(_file);
+    _file = nullptr;
+    _state = GLCaptureState::DONE;
+    _numOfFramesLeft = 0;
+
+    _lastCapturePath = _path;
+    _uniforms.clear();
+    _stateEntries.clear();
+    Log::LogInfo("GL capture written to " + _lastCapturePath + " (" + std::to_string(_numOfBytesWritten / 1024) + " KB)");
+}
+
+void GLCapture::Write(GLTraceOp op, const uint64_t *values, size_t numOfValues, const GLTracePayload *payloads, size_t numOfPayloads)
+{
+    GLTrace::WriteCall(_writeBuffer, op, values, numOfValues, payloads, numOfPayloads);
+    if(_writeBuffer.size() >= WRITE_BUFFER_SIZE)
+        FlushWriteBuffer();
+}
+
+void GLCapture::FlushWriteBuffer()
+{
+    if(_file == nullptr || _writeBuffer.empty())
+        return;
+    if(std::fwrite(_writeBuffer.data(), 1, _writeBuffer.size(), _file) != _writeBuffer.size())
+        Log::LogError("Couldn't write to " + _path);
+    _numOfBytesWritten += _writeBuffer.size();
+    _writeBuffer.clear();
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "misc/singleton.hpp"
+#include "gl_trace.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class GLCaptureState
+{
+    // Nothing's hooked
+    DISARMED = 0,
+    // Recording what the frames will need, waiting for the frames to start
+    ARMED,
+    // Recording every call of the frames
+    CAPTURING,
+    // The trace has been written, the hooks only pass the calls on
+    DONE
+};
+
+/*
+Records the GL calls of a window of frames, along with the buffer and texture data and shader sources they use,
+into a trace that ModelViewerReplay can play back without the models, textures, shaders or UI that made it (see gl_trace.hpp).
+Arming it swaps the GL function pointers glad (and GLExtensions) call through for hooks that record the call and pass it on,
+which catches every GL_CALL site on every thread. It has to be armed before anything gets created, since a trace has to be
+able to make every object its frames use:
+- Until the frames start, only what creates, deletes or fills in objects gets written out. Binds and fixed function state
+  only get written right before a call that depends on them, uniforms only get kept as their latest value per program and location,
+  and the contents of the buffers get read back once the frames start, so the part before the frames doesn't grow with every frame
+- When the frames start, the uniforms, the contents of the buffers and the whole bound state get written out,
+  then every call of the frames gets written as it's made
+Writes through mapped memory never go through GL, the streaming ring buffer hands them over on its own (see RecordBufferContents()).
+The trace is streamed to a gl_capture_<date>_<time>.mvtrace file in the working directory.
+Left out are glGetError(), the debug output and the queries that only get made once at startup (eg. glGetString()).
+There's only one capture per run.
+*/
+class GLCapture final : public Singleton<GLCapture>
+{
+    friend class Singleton<GLCapture>;
+
+    public:
+    // Written out to the file once this much has piled up
+    static constexpr size_t WRITE_BUFFER_SIZE = 4 * 1024 * 1024;
+
+    private:
+    // A bind or a piece of fixed function state, written out when something depends on it
+    struct StateEntry final
+    {
+        GLTraceOp op;
+        uint64_t values[GLTraceOpInfo::MAX_ARGS];
+        size_t numOfValues;
+        // The texture unit a texture is bound to, which has to be made active first, -1 for everything else
+        int textureUnit;
+        // Which of the values names an object, -1 if none does
+        int objectIndex;
+        GLTraceArg objectType;
+        // Changed since it was last written out
+        bool dirty;
+    };
+
+    std::mutex _mutex;
+    std::atomic<GLCaptureState> _state{GLCaptureState::DISARMED};
+    FILE *_file = nullptr;
+    std::string _path;
+    std::string _lastCapturePath;
+    std::vector<unsigned char> _writeBuffer;
+    size_t _numOfBytesWritten = 0;
+
+    unsigned int _numOfFrames = 0;
+    unsigned int _numOfFramesLeft = 0;
+    // The frame to start capturing at, 0 to wait for Start()
+    unsigned int _startFrame = 0;
+    unsigned int _frameIndex = 0;
+    bool _isStartRequested = false;
+
+    // The state that calls get recorded against, as far as the calls seen so far go
+    unsigned int _program = 0;
+    unsigned int _vertexArray = 0;
+    unsigned int _activeTextureUnit = 0;
+    int _unpackAlignment = 4;
+    std::unordered_map<GLenum, unsigned int> _bufferBindings;
+    // GL_ELEMENT_ARRAY_BUFFER's binding is part of the vertex array
+    std::unordered_map<unsigned int, unsigned int> _elementBuffers;
+    // Buffer -> size, ordered so that every capture of the same run comes out the same
+    std::map<unsigned int, size_t> _bufferSizes;
+    // Buffer -> whether it's mapped persistently
+    std::unordered_map<unsigned int, bool> _mappedBuffers;
+    std::unordered_map<GLsync, uint64_t> _syncs;
+    uint64_t _nextSync = 1;
+
+    std::map<uint64_t, StateEntry> _stateEntries;
+    // (program, location) -> the encoded call that last set it
+    std::map<std::pair<unsigned int, int>, std::vector<unsigned char>> _uniforms;
+
+    private:
+    GLCapture() = default;
+    ~GLCapture() = default;
+
+    public:
+    // Hooks the GL functions and starts recording. Has to be called after glad and GLExtensions have been loaded
+    // and before anything gets created. The frames start at the given frame, or once Start() gets called if it's 0.
+    // The width and height are of the default framebuffer, which the replayer makes a framebuffer of its own for
+    void Arm(unsigned int width, unsigned int height, unsigned int numOfFrames, unsigned int startFrame);
+    // Puts the GL functions back and finishes the trace if the frames are still being captured,
+    // or deletes it if they never started
+    void DeInit();
+
+    // The frames start at the end of the current frame
+    void Start();
+    // Called by the render (GL) thread once at the end of every frame
+    void EndFrame();
+
+    // Profiler scopes, so that the replayer can time the parts of the frame
+    void BeginMarker(const char *name);
+    void EndMarker();
+    // Data written straight into mapped memory, which has to be recorded before the calls that read it
+    void RecordBufferContents(unsigned int buffer, size_t offset, size_t size, const void *data);
+
+    // Used by the hooks. The values are encoded with GLTrace::EncodeValue()
+    void Record(GLTraceOp op, const uint64_t *values, size_t numOfValues, const GLTracePayload *payloads = nullptr, size_t numOfPayloads = 0);
+    unsigned int GetBoundBuffer(GLenum target);
+    // Returns 0 if the sync wasn't made while the frames were being captured
+    uint64_t GetSyncID(GLsync sync, bool create);
+    void ForgetSync(GLsync sync);
+    int getUnpackAlignment();
+
+    inline GLCaptureState getState() const { return _state.load(std::memory_order_relaxed); }
+    inline bool isRecording() const { const GLCaptureState state = getState(); return state == GLCaptureState::ARMED || state == GLCaptureState::CAPTURING; }
+    inline bool isCapturingFrames() const { return getState() == GLCaptureState::CAPTURING; }
+    inline unsigned int getNumOfFrames() const { return _numOfFrames; }
+    inline unsigned int getNumOfFramesLeft() const { return _numOfFramesLeft; }
+    inline const std::string &getLastCapturePath() const { return _lastCapturePath; }
+
+    private:
+    static void InstallHooks();
+    static void UninstallHooks();
+
+    // Keeps track of the bindings and objects the hooks need to know about
+    void Track(GLTraceOp op, const uint64_t *values, size_t numOfValues);
+    void OnObjectDeleted(GLTraceArg type, uint64_t name);
+    // Returns false if the call isn't one that's kept as state
+    bool UpdateStateEntry(GLTraceOp op, const uint64_t *values, size_t numOfValues);
+    // Writes out the state entries that changed since they were last written, or all of them
+    void WriteState(bool all);
+    // Writes out everything the frames start from
+    void BeginFrames();
+    void Finish();
+    void Write(GLTraceOp op, const uint64_t *values, size_t numOfValues, const GLTracePayload *payloads = nullptr, size_t numOfPayloads = 0);
+    void FlushWriteBuffer();
+};
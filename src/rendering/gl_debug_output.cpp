@@ -0,0 +1,91 @@
+#include "gl_debug_output.hpp"
+
+#include "core/log.hpp"
+
+void GLDebugOutput::Init(bool enable, bool synchronous)
+{
+    // Core since 4.3, loaded by GLExtensions through GL_KHR_debug on older contexts
+    _isSupported = glad_glDebugMessageCallback != nullptr && glad_glDebugMessageControl != nullptr;
+    if(!_isSupported)
+    {
+        Log::LogInfo("GL debug output isn't supported, only glGetError() checks are available");
+        return;
+    }
+
+    GL_CALL(glad_glDebugMessageCallback(MessageCallback, nullptr));
+    if(synchronous)
+    {
+        GL_CALL(glad_glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS));
+    }
+    SetEnabled(enable);
+}
+
+void GLDebugOutput::SetEnabled(bool enabled)
+{
+    if(!_isSupported)
+        return;
+
+    if(enabled)
+    {
+        GL_CALL(glad_glEnable(GL_DEBUG_OUTPUT));
+    }
+    else
+    {
+        GL_CALL(glad_glDisable(GL_DEBUG_OUTPUT));
+    }
+    _isEnabled = enabled;
+}
+
+const char *GLDebugOutput::GetSourceName(GLenum source)
+{
+    switch(source)
+    {
+        case GL_DEBUG_SOURCE_API:               return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:     return "Window system";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER:   return "Shader compiler";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:       return "Third party";
+        case GL_DEBUG_SOURCE_APPLICATION:       return "Application";
+        default:                                return "Other";
+    }
+}
+const char *GLDebugOutput::GetSeverityName(GLenum severity)
+{
+    switch(severity)
+    {
+        case GL_DEBUG_SEVERITY_HIGH:            return "High";
+        case GL_DEBUG_SEVERITY_MEDIUM:          return "Medium";
+        case GL_DEBUG_SEVERITY_LOW:             return "Low";
+        default:                                return "Notification";
+    }
+}
+
+int GLDebugOutput::GetSeverityIndex(GLenum severity)
+{
+    for(int i = 0; i < (int)SEVERITIES.size(); i++)
+    {
+        if(SEVERITIES[i] == severity)
+            return i;
+    }
+    return 0;
+}
+
+void APIENTRY GLDebugOutput::MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam)
+{
+    const int severityIndex = GetSeverityIndex(severity);
+    if(severityIndex < minSeverity)
+        return;
+
+    for(int i = 0; i < (int)SOURCES.size(); i++)
+    {
+        if(SOURCES[i] == source && !enabledSources[i])
+            return;
+    }
+
+    const std::string text = std::string("GL debug (") + GetSourceName(source) + ", " + GetSeverityName(severity) + ", id " + std::to_string(id) + "): " + message;
+    if(type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH)
+        Log::LogError(text);
+    else if(severity == GL_DEBUG_SEVERITY_MEDIUM)
+        Log::LogWarning(text);
+    else
+        Log::LogInfo(text);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+
+/*
+Routes the driver's GL_KHR_debug messages into the log. Unlike glGetError(), the driver reports
+what went wrong in words and doesn't need to be polled. Messages can be filtered by source and severity at runtime.
+*/
+class GLDebugOutput final
+{
+    public:
+    static constexpr std::array<GLenum, 6> SOURCES = { GL_DEBUG_SOURCE_API, GL_DEBUG_SOURCE_WINDOW_SYSTEM, GL_DEBUG_SOURCE_SHADER_COMPILER, GL_DEBUG_SOURCE_THIRD_PARTY, GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_SOURCE_OTHER };
+    // From the least to the most severe
+    static constexpr std::array<GLenum, 4> SEVERITIES = { GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH };
+
+    private:
+    inline static bool _isSupported = false;
+    inline static bool _isEnabled = false;
+
+    public:
+    // Index into SEVERITIES, messages below it get dropped
+    inline static int minSeverity = 1;
+    // Whether the messages from each of the SOURCES get logged
+    inline static std::array<bool, SOURCES.size()> enabledSources = { true, true, true, true, true, true };
+
+    private:
+    GLDebugOutput() {}
+    ~GLDebugOutput() {}
+
+    public:
+    // Registers the callback if the context supports debug output.
+    // Synchronous output makes the callback run inside the offending call, which is slower but easy to break on
+    static void Init(bool enable, bool synchronous);
+    static void SetEnabled(bool enabled);
+
+    inline static bool IsSupported() { return _isSupported; }
+    inline static bool IsEnabled() { return _isEnabled; }
+
+    static const char *GetSourceName(GLenum source);
+    static const char *GetSeverityName(GLenum severity);
+
+    private:
+    static void APIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam);
+    static int GetSeverityIndex(GLenum severity);
+};
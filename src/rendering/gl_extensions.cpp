@@ -0,0 +1,64 @@
+#include "gl_extensions.hpp"
+
+#include "core/log.hpp"
+
+#include <algorithm>
+
+void GLExtensions::Load(GLADloadproc loader)
+{
+    _supportedExtensions.clear();
+
+    int numOfExtensions = 0;
+    GL_CALL(glad_glGetIntegerv(GL_NUM_EXTENSIONS, &numOfExtensions));
+    for(int i = 0; i < numOfExtensions; i++)
+    {
+        const char *extension = (const char*)GL_CALL(glad_glGetStringi(GL_EXTENSIONS, i));
+        if(extension != nullptr)
+            _supportedExtensions.push_back(extension);
+    }
+
+    // KHR_parallel_shader_compile
+    if(IsSupported("GL_KHR_parallel_shader_compile"))
+        glMaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsKHR");
+    else if(IsSupported("GL_ARB_parallel_shader_compile"))
+        glMaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)loader("glMaxShaderCompilerThreadsARB");
+    parallelShaderCompile = glMaxShaderCompilerThreads != nullptr;
+
+    Log::LogInfo("Parallel shader compilation " + std::string(parallelShaderCompile ? "supported" : "not supported"));
+
+    // KHR_debug, core since 4.3 so glad has only loaded it on 4.3+ contexts.
+    // In a core profile the extension's entry points don't have a suffix, so they fill glad's pointers
+    if(glad_glDebugMessageCallback == nullptr && IsSupported("GL_KHR_debug"))
+    {
+        glad_glDebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)loader("glDebugMessageCallback");
+        glad_glDebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)loader("glDebugMessageControl");
+    }
+
+    // ARB_multi_draw_indirect, core since 4.3 as well
+    if(glad_glMultiDrawArraysIndirect == nullptr && IsSupported("GL_ARB_multi_draw_indirect"))
+        glad_glMultiDrawArraysIndirect = (PFNGLMULTIDRAWARRAYSINDIRECTPROC)loader("glMultiDrawArraysIndirect");
+    multiDrawIndirect = glad_glMultiDrawArraysIndirect != nullptr && IsSupported("GL_ARB_shader_storage_buffer_object");
+
+    Log::LogInfo("Multi draw indirect " + std::string(multiDrawIndirect ? "supported" : "not supported"));
+
+    // ARB_compute_shader and ARB_clear_buffer_object, both core since 4.3
+    if(glad_glDispatchCompute == nullptr && IsSupported("GL_ARB_compute_shader"))
+        glad_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)loader("glDispatchCompute");
+    if(glad_glClearBufferData == nullptr && IsSupported("GL_ARB_clear_buffer_object"))
+        glad_glClearBufferData = (PFNGLCLEARBUFFERDATAPROC)loader("glClearBufferData");
+    computeShaders = multiDrawIndirect && glad_glDispatchCompute != nullptr && glad_glClearBufferData != nullptr;
+
+    Log::LogInfo("Compute shaders " + std::string(computeShaders ? "supported" : "not supported"));
+
+    // ARB_buffer_storage, beyond the 4.3 glad was generated for so it's always loaded by hand
+    if(IsSupported("GL_ARB_buffer_storage"))
+        glBufferStorage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+    bufferStorage = glBufferStorage != nullptr;
+
+    Log::LogInfo("Persistently mapped buffers " + std::string(bufferStorage ? "supported" : "not supported"));
+}
+
+bool GLExtensions::IsSupported(const std::string &name)
+{
+    return std::find(_supportedExtensions.begin(), _supportedExtensions.end(), name) != _supportedExtensions.end();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// glad is generated for GL 4.3 core without any extensions,
+// so the tokens and entry points of the extensions used by the renderer are declared here
+
+#pragma region KHR_parallel_shader_compile
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#pragma endregion
+
+#pragma region ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+#pragma endregion
+
+class GLExtensions final
+{
+    private:
+    inline static std::vector<std::string> _supportedExtensions;
+
+    public:
+    // KHR_parallel_shader_compile (or its ARB twin, which shares the tokens)
+    inline static bool parallelShaderCompile = false;
+    inline static PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreads = nullptr;
+    // glMultiDrawArraysIndirect and shader storage buffers, either through a 4.3 context or ARB_multi_draw_indirect
+    // and ARB_shader_storage_buffer_object on a 4.2 one. The shaders always enable the latter explicitly since they're #version 420
+    inline static bool multiDrawIndirect = false;
+    // glDispatchCompute and glClearBufferData, either through a 4.3 context or ARB_compute_shader and ARB_clear_buffer_object.
+    // Only set along with multiDrawIndirect since the compute shaders write storage buffers
+    inline static bool computeShaders = false;
+    // ARB_buffer_storage (core since 4.4), for buffers that stay mapped while the GPU reads them
+    inline static bool bufferStorage = false;
+    inline static PFNGLBUFFERSTORAGEPROC glBufferStorage = nullptr;
+
+    private:
+    GLExtensions() {}
+    ~GLExtensions() {}
+
+    public:
+    // Queries the extensions of the current context and loads their entry points.
+    // Must be called after glad has been initialized
+    static void Load(GLADloadproc loader);
+    static bool IsSupported(const std::string &name);
+};
@@ -0,0 +1,295 @@
+#include "gl_state.hpp"
+
+#include "core/log.hpp"
+
+GLState::GLState()
+{
+    Invalidate();
+}
+
+bool GLState::Update(unsigned int &current, unsigned int value)
+{
+    if(current == value)
+    {
+        _counters.redundantCalls++;
+        return false;
+    }
+
+    current = value;
+    _counters.issuedCalls++;
+    return true;
+}
+
+int GLState::GetTextureTargetIndex(unsigned int target)
+{
+    for(int i = 0; i < (int)TEXTURE_TARGETS.size(); i++)
+    {
+        if(TEXTURE_TARGETS[i] == target)
+            return i;
+    }
+    return -1;
+}
+int GLState::GetBufferTargetIndex(unsigned int target)
+{
+    for(int i = 0; i < (int)BUFFER_TARGETS.size(); i++)
+    {
+        if(BUFFER_TARGETS[i] == target)
+            return i;
+    }
+    return -1;
+}
+
+void GLState::UseProgram(unsigned int program)
+{
+    if(Update(_program, program))
+    {
+        _counters.programBinds++;
+        GL_CALL(glad_glUseProgram(program));
+    }
+}
+void GLState::BindVertexArray(unsigned int vertexArray)
+{
+    if(Update(_vertexArray, vertexArray))
+    {
+        _counters.vertexArrayBinds++;
+        GL_CALL(glad_glBindVertexArray(vertexArray));
+    }
+}
+void GLState::ActiveTexture(unsigned int unit)
+{
+    if(Update(_activeTextureUnit, unit))
+    {
+        GL_CALL(glad_glActiveTexture(GL_TEXTURE0 + unit));
+    }
+}
+void GLState::BindTexture(unsigned int target, unsigned int texture)
+{
+    const int targetIndex = GetTextureTargetIndex(target);
+    // Nothing is known about the bindings if the active unit was never set through the cache
+    if(targetIndex == -1 || _activeTextureUnit >= MAX_TEXTURE_UNITS)
+    {
+        _counters.issuedCalls++;
+        _counters.textureBinds++;
+        GL_CALL(glad_glBindTexture(target, texture));
+        return;
+    }
+
+    if(Update(_textures[_activeTextureUnit][targetIndex], texture))
+    {
+        _counters.textureBinds++;
+        GL_CALL(glad_glBindTexture(target, texture));
+    }
+}
+void GLState::BindTextureToUnit(unsigned int unit, unsigned int target, unsigned int texture)
+{
+    // Only switch the active unit if the binding actually has to change
+    const int targetIndex = GetTextureTargetIndex(target);
+    if(targetIndex != -1 && unit < MAX_TEXTURE_UNITS && _textures[unit][targetIndex] == texture)
+    {
+        _counters.redundantCalls++;
+        return;
+    }
+
+    ActiveTexture(unit);
+    BindTexture(target, texture);
+}
+void GLState::BindBuffer(unsigned int target, unsigned int buffer)
+{
+    const int targetIndex = GetBufferTargetIndex(target);
+    if(targetIndex == -1)
+    {
+        _counters.issuedCalls++;
+        GL_CALL(glad_glBindBuffer(target, buffer));
+        return;
+    }
+
+    if(Update(_buffers[targetIndex], buffer))
+    {
+        GL_CALL(glad_glBindBuffer(target, buffer));
+    }
+}
+
+void GLState::BindBufferBase(unsigned int target, unsigned int index, unsigned int buffer)
+{
+    _counters.issuedCalls++;
+    GL_CALL(glad_glBindBufferBase(target, index, buffer));
+
+    const int targetIndex = GetBufferTargetIndex(target);
+    if(targetIndex != -1)
+        _buffers[targetIndex] = buffer;
+}
+
+void GLState::BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, size_t offset, size_t size)
+{
+    _counters.issuedCalls++;
+    GL_CALL(glad_glBindBufferRange(target, index, buffer, (GLintptr)offset, (GLsizeiptr)size));
+
+    const int targetIndex = GetBufferTargetIndex(target);
+    if(targetIndex != -1)
+        _buffers[targetIndex] = buffer;
+}
+
+void GLState::SetCapability(GLenum capability, bool enabled)
+{
+    auto state = _capabilities.find(capability);
+    if(state == _capabilities.end())
+        state = _capabilities.emplace(capability, UNKNOWN).first;
+
+    if(!Update(state->second, enabled))
+        return;
+
+    if(enabled)
+    {
+        GL_CALL(glad_glEnable(capability));
+    }
+    else
+    {
+        GL_CALL(glad_glDisable(capability));
+    }
+}
+void GLState::ClearColor(const glm::vec4 &color)
+{
+    if(_clearColor == color)
+    {
+        _counters.redundantCalls++;
+        return;
+    }
+
+    _clearColor = color;
+    _counters.issuedCalls++;
+    GL_CALL(glad_glClearColor(color.x, color.y, color.z, color.w));
+}
+void GLState::PolygonMode(unsigned int mode)
+{
+    if(Update(_polygonMode, mode))
+    {
+        GL_CALL(glad_glPolygonMode(GL_FRONT_AND_BACK, mode));
+    }
+}
+void GLState::DepthFunc(unsigned int func)
+{
+    if(Update(_depthFunc, func))
+    {
+        GL_CALL(glad_glDepthFunc(func));
+    }
+}
+void GLState::DepthMask(bool enabled)
+{
+    if(Update(_depthMask, enabled))
+    {
+        GL_CALL(glad_glDepthMask(enabled ? GL_TRUE : GL_FALSE));
+    }
+}
+void GLState::BlendFunc(unsigned int src, unsigned int dst)
+{
+    if(_blendSrc == src && _blendDst == dst)
+    {
+        _counters.redundantCalls++;
+        return;
+    }
+
+    _blendSrc = src;
+    _blendDst = dst;
+    _counters.issuedCalls++;
+    GL_CALL(glad_glBlendFunc(src, dst));
+}
+void GLState::CullFace(unsigned int mode)
+{
+    if(Update(_cullFace, mode))
+    {
+        GL_CALL(glad_glCullFace(mode));
+    }
+}
+
+void GLState::OnProgramDeleted(unsigned int program)
+{
+    if(_program == program)
+        _program = UNKNOWN;
+}
+void GLState::OnVertexArrayDeleted(unsigned int vertexArray)
+{
+    if(_vertexArray == vertexArray)
+        _vertexArray = 0;
+}
+void GLState::OnTextureDeleted(unsigned int texture)
+{
+    for(auto &unit: _textures)
+    {
+        for(unsigned int &boundTexture: unit)
+        {
+            if(boundTexture == texture)
+                boundTexture = 0;
+        }
+    }
+}
+void GLState::OnBufferDeleted(unsigned int buffer)
+{
+    for(unsigned int &boundBuffer: _buffers)
+    {
+        if(boundBuffer == buffer)
+            boundBuffer = 0;
+    }
+}
+
+void GLState::Invalidate()
+{
+    _program = UNKNOWN;
+    _vertexArray = UNKNOWN;
+    _activeTextureUnit = UNKNOWN;
+    for(auto &unit: _textures)
+        unit.fill(UNKNOWN);
+    _buffers.fill(UNKNOWN);
+
+    _capabilities.clear();
+    _clearColor = glm::vec4(-1.0f);
+    _polygonMode = UNKNOWN;
+    _depthFunc = UNKNOWN;
+    _depthMask = UNKNOWN;
+    _blendSrc = _blendDst = UNKNOWN;
+    _cullFace = UNKNOWN;
+}
+
+void GLState::ValidateState() const
+{
+    auto validate = [](const char *name, unsigned int shadowed, GLenum query)
+    {
+        if(shadowed == UNKNOWN)
+            return;
+
+        int actual = 0;
+        GL_CALL(glad_glGetIntegerv(query, &actual));
+        if((unsigned int)actual != shadowed)
+            Log::LogError(std::string("GL state cache out of sync: ") + name + " is " + std::to_string(actual) + " but the cache thinks it's " + std::to_string(shadowed));
+    };
+
+    validate("program", _program, GL_CURRENT_PROGRAM);
+    validate("vertex array", _vertexArray, GL_VERTEX_ARRAY_BINDING);
+    validate("array buffer", _buffers[GetBufferTargetIndex(GL_ARRAY_BUFFER)], GL_ARRAY_BUFFER_BINDING);
+    validate("depth func", _depthFunc, GL_DEPTH_FUNC);
+    validate("cull face", _cullFace, GL_CULL_FACE_MODE);
+    if(_activeTextureUnit != UNKNOWN)
+    {
+        validate("active texture", GL_TEXTURE0 + _activeTextureUnit, GL_ACTIVE_TEXTURE);
+        validate("texture 2D binding", _textures[_activeTextureUnit][GetTextureTargetIndex(GL_TEXTURE_2D)], GL_TEXTURE_BINDING_2D);
+    }
+
+    for(const auto &capability: _capabilities)
+    {
+        if(capability.second == UNKNOWN)
+            continue;
+
+        const bool isEnabled = glad_glIsEnabled(capability.first) == GL_TRUE;
+        if(isEnabled != (capability.second == 1))
+            Log::LogError("GL state cache out of sync: capability " + std::to_string(capability.first) + " is " + (isEnabled ? "enabled" : "disabled"));
+    }
+}
+
+void GLState::EndFrame()
+{
+#ifdef GL_STATE_VALIDATION
+    ValidateState();
+#endif
+
+    _lastFrameCounters = _counters;
+    _counters = GLStateCounters();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+
+#include "misc/singleton.hpp"
+
+#include <array>
+#include <cstddef>
+#include <unordered_map>
+
+// Unbinding only matters for catching code that relies on stale bindings, so it's only done (and the shadowed state
+// checked against the real one) with GL_STATE_VALIDATION defined, see the CMake option of the same name
+
+struct GLStateCounters
+{
+    // State changing calls that actually reached GL
+    unsigned int issuedCalls = 0;
+    // State changing calls that were skipped because they wouldn't have changed anything
+    unsigned int redundantCalls = 0;
+    // The issued calls that bound a program, a vertex array or a texture
+    unsigned int programBinds = 0;
+    unsigned int vertexArrayBinds = 0;
+    unsigned int textureBinds = 0;
+};
+
+/*
+Shadows the GL state of the main context and skips the calls that wouldn't change anything.
+Everything that binds objects or changes raster state on the main context should go through here,
+otherwise the shadowed state goes stale. Code that touches the state behind its back
+has to either restore it (like the ImGui backend does) or call Invalidate() afterwards.
+*/
+class GLState final : public Singleton<GLState>
+{
+    friend class Singleton<GLState>;
+
+    public:
+    static constexpr unsigned int MAX_TEXTURE_UNITS = 32;
+
+    private:
+    // Stands in for state that hasn't been set through the cache yet, so the first call always goes through
+    static constexpr unsigned int UNKNOWN = 0xFFFFFFFF;
+
+    static constexpr std::array<GLenum, 5> TEXTURE_TARGETS = { GL_TEXTURE_1D, GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY };
+    // GL_ELEMENT_ARRAY_BUFFER is left out on purpose, its binding is part of the VAO state
+    static constexpr std::array<GLenum, 8> BUFFER_TARGETS = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_DRAW_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+
+    unsigned int _program = UNKNOWN;
+    unsigned int _vertexArray = UNKNOWN;
+    unsigned int _activeTextureUnit = UNKNOWN;
+    std::array<std::array<unsigned int, TEXTURE_TARGETS.size()>, MAX_TEXTURE_UNITS> _textures;
+    std::array<unsigned int, BUFFER_TARGETS.size()> _buffers;
+
+    // Capability -> 0/1, missing means unknown
+    std::unordered_map<GLenum, unsigned int> _capabilities;
+    glm::vec4 _clearColor = glm::vec4(-1.0f);
+    unsigned int _polygonMode = UNKNOWN;
+    unsigned int _depthFunc = UNKNOWN;
+    unsigned int _depthMask = UNKNOWN;
+    unsigned int _blendSrc = UNKNOWN, _blendDst = UNKNOWN;
+    unsigned int _cullFace = UNKNOWN;
+
+    GLStateCounters _counters;
+    GLStateCounters _lastFrameCounters;
+
+    private:
+    GLState();
+    ~GLState() = default;
+
+    public:
+    void UseProgram(unsigned int program);
+    void BindVertexArray(unsigned int vertexArray);
+    // Takes the index of the unit (eg. 2) rather than the enum (eg. GL_TEXTURE2)
+    void ActiveTexture(unsigned int unit);
+    // Binds the texture to the active texture unit
+    void BindTexture(unsigned int target, unsigned int texture);
+    void BindTextureToUnit(unsigned int unit, unsigned int target, unsigned int texture);
+    void BindBuffer(unsigned int target, unsigned int buffer);
+    // Binds the buffer to an indexed binding point (eg. of GL_SHADER_STORAGE_BUFFER). The indexed bindings aren't shadowed,
+    // but the call also binds the buffer to the target itself and that binding is
+    void BindBufferBase(unsigned int target, unsigned int index, unsigned int buffer);
+    // Same as BindBufferBase, for part of the buffer
+    void BindBufferRange(unsigned int target, unsigned int index, unsigned int buffer, size_t offset, size_t size);
+
+    void SetCapability(GLenum capability, bool enabled);
+    void ClearColor(const glm::vec4 &color);
+    void PolygonMode(unsigned int mode);
+    void DepthFunc(unsigned int func);
+    void DepthMask(bool enabled);
+    void BlendFunc(unsigned int src, unsigned int dst);
+    void CullFace(unsigned int mode);
+
+    // GL unbinds deleted objects on its own and their names can be reused afterwards,
+    // so the cache has to forget about them
+    void OnProgramDeleted(unsigned int program);
+    void OnVertexArrayDeleted(unsigned int vertexArray);
+    void OnTextureDeleted(unsigned int texture);
+    void OnBufferDeleted(unsigned int buffer);
+
+    // Forgets the whole shadowed state, the next call of every kind goes through
+    void Invalidate();
+    // Compares the shadowed state against what GL reports and logs any mismatch. Slow, debug only
+    void ValidateState() const;
+
+    // Moves the counters of the frame that just ended to the last frame counters
+    void EndFrame();
+    inline const GLStateCounters &getCounters() const { return _counters; }
+    inline const GLStateCounters &getLastFrameCounters() const { return _lastFrameCounters; }
+
+    private:
+    // Returns true if the value changed and the call has to be issued
+    bool Update(unsigned int &current, unsigned int value);
+    static int GetTextureTargetIndex(unsigned int target);
+    static int GetBufferTargetIndex(unsigned int target);
+};
@@ -0,0 +1,252 @@
+#include "gl_trace.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    // Short names for the tables below
+    constexpr GLTraceArg BUFFER = GLTraceArg::BUFFER, TEXTURE = GLTraceArg::TEXTURE, VERTEX_ARRAY = GLTraceArg::VERTEX_ARRAY,
+                         FRAMEBUFFER = GLTraceArg::FRAMEBUFFER, RENDERBUFFER = GLTraceArg::RENDERBUFFER, QUERY = GLTraceArg::QUERY,
+                         PROGRAM = GLTraceArg::PROGRAM, SHADER = GLTraceArg::SHADER, LOCATION = GLTraceArg::LOCATION,
+                         OFFSET = GLTraceArg::OFFSET, OUTPUT = GLTraceArg::OUTPUT, VALUE = GLTraceArg::VALUE;
+    constexpr GLTraceCategory STATE = GLTraceCategory::STATE, UNIFORM = GLTraceCategory::UNIFORM, RESOURCE = GLTraceCategory::RESOURCE,
+                              FRAME = GLTraceCategory::FRAME, MARKER = GLTraceCategory::MARKER;
+
+    const GLTraceOpInfo OP_INFOS[(size_t)GLTraceOp::COUNT] =
+    {
+#define GL_TRACE_GENERIC_INFO(name, function, category, ...) { "gl" #name, category, { __VA_ARGS__ }, nullptr },
+#define GL_TRACE_SPECIAL_INFO(name, category, layout) { category == MARKER ? #name : "gl" #name, category, {}, layout },
+        GL_TRACE_GENERIC_CALLS(GL_TRACE_GENERIC_INFO)
+        GL_TRACE_SPECIAL_CALLS(GL_TRACE_SPECIAL_INFO)
+#undef GL_TRACE_GENERIC_INFO
+#undef GL_TRACE_SPECIAL_INFO
+    };
+}
+
+const GLTraceOpInfo &GLTrace::GetOpInfo(GLTraceOp op)
+{
+    return OP_INFOS[(size_t)op];
+}
+
+void GLTrace::WriteHeader(std::vector<unsigned char> &out, const GLTraceHeader &header)
+{
+    out.insert(out.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    WriteVarint(out, VERSION);
+    WriteVarint(out, header.width);
+    WriteVarint(out, header.height);
+    WritePayload(out, { header.renderer.data(), header.renderer.size() });
+    WritePayload(out, { header.version.data(), header.version.size() });
+}
+
+bool GLTrace::ReadHeader(const unsigned char *&cursor, const unsigned char *end, GLTraceHeader &header)
+{
+    if((size_t)(end - cursor) < sizeof(MAGIC) || std::memcmp(cursor, MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    cursor += sizeof(MAGIC);
+
+    uint64_t version = 0, width = 0, height = 0;
+    GLTracePayload renderer, glVersion;
+    if(!ReadVarint(cursor, end, version) || version != VERSION || !ReadVarint(cursor, end, width) || !ReadVarint(cursor, end, height) ||
+       !ReadPayload(cursor, end, renderer) || !ReadPayload(cursor, end, glVersion))
+        return false;
+
+    header.width = (unsigned int)width;
+    header.height = (unsigned int)height;
+    header.renderer.assign((const char*)renderer.data, renderer.size);
+    header.version.assign((const char*)glVersion.data, glVersion.size);
+    return true;
+}
+
+void GLTrace::WriteCall(std::vector<unsigned char> &out, GLTraceOp op, const uint64_t *values, size_t numOfValues,
+                        const GLTracePayload *payloads, size_t numOfPayloads)
+{
+    WriteVarint(out, (uint64_t)op);
+    const GLTraceOpInfo &info = GetOpInfo(op);
+    if(info.layout == nullptr)
+    {
+        for(size_t i = 0; i < numOfValues; i++)
+            WriteVarint(out, values[i]);
+        return;
+    }
+
+    size_t valueIndex = 0, payloadIndex = 0;
+    for(const char *layout = info.layout; *layout != '\0'; layout++)
+    {
+        switch(*layout)
+        {
+            case 'v':
+                WriteVarint(out, valueIndex < numOfValues ? values[valueIndex] : 0);
+                valueIndex++;
+                break;
+            case 'n':
+            {
+                const uint64_t count = valueIndex < numOfValues ? values[valueIndex] : 0;
+                WriteVarint(out, count);
+                valueIndex++;
+                for(uint64_t i = 0; i < count; i++, valueIndex++)
+                    WriteVarint(out, valueIndex < numOfValues ? values[valueIndex] : 0);
+                break;
+            }
+            case 'p':
+                WritePayload(out, payloadIndex < numOfPayloads ? payloads[payloadIndex] : GLTracePayload());
+                payloadIndex++;
+                break;
+            case 'P':
+            {
+                const uint64_t count = valueIndex < numOfValues ? values[valueIndex] : 0;
+                WriteVarint(out, count);
+                valueIndex++;
+                for(uint64_t i = 0; i < count; i++, payloadIndex++)
+                    WritePayload(out, payloadIndex < numOfPayloads ? payloads[payloadIndex] : GLTracePayload());
+                break;
+            }
+        }
+    }
+}
+
+bool GLTrace::ReadCall(const unsigned char *&cursor, const unsigned char *end, GLTraceCall &call)
+{
+    call.values.clear();
+    call.payloads.clear();
+
+    uint64_t op = 0;
+    if(!ReadVarint(cursor, end, op) || op >= (uint64_t)GLTraceOp::COUNT)
+        return false;
+    call.op = (GLTraceOp)op;
+
+    uint64_t value = 0;
+    const GLTraceOpInfo &info = GetOpInfo(call.op);
+    if(info.layout == nullptr)
+    {
+        for(size_t i = 0; i < GLTraceOpInfo::MAX_ARGS && info.args[i] != GLTraceArg::NONE; i++)
+        {
+            if(info.args[i] == GLTraceArg::OUTPUT)
+                continue;
+            if(!ReadVarint(cursor, end, value))
+                return false;
+            call.values.push_back(value);
+        }
+        return true;
+    }
+
+    for(const char *layout = info.layout; *layout != '\0'; layout++)
+    {
+        GLTracePayload payload;
+        switch(*layout)
+        {
+            case 'v':
+                if(!ReadVarint(cursor, end, value))
+                    return false;
+                call.values.push_back(value);
+                break;
+            case 'n':
+            {
+                uint64_t count = 0;
+                if(!ReadVarint(cursor, end, count) || count > (uint64_t)(end - cursor))
+                    return false;
+                call.values.push_back(count);
+                for(uint64_t i = 0; i < count; i++)
+                {
+                    if(!ReadVarint(cursor, end, value))
+                        return false;
+                    call.values.push_back(value);
+                }
+                break;
+            }
+            case 'p':
+                if(!ReadPayload(cursor, end, payload))
+                    return false;
+                call.payloads.push_back(payload);
+                break;
+            case 'P':
+            {
+                uint64_t count = 0;
+                if(!ReadVarint(cursor, end, count) || count > (uint64_t)(end - cursor))
+                    return false;
+                call.values.push_back(count);
+                for(uint64_t i = 0; i < count; i++)
+                {
+                    if(!ReadPayload(cursor, end, payload))
+                        return false;
+                    call.payloads.push_back(payload);
+                }
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+size_t GLTrace::GetPixelSize(GLenum format, GLenum type)
+{
+    size_t numOfComponents = 0;
+    switch(format)
+    {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: numOfComponents = 1; break;
+        case GL_RG: case GL_RG_INTEGER: numOfComponents = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: numOfComponents = 3; break;
+        case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: numOfComponents = 4; break;
+        default: return 0;
+    }
+
+    switch(type)
+    {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return numOfComponents;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT: return numOfComponents * 2;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT: return numOfComponents * 4;
+        default: return 0;
+    }
+}
+
+size_t GLTrace::GetImageSize(int width, int height, GLenum format, GLenum type, int alignment)
+{
+    if(width <= 0 || height <= 0)
+        return 0;
+    alignment = std::max(alignment, 1);
+    const size_t rowSize = (size_t)width * GetPixelSize(format, type);
+    const size_t rowStride = (rowSize + alignment - 1) / alignment * alignment;
+    return rowStride * (height - 1) + rowSize;
+}
+
+void GLTrace::WriteVarint(std::vector<unsigned char> &out, uint64_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back((unsigned char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char)value);
+}
+
+bool GLTrace::ReadVarint(const unsigned char *&cursor, const unsigned char *end, uint64_t &value)
+{
+    value = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if(cursor == end)
+            return false;
+        const unsigned char byte = *cursor++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+void GLTrace::WritePayload(std::vector<unsigned char> &out, const GLTracePayload &payload)
+{
+    WriteVarint(out, payload.size);
+    if(payload.size > 0)
+        out.insert(out.end(), (const unsigned char*)payload.data, (const unsigned char*)payload.data + payload.size);
+}
+
+bool GLTrace::ReadPayload(const unsigned char *&cursor, const unsigned char *end, GLTracePayload &payload)
+{
+    uint64_t size = 0;
+    if(!ReadVarint(cursor, end, size) || size > (uint64_t)(end - cursor))
+        return false;
+    payload.data = cursor;
+    payload.size = (size_t)size;
+    cursor += size;
+    return true;
+}
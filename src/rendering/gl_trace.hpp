@@ -0,0 +1,320 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "gl_extensions.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+The binary format GLCapture writes and ModelViewerReplay reads.
+A trace starts with a header (magic, version, the size of the default framebuffer, the GL_RENDERER and GL_VERSION strings)
+followed by one record per call. A record is the op followed by its values as LEB128 varints (signed integers zigzagged,
+floats as their bits) and its payloads (buffer and texture data, shader sources) as a varint length and the bytes.
+The records are in three parts:
+- Everything up to WindowStart creates the objects and uploads the data the captured frames use, see GLCapture
+- WindowStart to RestoreEnd puts the state the first captured frame started with back, so it can be replayed before every loop
+- The captured frames, each one ending with FrameEnd
+*/
+
+// What the arguments of a call are, so that the replayer knows which ones name objects that have to be translated
+enum class GLTraceArg : unsigned char
+{
+    // Marks the end of the arguments
+    NONE = 0,
+    // The kinds of objects, in the order of GetObjectIndex()
+    BUFFER,
+    TEXTURE,
+    VERTEX_ARRAY,
+    FRAMEBUFFER,
+    RENDERBUFFER,
+    QUERY,
+    PROGRAM,
+    SHADER,
+    // Of the program given to the call, or the program in use if there's none
+    LOCATION,
+    // A pointer that's really an offset into a bound buffer (eg. the indirect commands of glMultiDrawArraysIndirect)
+    OFFSET,
+    // Something the call writes to, which doesn't get recorded
+    OUTPUT,
+    VALUE
+};
+static constexpr unsigned int NUM_OF_GL_OBJECT_TYPES = (unsigned int)GLTraceArg::SHADER - (unsigned int)GLTraceArg::BUFFER + 1;
+
+// What a call does to the state, which decides how it gets recorded before the captured frames start
+enum class GLTraceCategory : unsigned char
+{
+    // Binds something or sets a piece of fixed function state
+    STATE = 0,
+    // Uploads the value of a uniform of the program in use
+    UNIFORM,
+    // Creates, deletes or fills in an object
+    RESOURCE,
+    // Only draws, reads back or synchronizes, so it has no effect on the frames after it
+    FRAME,
+    // Part of the trace rather than a GL call
+    MARKER
+};
+
+// The calls that get recorded as their arguments and nothing else: the GL function, its category and the kind of every argument
+#define GL_TRACE_GENERIC_CALLS(X) \
+    X(ActiveTexture, glad_glActiveTexture, STATE, VALUE) \
+    X(AttachShader, glad_glAttachShader, RESOURCE, PROGRAM, SHADER) \
+    X(BeginQuery, glad_glBeginQuery, FRAME, VALUE, QUERY) \
+    X(BindBuffer, glad_glBindBuffer, STATE, VALUE, BUFFER) \
+    X(BindBufferBase, glad_glBindBufferBase, STATE, VALUE, VALUE, BUFFER) \
+    X(BindBufferRange, glad_glBindBufferRange, STATE, VALUE, VALUE, BUFFER, VALUE, VALUE) \
+    X(BindFramebuffer, glad_glBindFramebuffer, STATE, VALUE, FRAMEBUFFER) \
+    X(BindImageTexture, glad_glBindImageTexture, STATE, VALUE, TEXTURE, VALUE, VALUE, VALUE, VALUE, VALUE) \
+    X(BindRenderbuffer, glad_glBindRenderbuffer, STATE, VALUE, RENDERBUFFER) \
+    X(BindTexture, glad_glBindTexture, STATE, VALUE, TEXTURE) \
+    X(BindVertexArray, glad_glBindVertexArray, STATE, VERTEX_ARRAY) \
+    X(BlendFunc, glad_glBlendFunc, STATE, VALUE, VALUE) \
+    X(CheckFramebufferStatus, glad_glCheckFramebufferStatus, FRAME, VALUE) \
+    X(Clear, glad_glClear, FRAME, VALUE) \
+    X(ClearColor, glad_glClearColor, STATE, VALUE, VALUE, VALUE, VALUE) \
+    X(CompileShader, glad_glCompileShader, RESOURCE, SHADER) \
+    X(CopyBufferSubData, glad_glCopyBufferSubData, FRAME, VALUE, VALUE, VALUE, VALUE, VALUE) \
+    X(CopyTexSubImage2D, glad_glCopyTexSubImage2D, FRAME, VALUE, VALUE, VALUE, VALUE, VALUE, VALUE, VALUE, VALUE) \
+    X(CullFace, glad_glCullFace, STATE, VALUE) \
+    X(DeleteProgram, glad_glDeleteProgram, RESOURCE, PROGRAM) \
+    X(DeleteShader, glad_glDeleteShader, RESOURCE, SHADER) \
+    X(DepthFunc, glad_glDepthFunc, STATE, VALUE) \
+    X(DepthMask, glad_glDepthMask, STATE, VALUE) \
+    X(DetachShader, glad_glDetachShader, RESOURCE, PROGRAM, SHADER) \
+    X(Disable, glad_glDisable, STATE, VALUE) \
+    X(DispatchCompute, glad_glDispatchCompute, FRAME, VALUE, VALUE, VALUE) \
+    X(DrawArrays, glad_glDrawArrays, FRAME, VALUE, VALUE, VALUE) \
+    X(DrawArraysInstancedBaseInstance, glad_glDrawArraysInstancedBaseInstance, FRAME, VALUE, VALUE, VALUE, VALUE, VALUE) \
+    X(DrawElements, glad_glDrawElements, FRAME, VALUE, VALUE, VALUE, OFFSET) \
+    X(Enable, glad_glEnable, STATE, VALUE) \
+    X(EnableVertexAttribArray, glad_glEnableVertexAttribArray, RESOURCE, VALUE) \
+    X(EndQuery, glad_glEndQuery, FRAME, VALUE) \
+    X(Finish, glad_glFinish, FRAME) \
+    X(Flush, glad_glFlush, FRAME) \
+    X(FramebufferRenderbuffer, glad_glFramebufferRenderbuffer, RESOURCE, VALUE, VALUE, VALUE, RENDERBUFFER) \
+    X(GetBufferSubData, glad_glGetBufferSubData, FRAME, VALUE, VALUE, VALUE, OUTPUT) \
+    X(GetIntegerv, glad_glGetIntegerv, FRAME, VALUE, OUTPUT) \
+    X(GetProgramInfoLog, glad_glGetProgramInfoLog, FRAME, PROGRAM, VALUE, OUTPUT, OUTPUT) \
+    X(GetProgramiv, glad_glGetProgramiv, FRAME, PROGRAM, VALUE, OUTPUT) \
+    X(GetQueryObjectiv, glad_glGetQueryObjectiv, FRAME, QUERY, VALUE, OUTPUT) \
+    X(GetQueryObjectui64v, glad_glGetQueryObjectui64v, FRAME, QUERY, VALUE, OUTPUT) \
+    X(GetShaderInfoLog, glad_glGetShaderInfoLog, FRAME, SHADER, VALUE, OUTPUT, OUTPUT) \
+    X(GetShaderiv, glad_glGetShaderiv, FRAME, SHADER, VALUE, OUTPUT) \
+    X(GetUniformfv, glad_glGetUniformfv, FRAME, PROGRAM, LOCATION, OUTPUT) \
+    X(GetUniformiv, glad_glGetUniformiv, FRAME, PROGRAM, LOCATION, OUTPUT) \
+    X(GetUniformuiv, glad_glGetUniformuiv, FRAME, PROGRAM, LOCATION, OUTPUT) \
+    X(LinkProgram, glad_glLinkProgram, RESOURCE, PROGRAM) \
+    X(MaxShaderCompilerThreads, GLExtensions::glMaxShaderCompilerThreads, RESOURCE, VALUE) \
+    X(MemoryBarrier, glad_glMemoryBarrier, FRAME, VALUE) \
+    X(MultiDrawArraysIndirect, glad_glMultiDrawArraysIndirect, FRAME, VALUE, OFFSET, VALUE, VALUE) \
+    X(PixelStorei, glad_glPixelStorei, STATE, VALUE, VALUE) \
+    X(PolygonMode, glad_glPolygonMode, STATE, VALUE, VALUE) \
+    X(ReadPixels, glad_glReadPixels, FRAME, VALUE, VALUE, VALUE, VALUE, VALUE, VALUE, OUTPUT) \
+    X(RenderbufferStorage, glad_glRenderbufferStorage, RESOURCE, VALUE, VALUE, VALUE, VALUE) \
+    X(TexParameteri, glad_glTexParameteri, RESOURCE, VALUE, VALUE, VALUE) \
+    X(TexStorage2D, glad_glTexStorage2D, RESOURCE, VALUE, VALUE, VALUE, VALUE, VALUE) \
+    X(Uniform1f, glad_glUniform1f, UNIFORM, LOCATION, VALUE) \
+    X(Uniform1i, glad_glUniform1i, UNIFORM, LOCATION, VALUE) \
+    X(Uniform1ui, glad_glUniform1ui, UNIFORM, LOCATION, VALUE) \
+    X(Uniform2i, glad_glUniform2i, UNIFORM, LOCATION, VALUE, VALUE) \
+    X(UseProgram, glad_glUseProgram, STATE, PROGRAM) \
+    X(VertexAttribDivisor, glad_glVertexAttribDivisor, RESOURCE, VALUE, VALUE) \
+    X(VertexAttribIPointer, glad_glVertexAttribIPointer, RESOURCE, VALUE, VALUE, VALUE, VALUE, OFFSET) \
+    X(VertexAttribPointer, glad_glVertexAttribPointer, RESOURCE, VALUE, VALUE, VALUE, VALUE, VALUE, OFFSET) \
+    X(Viewport, glad_glViewport, STATE, VALUE, VALUE, VALUE, VALUE)
+
+/*
+The calls (and trace markers) that need more than their arguments, recorded by hand.
+The layout says what follows the op: v is a value, n a count followed by that many values,
+p a payload and P a count followed by that many payloads. The values are listed in the order they come in
+*/
+#define GL_TRACE_SPECIAL_CALLS(X) \
+    /* n, names */ \
+    X(GenBuffers, RESOURCE, "n") \
+    X(GenTextures, RESOURCE, "n") \
+    X(GenVertexArrays, RESOURCE, "n") \
+    X(GenFramebuffers, RESOURCE, "n") \
+    X(GenRenderbuffers, RESOURCE, "n") \
+    X(GenQueries, RESOURCE, "n") \
+    X(DeleteBuffers, RESOURCE, "n") \
+    X(DeleteTextures, RESOURCE, "n") \
+    X(DeleteVertexArrays, RESOURCE, "n") \
+    X(DeleteFramebuffers, RESOURCE, "n") \
+    X(DeleteRenderbuffers, RESOURCE, "n") \
+    X(DeleteQueries, RESOURCE, "n") \
+    /* type, shader */ \
+    X(CreateShader, RESOURCE, "vv") \
+    /* program */ \
+    X(CreateProgram, RESOURCE, "v") \
+    /* shader, count, the sources */ \
+    X(ShaderSource, RESOURCE, "vP") \
+    /* program, the location it returned, the null terminated name */ \
+    X(GetUniformLocation, RESOURCE, "vvp") \
+    /* target, the buffer bound to it, size, usage (flags for glBufferStorage), the data (empty if there was none) */ \
+    X(BufferData, RESOURCE, "vvvvp") \
+    X(BufferStorage, RESOURCE, "vvvvp") \
+    /* target, offset, the data */ \
+    X(BufferSubData, FRAME, "vvp") \
+    /* target, internal format, format, type, the value (empty if there was none) */ \
+    X(ClearBufferData, FRAME, "vvvvp") \
+    /* the 8 arguments before the pixels, whether they come from a pixel unpack buffer, the offset into it, the pixels */ \
+    X(TexImage2D, RESOURCE, "vvvvvvvvvvp") \
+    /* location, count, the values */ \
+    X(Uniform2fv, UNIFORM, "vvp") \
+    X(Uniform3fv, UNIFORM, "vvp") \
+    X(Uniform4fv, UNIFORM, "vvp") \
+    /* location, count, transpose, the values */ \
+    X(UniformMatrix2fv, UNIFORM, "vvvp") \
+    X(UniformMatrix3fv, UNIFORM, "vvvp") \
+    X(UniformMatrix4fv, UNIFORM, "vvvp") \
+    /* target, the buffer bound to it, offset, length, access */ \
+    X(MapBufferRange, RESOURCE, "vvvvv") \
+    /* target, the buffer bound to it */ \
+    X(UnmapBuffer, RESOURCE, "vv") \
+    /* condition, flags, the sync (numbered in the order they were made, 0 for the ones that weren't recorded) */ \
+    X(FenceSync, FRAME, "vvv") \
+    /* sync, flags, timeout */ \
+    X(ClientWaitSync, FRAME, "vvv") \
+    X(DeleteSync, FRAME, "v") \
+    X(FrameEnd, MARKER, "") \
+    X(WindowStart, MARKER, "") \
+    X(RestoreEnd, MARKER, "") \
+    /* the name of a profiler scope */ \
+    X(BeginMarker, MARKER, "p") \
+    X(EndMarker, MARKER, "") \
+    /* buffer, offset, the data. Written through a mapping (eg. of the streaming ring buffer) rather than a GL call */ \
+    X(BufferContents, MARKER, "vvp")
+
+enum class GLTraceOp : unsigned short
+{
+#define GL_TRACE_GENERIC_OP(name, function, category, ...) name,
+#define GL_TRACE_SPECIAL_OP(name, category, layout) name,
+    GL_TRACE_GENERIC_CALLS(GL_TRACE_GENERIC_OP)
+    GL_TRACE_SPECIAL_CALLS(GL_TRACE_SPECIAL_OP)
+#undef GL_TRACE_GENERIC_OP
+#undef GL_TRACE_SPECIAL_OP
+    COUNT
+};
+
+struct GLTraceOpInfo final
+{
+    static constexpr size_t MAX_ARGS = 8;
+
+    // The GL function, or the marker's name
+    const char *name;
+    GLTraceCategory category;
+    // Only the generic calls have their arguments listed, NONE past the last one
+    GLTraceArg args[MAX_ARGS];
+    // nullptr for the generic calls, which have a value for every argument that isn't an OUTPUT
+    const char *layout;
+};
+
+struct GLTracePayload final
+{
+    const void *data = nullptr;
+    size_t size = 0;
+};
+
+// A decoded record. The payloads point into the trace they were read from
+struct GLTraceCall final
+{
+    GLTraceOp op = GLTraceOp::COUNT;
+    std::vector<uint64_t> values;
+    std::vector<GLTracePayload> payloads;
+};
+
+struct GLTraceHeader final
+{
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::string renderer;
+    std::string version;
+};
+
+class GLTrace final
+{
+    public:
+    static constexpr char MAGIC[8] = { 'M', 'V', 'G', 'L', 'T', 'R', 'C', 'E' };
+    static constexpr unsigned int VERSION = 1;
+
+    private:
+    GLTrace() {}
+    ~GLTrace() {}
+
+    public:
+    static const GLTraceOpInfo &GetOpInfo(GLTraceOp op);
+    static bool IsObject(GLTraceArg arg) { return arg >= GLTraceArg::BUFFER && arg <= GLTraceArg::SHADER; }
+    // Index of the kind of object into a table of every kind
+    static unsigned int GetObjectIndex(GLTraceArg arg) { return (unsigned int)arg - (unsigned int)GLTraceArg::BUFFER; }
+
+    static void WriteHeader(std::vector<unsigned char> &out, const GLTraceHeader &header);
+    // Returns false if it isn't a trace or it's of another version
+    static bool ReadHeader(const unsigned char *&cursor, const unsigned char *end, GLTraceHeader &header);
+    // The values are in the order of the op's layout, for the generic calls one for every argument that isn't an OUTPUT
+    static void WriteCall(std::vector<unsigned char> &out, GLTraceOp op, const uint64_t *values, size_t numOfValues,
+                          const GLTracePayload *payloads = nullptr, size_t numOfPayloads = 0);
+    // Returns false at the end of the trace or if the record is cut off
+    static bool ReadCall(const unsigned char *&cursor, const unsigned char *end, GLTraceCall &call);
+
+    // Bytes per pixel of the format and type, 0 for the combinations the renderer doesn't use
+    static size_t GetPixelSize(GLenum format, GLenum type);
+    // Size of a glTexImage2D/glReadPixels image with rows aligned to the pack or unpack alignment
+    static size_t GetImageSize(int width, int height, GLenum format, GLenum type, int alignment);
+
+    // Every value is stored as 64 bits, the signed ones zigzagged so that small negative values stay small as varints
+    template<typename T> static uint64_t EncodeValue(T value)
+    {
+        if constexpr(std::is_pointer_v<T>)
+            return (uint64_t)(uintptr_t)value;
+        else if constexpr(std::is_same_v<T, float>)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        else if constexpr(std::is_same_v<T, double>)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        else if constexpr(std::is_signed_v<T>)
+            return ((uint64_t)(int64_t)value << 1) ^ (uint64_t)((int64_t)value >> 63);
+        else
+            return (uint64_t)value;
+    }
+    template<typename T> static T DecodeValue(uint64_t value)
+    {
+        if constexpr(std::is_pointer_v<T>)
+            return (T)(uintptr_t)value;
+        else if constexpr(std::is_same_v<T, float>)
+        {
+            const uint32_t bits = (uint32_t)value;
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+        else if constexpr(std::is_same_v<T, double>)
+        {
+            double result;
+            std::memcpy(&result, &value, sizeof(result));
+            return result;
+        }
+        else if constexpr(std::is_signed_v<T>)
+            return (T)(int64_t)((value >> 1) ^ (~(value & 1) + 1));
+        else
+            return (T)value;
+    }
+
+    private:
+    static void WriteVarint(std::vector<unsigned char> &out, uint64_t value);
+    static bool ReadVarint(const unsigned char *&cursor, const unsigned char *end, uint64_t &value);
+    static void WritePayload(std::vector<unsigned char> &out, const GLTracePayload &payload);
+    static bool ReadPayload(const unsigned char *&cursor, const unsigned char *end, GLTracePayload &payload);
+};
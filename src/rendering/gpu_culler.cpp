@@ -0,0 +1,283 @@
+#include "gpu_culler.hpp"
+
+#include "core/log.hpp"
+#include "gl_state.hpp"
+#include "render_counters.hpp"
+#include "shader_preprocessor.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool GPUCuller::Init(const std::string &shaderDirectory)
+{
+    _cullProgram = CompileComputeProgram(shaderDirectory + "cull.cs");
+    _pyramidProgram = CompileComputeProgram(shaderDirectory + "hiz.cs");
+    if(_cullProgram == 0 || _pyramidProgram == 0)
+    {
+        DeInit();
+        return false;
+    }
+
+    GL_CALL(glad_glGenBuffers(1, &_candidateBuffer));
+    GL_CALL(glad_glGenBuffers(1, &_counterBuffer));
+    GL_CALL(glad_glGenBuffers(1, &_cullStateBuffer));
+    GL_CALL(glad_glGenBuffers(NUM_OF_READBACK_BUFFERS, _readbackBuffers));
+
+    GLState &glState = GLState::getInstance();
+    for(unsigned int buffer: _readbackBuffers)
+    {
+        glState.BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        GL_CALL(glad_glBufferData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * NUM_OF_STAT_COUNTERS, nullptr, GL_STREAM_READ));
+    }
+    return true;
+}
+
+void GPUCuller::DeInit()
+{
+    GLState &glState = GLState::getInstance();
+
+    for(GLsync &fence: _readbackFences)
+    {
+        if(fence != nullptr)
+        {
+            GL_CALL(glad_glDeleteSync(fence));
+        }
+        fence = nullptr;
+    }
+
+    unsigned int buffers[] = { _candidateBuffer, _counterBuffer, _cullStateBuffer };
+    for(unsigned int buffer: buffers)
+    {
+        GL_CALL(glad_glDeleteBuffers(1, &buffer));
+        glState.OnBufferDeleted(buffer);
+    }
+    for(unsigned int buffer: _readbackBuffers)
+    {
+        GL_CALL(glad_glDeleteBuffers(1, &buffer));
+        glState.OnBufferDeleted(buffer);
+    }
+    unsigned int textures[] = { _depthTexture, _depthPyramid };
+    for(unsigned int texture: textures)
+    {
+        GL_CALL(glad_glDeleteTextures(1, &texture));
+        glState.OnTextureDeleted(texture);
+    }
+    unsigned int programs[] = { _cullProgram, _pyramidProgram };
+    for(unsigned int program: programs)
+    {
+        GL_CALL(glad_glDeleteProgram(program));
+        glState.OnProgramDeleted(program);
+    }
+
+    _cullProgram = _pyramidProgram = 0;
+    _candidateBuffer = _counterBuffer = _cullStateBuffer = 0;
+    _candidateCapacity = _counterCapacity = _cullStateCapacity = 0;
+    std::fill(std::begin(_readbackBuffers), std::end(_readbackBuffers), 0);
+    _depthTexture = _depthPyramid = 0;
+    _depthWidth = _depthHeight = _numOfPyramidLevels = 0;
+    _hasDepthPyramid = false;
+    _stats = GPUCullStats();
+}
+
+void GPUCuller::Cull(const std::vector<GPUCullCandidate> &candidates, unsigned int numOfBatchCounters, size_t numOfInstances,
+                     const Frustum &frustum, unsigned int commandBuffer, bool occlusionCulling, bool drawCulled)
+{
+    GLState &glState = GLState::getInstance();
+    const size_t numOfCounters = NUM_OF_STAT_COUNTERS + numOfBatchCounters;
+
+    ReserveBuffer(GL_SHADER_STORAGE_BUFFER, _candidateBuffer, sizeof(GPUCullCandidate) * candidates.size(), _candidateCapacity);
+    GL_CALL(glad_glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GPUCullCandidate) * candidates.size(), (void*)candidates.data()));
+    RenderCounters::getInstance().CountBufferUpload(sizeof(GPUCullCandidate) * candidates.size());
+    // Clearing with no data fills the buffers with zeros
+    ReserveBuffer(GL_SHADER_STORAGE_BUFFER, _counterBuffer, sizeof(unsigned int) * numOfCounters, _counterCapacity);
+    GL_CALL(glad_glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr));
+    ReserveBuffer(GL_SHADER_STORAGE_BUFFER, _cullStateBuffer, sizeof(unsigned int) * numOfInstances, _cullStateCapacity);
+    glState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    GL_CALL(glad_glClearBufferData(GL_DRAW_INDIRECT_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr));
+
+    glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_STATES_BINDING, _cullStateBuffer);
+    glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, CANDIDATES_BINDING, _candidateBuffer);
+    glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commandBuffer);
+    glState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTERS_BINDING, _counterBuffer);
+
+    glState.UseProgram(_cullProgram);
+    occlusionCulling = occlusionCulling && _hasDepthPyramid;
+    GL_CALL(glad_glUniform4fv(glad_glGetUniformLocation(_cullProgram, "u_FrustumPlanes"), 6, &frustum.planes[0].x));
+    GL_CALL(glad_glUniformMatrix4fv(glad_glGetUniformLocation(_cullProgram, "u_OcclusionViewProjection"), 1, GL_FALSE, &_pyramidViewProjection[0].x));
+    GL_CALL(glad_glUniform1i(glad_glGetUniformLocation(_cullProgram, "u_NumOfPyramidLevels"), _numOfPyramidLevels));
+    GL_CALL(glad_glUniform1ui(glad_glGetUniformLocation(_cullProgram, "u_NumOfCandidates"), (unsigned int)candidates.size()));
+    GL_CALL(glad_glUniform1i(glad_glGetUniformLocation(_cullProgram, "u_OcclusionCulling"), occlusionCulling));
+    GL_CALL(glad_glUniform1i(glad_glGetUniformLocation(_cullProgram, "u_DrawCulled"), drawCulled));
+    RenderCounters::getInstance().CountUniformUploads(6);
+    if(occlusionCulling)
+        glState.BindTextureToUnit(0, GL_TEXTURE_2D, _depthPyramid);
+
+    const unsigned int numOfWorkgroups = ((unsigned int)candidates.size() + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+    GL_CALL(glad_glDispatchCompute(numOfWorkgroups, 1, 1));
+    // The commands are read by the draws, the cull states by the vertex shader and the counters by the copy below
+    GL_CALL(glad_glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT));
+
+    // If the GPU is so far behind that the oldest copy still hasn't arrived, its result is dropped
+    const unsigned int slot = _frameIndex % NUM_OF_READBACK_BUFFERS;
+    if(_readbackFences[slot] != nullptr)
+    {
+        GL_CALL(glad_glDeleteSync(_readbackFences[slot]));
+    }
+    glState.BindBuffer(GL_COPY_READ_BUFFER, _counterBuffer);
+    glState.BindBuffer(GL_COPY_WRITE_BUFFER, _readbackBuffers[slot]);
+    GL_CALL(glad_glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(unsigned int) * NUM_OF_STAT_COUNTERS));
+    _readbackFences[slot] = GL_CALL(glad_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    _readbackFrames[slot] = _frameIndex;
+    _frameIndex++;
+}
+
+void GPUCuller::BuildDepthPyramid(const glm::mat4 &viewProjection, int width, int height)
+{
+    // Nothing to copy while the window is minimized
+    if(width <= 0 || height <= 0)
+        return;
+    if(width != _depthWidth || height != _depthHeight)
+        ResizeDepthTextures(width, height);
+
+    GLState &glState = GLState::getInstance();
+
+    // Reads the depth buffer of the framebuffer bound for reading, which is the window's
+    glState.BindTextureToUnit(0, GL_TEXTURE_2D, _depthTexture);
+    GL_CALL(glad_glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height));
+
+    glState.UseProgram(_pyramidProgram);
+    const int destinationSizeLocation = GL_CALL(glad_glGetUniformLocation(_pyramidProgram, "u_DestinationSize"));
+    const int sourceLevelLocation = GL_CALL(glad_glGetUniformLocation(_pyramidProgram, "u_SourceLevel"));
+
+    // The first level is half the size of the depth buffer, every level after it half the size of the one before
+    unsigned int source = _depthTexture;
+    int sourceLevel = 0;
+    for(int level = 0; level < _numOfPyramidLevels; level++)
+    {
+        const int levelWidth = std::max(1, (width / 2) >> level);
+        const int levelHeight = std::max(1, (height / 2) >> level);
+
+        glState.BindTextureToUnit(0, GL_TEXTURE_2D, source);
+        GL_CALL(glad_glBindImageTexture(0, _depthPyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F));
+        GL_CALL(glad_glUniform2i(destinationSizeLocation, levelWidth, levelHeight));
+        GL_CALL(glad_glUniform1i(sourceLevelLocation, sourceLevel));
+        RenderCounters::getInstance().CountUniformUploads(2);
+        GL_CALL(glad_glDispatchCompute((levelWidth + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, (levelHeight + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, 1));
+        // The next level and the cull pass fetch from the level that was just written
+        GL_CALL(glad_glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT));
+
+        source = _depthPyramid;
+        sourceLevel = level;
+    }
+
+    _pyramidViewProjection = viewProjection;
+    _hasDepthPyramid = true;
+}
+
+void GPUCuller::ReadBackStats()
+{
+    GLState &glState = GLState::getInstance();
+
+    // Oldest first, so that the newest result that has arrived is the one that's kept.
+    // The fences signal in order, so once one hasn't the ones after it haven't either
+    for(unsigned int i = 0; i < NUM_OF_READBACK_BUFFERS; i++)
+    {
+        const unsigned int slot = (_frameIndex + i) % NUM_OF_READBACK_BUFFERS;
+        if(_readbackFences[slot] == nullptr)
+            continue;
+
+        const GLenum result = GL_CALL(glad_glClientWaitSync(_readbackFences[slot], 0, 0));
+        if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            break;
+
+        unsigned int counters[NUM_OF_STAT_COUNTERS];
+        glState.BindBuffer(GL_COPY_READ_BUFFER, _readbackBuffers[slot]);
+        GL_CALL(glad_glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(counters), counters));
+        GL_CALL(glad_glDeleteSync(_readbackFences[slot]));
+        _readbackFences[slot] = nullptr;
+
+        _stats.numOfVisible = counters[0];
+        _stats.numOfFrustumCulled = counters[1];
+        _stats.numOfOcclusionCulled = counters[2];
+        _stats.latency = _frameIndex - _readbackFrames[slot];
+    }
+}
+
+void GPUCuller::ResizeDepthTextures(int width, int height)
+{
+    GLState &glState = GLState::getInstance();
+    unsigned int textures[] = { _depthTexture, _depthPyramid };
+    for(unsigned int texture: textures)
+    {
+        GL_CALL(glad_glDeleteTextures(1, &texture));
+        glState.OnTextureDeleted(texture);
+    }
+
+    const int pyramidWidth = std::max(1, width / 2);
+    const int pyramidHeight = std::max(1, height / 2);
+    _numOfPyramidLevels = (int)std::floor(std::log2((float)std::max(pyramidWidth, pyramidHeight))) + 1;
+
+    GL_CALL(glad_glGenTextures(1, &_depthTexture));
+    glState.BindTextureToUnit(0, GL_TEXTURE_2D, _depthTexture);
+    GL_CALL(glad_glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height));
+    GL_CALL(glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
+    GL_CALL(glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+
+    GL_CALL(glad_glGenTextures(1, &_depthPyramid));
+    glState.BindTextureToUnit(0, GL_TEXTURE_2D, _depthPyramid);
+    GL_CALL(glad_glTexStorage2D(GL_TEXTURE_2D, _numOfPyramidLevels, GL_R32F, pyramidWidth, pyramidHeight));
+    GL_CALL(glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST));
+    GL_CALL(glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+
+    _depthWidth = width;
+    _depthHeight = height;
+    _hasDepthPyramid = false;
+}
+
+void GPUCuller::ReserveBuffer(unsigned int target, unsigned int buffer, size_t size, size_t &capacity)
+{
+    // Reallocated every time, which orphans the old storage so the driver doesn't wait for last frame's dispatch to finish with it
+    capacity = std::max(capacity, size);
+    GLState::getInstance().BindBuffer(target, buffer);
+    GL_CALL(glad_glBufferData(target, capacity, nullptr, GL_STREAM_DRAW));
+}
+
+unsigned int GPUCuller::CompileComputeProgram(const std::string &path)
+{
+    PreprocessedShader preprocessed = ShaderPreprocessor::ProcessFile(path);
+    if(!preprocessed.success)
+    {
+        Log::LogError("Failed to preprocess compute shader '" + path + "'");
+        return 0;
+    }
+
+    int success;
+    char infoLog[512];
+
+    const unsigned int shader = GL_CALL(glad_glCreateShader(GL_COMPUTE_SHADER));
+    const char *source = preprocessed.source.c_str();
+    GL_CALL(glad_glShaderSource(shader, 1, &source, nullptr));
+    GL_CALL(glad_glCompileShader(shader));
+    GL_CALL(glad_glGetShaderiv(shader, GL_COMPILE_STATUS, &success));
+    if(!success)
+    {
+        GL_CALL(glad_glGetShaderInfoLog(shader, 512, NULL, infoLog));
+        Log::LogError("Compute shader '" + path + "' error: " + std::string(infoLog));
+        GL_CALL(glad_glDeleteShader(shader));
+        return 0;
+    }
+
+    const unsigned int program = GL_CALL(glad_glCreateProgram());
+    GL_CALL(glad_glAttachShader(program, shader));
+    GL_CALL(glad_glLinkProgram(program));
+    GL_CALL(glad_glDeleteShader(shader));
+    GL_CALL(glad_glGetProgramiv(program, GL_LINK_STATUS, &success));
+    if(!success)
+    {
+        GL_CALL(glad_glGetProgramInfoLog(program, 512, NULL, infoLog));
+        Log::LogError("Compute shader '" + path + "' link error: " + std::string(infoLog));
+        GL_CALL(glad_glDeleteProgram(program));
+        return 0;
+    }
+    return program;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "misc/bounds.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// One draw the culling pass decides on, laid out the way the compute shader reads it
+struct GPUCullCandidate final
+{
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+    // The draw's vertices in the geometry pool and its index in the instance buffer
+    unsigned int count;
+    unsigned int first;
+    unsigned int instance;
+    // Where the candidate's batch starts in the command buffer and which counter compacts it
+    unsigned int outputBase;
+    unsigned int counter;
+    unsigned int padding[3];
+};
+
+// What the culling pass decided on, as of the newest frame whose counters have been read back
+struct GPUCullStats final
+{
+    unsigned int numOfVisible = 0;
+    unsigned int numOfFrustumCulled = 0;
+    unsigned int numOfOcclusionCulled = 0;
+    // How many frames old the counters were by the time they got read
+    unsigned int latency = 0;
+};
+
+/*
+Frustum and occlusion culls the multi draw candidates in a compute shader and writes the draws of the ones that survive
+straight into the indirect command buffer, so the CPU never has to look at them.
+The occlusion test runs against a depth pyramid built from the previous frame's depth buffer, where every texel
+holds the farthest depth under it. A box is occluded if its nearest depth is behind the farthest depth of the texels it covers.
+The counters of how many candidates got culled are copied into a ring of buffers and only read once their fence has passed,
+so reading them never waits on the GPU.
+*/
+class GPUCuller final
+{
+    public:
+    static constexpr unsigned int CULL_WORKGROUP_SIZE = 64;
+    static constexpr unsigned int PYRAMID_WORKGROUP_SIZE = 8;
+    // Visible, frustum culled and occlusion culled, followed by the per batch counters
+    static constexpr unsigned int NUM_OF_STAT_COUNTERS = 3;
+    static constexpr unsigned int NUM_OF_READBACK_BUFFERS = 3;
+    // Storage buffer bindings, the cull states binding is shared with the vertex shader that shows them
+    static constexpr unsigned int CULL_STATES_BINDING = 1;
+    static constexpr unsigned int CANDIDATES_BINDING = 2;
+    static constexpr unsigned int COMMANDS_BINDING = 3;
+    static constexpr unsigned int COUNTERS_BINDING = 4;
+
+    private:
+    unsigned int _cullProgram = 0;
+    unsigned int _pyramidProgram = 0;
+
+    unsigned int _candidateBuffer = 0;
+    size_t _candidateCapacity = 0;
+    unsigned int _counterBuffer = 0;
+    size_t _counterCapacity = 0;
+    unsigned int _cullStateBuffer = 0;
+    size_t _cullStateCapacity = 0;
+
+    // The previous frame's depth buffer and the pyramid built from it
+    unsigned int _depthTexture = 0;
+    unsigned int _depthPyramid = 0;
+    int _depthWidth = 0, _depthHeight = 0;
+    int _numOfPyramidLevels = 0;
+    bool _hasDepthPyramid = false;
+    glm::mat4 _pyramidViewProjection = glm::mat4(1.0f);
+
+    unsigned int _readbackBuffers[NUM_OF_READBACK_BUFFERS] = {};
+    GLsync _readbackFences[NUM_OF_READBACK_BUFFERS] = {};
+    unsigned int _readbackFrames[NUM_OF_READBACK_BUFFERS] = {};
+    unsigned int _frameIndex = 0;
+    GPUCullStats _stats;
+
+    public:
+    // Returns false if the compute shaders failed to compile
+    bool Init(const std::string &shaderDirectory);
+    void DeInit();
+
+    // Tests the candidates and writes the draws of the ones that survive to commandBuffer, which has to fit one command per candidate.
+    // The survivors of each counter are packed at the start of their batch's range, the rest of the range is zeroed so it draws nothing
+    void Cull(const std::vector<GPUCullCandidate> &candidates, unsigned int numOfBatchCounters, size_t numOfInstances,
+              const Frustum &frustum, unsigned int commandBuffer, bool occlusionCulling, bool drawCulled);
+    // Copies the depth buffer of the frame that was just drawn and builds the pyramid the next frame's occlusion test reads
+    void BuildDepthPyramid(const glm::mat4 &viewProjection, int width, int height);
+    // Picks up the counters of the newest cull whose results have arrived, without waiting on the GPU
+    void ReadBackStats();
+
+    inline const GPUCullStats &getStats() const { return _stats; }
+    inline unsigned int getCullStateBuffer() const { return _cullStateBuffer; }
+    inline bool hasDepthPyramid() const { return _hasDepthPyramid; }
+
+    private:
+    void ResizeDepthTextures(int width, int height);
+    void ReserveBuffer(unsigned int target, unsigned int buffer, size_t size, size_t &capacity);
+    static unsigned int CompileComputeProgram(const std::string &path);
+};
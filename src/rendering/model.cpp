@@ -2,53 +2,67 @@
 
 #include <glad/glad.h>
 
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
 #include "core/log.hpp"
+#include "gl_state.hpp"
+#include "geometry_pool.hpp"
+#include "render_counters.hpp"
 
 Model::Model()
     : _VAO(0), _VBO(0), _EBO(0){}
 Model::Model(const std::vector<Vertex> &vertices)
     : _vertices(vertices)
 {
+    if(!_vertices.empty())
+    {
+        _bounds = { _vertices[0].position, _vertices[0].position };
+        for(const Vertex &vertex: _vertices)
+        {
+            _bounds.min = glm::min(_bounds.min, vertex.position);
+            _bounds.max = glm::max(_bounds.max, vertex.position);
+        }
+    }
+
     GL_CALL(glad_glGenVertexArrays(1, &_VAO));
     GL_CALL(glad_glGenBuffers(1, &_VBO));
     GL_CALL(glad_glGenBuffers(1, &_EBO));
 
-    GL_CALL(glad_glBindVertexArray(_VAO));
+    GLState &glState = GLState::getInstance();
+    glState.BindVertexArray(_VAO);
 
-    GL_CALL(glad_glBindBuffer(GL_ARRAY_BUFFER, _VBO));
+    glState.BindBuffer(GL_ARRAY_BUFFER, _VBO);
     // The size of the data must be written out like this because just doing _vertices.size()
     // returns the amount of elements rather than the size of the data itself 
     GL_CALL(glad_glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * _vertices.size(), (void*)_vertices.data(), GL_STATIC_DRAW));
+    RenderCounters::getInstance().CountBufferUpload(sizeof(Vertex) * _vertices.size());
 
     // GL_CALL(glad_glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO));
     // GL_CALL(glad_glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW));
 
-    /*
-                        Vertex format:
-            Position     Tex coords       Normal
-        vx   vy   vz   \   u   v   \   nx   ny   nz
-    */
-    // Vertex position
-    GL_CALL(glad_glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec3), (void*)0));
-    GL_CALL(glad_glEnableVertexAttribArray(0));
-    // UV coords
-    GL_CALL(glad_glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(glm::vec2) + sizeof(glm::vec3) + sizeof(glm::vec3), (void*)(sizeof(glm::vec3))));
-    GL_CALL(glad_glEnableVertexAttribArray(1));
-    // Normals
-    GL_CALL(glad_glVertexAttribPointer(2, 3, GL_FLOAT, false, sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec2), (void*)(sizeof(glm::vec3) + sizeof(glm::vec2))));
-    GL_CALL(glad_glEnableVertexAttribArray(2));
-
-
-    GL_CALL(glad_glBindVertexArray(0));
-    GL_CALL(glad_glBindBuffer(GL_ARRAY_BUFFER, 0));
+    const VertexLayout &layout = GetVertexLayout();
+    for(const VertexAttribute &attribute: layout.attributes)
+    {
+        GL_CALL(glad_glVertexAttribPointer(attribute.location, attribute.numOfComponents, attribute.type, attribute.normalized, layout.stride, (void*)(size_t)attribute.offset));
+        GL_CALL(glad_glEnableVertexAttribArray(attribute.location));
+    }
+
+
+    glState.BindVertexArray(0);
+    glState.BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 Model::~Model()
 {
-    GL_CALL(glad_glBindVertexArray(0));
-
     GL_CALL(glad_glDeleteBuffers(1, &_EBO));
     GL_CALL(glad_glDeleteBuffers(1, &_VBO));
     GL_CALL(glad_glDeleteVertexArrays(1, &_VAO));
+
+    GLState &glState = GLState::getInstance();
+    glState.OnBufferDeleted(_EBO);
+    glState.OnBufferDeleted(_VBO);
+    glState.OnVertexArrayDeleted(_VAO);
+    GeometryPool::getInstance().OnModelDeleted(this);
 }
 Model::Model(const Model &other)
 {
@@ -58,6 +72,8 @@ Model::Model(const Model &other)
         this->_VBO = other._VBO;
         this->_EBO = other._EBO;
         this->_vertices = other._vertices;
+        this->_instanceBuffer = other._instanceBuffer;
+        this->_bounds = other._bounds;
     }
 }
 Model &Model::operator=(const Model &other)
@@ -68,6 +84,8 @@ Model &Model::operator=(const Model &other)
         this->_VBO = other._VBO;
         this->_EBO = other._EBO;
         this->_vertices = other._vertices;
+        this->_instanceBuffer = other._instanceBuffer;
+        this->_bounds = other._bounds;
     }
     return *this;
 }
@@ -79,6 +97,8 @@ Model::Model(Model &&other)
         this->_VBO = std::move(other._VBO);
         this->_EBO = std::move(other._EBO);
         this->_vertices = std::move(other._vertices);
+        this->_instanceBuffer = other._instanceBuffer;
+        this->_bounds = other._bounds;
     }
 }
 Model &Model::operator=(Model &&other)
@@ -89,16 +109,62 @@ Model &Model::operator=(Model &&other)
         this->_VBO = std::move(other._VBO);
         this->_EBO = std::move(other._EBO);
         this->_vertices = std::move(other._vertices);
+        this->_instanceBuffer = other._instanceBuffer;
+        this->_bounds = other._bounds;
     }
     return *this;
 }
 
 
+const VertexLayout &Model::GetVertexLayout()
+{
+    /*
+                        Vertex format:
+            Position     Tex coords       Normal
+        vx   vy   vz   \   u   v   \   nx   ny   nz
+    */
+    static const VertexLayout layout = 
+    {
+        sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec3),
+        {
+            // Vertex position
+            { 0, 3, GL_FLOAT, false, 0 },
+            // UV coords
+            { 1, 2, GL_FLOAT, false, sizeof(glm::vec3) },
+            // Normals
+            { 2, 3, GL_FLOAT, false, sizeof(glm::vec3) + sizeof(glm::vec2) }
+        }
+    };
+    return layout;
+}
+
+void Model::SetInstanceBuffer(unsigned int instanceBuffer)
+{
+    if(_VAO == 0 || _instanceBuffer == instanceBuffer)
+        return;
+    _instanceBuffer = instanceBuffer;
+
+    GLState &glState = GLState::getInstance();
+    glState.BindVertexArray(_VAO);
+    glState.BindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+
+    // A mat4 attribute is fed as 4 vec4 columns, each advancing once per instance rather than per vertex
+    for(unsigned int column = 0; column < 4; column++)
+    {
+        const unsigned int location = INSTANCE_MATRIX_LOCATION + column;
+        GL_CALL(glad_glVertexAttribPointer(location, 4, GL_FLOAT, false, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * column)));
+        GL_CALL(glad_glEnableVertexAttribArray(location));
+        GL_CALL(glad_glVertexAttribDivisor(location, 1));
+    }
+}
+
 void Model::Bind() const
 {
-    GL_CALL(glad_glBindVertexArray(_VAO));
+    GLState::getInstance().BindVertexArray(_VAO);
 }
 void Model::Unbind() const
 {
-    GL_CALL(glad_glBindVertexArray(0));
+#ifdef GL_STATE_VALIDATION
+    GLState::getInstance().BindVertexArray(0);
+#endif
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include <glm/vec2.hpp> 
 #include <glm/vec3.hpp> 
 
+#include "misc/bounds.hpp"
+
 #include <vector>
 #include <array>
 
@@ -68,11 +70,35 @@ struct Vertex final
     }
 };
 
+struct VertexAttribute final
+{
+    unsigned int location;
+    int numOfComponents;
+    unsigned int type;
+    bool normalized;
+    unsigned int offset;
+};
+
+// How the vertex data of a buffer is laid out, used to set up the VAOs
+struct VertexLayout final
+{
+    unsigned int stride = 0;
+    std::vector<VertexAttribute> attributes;
+};
+
 class Model
 {
+   public:
+   // Where the per-instance model matrix starts, it takes up this location and the 3 after it (one per column)
+   static constexpr unsigned int INSTANCE_MATRIX_LOCATION = 3;
+
    protected:
    unsigned int _VAO, _VBO, _EBO;
+   // The buffer the VAO's per-instance attributes read from, 0 until the model gets drawn instanced
+   unsigned int _instanceBuffer = 0;
    std::vector<Vertex> _vertices;
+   // Bounds of the vertices in model space
+   AABB _bounds;
 
    public:
    Model();
@@ -88,6 +114,12 @@ class Model
    inline const unsigned int &getVBO() const { return _VBO; }
    inline const unsigned int &getEBO() const { return _EBO; }
    inline const std::vector<Vertex> &getVertices() const { return _vertices; }
+   inline const AABB &getBounds() const { return _bounds; }
+   // The layout of the Vertex struct every model's vertex buffer is made of
+   static const VertexLayout &GetVertexLayout();
+
+   // Points the VAO's per-instance model matrix attribute at the given buffer of glm::mat4s
+   void SetInstanceBuffer(unsigned int instanceBuffer);
 
    void Bind() const;
    void Unbind() const;
@@ -0,0 +1,188 @@
+#include "pipeline_state.hpp"
+
+#include "gl_state.hpp"
+#include "misc/utils.hpp"
+
+size_t PipelineStateDesc::GetHash() const
+{
+    size_t hash = 0;
+    HashCombine(hash, program);
+
+    HashCombine(hash, raster.polygonMode);
+    HashCombine(hash, raster.cullingEnabled);
+    HashCombine(hash, raster.cullFace);
+    HashCombine(hash, depth.testEnabled);
+    HashCombine(hash, depth.writeEnabled);
+    HashCombine(hash, depth.func);
+    HashCombine(hash, blend.enabled);
+    HashCombine(hash, blend.srcFactor);
+    HashCombine(hash, blend.dstFactor);
+
+    for(unsigned int target: textureTargets)
+        HashCombine(hash, target);
+    return hash;
+}
+bool PipelineStateDesc::operator==(const PipelineStateDesc &other) const
+{
+    return program == other.program
+        && raster.polygonMode == other.raster.polygonMode && raster.cullingEnabled == other.raster.cullingEnabled && raster.cullFace == other.raster.cullFace
+        && depth.testEnabled == other.depth.testEnabled && depth.writeEnabled == other.depth.writeEnabled && depth.func == other.depth.func
+        && blend.enabled == other.blend.enabled && blend.srcFactor == other.blend.srcFactor && blend.dstFactor == other.blend.dstFactor
+        && textureTargets == other.textureTargets;
+}
+
+PipelineState::PipelineState(const PipelineStateDesc &desc, size_t hash)
+    : _desc(desc), _hash(hash)
+{
+    _fullCommands = PipelineStateCache::BuildCommands(nullptr, _desc);
+}
+
+size_t PipelineStateCache::TransitionKeyHash::operator()(const std::pair<const PipelineState*, const PipelineState*> &key) const
+{
+    size_t hash = 0;
+    HashCombine(hash, key.first);
+    HashCombine(hash, key.second);
+    return hash;
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+    Clear();
+}
+
+const PipelineState *PipelineStateCache::Get(const PipelineStateDesc &desc)
+{
+    const size_t hash = desc.GetHash();
+    std::vector<PipelineState*> &bucket = _states[hash];
+    for(const PipelineState *state: bucket)
+    {
+        if(state->_desc == desc)
+            return state;
+    }
+
+    PipelineState *state = new PipelineState(desc, hash);
+    bucket.push_back(state);
+    _numOfStates++;
+    return state;
+}
+
+void PipelineStateCache::Apply(const PipelineState *state)
+{
+    if(state == nullptr || state == _lastApplied)
+    {
+        _numOfCommandsLastApply = 0;
+        return;
+    }
+
+    if(_lastApplied == nullptr)
+    {
+        ExecuteCommands(state->_fullCommands);
+        _numOfCommandsLastApply = state->_fullCommands.size();
+    }
+    else
+    {
+        auto transition = _transitions.find({_lastApplied, state});
+        if(transition == _transitions.end())
+            transition = _transitions.emplace(std::make_pair(_lastApplied, state), BuildCommands(&_lastApplied->_desc, state->_desc)).first;
+
+        ExecuteCommands(transition->second);
+        _numOfCommandsLastApply = transition->second.size();
+    }
+
+    _lastApplied = state;
+}
+
+void PipelineStateCache::InvalidateApplied()
+{
+    _lastApplied = nullptr;
+}
+
+void PipelineStateCache::OnProgramDeleted(unsigned int program)
+{
+    // The states themselves stay valid, they only describe which program to use.
+    // The program's name can be reused by a new program though, which has to be made current again
+    if(_lastApplied != nullptr && _lastApplied->_desc.program == program)
+        _lastApplied = nullptr;
+}
+
+void PipelineStateCache::Clear()
+{
+    for(auto &bucket: _states)
+    {
+        for(PipelineState *state: bucket.second)
+            delete state;
+    }
+    _states.clear();
+    _transitions.clear();
+    _numOfStates = 0;
+    _lastApplied = nullptr;
+}
+
+std::vector<PipelineCommand> PipelineStateCache::BuildCommands(const PipelineStateDesc *from, const PipelineStateDesc &to)
+{
+    std::vector<PipelineCommand> commands;
+    auto capability = [&](unsigned int capability, bool fromEnabled, bool toEnabled)
+    {
+        if(from == nullptr || fromEnabled != toEnabled)
+            commands.push_back({ toEnabled ? PipelineCommandType::ENABLE : PipelineCommandType::DISABLE, { capability, 0 } });
+    };
+
+    if(from == nullptr || from->program != to.program)
+        commands.push_back({ PipelineCommandType::USE_PROGRAM, { to.program, 0 } });
+
+    // The vertex layout lives in each model's VAO, which gets bound per draw
+    if(from == nullptr || from->raster.polygonMode != to.raster.polygonMode)
+        commands.push_back({ PipelineCommandType::POLYGON_MODE, { to.raster.polygonMode, 0 } });
+    capability(GL_CULL_FACE, from != nullptr && from->raster.cullingEnabled, to.raster.cullingEnabled);
+    if(to.raster.cullingEnabled && (from == nullptr || from->raster.cullFace != to.raster.cullFace))
+        commands.push_back({ PipelineCommandType::CULL_FACE, { to.raster.cullFace, 0 } });
+
+    capability(GL_DEPTH_TEST, from != nullptr && from->depth.testEnabled, to.depth.testEnabled);
+    if(from == nullptr || from->depth.writeEnabled != to.depth.writeEnabled)
+        commands.push_back({ PipelineCommandType::DEPTH_MASK, { to.depth.writeEnabled, 0 } });
+    if(to.depth.testEnabled && (from == nullptr || from->depth.func != to.depth.func))
+        commands.push_back({ PipelineCommandType::DEPTH_FUNC, { to.depth.func, 0 } });
+
+    capability(GL_BLEND, from != nullptr && from->blend.enabled, to.blend.enabled);
+    if(to.blend.enabled && (from == nullptr || from->blend.srcFactor != to.blend.srcFactor || from->blend.dstFactor != to.blend.dstFactor))
+        commands.push_back({ PipelineCommandType::BLEND_FUNC, { to.blend.srcFactor, to.blend.dstFactor } });
+
+    // The texture layout doesn't need any calls of its own, the textures get bound to its units per draw
+    return commands;
+}
+
+void PipelineStateCache::ExecuteCommands(const std::vector<PipelineCommand> &commands)
+{
+    // Still goes through the GL state cache so that its shadowed state stays in sync
+    GLState &glState = GLState::getInstance();
+    for(const PipelineCommand &command: commands)
+    {
+        switch(command.type)
+        {
+            case PipelineCommandType::USE_PROGRAM:
+                glState.UseProgram(command.args[0]);
+            break;
+            case PipelineCommandType::ENABLE:
+                glState.SetCapability(command.args[0], true);
+            break;
+            case PipelineCommandType::DISABLE:
+                glState.SetCapability(command.args[0], false);
+            break;
+            case PipelineCommandType::POLYGON_MODE:
+                glState.PolygonMode(command.args[0]);
+            break;
+            case PipelineCommandType::CULL_FACE:
+                glState.CullFace(command.args[0]);
+            break;
+            case PipelineCommandType::DEPTH_FUNC:
+                glState.DepthFunc(command.args[0]);
+            break;
+            case PipelineCommandType::DEPTH_MASK:
+                glState.DepthMask(command.args[0] != 0);
+            break;
+            case PipelineCommandType::BLEND_FUNC:
+                glState.BlendFunc(command.args[0], command.args[1]);
+            break;
+        }
+    }
+}
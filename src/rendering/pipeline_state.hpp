@@ -0,0 +1,133 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "misc/singleton.hpp"
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+struct RasterState final
+{
+    unsigned int polygonMode = GL_FILL;
+    bool cullingEnabled = false;
+    unsigned int cullFace = GL_BACK;
+};
+struct DepthState final
+{
+    bool testEnabled = true;
+    bool writeEnabled = true;
+    unsigned int func = GL_LESS;
+};
+struct BlendState final
+{
+    bool enabled = false;
+    unsigned int srcFactor = GL_ONE;
+    unsigned int dstFactor = GL_ZERO;
+};
+
+// Everything a pipeline state is built from. The vertex layout isn't part of it, every model's VAO keeps its own
+struct PipelineStateDesc final
+{
+    unsigned int program = 0;
+    RasterState raster;
+    DepthState depth;
+    BlendState blend;
+    // The texture target expected at each texture unit, unit i being the shader's i-th sampler
+    std::vector<unsigned int> textureTargets;
+
+    size_t GetHash() const;
+    bool operator==(const PipelineStateDesc &other) const;
+};
+
+enum class PipelineCommandType
+{
+    USE_PROGRAM = 0,
+    ENABLE,
+    DISABLE,
+    POLYGON_MODE,
+    CULL_FACE,
+    DEPTH_FUNC,
+    DEPTH_MASK,
+    BLEND_FUNC
+};
+struct PipelineCommand final
+{
+    PipelineCommandType type;
+    unsigned int args[2];
+};
+
+/*
+An immutable snapshot of the draw state. Created once through the PipelineStateCache
+and only ever handed out as a const pointer, so two draws with the same state share the same object.
+*/
+class PipelineState final
+{
+    friend class PipelineStateCache;
+
+    private:
+    const PipelineStateDesc _desc;
+    const size_t _hash;
+    // The commands that set up the whole state from scratch
+    std::vector<PipelineCommand> _fullCommands;
+
+    private:
+    PipelineState(const PipelineStateDesc &desc, size_t hash);
+
+    public:
+    PipelineState(const PipelineState &other) = delete;
+    PipelineState &operator=(const PipelineState &other) = delete;
+
+    inline const PipelineStateDesc &getDesc() const { return _desc; }
+    inline size_t getHash() const { return _hash; }
+};
+
+/*
+Owns every pipeline state and applies them. The transition from one state to another
+is diffed once and the resulting command list is kept, so switching between states that were
+switched between before only replays the calls that differ.
+*/
+class PipelineStateCache final : public Singleton<PipelineStateCache>
+{
+    friend class Singleton<PipelineStateCache>;
+    friend class PipelineState;
+
+    private:
+    struct TransitionKeyHash
+    {
+        size_t operator()(const std::pair<const PipelineState*, const PipelineState*> &key) const;
+    };
+
+    // Hash -> every state with that hash
+    std::unordered_map<size_t, std::vector<PipelineState*>> _states;
+    unsigned int _numOfStates = 0;
+    std::unordered_map<std::pair<const PipelineState*, const PipelineState*>, std::vector<PipelineCommand>, TransitionKeyHash> _transitions;
+    const PipelineState *_lastApplied = nullptr;
+    unsigned int _numOfCommandsLastApply = 0;
+
+    private:
+    PipelineStateCache() = default;
+    ~PipelineStateCache();
+
+    public:
+    // Returns the state matching the description, creating it the first time it's asked for
+    const PipelineState *Get(const PipelineStateDesc &desc);
+    // Issues the calls that differ between the last applied state and the given one
+    void Apply(const PipelineState *state);
+    // Makes the next Apply set up the whole state, eg. after the GL state was changed behind the cache's back
+    void InvalidateApplied();
+    // Makes sure the next state with the program's name actually gets it used, the name can be reused by a new program
+    void OnProgramDeleted(unsigned int program);
+    // Destroys every state and transition
+    void Clear();
+
+    inline const PipelineState *getLastApplied() const { return _lastApplied; }
+    inline unsigned int getNumOfStates() const { return _numOfStates; }
+    inline size_t getNumOfTransitions() const { return _transitions.size(); }
+    inline unsigned int getNumOfCommandsLastApply() const { return _numOfCommandsLastApply; }
+
+    private:
+    static std::vector<PipelineCommand> BuildCommands(const PipelineStateDesc *from, const PipelineStateDesc &to);
+    static void ExecuteCommands(const std::vector<PipelineCommand> &commands);
+};
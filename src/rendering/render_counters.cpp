@@ -0,0 +1,171 @@
+#include "render_counters.hpp"
+
+#include <glad/glad.h>
+
+#include "core/log.hpp"
+#include "core/allocation_counter.hpp"
+#include "gl_state.hpp"
+#include "misc/utils.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+
+const RenderCounterField RenderCounters::FIELDS[NUM_OF_FIELDS] =
+{
+    { "drawCalls",          "Draw calls",           &RenderCounterValues::drawCalls },
+    { "vertices",           "Vertices",             &RenderCounterValues::vertices },
+    { "triangles",          "Triangles",            &RenderCounterValues::triangles },
+    { "programBinds",       "Program binds",        &RenderCounterValues::programBinds },
+    { "vertexArrayBinds",   "VAO binds",            &RenderCounterValues::vertexArrayBinds },
+    { "textureBinds",       "Texture binds",        &RenderCounterValues::textureBinds },
+    { "uniformUploads",     "Uniform uploads",      &RenderCounterValues::uniformUploads },
+    { "bufferUploadBytes",  "Buffer upload bytes",  &RenderCounterValues::bufferUploadBytes },
+    { "textureUploadBytes", "Texture upload bytes", &RenderCounterValues::textureUploadBytes },
+    { "errorQueries",       "glGetError calls",     &RenderCounterValues::errorQueries },
+    { "allocations",        "Allocations",          &RenderCounterValues::allocations },
+    { "allocatedBytes",     "Allocated bytes",      &RenderCounterValues::allocatedBytes },
+};
+
+static const char *GetGLString(GLenum name)
+{
+    const GLubyte *string = GL_CALL(glad_glGetString(name));
+    return string != nullptr ? (const char*)string : "";
+}
+
+static std::string GetCompilerName()
+{
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+void RenderCounters::EndFrame()
+{
+    const GLStateCounters &stateCounters = GLState::getInstance().getLastFrameCounters();
+    _counters.programBinds = stateCounters.programBinds;
+    _counters.vertexArrayBinds = stateCounters.vertexArrayBinds;
+    _counters.textureBinds = stateCounters.textureBinds;
+
+    const unsigned long long errorQueries = GLErrorChecks::GetNumOfErrorQueries();
+    const unsigned long long allocations = AllocationCounter::getNumOfAllocations();
+    const unsigned long long allocatedBytes = AllocationCounter::getAllocatedBytes();
+    _counters.errorQueries = errorQueries - _lastErrorQueries;
+    _counters.allocations = allocations - _lastAllocations;
+    _counters.allocatedBytes = allocatedBytes - _lastAllocatedBytes;
+    _lastErrorQueries = errorQueries;
+    _lastAllocations = allocations;
+    _lastAllocatedBytes = allocatedBytes;
+
+    _lastFrameCounters = _counters;
+    _counters = RenderCounterValues();
+    AddToHistory(_lastFrameCounters);
+    _numOfFrames++;
+
+    if(_numOfFramesUntilDump > 0 && --_numOfFramesUntilDump == 0)
+        Dump();
+}
+
+bool RenderCounters::DumpJSON(const std::string &path) const
+{
+    std::ofstream file(path);
+    if(!file.is_open())
+    {
+        Log::LogError("Failed to open " + path + " for writing the render stats");
+        return false;
+    }
+
+    const RenderCounterValues average = GetAverageCounters();
+    const RenderCounterValues max = GetMaxCounters();
+    auto writeCounters = [&](const char *name, const RenderCounterValues &counters, bool isLast)
+    {
+        file << "  \"" << name << "\": {";
+        for(size_t i = 0; i < NUM_OF_FIELDS; i++)
+            file << (i == 0 ? "" : ", ") << '"' << FIELDS[i].name << "\": " << counters.*FIELDS[i].value;
+        file << (isLast ? "}\n" : "},\n");
+    };
+
+    // CMake defines NDEBUG for the release configurations with every compiler, _DEBUG is MSVC only
+#ifdef NDEBUG
+    const char *buildType = "release";
+#else
+    const char *buildType = "debug";
+#endif
+    file << "{\n";
+    file << "  \"build\": {\"type\": \"" << buildType << "\", \"compiler\": " << ToJSONString(GetCompilerName())
+         << ", \"glErrorCheckLevel\": " << GL_ERROR_CHECK_LEVEL << ", \"glErrorCheckMode\": " << (int)GLErrorChecks::GetMode() << "},\n";
+    file << "  \"gl\": {\"vendor\": " << ToJSONString(GetGLString(GL_VENDOR)) << ", \"renderer\": " << ToJSONString(GetGLString(GL_RENDERER))
+         << ", \"version\": " << ToJSONString(GetGLString(GL_VERSION)) << "},\n";
+    file << "  \"numOfFrames\": " << _numOfFrames << ",\n";
+    file << "  \"numOfSampledFrames\": " << _history.size() << ",\n";
+    writeCounters("lastFrame", _lastFrameCounters, false);
+    // Averages get rounded down, they're meant for spotting changes between builds rather than exact values
+    writeCounters("average", average, false);
+    writeCounters("max", max, true);
+    file << "}\n";
+    return true;
+}
+
+void RenderCounters::DumpAfterFrames(unsigned int numOfFrames)
+{
+    _numOfFramesUntilDump = numOfFrames;
+}
+
+RenderCounterValues RenderCounters::GetAverageCounters() const
+{
+    RenderCounterValues average;
+    if(_history.empty())
+        return average;
+
+    for(const RenderCounterField &field: FIELDS)
+    {
+        unsigned long long sum = 0;
+        for(const RenderCounterValues &counters: _history)
+            sum += counters.*field.value;
+        average.*field.value = sum / _history.size();
+    }
+    return average;
+}
+
+RenderCounterValues RenderCounters::GetMaxCounters() const
+{
+    RenderCounterValues max;
+    for(const RenderCounterField &field: FIELDS)
+    {
+        for(const RenderCounterValues &counters: _history)
+            max.*field.value = std::max(max.*field.value, counters.*field.value);
+    }
+    return max;
+}
+
+void RenderCounters::AddToHistory(const RenderCounterValues &counters)
+{
+    if(_history.size() < HISTORY_SIZE)
+    {
+        _history.push_back(counters);
+        return;
+    }
+
+    _history[_historyStart] = counters;
+    _historyStart = (_historyStart + 1) % HISTORY_SIZE;
+}
+
+bool RenderCounters::Dump()
+{
+    char timestamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    const std::string path = "render_stats_" + std::string(timestamp) + ".json";
+    if(!DumpJSON(path))
+        return false;
+
+    _lastDumpPath = path;
+    Log::LogInfo("Render stats written to " + path);
+    return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// What a frame handed to GL, counted on the CPU
+struct RenderCounterValues
+{
+    unsigned long long drawCalls = 0;
+    // The multi draw indirect calls count every draw they were given, the ones the GPU culling pass drops included
+    unsigned long long vertices = 0;
+    unsigned long long triangles = 0;
+
+    // Only the binds that reached GL, see GLState
+    unsigned long long programBinds = 0;
+    unsigned long long vertexArrayBinds = 0;
+    unsigned long long textureBinds = 0;
+
+    unsigned long long uniformUploads = 0;
+    // Written to buffers through glBufferData/glBufferSubData and the streaming ring buffer, and uploaded to textures
+    unsigned long long bufferUploadBytes = 0;
+    unsigned long long textureUploadBytes = 0;
+
+    unsigned long long errorQueries = 0;
+    // Through the global operator new, see AllocationCounter
+    unsigned long long allocations = 0;
+    unsigned long long allocatedBytes = 0;
+};
+
+// One of the counters, for going through all of them without naming each one
+struct RenderCounterField
+{
+    // What it's called in the JSON dump
+    const char *name;
+    // What it's called in the UI
+    const char *label;
+    unsigned long long RenderCounterValues::*value;
+};
+
+/*
+Counts what every frame submits. The draws, uniform uploads and uploads get counted where they're made,
+the binds come from GLState's counters, the glGetError() calls from GLErrorChecks and the allocations from AllocationCounter.
+Only the render (GL) thread's work gets counted apart from the glGetError() calls and the allocations, which are counted on every thread.
+Anything the ImGui backend does is left out since it talks to GL directly.
+*/
+class RenderCounters final : public Singleton<RenderCounters>
+{
+    friend class Singleton<RenderCounters>;
+
+    public:
+    static constexpr unsigned int HISTORY_SIZE = 300;
+    static constexpr size_t NUM_OF_FIELDS = 12;
+    static const RenderCounterField FIELDS[NUM_OF_FIELDS];
+
+    private:
+    RenderCounterValues _counters;
+    RenderCounterValues _lastFrameCounters;
+    std::vector<RenderCounterValues> _history;
+    unsigned int _historyStart = 0;
+    unsigned int _numOfFrames = 0;
+
+    // What the running counts were at the end of the last frame
+    unsigned long long _lastErrorQueries = 0;
+    unsigned long long _lastAllocations = 0;
+    unsigned long long _lastAllocatedBytes = 0;
+
+    // Dumps the counters once this many more frames have ended, 0 if no dump is waiting
+    unsigned int _numOfFramesUntilDump = 0;
+    std::string _lastDumpPath;
+
+    private:
+    RenderCounters() = default;
+    ~RenderCounters() = default;
+
+    public:
+    // Takes this frame's binds from GLState, so it has to be called after GLState::EndFrame()
+    void EndFrame();
+
+    inline void CountDraw(unsigned long long numOfVertices, unsigned long long numOfInstances = 1)
+    {
+        _counters.drawCalls++;
+        _counters.vertices += numOfVertices * numOfInstances;
+        _counters.triangles += numOfVertices / 3 * numOfInstances;
+    }
+    inline void CountUniformUploads(unsigned int numOfUploads = 1) { _counters.uniformUploads += numOfUploads; }
+    inline void CountBufferUpload(size_t size) { _counters.bufferUploadBytes += size; }
+    inline void CountTextureUpload(size_t size) { _counters.textureUploadBytes += size; }
+
+    // Writes the last frame's counters along with their averages and maximums over the history to a JSON file
+    bool DumpJSON(const std::string &path) const;
+    // Dumps the counters to a render_stats_<date>_<time>.json file in the working directory
+    bool Dump();
+    // Dumps the counters once the given number of frames have ended
+    void DumpAfterFrames(unsigned int numOfFrames);
+
+    inline const RenderCounterValues &getLastFrameCounters() const { return _lastFrameCounters; }
+    // Over the frames in the history
+    RenderCounterValues GetAverageCounters() const;
+    RenderCounterValues GetMaxCounters() const;
+    inline unsigned int getNumOfFrames() const { return _numOfFrames; }
+    inline const std::string &getLastDumpPath() const { return _lastDumpPath; }
+
+    private:
+    void AddToHistory(const RenderCounterValues &counters);
+};
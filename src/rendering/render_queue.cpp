@@ -0,0 +1,105 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr unsigned int PASS_SHIFT = 62;
+static constexpr SortKey STATE_BITS = RenderQueue::PROGRAM_BITS + RenderQueue::TEXTURES_BITS + RenderQueue::MESH_BITS;
+static constexpr SortKey DEPTH_MASK = (1ull << RenderQueue::DEPTH_BITS) - 1;
+static constexpr SortKey STATE_MASK = (1ull << STATE_BITS) - 1;
+
+// Positive floats compare the same as their bits do, so the top bits (minus the sign) make a depth key that works at any scale
+static SortKey GetDepthBits(float depth)
+{
+    if(!(depth > 0.0f))
+        return 0;
+
+    unsigned int bits;
+    std::memcpy(&bits, &depth, sizeof(bits));
+    return (bits >> (31 - RenderQueue::DEPTH_BITS)) & DEPTH_MASK;
+}
+
+SortKey RenderQueue::MakeSortKey(RenderPass pass, unsigned int program, unsigned int textures, unsigned int mesh, float depth)
+{
+    const SortKey state =
+        ((SortKey)(program & ((1u << PROGRAM_BITS) - 1)) << (TEXTURES_BITS + MESH_BITS)) |
+        ((SortKey)(textures & ((1u << TEXTURES_BITS) - 1)) << MESH_BITS) |
+        (SortKey)(mesh & ((1u << MESH_BITS) - 1));
+    const SortKey depthBits = GetDepthBits(depth);
+
+    if(pass == RenderPass::TRANSPARENT_PASS)
+        return ((SortKey)pass << PASS_SHIFT) | ((DEPTH_MASK - depthBits) << STATE_BITS) | state;
+    return ((SortKey)pass << PASS_SHIFT) | (state << DEPTH_BITS) | depthBits;
+}
+
+RenderPass RenderQueue::GetPass(SortKey key)
+{
+    return (RenderPass)(key >> PASS_SHIFT);
+}
+
+void RenderQueue::Sort()
+{
+    const size_t numOfItems = _items.size();
+    if(numOfItems < 2)
+        return;
+
+    // One pass over the keys builds the histograms of all 8 digits
+    unsigned int histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+    for(const RenderItem &item: _items)
+    {
+        for(unsigned int digit = 0; digit < 8; digit++)
+            histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+    }
+
+    _sortBuffer.resize(numOfItems);
+    RenderItem *source = _items.data();
+    RenderItem *destination = _sortBuffer.data();
+    for(unsigned int digit = 0; digit < 8; digit++)
+    {
+        const unsigned int shift = digit * 8;
+        unsigned int *histogram = histograms[digit];
+        // Every key has the same digit, scattering them would keep them in the same order
+        if(histogram[(source[0].key >> shift) & 0xFF] == numOfItems)
+            continue;
+
+        unsigned int offset = 0;
+        for(unsigned int bucket = 0; bucket < 256; bucket++)
+        {
+            const unsigned int count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += count;
+        }
+        for(size_t i = 0; i < numOfItems; i++)
+            destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+        std::swap(source, destination);
+    }
+
+    if(source != _items.data())
+        _items.swap(_sortBuffer);
+}
+
+RenderQueueStateChanges RenderQueue::CountStateChanges() const
+{
+    RenderQueueStateChanges changes;
+    SortKey lastState = 0;
+    for(size_t i = 0; i < _items.size(); i++)
+    {
+        const SortKey key = _items[i].key;
+        const SortKey state = GetPass(key) == RenderPass::TRANSPARENT_PASS ? key & STATE_MASK : (key >> DEPTH_BITS) & STATE_MASK;
+        const SortKey programs = state >> (TEXTURES_BITS + MESH_BITS);
+        const SortKey textures = (state >> MESH_BITS) & ((1u << TEXTURES_BITS) - 1);
+        const SortKey meshes = state & ((1u << MESH_BITS) - 1);
+
+        // The first item sets everything up
+        if(i == 0 || programs != lastState >> (TEXTURES_BITS + MESH_BITS))
+            changes.programs++;
+        if(i == 0 || textures != ((lastState >> MESH_BITS) & ((1u << TEXTURES_BITS) - 1)))
+            changes.textures++;
+        if(i == 0 || meshes != (lastState & ((1u << MESH_BITS) - 1)))
+            changes.meshes++;
+        lastState = state;
+    }
+    return changes;
+}
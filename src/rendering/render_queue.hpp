@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Suffixed since <wingdi.h> defines OPAQUE and TRANSPARENT as macros
+enum class RenderPass
+{
+    OPAQUE_PASS = 0,
+    TRANSPARENT_PASS
+};
+
+/*
+The sort key of a draw, from the most to the least significant bits:
+    Opaque:      pass (2) | program (12) | textures (12) | mesh (14) | depth (24)
+    Transparent: pass (2) | inverted depth (24) | program (12) | textures (12) | mesh (14)
+Sorting the keys puts the opaque draws first, grouped by the state that's the most expensive to switch
+and front to back within each group so that the depth test rejects as much as possible.
+The transparent draws come after them, back to front, because they have to blend in that order.
+The state fields are truncated IDs, so a collision can only ever make the order a bit worse, never wrong.
+*/
+using SortKey = unsigned long long;
+
+struct RenderItem final
+{
+    SortKey key;
+    // The index of the renderable in Scene::renderables
+    unsigned int renderable;
+};
+
+// How many times a state would switch if the items were drawn in the queue's order
+struct RenderQueueStateChanges final
+{
+    unsigned int programs = 0;
+    unsigned int textures = 0;
+    unsigned int meshes = 0;
+};
+
+class RenderQueue final
+{
+    public:
+    static constexpr unsigned int PROGRAM_BITS = 12;
+    static constexpr unsigned int TEXTURES_BITS = 12;
+    static constexpr unsigned int MESH_BITS = 14;
+    static constexpr unsigned int DEPTH_BITS = 24;
+
+    private:
+    std::vector<RenderItem> _items;
+    // The radix sort ping-pongs between the items and this
+    std::vector<RenderItem> _sortBuffer;
+
+    public:
+    // Depth is the view space distance along the camera's forward axis
+    static SortKey MakeSortKey(RenderPass pass, unsigned int program, unsigned int textures, unsigned int mesh, float depth);
+    static RenderPass GetPass(SortKey key);
+
+    inline void Clear() { _items.clear(); }
+    inline void Reserve(size_t numOfItems) { _items.reserve(numOfItems); }
+    inline void Push(SortKey key, unsigned int renderable) { _items.push_back({ key, renderable }); }
+
+    // Least significant digit radix sort of the keys, 8 bits per pass.
+    // Passes over bytes that are the same in every key (eg. the pass bits when there's nothing transparent) are skipped
+    void Sort();
+    RenderQueueStateChanges CountStateChanges() const;
+
+    inline const std::vector<RenderItem> &getItems() const { return _items; }
+    inline size_t getNumOfItems() const { return _items.size(); }
+};
@@ -2,6 +2,16 @@
 
 #include "core/log.hpp"
 #include "core/resource_manager.hpp"
+#include "shader_specializer.hpp"
+#include "gl_state.hpp"
+#include "gl_extensions.hpp"
+#include "geometry_pool.hpp"
+#include "render_counters.hpp"
+#include "misc/simd_math.hpp"
+#include "misc/utils.hpp"
+
+#include <algorithm>
+#include <numeric>
 
 void Renderer::Init()
 {
@@ -65,51 +75,700 @@ void Renderer::Init()
     _cube = new Model(std::move(cubeVertices));
     _quad = new Model(std::move(quadVertices));
 
+    GL_CALL(glad_glGenBuffers(1, &_indirectBuffer));
+    _streamingBuffer.Init(STREAMING_SEGMENT_SIZE);
+    int alignment = 0;
+    GL_CALL(glad_glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+    _uniformBufferAlignment = std::max(alignment, 1);
+    if(GLExtensions::multiDrawIndirect)
+    {
+        GL_CALL(glad_glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment));
+        _storageBufferAlignment = std::max(alignment, 1);
+    }
+    GeometryPool::getInstance().Init();
+    if(GLExtensions::computeShaders)
+        _gpuCullerReady = _gpuCuller.Init("../../../res/shaders/");
+    _occlusionCuller.Init();
+    _commandRecorder.Init();
+    // Every renderable drawn with the scene's shader draws with the same program, so the values of
+    // the first one can't be baked into it. With a still camera they'd otherwise settle and end up in every draw
+    ShaderSpecializer::getInstance().SetPerDrawUniforms({ "u_ModelMatrix", "u_MVP" });
+
     // Scene::getInstance().model = _cube;
 }
 void Renderer::DeInit()
 {
     delete _cube;
     delete _quad;
+
+    _streamingBuffer.DeInit();
+    GL_CALL(glad_glDeleteBuffers(1, &_indirectBuffer));
+    GLState::getInstance().OnBufferDeleted(_indirectBuffer);
+    GeometryPool::getInstance().DeInit();
+    if(_gpuCullerReady)
+        _gpuCuller.DeInit();
+    _gpuCullerReady = false;
+    _occlusionCuller.DeInit();
+    _commandRecorder.DeInit();
+    ShaderSpecializer::getInstance().Reset();
+    _scenePipelineStates.clear();
+    PipelineStateCache::getInstance().Clear();
+}
+
+void Renderer::OnShaderUnloaded(const Shader *shader)
+{
+    if(_lastReadyShader == shader)
+        _lastReadyShader = nullptr;
+}
+
+void Renderer::BeginFrame()
+{
+    _frameStartTime = std::chrono::steady_clock::now();
+
+    _streamingBuffer.BeginFrame();
+    stats.streamingWaitTime = _streamingBuffer.getWaitTime();
+}
+void Renderer::EndFrame()
+{
+    stats.streamedBytes = _streamingBuffer.getFrameUsage();
+    stats.streamingSegmentSize = _streamingBuffer.getSegmentSize();
+    _streamingBuffer.EndFrame();
+
+    GLErrorChecks::CheckFrame();
+    GLState::getInstance().EndFrame();
+    RenderCounters::getInstance().EndFrame();
+
+    // Measured before the buffers get swapped so that waiting for vsync doesn't hide the difference between the error check modes
+    stats.frameTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _frameStartTime).count();
+
+    constexpr float smoothing = 0.05f;
+    float &averageTime = stats.frameTimeByErrorCheckMode[(int)GLErrorChecks::GetMode()];
+    averageTime = averageTime == 0.0f ? stats.frameTime : averageTime + (stats.frameTime - averageTime) * smoothing;
 }
 
 void Renderer::DrawScene()
 {
     static const Shader &defaultShader = *(ResourceManager::getInstance().GetShader("default"));
-    static const Texture &missingTex = *(ResourceManager::getInstance().GetTexture("tex_missing"));
-    
+
     static Scene &scene = Scene::getInstance();
+    GLState &glState = GLState::getInstance();
+    FrameProfiler &profiler = FrameProfiler::getInstance();
+    ProfileScope drawSceneScope("Draw scene");
+
+    // Bring the world matrices of whatever moved since the last frame up to date
+    const auto transformUpdateStartTime = std::chrono::steady_clock::now();
+    profiler.BeginScope("Transform update");
+    stats.numOfUpdatedTransforms = scene.transforms.UpdateWorldMatrices();
+    profiler.EndScope();
+    stats.transformUpdateTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - transformUpdateStartTime).count();
 
     // FIXME: Throws error 1282 after just unloading a texture
-    GL_CALL(glad_glEnable(GL_DEPTH_TEST));
-    
+    glState.ClearColor(glm::vec4(settings.bgColor.x, settings.bgColor.y, settings.bgColor.z, 1.0f));
+    // Clearing the depth buffer needs depth writes on, which the last pipeline state might have turned off
+    PipelineStateCache &pipelineStateCache = PipelineStateCache::getInstance();
+    if(pipelineStateCache.getLastApplied() != nullptr && !pipelineStateCache.getLastApplied()->getDesc().depth.writeEnabled)
+    {
+        glState.DepthMask(true);
+        pipelineStateCache.InvalidateApplied();
+    }
     GL_CALL(glad_glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
-    GL_CALL(glad_glClearColor(settings.bgColor.x, settings.bgColor.y, settings.bgColor.z, 1.0f));
-
-    GL_CALL(glad_glPolygonMode(GL_FRONT_AND_BACK, (GLenum)settings.renderMode));
 
     if(scene.model == nullptr)
         scene.model = _cube;
-    scene.model->Bind();
 
     if(scene.shader == nullptr)
         scene.shader = const_cast<Shader*>(&defaultShader);
-    scene.shader->Bind();
 
-    auto &textureUniforms = scene.shader->getUniformsOfType(ShaderUniformType::TEX2D);
-    // If there are textures present in the scene, go through them and bind the appropriate texture to the appropriate bind target
+    // Keep drawing with the previous shader until the newly selected one has finished compiling
+    if(scene.shader->isReady())
+        _lastReadyShader = scene.shader;
+    else if(_lastReadyShader == nullptr)
+        _lastReadyShader = const_cast<Shader*>(&defaultShader);
+    Shader *sceneShader = _lastReadyShader;
+
+    // Shader uniforms only point at their values, so the matrices of every renderable have to stay alive until the next frame
+    const glm::mat4 viewProjection = scene.camera.projection * scene.camera.view;
+    _modelMatrices.resize(scene.renderables.size());
+    _mvpMatrices.resize(scene.renderables.size());
+
+    // Only the renderables whose bounds are at least partially in view get drawn.
+    // When the GPU culls they all go through, the batches that it doesn't cull get frustum culled while they're being built
+    const bool gpuCulling = IsGPUCullingActive();
+    if(!gpuCulling || !settings.freezeGPUCulling)
+        _gpuCullViewProjection = viewProjection;
+    const auto cullStartTime = std::chrono::steady_clock::now();
+    profiler.BeginScope("Culling");
+    UpdateSceneBounds();
+    _visibleRenderables.clear();
+    if(settings.frustumCulling && !gpuCulling)
+    {
+        _sceneBVH.Cull(Frustum::FromMatrix(viewProjection), _visibleRenderables);
+    }
+    else
+    {
+        _visibleRenderables.resize(scene.renderables.size());
+        std::iota(_visibleRenderables.begin(), _visibleRenderables.end(), 0);
+    }
+    stats.cullTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cullStartTime).count();
+    if(settings.softwareOcclusionCulling && !gpuCulling)
+    {
+        CullOccludedRenderables(viewProjection);
+    }
+    else
+    {
+        stats.occluderRasterTime = stats.occlusionTestTime = 0.0f;
+        stats.numOfOccluders = stats.numOfOccluderTriangles = 0;
+        stats.numOfOcclusionTested = stats.numOfSoftwareOccluded = 0;
+    }
+    profiler.EndScope();
+    stats.numOfVisibleRenderables = _visibleRenderables.size();
+    stats.numOfCulledRenderables = scene.renderables.size() - _visibleRenderables.size();
+
+    ReadScenePassTime();
+    profiler.BeginScope(SCENE_PASS_SCOPE, true);
+
+    // Bound for the whole frame, only the shaders that take their model matrices per instance read it
+    const FrameUniforms frameUniforms = { viewProjection };
+    const RingBufferAllocation frameUniformData = _streamingBuffer.Upload(&frameUniforms, sizeof(frameUniforms), _uniformBufferAlignment);
+    if(frameUniformData.data != nullptr)
+        glState.BindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameUniformData.buffer, frameUniformData.offset, frameUniformData.size);
+    _showCulledInstances = gpuCulling && settings.showGPUCulled;
+    if(gpuCulling)
+    {
+        _gpuCuller.ReadBackStats();
+        stats.gpuCulling = _gpuCuller.getStats();
+    }
+    profiler.BeginScope("Build draw batches");
+    BuildDrawBatches(*sceneShader, gpuCulling);
+    // Everything the draws read from the ring has been written by now
+    _streamingBuffer.Flush();
+    profiler.EndScope();
+
+    // The workers only read the batches and the scene, each of them writes the matrices of its own renderables
+    const auto recordStartTime = std::chrono::steady_clock::now();
+    profiler.BeginScope("Record draws");
+    const Shader *sceneProgram = PrepareDrawBatches(*sceneShader, viewProjection);
+    const unsigned int numOfBatchedRenderables = _batchedRenderables.size();
+    const unsigned int numOfRecordSlices = settings.parallelRecording ? numOfBatchedRenderables / MIN_RENDERABLES_PER_SLICE : 1;
+    _commandRecorder.Record(numOfRecordSlices, [&](CommandList &commands, unsigned int slice, unsigned int numOfSlices)
+    {
+        const unsigned int sliceStart = (unsigned long long)numOfBatchedRenderables * slice / numOfSlices;
+        const unsigned int sliceEnd = (unsigned long long)numOfBatchedRenderables * (slice + 1) / numOfSlices;
+        RecordDraws(commands, sliceStart, sliceEnd, viewProjection);
+    });
+    profiler.EndScope();
+    stats.recordTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - recordStartTime).count();
+    stats.numOfRecordedLists = _commandRecorder.getNumOfRecordedLists();
+    stats.numOfRecordedCommands = _commandRecorder.GetNumOfRecordedCommands();
+
+    const auto submitStartTime = std::chrono::steady_clock::now();
+    profiler.BeginScope("Submit draws");
+    _commandRecorder.Execute();
+    profiler.EndScope();
+    stats.submitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submitStartTime).count();
+    stats.isShaderSpecialized = sceneProgram != nullptr && sceneProgram != sceneShader;
+    _scenePassSpecialized[profiler.getFrameIndex() % FrameProfiler::NUM_OF_PENDING_FRAMES] = stats.isShaderSpecialized;
+
+    // The next frame's occlusion test reads this frame's depth
+    if(gpuCulling && settings.occlusionCulling && !settings.freezeGPUCulling)
+    {
+        int viewport[4];
+        GL_CALL(glad_glGetIntegerv(GL_VIEWPORT, viewport));
+        _gpuCuller.BuildDepthPyramid(viewProjection, viewport[2], viewport[3]);
+    }
+
+    profiler.EndScope();
+    // GL_CALL(glad_glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0));
+
+#ifdef GL_STATE_VALIDATION
+    // Unbind everything the scene pass has bound.
+    // Outside of debug builds the bindings are left as they are so that next frame's binds can be skipped
+    for(unsigned int i = 0; i < _numOfUsedTextureUnits; i++)
+        glState.BindTextureToUnit(i, GL_TEXTURE_2D, 0);
+    glState.UseProgram(0);
+    glState.BindVertexArray(0);
+#endif
+}
+
+void Renderer::UpdateSceneBounds()
+{
+    static Scene &scene = Scene::getInstance();
+    const size_t numOfRenderables = scene.renderables.size();
+
+    // Renderables got added or removed, build the BVH from scratch
+    if(_boundedModels.size() != numOfRenderables)
+    {
+        std::vector<AABB> bounds(numOfRenderables);
+        _boundedModels.resize(numOfRenderables);
+        for(size_t i = 0; i < numOfRenderables; i++)
+        {
+            const Renderable &renderable = scene.renderables[i];
+            _boundedModels[i] = renderable.model != nullptr ? renderable.model : scene.model;
+            bounds[i] = TransformAABB(_boundedModels[i]->getBounds(), scene.transforms.getWorldMatrix(renderable.entity));
+        }
+        _sceneBVH.Build(bounds);
+        return;
+    }
+
+    // Otherwise only the renderables that moved or whose model changed (eg. a different one got loaded through the UI) get new bounds
+    _movedEntities.assign(scene.transforms.getNumOfEntities(), false);
+    for(const EntityID entity: scene.transforms.getUpdatedEntities())
+        _movedEntities[entity] = true;
+
+    for(size_t i = 0; i < numOfRenderables; i++)
+    {
+        const Renderable &renderable = scene.renderables[i];
+        const Model *model = renderable.model != nullptr ? renderable.model : scene.model;
+        if(model == _boundedModels[i] && !_movedEntities[renderable.entity])
+            continue;
+
+        _boundedModels[i] = model;
+        _sceneBVH.UpdatePrimitive(i, TransformAABB(model->getBounds(), scene.transforms.getWorldMatrix(renderable.entity)));
+    }
+    _sceneBVH.Refit();
+}
+
+void Renderer::CullOccludedRenderables(const glm::mat4 &viewProjection)
+{
+    static Scene &scene = Scene::getInstance();
+
+    // The occluders in view get rasterized with the same bounds-resolved models the BVH was built from
+    const auto rasterStartTime = std::chrono::steady_clock::now();
+    _occlusionCuller.BeginFrame(viewProjection);
+    for(const unsigned int i: _visibleRenderables)
+    {
+        const Renderable &renderable = scene.renderables[i];
+        if(!renderable.occluder)
+            continue;
+
+        const std::vector<Vertex> &vertices = _boundedModels[i]->getVertices();
+        if(!vertices.empty())
+            _occlusionCuller.AddOccluder(scene.transforms.getWorldMatrix(renderable.entity), &vertices[0].position, sizeof(Vertex), vertices.size());
+    }
+    _occlusionCuller.Rasterize();
+    const auto testStartTime = std::chrono::steady_clock::now();
+
+    // Occluders are never tested, they'd always be hidden behind themselves
+    unsigned int numOfTested = 0;
+    size_t numOfVisible = 0;
+    for(const unsigned int i: _visibleRenderables)
+    {
+        if(!scene.renderables[i].occluder)
+        {
+            numOfTested++;
+            if(!_occlusionCuller.IsVisible(_sceneBVH.getPrimitiveBounds(i)))
+                continue;
+        }
+        _visibleRenderables[numOfVisible++] = i;
+    }
+
+    stats.occluderRasterTime = std::chrono::duration<float, std::milli>(testStartTime - rasterStartTime).count();
+    stats.occlusionTestTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - testStartTime).count();
+    stats.numOfOccluders = _occlusionCuller.getNumOfOccluders();
+    stats.numOfOccluderTriangles = _occlusionCuller.getNumOfTriangles();
+    stats.numOfOcclusionTested = numOfTested;
+    stats.numOfSoftwareOccluded = _visibleRenderables.size() - numOfVisible;
+    _visibleRenderables.resize(numOfVisible);
+}
+
+void Renderer::BuildDrawBatches(Shader &sceneShader, bool gpuCulling)
+{
+    static Scene &scene = Scene::getInstance();
+
+    // Queue up the visible renderables with keys that sort them by state and depth
+    const glm::mat4 &view = scene.camera.view;
+    const Shader *lastShader = nullptr;
+    unsigned int textureSetKey = 0;
+    _renderQueue.Clear();
+    _renderQueue.Reserve(_visibleRenderables.size());
+    for(const unsigned int i: _visibleRenderables)
+    {
+        Model *model;
+        Shader *shader;
+        ResolveRenderable(i, sceneShader, model, shader);
+
+        // Every renderable drawn with the same shader samples the same textures
+        if(shader != lastShader)
+        {
+            textureSetKey = GetTextureSetKey(*shader);
+            lastShader = shader;
+        }
+
+        const glm::vec3 center = _sceneBVH.getPrimitiveBounds(i).GetCenter();
+        const float depth = -(view[0].z * center.x + view[1].z * center.y + view[2].z * center.z + view[3].z);
+        const RenderPass pass = scene.renderables[i].transparent ? RenderPass::TRANSPARENT_PASS : RenderPass::OPAQUE_PASS;
+        _renderQueue.Push(RenderQueue::MakeSortKey(pass, shader->getID(), textureSetKey, model->getVAO(), depth), i);
+    }
+
+    stats.stateChangesUnsorted = _renderQueue.CountStateChanges();
+    if(settings.sortRenderQueue)
+    {
+        const auto sortStartTime = std::chrono::steady_clock::now();
+        _renderQueue.Sort();
+        stats.sortTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - sortStartTime).count();
+    }
+    else
+    {
+        stats.sortTime = 0.0f;
+    }
+    stats.stateChangesSubmitted = _renderQueue.CountStateChanges();
+
+    // Runs of renderables with the same model, shader and pass make up the batches
+    _drawBatches.clear();
+    _batchedRenderables.resize(_renderQueue.getNumOfItems());
+    for(size_t j = 0; j < _renderQueue.getNumOfItems(); j++)
+    {
+        const RenderItem &item = _renderQueue.getItems()[j];
+        _batchedRenderables[j] = item.renderable;
+
+        Model *model;
+        Shader *shader;
+        ResolveRenderable(item.renderable, sceneShader, model, shader);
+        const bool transparent = RenderQueue::GetPass(item.key) == RenderPass::TRANSPARENT_PASS;
+
+        if(_drawBatches.empty() || _drawBatches.back().model != model || _drawBatches.back().shader != shader || _drawBatches.back().transparent != transparent)
+            _drawBatches.push_back({ model, shader, nullptr, transparent, (unsigned int)j, 0, 0, false, 0, 0, nullptr, nullptr });
+        _drawBatches.back().numOfRenderables++;
+    }
+
+    // Batches get drawn through multi draw indirect if their shader has a variant for it. If not, the ones that are big enough
+    // get drawn with a single instanced draw call if their shader has an instanced variant.
+    // The variants get compiled the first time they're asked for, the batch is drawn one renderable at a time until they're ready
+    _instanceMatrices.clear();
+    _indirectCommands.clear();
+    _cullCandidates.clear();
+    unsigned int numOfCulledBatches = 0;
+    const Frustum cullFrustum = Frustum::FromMatrix(_gpuCullViewProjection);
+    const bool multiDrawIndirect = settings.multiDrawIndirect && GLExtensions::multiDrawIndirect;
+    if(multiDrawIndirect)
+        GeometryPool::getInstance().Trim();
+    for(DrawBatch &batch: _drawBatches)
+    {
+        Shader *perInstanceShader = multiDrawIndirect ? GetPerInstanceVariant(*batch.shader, MULTI_DRAW_KEYWORD) : nullptr;
+        batch.multiDraw = perInstanceShader != nullptr;
+
+        // The GPU only culls the multi draw batches, the renderables of the rest that are out of view are dropped here
+        if(gpuCulling && !batch.multiDraw && settings.frustumCulling)
+        {
+            unsigned int numOfVisible = 0;
+            for(unsigned int j = batch.firstRenderable; j < batch.firstRenderable + batch.numOfRenderables; j++)
+            {
+                if(FrustumTestAABB(cullFrustum, _sceneBVH.getPrimitiveBounds(_batchedRenderables[j])))
+                    _batchedRenderables[batch.firstRenderable + numOfVisible++] = _batchedRenderables[j];
+            }
+            stats.numOfCulledRenderables += batch.numOfRenderables - numOfVisible;
+            stats.numOfVisibleRenderables -= batch.numOfRenderables - numOfVisible;
+            batch.numOfRenderables = numOfVisible;
+        }
+
+        if(perInstanceShader == nullptr && settings.instancing && batch.numOfRenderables >= (unsigned int)settings.minInstancedBatchSize)
+            perInstanceShader = GetPerInstanceVariant(*batch.shader, INSTANCING_KEYWORD);
+        if(perInstanceShader == nullptr)
+            continue;
+
+        batch.instancedShader = perInstanceShader;
+        batch.baseInstance = _instanceMatrices.size();
+        for(unsigned int j = batch.firstRenderable; j < batch.firstRenderable + batch.numOfRenderables; j++)
+            _instanceMatrices.push_back(scene.transforms.getWorldMatrix(scene.renderables[_batchedRenderables[j]].entity));
+
+        if(!batch.multiDraw)
+            continue;
+
+        const unsigned int numOfVerts = batch.model->getVertices().size();
+        const unsigned int firstVertex = GeometryPool::getInstance().GetFirstVertex(*batch.model);
+        if(gpuCulling)
+        {
+            // Every renderable becomes a candidate, the ones that survive get packed at the start of the batch's commands
+            batch.indirectCommand = _cullCandidates.size();
+            batch.numOfIndirectCommands = batch.numOfRenderables;
+            for(unsigned int j = 0; j < batch.numOfRenderables; j++)
+            {
+                const AABB &bounds = _sceneBVH.getPrimitiveBounds(_batchedRenderables[batch.firstRenderable + j]);
+                _cullCandidates.push_back({ glm::vec4(bounds.min, 1.0f), glm::vec4(bounds.max, 1.0f), numOfVerts, firstVertex, batch.baseInstance + j, batch.indirectCommand, numOfCulledBatches, {} });
+            }
+            numOfCulledBatches++;
+        }
+        else
+        {
+            batch.indirectCommand = _indirectCommands.size();
+            batch.numOfIndirectCommands = 1;
+            _indirectCommands.push_back({ numOfVerts, batch.numOfRenderables, firstVertex, batch.baseInstance });
+        }
+    }
+
+    if(_instanceMatrices.empty())
+        return;
+
+    // Written straight into the frame's part of the ring, which the GPU isn't reading from anymore.
+    // Aligned to a whole matrix so that the instanced draws can reach it through their base instance
+    const size_t instanceAlignment = std::max(sizeof(glm::mat4), _storageBufferAlignment);
+    _instanceData = _streamingBuffer.Upload(_instanceMatrices.data(), sizeof(glm::mat4) * _instanceMatrices.size(), instanceAlignment);
+    if(_instanceData.data == nullptr)
+    {
+        // Nothing that's drawn per instance would have its matrices
+        _drawBatches.clear();
+        return;
+    }
+
+    if(_indirectCommands.empty() && _cullCandidates.empty())
+        return;
+
+    GeometryPool::getInstance().ReserveInstanceIndices(_instanceMatrices.size());
+    if(gpuCulling)
+    {
+        // Orphaned so that the culling pass doesn't have to wait for last frame's draws to finish reading the commands
+        GLState::getInstance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+        _indirectBufferCapacity = std::max(_indirectBufferCapacity, _cullCandidates.size());
+        GL_CALL(glad_glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawArraysIndirectCommand) * _indirectBufferCapacity, nullptr, GL_STREAM_DRAW));
+        _gpuCuller.Cull(_cullCandidates, numOfCulledBatches, _instanceMatrices.size(), cullFrustum, _indirectBuffer, settings.occlusionCulling, settings.showGPUCulled);
+        _indirectCommandBuffer = _indirectBuffer;
+        _indirectCommandOffset = 0;
+    }
+    else
+    {
+        const RingBufferAllocation commands = _streamingBuffer.Upload(_indirectCommands.data(), sizeof(DrawArraysIndirectCommand) * _indirectCommands.size(), sizeof(unsigned int));
+        _indirectCommandBuffer = commands.buffer;
+        _indirectCommandOffset = commands.offset;
+    }
+}
+
+bool Renderer::IsGPUCullingActive() const
+{
+    return settings.gpuCulling && _gpuCullerReady && settings.multiDrawIndirect && GLExtensions::multiDrawIndirect;
+}
+
+Shader *Renderer::GetPerInstanceVariant(const Shader &shader, const char *keyword) const
+{
+    if(shader.getKeywords().count(keyword) == 0)
+        return nullptr;
+
+    ShaderDefines defines = shader.getDefines();
+    defines[keyword] = "";
+    Shader *variant = ResourceManager::getInstance().GetShaderVariant(shader.getName(), defines);
+    return variant != nullptr && variant->isReady() ? variant : nullptr;
+}
+
+void Renderer::ResolveRenderable(unsigned int renderable, Shader &sceneShader, Model *&model, Shader *&shader) const
+{
+    static Scene &scene = Scene::getInstance();
+    const Renderable &sceneRenderable = scene.renderables[renderable];
+    model = sceneRenderable.model != nullptr ? sceneRenderable.model : scene.model;
+    // Renderables with a shader of their own fall back onto the scene's shader while theirs is compiling
+    shader = sceneRenderable.shader != nullptr && sceneRenderable.shader->isReady() ? sceneRenderable.shader : &sceneShader;
+}
+
+unsigned int Renderer::GetTextureSetKey(const Shader &shader) const
+{
+    static Scene &scene = Scene::getInstance();
+    // Without any textures in the scene every shader draws with the missing texture
+    if(scene.textures.empty())
+        return 0;
+
+    size_t hash = 0;
+    for(const ShaderUniform *uniform: shader.getUniformsOfType(ShaderUniformType::TEX2D))
+    {
+        const Texture *texture = (const Texture*)uniform->value;
+        HashCombine(hash, texture != nullptr ? texture->getID() : 0);
+    }
+    return (unsigned int)hash;
+}
+
+void Renderer::SetUpPerInstanceShader(const DrawBatch &batch)
+{
+    static Scene &scene = Scene::getInstance();
+    Shader &perInstanceShader = *batch.instancedShader;
+
+    // The variant draws with whatever the renderables' shader has been set up with.
+    // u_ViewPos has to point at the camera on both first so that copying it over doesn't overwrite the camera with a stale value
+    batch.shader->SetUniform("u_ViewPos", (void*)&scene.camera.position);
+    perInstanceShader.InheritUniformValues(batch.shader);
+    perInstanceShader.SetUniform("u_ViewPos", (void*)&scene.camera.position);
+    perInstanceShader.SetUniform("u_ShowCulledInstances", (void*)&_showCulledInstances);
+}
+
+const Shader *Renderer::PrepareDrawBatches(Shader &sceneShader, const glm::mat4 &viewProjection)
+{
+    static Scene &scene = Scene::getInstance();
+    if(_missingTexture == nullptr)
+        _missingTexture = ResourceManager::getInstance().GetTexture("tex_missing");
+
+    // Draw the scene's shader with the program that has the static uniforms baked in if there is one.
+    // Decided once per frame, after the uniforms have been pointed at the values of the first renderable drawn with it.
+    // Its per-draw uniforms are never baked in (see Init())
+    const Shader *sceneProgram = nullptr;
+    for(const DrawBatch &batch: _drawBatches)
+    {
+        if(batch.instancedShader != nullptr || batch.shader != &sceneShader || batch.numOfRenderables == 0)
+            continue;
+
+        const unsigned int i = _batchedRenderables[batch.firstRenderable];
+        _modelMatrices[i] = scene.transforms.getWorldMatrix(scene.renderables[i].entity);
+        MultiplyMat4(viewProjection, _modelMatrices[i], _mvpMatrices[i]);
+        sceneShader.SetUniform("u_ModelMatrix", (void*)&_modelMatrices[i]);
+        sceneShader.SetUniform("u_MVP", (void*)&_mvpMatrices[i]);
+        sceneShader.SetUniform("u_ViewPos", (void*)&scene.camera.position);
+        if(settings.specializeStaticUniforms)
+        {
+            sceneProgram = ShaderSpecializer::getInstance().Update(&sceneShader, settings.specializationFrameThreshold);
+        }
+        else
+        {
+            ShaderSpecializer::getInstance().Reset();
+            sceneProgram = &sceneShader;
+        }
+        break;
+    }
+
+    stats.numOfDrawCalls = 0;
+    stats.numOfInstancedBatches = 0;
+    stats.numOfInstances = 0;
+    stats.numOfMultiDrawCommands = 0;
+    for(unsigned int batchIndex = 0; batchIndex < _drawBatches.size(); batchIndex++)
+    {
+        // Batches the GPU culling pass left empty don't get drawn at all
+        DrawBatch &batch = _drawBatches[batchIndex];
+        if(batch.numOfRenderables == 0)
+            continue;
+
+        if(batch.multiDraw)
+        {
+            // All of the batches of a run share the variant, so the first one's shader stands in for the rest.
+            // Its textures and other uniforms are the same for all of them since they share a program and texture set in the sort key
+            if(batchIndex == 0 || !ContinuesMultiDraw(_drawBatches[batchIndex - 1], batch))
+            {
+                SetUpPerInstanceShader(batch);
+                stats.numOfDrawCalls++;
+            }
+            batch.program = batch.instancedShader;
+            stats.numOfMultiDrawCommands += batch.numOfIndirectCommands;
+            stats.numOfInstances += batch.numOfRenderables;
+        }
+        else if(batch.instancedShader != nullptr)
+        {
+            SetUpPerInstanceShader(batch);
+            // The attributes always start at the beginning of the ring, the base instance skips ahead to the frame's matrices
+            batch.model->SetInstanceBuffer(_instanceData.buffer);
+            batch.program = batch.instancedShader;
+            stats.numOfDrawCalls++;
+            stats.numOfInstancedBatches++;
+            stats.numOfInstances += batch.numOfRenderables;
+        }
+        else
+        {
+            batch.program = batch.shader == &sceneShader ? sceneProgram : batch.shader;
+            stats.numOfDrawCalls += batch.numOfRenderables;
+        }
+
+        const Shader &shader = batch.instancedShader != nullptr ? *batch.instancedShader : *batch.shader;
+        batch.pipelineState = GetScenePipelineState(*batch.program, GetNumOfTextures(shader), batch.transparent);
+        _numOfUsedTextureUnits = std::max(_numOfUsedTextureUnits, (unsigned int)batch.pipelineState->getDesc().textureTargets.size());
+    }
+    return sceneProgram;
+}
+
+void Renderer::RecordDraws(CommandList &commands, unsigned int sliceStart, unsigned int sliceEnd, const glm::mat4 &viewProjection)
+{
+    static Scene &scene = Scene::getInstance();
+
+    // The batches are in the order of their renderables, start at the first one that reaches into the slice
+    const auto firstBatch = std::upper_bound(_drawBatches.begin(), _drawBatches.end(), sliceStart, [](unsigned int renderable, const DrawBatch &batch)
+    {
+        return renderable < batch.firstRenderable + batch.numOfRenderables;
+    });
+    for(unsigned int batchIndex = firstBatch - _drawBatches.begin(); batchIndex < _drawBatches.size() && _drawBatches[batchIndex].firstRenderable < sliceEnd; batchIndex++)
+    {
+        const DrawBatch &batch = _drawBatches[batchIndex];
+        if(batch.numOfRenderables == 0)
+            continue;
+
+        if(batch.instancedShader != nullptr)
+        {
+            // Drawn as a whole by the slice the batch starts in
+            if(batch.firstRenderable < sliceStart)
+                continue;
+            Shader &perInstanceShader = *batch.instancedShader;
+
+            if(!batch.multiDraw)
+            {
+                RecordBindings(commands, batch, perInstanceShader, batch.model->getVAO());
+                commands.SetUniforms(perInstanceShader, *batch.program);
+                const unsigned int baseInstance = batch.baseInstance + (unsigned int)(_instanceData.offset / sizeof(glm::mat4));
+                commands.DrawInstanced(batch.model->getVertices().size(), batch.numOfRenderables, baseInstance);
+                continue;
+            }
+
+            // Consecutive multi draw batches with the same variant and pass go out as one call, recorded along with the first of them.
+            // Their commands were appended in batch order, so they're next to each other in the indirect buffer
+            if(batchIndex > 0 && ContinuesMultiDraw(_drawBatches[batchIndex - 1], batch))
+                continue;
+            unsigned int endBatch = batchIndex + 1;
+            while(endBatch < _drawBatches.size() && ContinuesMultiDraw(_drawBatches[endBatch - 1], _drawBatches[endBatch]))
+                endBatch++;
+
+            const RenderBufferBinding buffers[] =
+            {
+                { RenderBufferBindingType::RANGE, GL_SHADER_STORAGE_BUFFER, 0, _instanceData.buffer, _instanceData.offset, _instanceData.size },
+                { RenderBufferBindingType::BUFFER, GL_DRAW_INDIRECT_BUFFER, 0, _indirectCommandBuffer, 0, 0 },
+                { RenderBufferBindingType::BASE, GL_SHADER_STORAGE_BUFFER, GPUCuller::CULL_STATES_BINDING, _gpuCuller.getCullStateBuffer(), 0, 0 }
+            };
+            RecordBindings(commands, batch, perInstanceShader, GeometryPool::getInstance().getVAO(), buffers, _showCulledInstances ? 3 : 2);
+            commands.SetUniforms(perInstanceShader, *batch.program);
+
+            const DrawBatch &last = _drawBatches[endBatch - 1];
+            const unsigned int numOfCommands = last.indirectCommand + last.numOfIndirectCommands - batch.indirectCommand;
+            const size_t commandsOffset = _indirectCommandOffset + sizeof(DrawArraysIndirectCommand) * batch.indirectCommand;
+            unsigned long long numOfVerts = 0;
+            for(unsigned int i = batchIndex; i < endBatch; i++)
+                numOfVerts += (unsigned long long)_drawBatches[i].model->getVertices().size() * _drawBatches[i].numOfRenderables;
+            commands.MultiDrawIndirect(commandsOffset, numOfCommands, numOfVerts);
+            continue;
+        }
+
+        Shader &shader = *batch.shader;
+        RecordBindings(commands, batch, shader, batch.model->getVAO());
+        const unsigned int numOfVerts = batch.model->getVertices().size();
+        const unsigned int first = std::max(batch.firstRenderable, sliceStart);
+        const unsigned int end = std::min(batch.firstRenderable + batch.numOfRenderables, sliceEnd);
+        for(unsigned int j = first; j < end; j++)
+        {
+            const unsigned int i = _batchedRenderables[j];
+            const Renderable &renderable = scene.renderables[i];
+
+            _modelMatrices[i] = scene.transforms.getWorldMatrix(renderable.entity);
+            MultiplyMat4(viewProjection, _modelMatrices[i], _mvpMatrices[i]);
+            const RenderUniformValue uniformValues[] =
+            {
+                { "u_ModelMatrix", &_modelMatrices[i] },
+                { "u_MVP", &_mvpMatrices[i] },
+                { "u_ViewPos", &scene.camera.position }
+            };
+            commands.SetUniforms(shader, *batch.program, uniformValues, 3);
+            commands.Draw(numOfVerts);
+        }
+    }
+}
+
+void Renderer::RecordBindings(CommandList &commands, const DrawBatch &batch, const Shader &shader, unsigned int vertexArray,
+                              const RenderBufferBinding *buffers, unsigned int numOfBuffers) const
+{
+    static Scene &scene = Scene::getInstance();
+    commands.BindPipeline(batch.pipelineState);
+
+    // If there are textures present in the scene, go through them and bind the appropriate texture to the unit the pipeline state expects it at
     // Else just bind the missing texture
+    RenderTextureBinding textures[GLState::MAX_TEXTURE_UNITS];
+    unsigned int numOfTextures = 0;
+    const std::vector<unsigned int> &textureTargets = batch.pipelineState->getDesc().textureTargets;
     if(!scene.textures.empty())
     {
-        for (int i = 0; i < scene.textures.size() && i < textureUniforms.size() && i < 32; i++)
+        const std::vector<ShaderUniform*> textureUniforms = shader.getUniformsOfType(ShaderUniformType::TEX2D);
+        for(unsigned int i = 0; i < textureTargets.size(); i++)
         {
-            GL_CALL(glad_glActiveTexture(GL_TEXTURE0 + i));
-            
             const Texture* const tex = (Texture*)(textureUniforms[i])->value;
-            if(tex != nullptr && tex->getID() != 0)
-                tex->Bind();
+            if(tex != nullptr && tex->getID() != 0 && (unsigned int)tex->getTarget() == textureTargets[i])
+                textures[numOfTextures++] = { i, (unsigned int)tex->getTarget(), tex->getID() };
             else
-                missingTex.Bind();
+                textures[numOfTextures++] = { i, (unsigned int)_missingTexture->getTarget(), _missingTexture->getID() };
             // NOTE: As it stands right now, the missing texture's image unit index doesn't change from 0
             // That's bad for shaders with multiple textures because only GL_TEXTURE0 shows up as missing texture
             // (eg. the inside or outside of the mask should be missing tex if not specified)
@@ -119,34 +778,70 @@ void Renderer::DrawScene()
     }
     else
     {
-        GL_CALL(glad_glActiveTexture(GL_TEXTURE0));
-        missingTex.Bind();
+        textures[numOfTextures++] = { 0, (unsigned int)_missingTexture->getTarget(), _missingTexture->getID() };
     }
-    
-    int numOfVerts = scene.model->getVertices().size();
-    GL_CALL(glad_glDrawArrays(GL_TRIANGLES, 0, numOfVerts));
-    // GL_CALL(glad_glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0));
-    
-    // Unbind the textures in order if present, else just unbind the missing tex
-    if(!scene.textures.empty())
-    {    
-        for (int i = 0; i < scene.textures.size() && i < textureUniforms.size() && i < 32; i++)
-        {
-            GL_CALL(glad_glActiveTexture(GL_TEXTURE0 + i));
-            
-            const Texture* const tex = (Texture*)(textureUniforms[i])->value;
-            if(tex != nullptr && tex->getID() != 0)
-                tex->Unbind();
-            else
-                missingTex.Unbind();
-        }
+    commands.SetBindings(vertexArray, textures, numOfTextures, buffers, numOfBuffers);
+}
+
+unsigned int Renderer::GetNumOfTextures(const Shader &shader) const
+{
+    static Scene &scene = Scene::getInstance();
+    const size_t numOfTextureUniforms = shader.getUniformsOfType(ShaderUniformType::TEX2D).size();
+    return scene.textures.empty() ? 1 : std::min({ scene.textures.size(), numOfTextureUniforms, (size_t)GLState::MAX_TEXTURE_UNITS });
+}
+
+bool Renderer::ContinuesMultiDraw(const DrawBatch &previous, const DrawBatch &batch)
+{
+    return previous.multiDraw && batch.multiDraw && previous.instancedShader == batch.instancedShader && previous.transparent == batch.transparent;
+}
+
+const PipelineState *Renderer::GetScenePipelineState(const Shader &program, unsigned int numOfTextures, bool transparent)
+{
+    // The pipeline states only depend on the program, the number of textures and the pass as long as the render mode stays the same
+    if(_scenePipelineStatesRenderMode != settings.renderMode)
+    {
+        _scenePipelineStates.clear();
+        _scenePipelineStatesRenderMode = settings.renderMode;
     }
-    else
+
+    const unsigned long long key = ((unsigned long long)program.getID() << 32) | ((unsigned long long)transparent << 31) | numOfTextures;
+    auto pipelineState = _scenePipelineStates.find(key);
+    if(pipelineState != _scenePipelineStates.end())
+        return pipelineState->second;
+
+    PipelineStateDesc desc;
+    desc.program = program.getID();
+    desc.raster.polygonMode = (unsigned int)settings.renderMode;
+    desc.depth.testEnabled = true;
+    // Transparent renderables are drawn back to front after everything opaque, blending over it without occluding each other
+    desc.depth.writeEnabled = !transparent;
+    desc.blend.enabled = transparent;
+    if(transparent)
     {
-        GL_CALL(glad_glActiveTexture(GL_TEXTURE0));
-        missingTex.Unbind();
+        desc.blend.srcFactor = GL_SRC_ALPHA;
+        desc.blend.dstFactor = GL_ONE_MINUS_SRC_ALPHA;
     }
+    desc.textureTargets.assign(numOfTextures, GL_TEXTURE_2D);
+
+    const PipelineState *newPipelineState = PipelineStateCache::getInstance().Get(desc);
+    _scenePipelineStates[key] = newPipelineState;
+    return newPipelineState;
+}
+
+void Renderer::ReadScenePassTime()
+{
+    // The newest frame whose GPU times have arrived, which is never more than NUM_OF_PENDING_FRAMES behind
+    const ProfiledFrame *frame = FrameProfiler::getInstance().GetLatestFrame();
+    if(frame == nullptr || frame->frameIndex == _lastProfiledFrame)
+        return;
+    _lastProfiledFrame = frame->frameIndex;
+
+    const ProfiledScope *scenePass = frame->FindScope(SCENE_PASS_SCOPE);
+    if(scenePass == nullptr || scenePass->gpuTime < 0.0f)
+        return;
+    stats.scenePassTime = scenePass->gpuTime;
 
-    scene.shader->Unbind();
-    scene.model->Unbind();
-};
\ No newline at end of file
+    constexpr float smoothing = 0.05f;
+    float &averageTime = _scenePassSpecialized[frame->frameIndex % FrameProfiler::NUM_OF_PENDING_FRAMES] ? stats.specializedScenePassTime : stats.genericScenePassTime;
+    averageTime = averageTime == 0.0f ? stats.scenePassTime : averageTime + (stats.scenePassTime - averageTime) * smoothing;
+}
\ No newline at end of file
@@ -2,12 +2,25 @@
 
 #include <glad/glad.h>
 #include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
 
 #include "misc/singleton.hpp"
 #include "core/scene.hpp"
+#include "core/bvh.hpp"
+#include "core/software_occlusion_culler.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 #include "model.hpp"
+#include "pipeline_state.hpp"
+#include "render_queue.hpp"
+#include "gpu_culler.hpp"
+#include "ring_buffer.hpp"
+#include "frame_profiler.hpp"
+#include "command_list.hpp"
 
 enum class RenderMode
 {
@@ -19,19 +32,264 @@ struct RendererSettings
 {
     RenderMode renderMode = RenderMode::TRIANGLES;
     glm::vec4 bgColor = glm::vec4(23.0f/255.0f, 22.0f/255.0f, 26.0f/255.0f, 1.0f);
+
+    // Bake uniforms that haven't changed for a while into the shader as constants
+    bool specializeStaticUniforms = false;
+    int specializationFrameThreshold = 120;
+
+    // Skip drawing the renderables that are out of view
+    bool frustumCulling = true;
+
+    // Draw renderables that share a model and shader with one instanced draw call
+    bool instancing = true;
+    // Smaller groups are drawn one renderable at a time
+    int minInstancedBatchSize = 2;
+    // Draw every batch whose shader allows it with one multi draw indirect call per shader, out of the shared geometry pool.
+    // Takes priority over instancing when it's supported
+    bool multiDrawIndirect = true;
+
+    // Cull the multi draw batches in a compute shader instead of through the BVH, against the frustum
+    // and optionally a depth pyramid of the previous frame. Everything else still gets frustum culled on the CPU
+    bool gpuCulling = false;
+    bool occlusionCulling = true;
+    // Draw what the GPU culled as well, tinted red if it was outside the frustum and blue if it was occluded
+    bool showGPUCulled = false;
+    // Keep culling from where the camera was when this got turned on, so that what got culled can be looked at from elsewhere
+    bool freezeGPUCulling = false;
+
+    // Skip the renderables that are hidden behind the scene's occluders, tested on the CPU against a small depth buffer
+    // the occluders get rasterized into every frame. Only runs when the GPU isn't culling
+    bool softwareOcclusionCulling = false;
+
+    // Sort the draws by state and depth before submitting them
+    bool sortRenderQueue = true;
+
+    // Record the draws into command lists on worker threads, one slice of the batched renderables per thread.
+    // The lists get executed on the GL thread in order afterwards either way
+    bool parallelRecording = true;
+};
+
+struct RendererStats
+{
+    // GPU time of the scene pass, in milliseconds
+    float scenePassTime = 0.0f;
+    // Running averages of the scene pass time split by whether the shader was specialized,
+    // for comparing the fragment cost of the two
+    float genericScenePassTime = 0.0f;
+    float specializedScenePassTime = 0.0f;
+    bool isShaderSpecialized = false;
+
+    // CPU time it took to update the world matrices of the entities that moved, in milliseconds
+    float transformUpdateTime = 0.0f;
+    unsigned int numOfUpdatedTransforms = 0;
+    unsigned int numOfDrawCalls = 0;
+
+    // CPU time it took to refit the scene's BVH and frustum cull it, in milliseconds
+    float cullTime = 0.0f;
+    unsigned int numOfVisibleRenderables = 0;
+    unsigned int numOfCulledRenderables = 0;
+
+    // CPU time it took to rasterize the occluders and to test the renderables against them, in milliseconds
+    float occluderRasterTime = 0.0f;
+    float occlusionTestTime = 0.0f;
+    unsigned int numOfOccluders = 0;
+    unsigned int numOfOccluderTriangles = 0;
+    // How many of the renderables in view were tested against the occluders and how many of those were hidden
+    unsigned int numOfOcclusionTested = 0;
+    unsigned int numOfSoftwareOccluded = 0;
+
+    unsigned int numOfInstancedBatches = 0;
+    // How many of the renderables were drawn through instanced draw calls
+    unsigned int numOfInstances = 0;
+    // How many draws were packed into the multi draw indirect calls
+    unsigned int numOfMultiDrawCommands = 0;
+    // Read back from the GPU a few frames late, so they lag behind the rest
+    GPUCullStats gpuCulling;
+
+    // The state changes the draws would've caused in the order they were culled in and in the order they were submitted in
+    RenderQueueStateChanges stateChangesUnsorted;
+    RenderQueueStateChanges stateChangesSubmitted;
+    // CPU time it took to sort the render queue, in milliseconds
+    float sortTime = 0.0f;
+
+    // CPU time it took to record the draws and to execute the recorded commands on the GL thread, in milliseconds
+    float recordTime = 0.0f;
+    float submitTime = 0.0f;
+    unsigned int numOfRecordedLists = 0;
+    size_t numOfRecordedCommands = 0;
+
+    // How much of the streaming ring buffer the frame wrote and how long it waited for the GPU to free up its segment, in milliseconds
+    size_t streamedBytes = 0;
+    size_t streamingSegmentSize = 0;
+    float streamingWaitTime = 0.0f;
+
+    // CPU time from the start of the frame until it's handed off to be presented, in milliseconds
+    float frameTime = 0.0f;
+    // Running averages of the frame time split by the GL error check mode it was measured with
+    float frameTimeByErrorCheckMode[3] = {0.0f, 0.0f, 0.0f};
+};
+
+// Visible renderables next to each other in the sorted render queue that share a model, shader and pass
+struct DrawBatch
+{
+    Model *model;
+    Shader *shader;
+    // The variant of the shader that takes the model matrices per instance (instanced or multi draw),
+    // nullptr if the batch is drawn one renderable at a time
+    Shader *instancedShader;
+    bool transparent;
+    // The range of Renderer::_batchedRenderables the batch's renderables are in
+    unsigned int firstRenderable;
+    unsigned int numOfRenderables;
+    // Where the batch's model matrices start in the instance buffer
+    unsigned int baseInstance;
+    // Whether the batch is drawn through multi draw indirect, and which of the frame's indirect commands is its
+    bool multiDraw;
+    unsigned int indirectCommand;
+    // One for the whole batch, or one per renderable when the commands are written by the GPU culling pass
+    unsigned int numOfIndirectCommands;
+    // What the batch gets drawn with, resolved on the main thread before the draws are recorded
+    const Shader *program;
+    const PipelineState *pipelineState;
+};
+
+// The FrameData uniform block of the shaders that take their model matrices per instance, in std140
+struct FrameUniforms
+{
+    glm::mat4 viewProjection;
+};
+
+// Laid out the way glMultiDrawArraysIndirect reads it
+struct DrawArraysIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int first;
+    unsigned int baseInstance;
 };
 
 class Renderer : public Singleton<Renderer>
 {
     public:
+    // The shader feature that makes a shader read its model matrix from a per-instance attribute
+    static constexpr const char *INSTANCING_KEYWORD = "INSTANCED";
+    // The shader feature that makes a shader read its model matrix from the instance buffer bound as a storage buffer
+    static constexpr const char *MULTI_DRAW_KEYWORD = "MULTI_DRAW";
+    // Uniform buffer binding of the FrameData block
+    static constexpr unsigned int FRAME_UNIFORMS_BINDING = 0;
+    // What the streaming ring buffer starts out with per frame, it grows when a frame needs more
+    static constexpr size_t STREAMING_SEGMENT_SIZE = 1024 * 1024;
+    // The profiler scope timed on the GPU around the scene pass
+    static constexpr const char *SCENE_PASS_SCOPE = "Scene pass";
+    // Fewer batched renderables than this per worker aren't worth recording in parallel
+    static constexpr unsigned int MIN_RENDERABLES_PER_SLICE = 256;
+
     RendererSettings settings;
+    RendererStats stats;
 
     private:
     Model *_cube;
     Model *_quad;
+    // The last shader that was usable, drawn with while the scene's shader is still compiling
+    Shader *_lastReadyShader = nullptr;
+    // The pipeline states of the scene pass by program, number of textures and pass, for the render mode they were made with
+    std::unordered_map<unsigned long long, const PipelineState*> _scenePipelineStates;
+    RenderMode _scenePipelineStatesRenderMode = RenderMode::TRIANGLES;
+    unsigned int _numOfUsedTextureUnits = 0;
+    const Texture *_missingTexture = nullptr;
+
+    // The matrices the renderables were last drawn with, the shader uniforms point into these
+    std::vector<glm::mat4> _modelMatrices;
+    std::vector<glm::mat4> _mvpMatrices;
+
+    // BVH over the world space bounds of the scene's renderables, indexed the same as Scene::renderables
+    BVH _sceneBVH;
+    // The model each renderable's bounds were last computed with
+    std::vector<const Model*> _boundedModels;
+    std::vector<unsigned char> _movedEntities;
+    std::vector<unsigned int> _visibleRenderables;
+    SoftwareOcclusionCuller _occlusionCuller;
+
+    RenderQueue _renderQueue;
+    // This frame's batches and the visible renderables in the order they're submitted in
+    std::vector<DrawBatch> _drawBatches;
+    std::vector<unsigned int> _batchedRenderables;
+    // Everything that gets rewritten every frame is streamed through here: the frame's uniforms,
+    // the model matrices of the instanced and multi draw batches and the indirect commands the CPU writes
+    RingBuffer _streamingBuffer;
+    size_t _uniformBufferAlignment = 256;
+    size_t _storageBufferAlignment = 256;
+    // Model matrices of every instanced and multi draw batch
+    std::vector<glm::mat4> _instanceMatrices;
+    RingBufferAllocation _instanceData;
+    // One command per multi draw batch
+    std::vector<DrawArraysIndirectCommand> _indirectCommands;
+    // The commands the GPU culling pass writes, which don't go through the ring since the CPU never touches them
+    unsigned int _indirectBuffer = 0;
+    size_t _indirectBufferCapacity = 0;
+    // Where this frame's commands are, in either of the two
+    unsigned int _indirectCommandBuffer = 0;
+    size_t _indirectCommandOffset = 0;
+
+    GPUCuller _gpuCuller;
+    // Whether the culling shaders compiled
+    bool _gpuCullerReady = false;
+    std::vector<GPUCullCandidate> _cullCandidates;
+    // The camera the GPU culls with, which stays put while the culling is frozen
+    glm::mat4 _gpuCullViewProjection = glm::mat4(1.0f);
+    // The value of the multi draw shaders' u_ShowCulledInstances
+    int _showCulledInstances = 0;
+
+    CommandListRecorder _commandRecorder;
+
+    // Whether the scene pass of each of the profiler's frames that are still waiting on their GPU times drew specialized
+    bool _scenePassSpecialized[FrameProfiler::NUM_OF_PENDING_FRAMES] = {};
+    unsigned int _lastProfiledFrame = ~0u;
+    std::chrono::steady_clock::time_point _frameStartTime;
 
     public:
     void Init();
     void DeInit();
+    // Called around everything that happens during a frame
+    void BeginFrame();
+    void EndFrame();
     void DrawScene();
+    // Forgets about a shader that's about to be deleted
+    void OnShaderUnloaded(const Shader *shader);
+
+    private:
+    // Brings the scene BVH up to date with the renderables
+    void UpdateSceneBounds();
+    // Rasterizes the visible occluders on the CPU and drops the visible renderables that are hidden behind them
+    void CullOccludedRenderables(const glm::mat4 &viewProjection);
+    // Sorts the visible renderables through the render queue, splits them into batches
+    // and uploads the model matrices of the batches that get drawn instanced
+    // The multi draw batches get their commands written by the GPU culling pass instead, if it's on
+    void BuildDrawBatches(Shader &sceneShader, bool gpuCulling);
+    // The model and shader the renderable gets drawn with
+    void ResolveRenderable(unsigned int renderable, Shader &sceneShader, Model *&model, Shader *&shader) const;
+    // Identifies the textures the shader's samplers are set to, for the render queue's sort keys
+    unsigned int GetTextureSetKey(const Shader &shader) const;
+    // The shader's variant with the keyword on if the shader has it and the variant has finished compiling, nullptr otherwise
+    Shader *GetPerInstanceVariant(const Shader &shader, const char *keyword) const;
+    // Points the batch's per-instance variant at the uniform values of the shader it was made from
+    void SetUpPerInstanceShader(const DrawBatch &batch);
+    // Does everything the recording needs that isn't safe to do on the worker threads: picks the scene's program,
+    // sets up the per-instance shaders, resolves the pipeline states and counts the draws. Returns the scene's program,
+    // nullptr if nothing is drawn with it one renderable at a time
+    const Shader *PrepareDrawBatches(Shader &sceneShader, const glm::mat4 &viewProjection);
+    // Records the draws of the batched renderables in [sliceStart, sliceEnd). Instanced batches and runs of multi draw batches
+    // are recorded as a whole by the slice their first renderable is in. Runs on the worker threads
+    void RecordDraws(CommandList &commands, unsigned int sliceStart, unsigned int sliceEnd, const glm::mat4 &viewProjection);
+    // Records the pipeline state and the vertex array, textures and buffers the batch is drawn with
+    void RecordBindings(CommandList &commands, const DrawBatch &batch, const Shader &shader, unsigned int vertexArray,
+                        const RenderBufferBinding *buffers = nullptr, unsigned int numOfBuffers = 0) const;
+    // How many texture units the shader's pipeline state expects textures at
+    unsigned int GetNumOfTextures(const Shader &shader) const;
+    // Whether the batch goes out with the same multi draw call as the one before it
+    static bool ContinuesMultiDraw(const DrawBatch &previous, const DrawBatch &batch);
+    const PipelineState *GetScenePipelineState(const Shader &program, unsigned int numOfTextures, bool transparent);
+    void ReadScenePassTime();
+    // Whether the GPU culling pass can run this frame
+    bool IsGPUCullingActive() const;
 };
\ No newline at end of file
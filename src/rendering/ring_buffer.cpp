@@ -0,0 +1,238 @@
+#include "ring_buffer.hpp"
+
+#include "core/log.hpp"
+#include "gl_capture.hpp"
+#include "gl_extensions.hpp"
+#include "gl_state.hpp"
+#include "render_counters.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+void RingBuffer::Init(size_t segmentSize)
+{
+    DeInit();
+
+    _persistent = GLExtensions::bufferStorage;
+    CreateBuffer(segmentSize);
+}
+
+void RingBuffer::DeInit()
+{
+    for(GLsync &fence: _frameFences)
+    {
+        if(fence != nullptr)
+        {
+            GL_CALL(glad_glDeleteSync(fence));
+        }
+        fence = nullptr;
+    }
+
+    if(_buffer != 0)
+    {
+        if(_mappedData != nullptr)
+            Unmap(_buffer);
+        DeleteBuffer(_buffer);
+    }
+    for(const RetiredBuffer &retired: _retiredBuffers)
+    {
+        if(retired.mapped)
+            Unmap(retired.buffer);
+        DeleteBuffer(retired.buffer);
+    }
+    _retiredBuffers.clear();
+
+    _buffer = 0;
+    _segmentSize = 0;
+    _mappedData = nullptr;
+    _mappedOffset = 0;
+    _frameOffset = 0;
+}
+
+void RingBuffer::BeginFrame()
+{
+    const unsigned int segment = _frameIndex % NUM_OF_FRAMES_IN_FLIGHT;
+    GLsync &fence = _frameFences[segment];
+
+    _waitTime = 0.0f;
+    if(fence != nullptr)
+    {
+        // The first check flushes so that the fence is sure to get signaled eventually
+        const auto waitStartTime = std::chrono::steady_clock::now();
+        GLenum result = GL_CALL(glad_glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0));
+        while(result == GL_TIMEOUT_EXPIRED)
+        {
+            result = GL_CALL(glad_glClientWaitSync(fence, 0, 1000000));
+        }
+        if(result == GL_WAIT_FAILED)
+            Log::LogError("Waiting on a ring buffer frame fence failed");
+        _waitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - waitStartTime).count();
+
+        GL_CALL(glad_glDeleteSync(fence));
+        fence = nullptr;
+    }
+
+    // Every frame up to the one whose fence was just waited on is done, along with the buffers they used
+    auto firstInUse = std::remove_if(_retiredBuffers.begin(), _retiredBuffers.end(), [this](const RetiredBuffer &retired)
+    {
+        if(retired.lastFrame + NUM_OF_FRAMES_IN_FLIGHT > _frameIndex)
+            return false;
+        DeleteBuffer(retired.buffer);
+        return true;
+    });
+    _retiredBuffers.erase(firstInUse, _retiredBuffers.end());
+
+    _frameOffset = 0;
+    _capturedOffset = 0;
+}
+
+void RingBuffer::EndFrame()
+{
+    Flush();
+
+    const unsigned int segment = _frameIndex % NUM_OF_FRAMES_IN_FLIGHT;
+    _frameFences[segment] = GL_CALL(glad_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+    _frameIndex++;
+}
+
+RingBufferAllocation RingBuffer::Allocate(size_t size, size_t alignment)
+{
+    // Not initialized
+    if(_buffer == 0)
+        return RingBufferAllocation();
+
+    size_t offset = (_frameOffset + alignment - 1) & ~(alignment - 1);
+    if(offset + size > _segmentSize)
+    {
+        Grow(_frameOffset + size + alignment);
+        offset = (_frameOffset + alignment - 1) & ~(alignment - 1);
+    }
+
+    const size_t segmentStart = (_frameIndex % NUM_OF_FRAMES_IN_FLIGHT) * _segmentSize;
+    if(_mappedData == nullptr)
+    {
+        // Without buffer storage only the part of the segment that's left gets mapped, without waiting on the GPU since the fence already has
+        GLState::getInstance().BindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+        _mappedOffset = segmentStart + offset;
+        _mappedData = (unsigned char*)GL_CALL(glad_glMapBufferRange(GL_COPY_WRITE_BUFFER, _mappedOffset, _segmentSize - offset,
+                                                                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+        if(_mappedData == nullptr)
+        {
+            Log::LogError("Failed to map the ring buffer");
+            return RingBufferAllocation();
+        }
+    }
+
+    RingBufferAllocation allocation;
+    allocation.buffer = _buffer;
+    allocation.offset = segmentStart + offset;
+    allocation.size = size;
+    allocation.data = _mappedData + (allocation.offset - _mappedOffset);
+    _frameOffset = offset + size;
+    // Whatever gets allocated is about to be written to
+    RenderCounters::getInstance().CountBufferUpload(size);
+    return allocation;
+}
+
+RingBufferAllocation RingBuffer::Upload(const void *data, size_t size, size_t alignment)
+{
+    RingBufferAllocation allocation = Allocate(size, alignment);
+    if(allocation.data != nullptr)
+        std::memcpy(allocation.data, data, size);
+    return allocation;
+}
+
+void RingBuffer::Flush()
+{
+    CaptureWrites();
+    if(_persistent)
+        return;
+
+    if(_mappedData != nullptr)
+    {
+        Unmap(_buffer);
+        _mappedData = nullptr;
+    }
+    for(RetiredBuffer &retired: _retiredBuffers)
+    {
+        if(retired.mapped)
+            Unmap(retired.buffer);
+        retired.mapped = false;
+    }
+}
+
+void RingBuffer::CreateBuffer(size_t segmentSize)
+{
+    GLState &glState = GLState::getInstance();
+    const size_t size = segmentSize * NUM_OF_FRAMES_IN_FLIGHT;
+
+    GL_CALL(glad_glGenBuffers(1, &_buffer));
+    glState.BindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+    if(_persistent)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GL_CALL(GLExtensions::glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags));
+        _mappedData = (unsigned char*)GL_CALL(glad_glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+        _mappedOffset = 0;
+        if(_mappedData == nullptr)
+        {
+            // Keeps going the way it would without buffer storage
+            Log::LogError("Failed to persistently map the ring buffer");
+            _persistent = false;
+            GL_CALL(glad_glDeleteBuffers(1, &_buffer));
+            glState.OnBufferDeleted(_buffer);
+            CreateBuffer(segmentSize);
+            return;
+        }
+    }
+    else
+    {
+        GL_CALL(glad_glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW));
+        _mappedData = nullptr;
+    }
+    _segmentSize = segmentSize;
+}
+
+void RingBuffer::Grow(size_t minSegmentSize)
+{
+    // The frames in flight might still be reading the old buffer and this frame's allocations so far are in it,
+    // so it's only deleted once they're done
+    // The fences are kept even though nothing's been written to the new buffer yet, they're what tells when the old one is free
+    CaptureWrites();
+    _retiredBuffers.push_back({ _buffer, _frameIndex, !_persistent && _mappedData != nullptr });
+
+    const size_t segmentSize = std::max(_segmentSize * 2, minSegmentSize);
+    Log::LogInfo("Growing the ring buffer to " + std::to_string(segmentSize / 1024) + " KB per frame");
+    CreateBuffer(segmentSize);
+    _frameOffset = 0;
+    _capturedOffset = 0;
+}
+
+void RingBuffer::CaptureWrites()
+{
+    GLCapture &capture = GLCapture::getInstance();
+    if(!capture.isCapturingFrames() || _mappedData == nullptr)
+        return;
+
+    // Only what's been allocated since the last time, and only the part of it the current mapping covers
+    const size_t segmentStart = (_frameIndex % NUM_OF_FRAMES_IN_FLIGHT) * _segmentSize;
+    const size_t start = std::max(segmentStart + _capturedOffset, _mappedOffset);
+    const size_t end = segmentStart + _frameOffset;
+    if(end > start)
+        capture.RecordBufferContents(_buffer, start, end - start, _mappedData + (start - _mappedOffset));
+    _capturedOffset = _frameOffset;
+}
+
+void RingBuffer::Unmap(unsigned int buffer)
+{
+    GLState::getInstance().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    GL_CALL(glad_glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+}
+
+void RingBuffer::DeleteBuffer(unsigned int buffer)
+{
+    GL_CALL(glad_glDeleteBuffers(1, &buffer));
+    GLState::getInstance().OnBufferDeleted(buffer);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// A piece of the ring that's valid for the rest of the frame it was allocated in
+struct RingBufferAllocation final
+{
+    unsigned int buffer = 0;
+    size_t offset = 0;
+    size_t size = 0;
+    // Where to write the data to, nullptr if the allocation failed
+    void *data = nullptr;
+};
+
+/*
+Streams data that gets rewritten every frame (uniform blocks, instance data, indirect commands) out of one buffer
+that's split into a segment per frame in flight. Allocations are bumped off of the current frame's segment and
+bound with glBindBufferRange or by their offset, so nothing ever gets reallocated or orphaned.
+Before a segment gets reused, the fence of the frame that last wrote it is waited on, which only blocks
+when the CPU has gotten more than NUM_OF_FRAMES_IN_FLIGHT frames ahead of the GPU.
+With ARB_buffer_storage the buffer stays mapped (persistent and coherent) for its whole life.
+Without it, the rest of the frame's segment gets mapped unsynchronized when it's first written to and has to be
+unmapped through Flush() before the GPU reads from it.
+When a frame doesn't fit, the ring grows into a new buffer. The old one stays alive (and mapped)
+until the frames that used it are done, so the frame's earlier allocations stay valid.
+*/
+class RingBuffer final
+{
+    public:
+    static constexpr unsigned int NUM_OF_FRAMES_IN_FLIGHT = 3;
+
+    private:
+    struct RetiredBuffer final
+    {
+        unsigned int buffer;
+        // The frame after which the GPU no longer reads it
+        unsigned int lastFrame;
+        // Still mapped without ARB_buffer_storage until the frame it got replaced in is flushed
+        bool mapped;
+    };
+
+    unsigned int _buffer = 0;
+    size_t _segmentSize = 0;
+    bool _persistent = false;
+    unsigned char *_mappedData = nullptr;
+    // Where the mapping starts when it only covers part of the buffer
+    size_t _mappedOffset = 0;
+
+    GLsync _frameFences[NUM_OF_FRAMES_IN_FLIGHT] = {};
+    unsigned int _frameIndex = 0;
+    // Where the next allocation starts, relative to the current frame's segment
+    size_t _frameOffset = 0;
+    // How much of the current frame's segment has been handed over to the GL capture
+    size_t _capturedOffset = 0;
+    std::vector<RetiredBuffer> _retiredBuffers;
+
+    // CPU time the last BeginFrame() spent waiting on the GPU, in milliseconds
+    float _waitTime = 0.0f;
+
+    public:
+    void Init(size_t segmentSize);
+    void DeInit();
+
+    // Waits until the GPU is done with the segment the frame is about to write
+    void BeginFrame();
+    // Fences the frame's segment off until the GPU is done reading it. Has to come after the frame's last draw that reads from the ring
+    void EndFrame();
+
+    // Alignment has to be a power of 2, eg. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for a uniform block
+    RingBufferAllocation Allocate(size_t size, size_t alignment);
+    // Copies the data into a new allocation
+    RingBufferAllocation Upload(const void *data, size_t size, size_t alignment);
+    // Makes everything written so far visible to the GPU. Only does anything when the buffer can't stay mapped
+    void Flush();
+
+    inline unsigned int getBuffer() const { return _buffer; }
+    inline size_t getSegmentSize() const { return _segmentSize; }
+    inline size_t getFrameUsage() const { return _frameOffset; }
+    inline bool isPersistent() const { return _persistent; }
+    inline float getWaitTime() const { return _waitTime; }
+
+    private:
+    void CreateBuffer(size_t segmentSize);
+    // Replaces the buffer with one whose segments fit at least minSegmentSize, in the middle of a frame
+    void Grow(size_t minSegmentSize);
+    // Writes through the mapping never go through GL, so while GL calls are being captured they get recorded by hand
+    void CaptureWrites();
+    static void Unmap(unsigned int buffer);
+    static void DeleteBuffer(unsigned int buffer);
+};
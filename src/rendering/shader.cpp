@@ -1,65 +1,35 @@
 #include "shader.hpp"
 
 #include "core/log.hpp"
+#include "core/trace.hpp"
 #include "misc/utils.hpp"
 #include "texture.hpp"
+#include "shader_compiler.hpp"
+#include "gl_extensions.hpp"
+#include "gl_state.hpp"
+#include "pipeline_state.hpp"
+#include "render_counters.hpp"
 
 #include <sstream>
 
-Shader::Shader(const char *vertSource, const char *fragSource): _id(0)
+Shader::Shader(const char *vertSource, const char *fragSource)
+    : _id(0), _status(ShaderStatus::PENDING), _vertSource(vertSource), _fragSource(fragSource)
 {
-    unsigned int vertShader, fragShader;
-    
-    // Create and compile VERTEX shader
-    vertShader = GL_CALL(glad_glCreateShader(GL_VERTEX_SHADER));
-    GL_CALL(glad_glShaderSource(vertShader, 1, &vertSource, 0));
-    GL_CALL(glad_glCompileShader(vertShader));
-    CheckShaderForErrors(vertShader);
-
-    // Create and compile FRAGMENT shader
-    fragShader = GL_CALL(glad_glCreateShader(GL_FRAGMENT_SHADER));
-    GL_CALL(glad_glShaderSource(fragShader, 1, &fragSource, 0));
-    GL_CALL(glad_glCompileShader(fragShader));
-    CheckShaderForErrors(fragShader);
-
-    // Link PROGRAM
-    _id = GL_CALL(glad_glCreateProgram());
-    GL_CALL(glad_glAttachShader(_id, vertShader));
-    GL_CALL(glad_glAttachShader(_id, fragShader));
-    GL_CALL(glad_glLinkProgram(_id));
-
-    GL_CALL(glad_glDeleteShader(vertShader));
-    GL_CALL(glad_glDeleteShader(fragShader));
-
-    // Uniform parsing
-    std::stringstream vertStream(vertSource), fragStream(fragSource);
-    std::string line;
-    // Go through every line of the VERTEX shader
-    // and save the shader uniform if one was declared on the given line
-    while(vertStream.good())
-    {
-        std::getline(vertStream, line, '\n');
-        
-        auto uniform = ParseShaderUniformLine(line);
-        if(uniform != nullptr)
-            _uniforms.push_back(std::move(uniform));    
-    }
-    line.clear();
-
-    // Go through every line of the FRAGMENT shader
-    // and save the shader uniform if one was declared on the given line
-    while(fragStream.good())
-    {
-        std::getline(fragStream, line, '\n');
-        
-        auto uniform = ParseShaderUniformLine(line);
-        if(uniform != nullptr)
-            _uniforms.push_back(std::move(uniform));    
-    }
+    // The ShaderCompiler decides whether the compile gets submitted right away
+    // or on the worker context, and finishes the shader once the driver is done with it
+    ShaderCompiler::getInstance().Submit(this);
 }
 Shader::~Shader()
 {
+    ShaderCompiler::getInstance().Cancel(this);
+
+    if(_compileFence != nullptr)
+    {
+        GL_CALL(glad_glDeleteSync(_compileFence));
+    }
     GL_CALL(glad_glDeleteProgram(_id));
+    GLState::getInstance().OnProgramDeleted(_id);
+    PipelineStateCache::getInstance().OnProgramDeleted(_id);
 }
 // Copy
 Shader::Shader(const Shader& other)
@@ -68,6 +38,12 @@ Shader::Shader(const Shader& other)
     {
         this->_id = other._id;
         this->_uniforms = other._uniforms;
+        this->_status = other._status;
+        this->_vertSource = other._vertSource;
+        this->_fragSource = other._fragSource;
+        this->_name = other._name;
+        this->_defines = other._defines;
+        this->_keywords = other._keywords;
     }
 }
 Shader& Shader::operator=(Shader other)
@@ -76,6 +52,12 @@ Shader& Shader::operator=(Shader other)
     {
         this->_id = other._id;
         this->_uniforms = other._uniforms;
+        this->_status = other._status;
+        this->_vertSource = other._vertSource;
+        this->_fragSource = other._fragSource;
+        this->_name = other._name;
+        this->_defines = other._defines;
+        this->_keywords = other._keywords;
     }
     return *this;
 }
@@ -86,6 +68,12 @@ Shader::Shader(Shader&& other)
     {
         this->_id = std::move(other._id);
         this->_uniforms = std::move(other._uniforms);
+        this->_status = std::move(other._status);
+        this->_vertSource = std::move(other._vertSource);
+        this->_fragSource = std::move(other._fragSource);
+        this->_name = std::move(other._name);
+        this->_defines = std::move(other._defines);
+        this->_keywords = std::move(other._keywords);
     }
 }
 Shader& Shader::operator=(Shader&& other)
@@ -94,18 +82,138 @@ Shader& Shader::operator=(Shader&& other)
     {
         this->_id = std::move(other._id);
         this->_uniforms = std::move(other._uniforms);
+        this->_status = std::move(other._status);
+        this->_vertSource = std::move(other._vertSource);
+        this->_fragSource = std::move(other._fragSource);
+        this->_name = std::move(other._name);
+        this->_defines = std::move(other._defines);
+        this->_keywords = std::move(other._keywords);
     }
     return *this;
 }
 
 void Shader::Bind() const
 {
-    GL_CALL(glad_glUseProgram(_id));
-    UpdateUniforms();
+    GLState::getInstance().UseProgram(_id);
+    UpdateUniforms(_id);
+}
+void Shader::BindSpecialization(const Shader &specialization) const
+{
+    GLState::getInstance().UseProgram(specialization._id);
+    // The baked uniforms don't exist in the specialized program,
+    // their location comes back as -1 which makes GL ignore the upload
+    UpdateUniforms(specialization._id);
 }
 void Shader::Unbind() const
 {
-    GL_CALL(glad_glUseProgram(0));
+#ifdef GL_STATE_VALIDATION
+    GLState::getInstance().UseProgram(0);
+#endif
+}
+
+void Shader::SubmitCompile()
+{
+    TRACE_ZONE_DETAIL("Compile shader", _name);
+
+    const char *vertSource = _vertSource.c_str();
+    const char *fragSource = _fragSource.c_str();
+
+    // Create and compile VERTEX shader
+    _vertShader = GL_CALL(glad_glCreateShader(GL_VERTEX_SHADER));
+    GL_CALL(glad_glShaderSource(_vertShader, 1, &vertSource, 0));
+    GL_CALL(glad_glCompileShader(_vertShader));
+
+    // Create and compile FRAGMENT shader
+    _fragShader = GL_CALL(glad_glCreateShader(GL_FRAGMENT_SHADER));
+    GL_CALL(glad_glShaderSource(_fragShader, 1, &fragSource, 0));
+    GL_CALL(glad_glCompileShader(_fragShader));
+
+    // Link PROGRAM
+    // The link is issued right away without waiting on the compile results,
+    // a failed compile simply makes the link fail as well
+    _id = GL_CALL(glad_glCreateProgram());
+    GL_CALL(glad_glAttachShader(_id, _vertShader));
+    GL_CALL(glad_glAttachShader(_id, _fragShader));
+    GL_CALL(glad_glLinkProgram(_id));
+}
+bool Shader::IsCompileFinished() const
+{
+    // Compiled on the worker context, the fence gets signaled once the program has been linked
+    if(_compileFence != nullptr)
+    {
+        GLenum result = GL_CALL(glad_glClientWaitSync(_compileFence, 0, 0));
+        return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED;
+    }
+
+    // Compiled on this context, ask the driver whether its compiler threads are done with the program
+    if(GLExtensions::parallelShaderCompile)
+    {
+        int isComplete = GL_FALSE;
+        GL_CALL(glad_glGetProgramiv(_id, GL_COMPLETION_STATUS_KHR, &isComplete));
+        return isComplete == GL_TRUE;
+    }
+
+    // There is no way of knowing without blocking
+    return true;
+}
+void Shader::FinishCompile()
+{
+    TRACE_ZONE_DETAIL("Finish shader compile", _name);
+
+    if(_compileFence != nullptr)
+    {
+        GL_CALL(glad_glClientWaitSync(_compileFence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED));
+        GL_CALL(glad_glDeleteSync(_compileFence));
+        _compileFence = nullptr;
+    }
+
+    bool compiled = CheckShaderForErrors(_vertShader);
+    compiled = CheckShaderForErrors(_fragShader) && compiled;
+    bool linked = compiled && CheckProgramForErrors(_id);
+
+    GL_CALL(glad_glDetachShader(_id, _vertShader));
+    GL_CALL(glad_glDetachShader(_id, _fragShader));
+    GL_CALL(glad_glDeleteShader(_vertShader));
+    GL_CALL(glad_glDeleteShader(_fragShader));
+    _vertShader = 0;
+    _fragShader = 0;
+
+    if(!linked)
+    {
+        _status = ShaderStatus::FAILED;
+        return;
+    }
+
+    // Uniform parsing
+    std::stringstream vertStream(_vertSource), fragStream(_fragSource);
+    std::string line;
+    // Go through every line of the VERTEX shader
+    // and save the shader uniform if one was declared on the given line
+    while(vertStream.good())
+    {
+        std::getline(vertStream, line, '\n');
+        
+        auto uniform = ParseShaderUniformLine(line);
+        if(uniform != nullptr)
+            _uniforms.push_back(std::move(uniform));    
+    }
+    line.clear();
+
+    // Go through every line of the FRAGMENT shader
+    // and save the shader uniform if one was declared on the given line
+    while(fragStream.good())
+    {
+        std::getline(fragStream, line, '\n');
+        
+        auto uniform = ParseShaderUniformLine(line);
+        if(uniform != nullptr)
+            _uniforms.push_back(std::move(uniform));    
+    }
+
+    _status = ShaderStatus::READY;
+
+    if(_inheritUniformsFrom != nullptr)
+        InheritUniformValues(_inheritUniformsFrom);
 }
 
 void Shader::SetUniform(const std::string &name, const void* value)
@@ -118,13 +226,50 @@ void Shader::SetUniform(const std::string &name, const void* value)
         }
     }
 }
-void Shader::UpdateUniforms() const
+void Shader::InheritUniformValues(const Shader *other)
+{
+    // A shader that isn't ready doesn't have any uniforms to inherit from
+    if(other == nullptr || other == this || !other->isReady())
+        return;
+
+    if(!isReady())
+    {
+        _inheritUniformsFrom = other;
+        return;
+    }
+
+    for(ShaderUniform *uniform: _uniforms)
+    {
+        for(const ShaderUniform *otherUniform: other->_uniforms)
+        {
+            if(otherUniform->getName() == uniform->getName())
+            {
+                uniform->CopyValue(*otherUniform);
+                break;
+            }
+        }
+    }
+    _inheritUniformsFrom = nullptr;
+}
+void Shader::ReplaceProgram(Shader &replacement)
+{
+    // Whatever was set up through the UI should survive the reload
+    replacement.InheritUniformValues(this);
+
+    std::swap(_id, replacement._id);
+    std::swap(_status, replacement._status);
+    std::swap(_uniforms, replacement._uniforms);
+    std::swap(_vertSource, replacement._vertSource);
+    std::swap(_fragSource, replacement._fragSource);
+    std::swap(_keywords, replacement._keywords);
+}
+void Shader::UpdateUniforms(unsigned int programID) const
 {
     // Go through each uniform and update its value
     // The appropriate function must be used for the appropriate type 
     for(auto &uniform: _uniforms)
     {
-        unsigned int uniformLocation = GL_CALL(glad_glGetUniformLocation(_id, uniform->getName().c_str()));
+        unsigned int uniformLocation = GL_CALL(glad_glGetUniformLocation(programID, uniform->getName().c_str()));
         switch(uniform->getType())
         {
             case ShaderUniformType::INT:
@@ -166,11 +311,12 @@ void Shader::UpdateUniforms() const
             break;
         }
     }
+    RenderCounters::getInstance().CountUniformUploads((unsigned int)_uniforms.size());
 }
 
 // Reports on the potential shader compile errors
 // so that they are known and can be fixed
-void Shader::CheckShaderForErrors(unsigned int shader)
+bool Shader::CheckShaderForErrors(unsigned int shader)
 {
     int success;
     char infoLog[512];
@@ -182,6 +328,22 @@ void Shader::CheckShaderForErrors(unsigned int shader)
         glGetShaderInfoLog(shader, 512, NULL, infoLog);
         Log::LogError("Shader error: " + std::string(infoLog));
     }
+    return success;
+}
+// Reports on the potential program link errors
+bool Shader::CheckProgramForErrors(unsigned int program)
+{
+    int success;
+    char infoLog[512];
+
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    if(!success)
+    {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        Log::LogError("Shader link error: " + std::string(infoLog));
+    }
+    return success;
 }
 
 // Parses the specified line of shader code and checks if a uniform is declared on it
@@ -295,7 +457,7 @@ ShaderUniform* const Shader::ParseShaderUniformLine(const std::string &line)
 
 
             case ShaderUniformType::TEX2D:
-                value = (void*)new Texture;
+                value = (void*)ShaderUniform::GetEmptyTexture();
             break;
         }
 
@@ -3,16 +3,45 @@
 #include <glad/glad.h>
 
 #include "shader_uniform.hpp"
+#include "shader_preprocessor.hpp"
 
 #include <vector>
+#include <string>
+#include <set>
+
+enum class ShaderStatus
+{
+    // Compile and link have been submitted but the results aren't known yet
+    PENDING = 0,
+    READY,
+    FAILED
+};
 
 class Shader
 {
+    friend class ShaderCompiler;
+
     private:
     unsigned int _id = 0;
     std::vector<ShaderUniform*> _uniforms;
 
+    ShaderStatus _status = ShaderStatus::PENDING;
+    // The uniforms can only be parsed once the program has finished linking.
+    // The sources are kept around afterwards as well so that specialized programs can be derived from them
+    std::string _vertSource, _fragSource;
+    unsigned int _vertShader = 0, _fragShader = 0;
+    // Signaled by the compile worker context once the program has been linked
+    GLsync _compileFence = nullptr;
+
+    // Which shader files and injected defines the program was built from
+    std::string _name;
+    ShaderDefines _defines;
+    std::set<std::string> _keywords;
+    // The shader whose uniform values get carried over once this one has finished compiling
+    const Shader *_inheritUniformsFrom = nullptr;
+
     public:
+    // Only submits the shader for compilation, the shader isn't usable until isReady() returns true
     Shader(const char *vertSource, const char *fragSource);
     // Copy
     Shader(const Shader& other);
@@ -24,9 +53,26 @@ class Shader
 
     public:
     void Bind() const;
+    // Binds a program derived from this shader (eg. with some of the uniforms baked in as constants)
+    // and uploads this shader's uniform values to it
+    void BindSpecialization(const Shader &specialization) const;
     void Unbind() const;
 
     inline const unsigned int &getID() const { return _id; }
+    inline const ShaderStatus &getStatus() const { return _status; }
+    inline bool isReady() const { return _status == ShaderStatus::READY; }
+    inline const std::string &getName() const { return _name; }
+    inline const std::string &getVertSource() const { return _vertSource; }
+    inline const std::string &getFragSource() const { return _fragSource; }
+    inline const ShaderDefines &getDefines() const { return _defines; }
+    inline const std::set<std::string> &getKeywords() const { return _keywords; }
+
+    inline void setVariantInfo(const std::string &name, const ShaderDefines &defines, const std::set<std::string> &keywords)
+    {
+        _name = name;
+        _defines = defines;
+        _keywords = keywords;
+    }
     inline const std::vector<ShaderUniform*> &getUniforms() const { return _uniforms; };
     inline const std::vector<ShaderUniform*> getUniformsOfType(const ShaderUniformType &type) const 
     {
@@ -40,9 +86,24 @@ class Shader
     }
 
     void SetUniform(const std::string &name, const void* value);
+    // Copies the values of the uniforms both shaders have in common from the other shader.
+    // If this shader is still compiling, the values get copied once it's done
+    void InheritUniformValues(const Shader *other);
+    // Takes over the program, uniforms and sources of a newly compiled shader, eg. after its files were edited.
+    // Everything referencing this shader keeps pointing at a valid object while the replacement ends up with the old program
+    void ReplaceProgram(Shader &replacement);
 
     private:
-    void UpdateUniforms() const;
-    void CheckShaderForErrors(unsigned int shader);
+    // Issues the compile and link commands without querying any results so that the driver can do the work in the background
+    void SubmitCompile();
+    // Whether the results of the compile can be queried without blocking
+    bool IsCompileFinished() const;
+    // Checks the compile results and parses the uniforms. Blocks if the compile isn't finished yet
+    void FinishCompile();
+
+    // Uploads the uniform values to the given program, uniforms the program doesn't have are skipped
+    void UpdateUniforms(unsigned int programID) const;
+    bool CheckShaderForErrors(unsigned int shader);
+    bool CheckProgramForErrors(unsigned int program);
     ShaderUniform* const ParseShaderUniformLine(const std::string &line);
 };
\ No newline at end of file
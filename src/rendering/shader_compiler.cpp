@@ -0,0 +1,172 @@
+#include "shader_compiler.hpp"
+
+#include "core/log.hpp"
+#include "core/trace.hpp"
+#include "gl_extensions.hpp"
+
+#include <algorithm>
+
+void ShaderCompiler::Init(GLFWwindow* const mainWindow)
+{
+    if(GLExtensions::parallelShaderCompile)
+    {
+        // Let the driver use as many compiler threads as it sees fit
+        GLExtensions::glMaxShaderCompilerThreads(0xFFFFFFFF);
+        return;
+    }
+
+    // The context hints set for the main window are still in effect,
+    // so the worker context ends up with the same version and profile
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    _workerContext = glfwCreateWindow(1, 1, "Shader compiler", NULL, mainWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if(_workerContext == nullptr)
+    {
+        Log::LogWarning("Couldn't create the shader compiler context, shaders will be compiled on the main thread");
+        return;
+    }
+
+    _workerRunning = true;
+    _workerThread = std::thread(&ShaderCompiler::WorkerLoop, this);
+    Log::LogInfo("Shaders will be compiled on a worker thread");
+}
+void ShaderCompiler::DeInit()
+{
+    if(_workerContext == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_workerMutex);
+        _workerRunning = false;
+    }
+    _workerCondition.notify_all();
+    _workerThread.join();
+
+    glfwDestroyWindow(_workerContext);
+    _workerContext = nullptr;
+}
+
+void ShaderCompiler::Submit(Shader *shader)
+{
+    if(isUsingWorkerThread())
+    {
+        {
+            std::lock_guard<std::mutex> lock(_workerMutex);
+            _workerQueue.push_back(shader);
+        }
+        _workerCondition.notify_all();
+        return;
+    }
+
+    shader->SubmitCompile();
+    _pendingShaders.push_back(shader);
+}
+void ShaderCompiler::Cancel(Shader *shader)
+{
+    if(isUsingWorkerThread())
+    {
+        std::unique_lock<std::mutex> lock(_workerMutex);
+        // Can't pull the shader out from under the worker, wait for it to be done with it
+        _workerCondition.wait(lock, [&]() { return _workerCurrentShader != shader; });
+
+        _workerQueue.erase(std::remove(_workerQueue.begin(), _workerQueue.end(), shader), _workerQueue.end());
+        _workerCompiled.erase(std::remove(_workerCompiled.begin(), _workerCompiled.end(), shader), _workerCompiled.end());
+    }
+
+    _pendingShaders.erase(std::remove(_pendingShaders.begin(), _pendingShaders.end(), shader), _pendingShaders.end());
+
+    if(shader->_vertShader != 0)
+    {
+        GL_CALL(glad_glDeleteShader(shader->_vertShader));
+        shader->_vertShader = 0;
+    }
+    if(shader->_fragShader != 0)
+    {
+        GL_CALL(glad_glDeleteShader(shader->_fragShader));
+        shader->_fragShader = 0;
+    }
+}
+
+void ShaderCompiler::Update()
+{
+    TRACE_ZONE("Shader compiler update");
+
+    CollectWorkerResults();
+
+    for(auto it = _pendingShaders.begin(); it != _pendingShaders.end();)
+    {
+        Shader *shader = *it;
+        if(shader->IsCompileFinished())
+        {
+            shader->FinishCompile();
+            it = _pendingShaders.erase(it);
+        }
+        else
+            it++;
+    }
+}
+void ShaderCompiler::WaitFor(Shader *shader)
+{
+    if(shader == nullptr || shader->getStatus() != ShaderStatus::PENDING)
+        return;
+
+    TRACE_ZONE_DETAIL("Wait for shader", shader->getName());
+    if(isUsingWorkerThread())
+    {
+        std::unique_lock<std::mutex> lock(_workerMutex);
+        _workerCondition.wait(lock, [&]()
+        {
+            return std::find(_workerCompiled.begin(), _workerCompiled.end(), shader) != _workerCompiled.end();
+        });
+    }
+    CollectWorkerResults();
+
+    auto it = std::find(_pendingShaders.begin(), _pendingShaders.end(), shader);
+    if(it != _pendingShaders.end())
+    {
+        shader->FinishCompile();
+        _pendingShaders.erase(it);
+    }
+}
+
+void ShaderCompiler::WorkerLoop()
+{
+    TRACE_THREAD_NAME("Shader compiler");
+    glfwMakeContextCurrent(_workerContext);
+
+    std::unique_lock<std::mutex> lock(_workerMutex);
+    while(true)
+    {
+        _workerCondition.wait(lock, [&]() { return !_workerRunning || !_workerQueue.empty(); });
+        if(!_workerRunning)
+            break;
+
+        _workerCurrentShader = _workerQueue.front();
+        _workerQueue.pop_front();
+        lock.unlock();
+
+        _workerCurrentShader->SubmitCompile();
+        // The fence lets the main context find out when the link is done without blocking.
+        // The flush makes sure the fence actually reaches the driver
+        _workerCurrentShader->_compileFence = GL_CALL(glad_glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+        GL_CALL(glad_glFlush());
+
+        lock.lock();
+        _workerCompiled.push_back(_workerCurrentShader);
+        _workerCurrentShader = nullptr;
+        _workerCondition.notify_all();
+    }
+    lock.unlock();
+
+    glfwMakeContextCurrent(NULL);
+}
+void ShaderCompiler::CollectWorkerResults()
+{
+    if(!isUsingWorkerThread())
+        return;
+
+    std::lock_guard<std::mutex> lock(_workerMutex);
+    _pendingShaders.insert(_pendingShaders.end(), _workerCompiled.begin(), _workerCompiled.end());
+    _workerCompiled.clear();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+
+#include "misc/singleton.hpp"
+#include "shader.hpp"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+Keeps track of the shaders that are still being compiled and finishes them once the driver is done.
+
+If the driver supports KHR_parallel_shader_compile, the compiles are submitted straight away
+and the completion status is polled every frame.
+Otherwise the compiles are handed off to a worker thread with its own context that shares objects
+with the main one, and the main thread waits for the fence the worker inserts after each link.
+*/
+class ShaderCompiler final : public Singleton<ShaderCompiler>
+{
+    friend class Singleton<ShaderCompiler>;
+
+    private:
+    // Shaders that were submitted and whose results haven't been checked yet
+    std::vector<Shader*> _pendingShaders;
+
+    // Worker context fallback
+    GLFWwindow *_workerContext = nullptr;
+    std::thread _workerThread;
+    std::mutex _workerMutex;
+    std::condition_variable _workerCondition;
+    std::deque<Shader*> _workerQueue;      // Waiting to be compiled by the worker
+    std::vector<Shader*> _workerCompiled;  // Compiled by the worker, waiting for the main thread to pick them up
+    Shader *_workerCurrentShader = nullptr;
+    bool _workerRunning = false;
+
+    private:
+    ShaderCompiler() = default;
+    ~ShaderCompiler() = default;
+
+    public:
+    // Spawns the worker context if the driver can't compile in parallel on its own.
+    // Has to be called from the main thread after the main window's context has been created
+    void Init(GLFWwindow* const mainWindow);
+    void DeInit();
+
+    inline bool isUsingWorkerThread() const { return _workerContext != nullptr; }
+    inline size_t getNumOfPendingShaders() const { return _pendingShaders.size(); }
+
+    // Submits the compile of the shader. Called by the Shader constructor
+    void Submit(Shader *shader);
+    // Forgets about the shader if it's still pending. Called by the Shader destructor
+    void Cancel(Shader *shader);
+
+    // Finishes every pending shader whose compile is done without blocking. Called once per frame
+    void Update();
+    // Blocks until the given shader is usable (or failed to compile)
+    void WaitFor(Shader *shader);
+
+    private:
+    void WorkerLoop();
+    // Moves the shaders compiled by the worker into the list of pending shaders
+    void CollectWorkerResults();
+};
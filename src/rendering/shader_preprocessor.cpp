@@ -0,0 +1,229 @@
+#include "shader_preprocessor.hpp"
+
+#include "core/log.hpp"
+#include "core/resource_manager.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+struct ShaderPreprocessor::State
+{
+    // Every macro defined at the current point, both injected and defined by the source itself
+    ShaderDefines defines;
+    ShaderDefines injectedDefines;
+    std::set<std::string> definedInSource;
+    std::set<std::string> testedMacros;
+
+    std::vector<std::string> files;
+    std::ostringstream output;
+};
+
+// One level of #ifdef/#ifndef/#if nesting
+struct ConditionalBlock
+{
+    bool parentActive;
+    bool active;
+    // Whether any branch of the block has been taken so far
+    bool branchTaken;
+    // #if expressions aren't evaluated here, the whole block is passed on to the GLSL compiler
+    bool passthrough;
+};
+
+static std::string TrimLeft(const std::string &string)
+{
+    size_t start = string.find_first_not_of(" \t");
+    return start == std::string::npos ? "" : string.substr(start);
+}
+static std::string GetDirectory(const std::string &path)
+{
+    size_t lastSlash = path.find_last_of("/\\");
+    return lastSlash == std::string::npos ? "" : path.substr(0, lastSlash + 1);
+}
+
+PreprocessedShader ShaderPreprocessor::ProcessFile(const std::string &path, const ShaderDefines &defines)
+{
+    PreprocessedShader result;
+
+    State state;
+    state.defines = defines;
+    state.injectedDefines = defines;
+
+    std::string source = ResourceManager::ReadFile(path);
+    if(source.empty())
+        return result;
+
+    // Without a #version directive the defines can simply go first
+    if(source.find("#version") == std::string::npos)
+    {
+        for(const auto &define: defines)
+            state.output << "#define " << define.first << " " << define.second << '\n';
+        state.output << "#line 1 0\n";
+    }
+
+    state.files.push_back(path);
+    result.success = ProcessSource(source, path, state, true);
+    result.source = state.output.str();
+    result.files = state.files;
+
+    // Macros the source defines for itself (eg. include guards or fixed features) can't be toggled from the outside
+    for(const std::string &macro: state.testedMacros)
+    {
+        if(state.definedInSource.count(macro) == 0 && macro.compare(0, 3, "GL_") != 0)
+            result.keywords.insert(macro);
+    }
+
+    return result;
+}
+
+std::string ShaderPreprocessor::GetDefinesKey(const ShaderDefines &defines)
+{
+    std::string key;
+    for(const auto &define: defines)
+    {
+        if(!key.empty())
+            key += ";";
+        key += define.first;
+        if(!define.second.empty())
+            key += "=" + define.second;
+    }
+    return key;
+}
+
+bool ShaderPreprocessor::ProcessSource(const std::string &source, const std::string &path, State &state, bool isRoot)
+{
+    const std::string directory = GetDirectory(path);
+    // GLSL #line directives identify files by number rather than by name
+    const size_t fileIndex = state.files.size() - 1;
+
+    std::vector<ConditionalBlock> conditionals;
+    auto isActive = [&]() { return conditionals.empty() || conditionals.back().active; };
+
+    std::istringstream stream(source);
+    std::string line;
+    int lineNumber = 0;
+    bool injectedDefines = false;
+    while(std::getline(stream, line))
+    {
+        lineNumber++;
+
+        std::string trimmedLine = TrimLeft(line);
+        if(trimmedLine.empty() || trimmedLine[0] != '#')
+        {
+            if(isActive())
+                state.output << line << '\n';
+            continue;
+        }
+
+        // Split the directive into its name and the rest of the line
+        std::istringstream directiveStream(TrimLeft(trimmedLine.substr(1)));
+        std::string directive, argument;
+        directiveStream >> directive >> argument;
+
+        if(directive == "ifdef" || directive == "ifndef")
+        {
+            state.testedMacros.insert(argument);
+            bool isDefined = state.defines.count(argument) != 0;
+            bool condition = directive == "ifdef" ? isDefined : !isDefined;
+            conditionals.push_back({isActive(), isActive() && condition, condition, false});
+        }
+        else if(directive == "if")
+        {
+            conditionals.push_back({isActive(), isActive(), true, true});
+            if(isActive())
+                state.output << line << '\n';
+        }
+        else if(directive == "elif" || directive == "else" || directive == "endif")
+        {
+            if(conditionals.empty())
+            {
+                Log::LogError("Shader preprocessor: #" + directive + " without a matching #if in " + path + ":" + std::to_string(lineNumber));
+                return false;
+            }
+
+            ConditionalBlock &block = conditionals.back();
+            if(block.passthrough)
+            {
+                if(block.parentActive)
+                    state.output << line << '\n';
+            }
+            else if(directive == "elif")
+            {
+                Log::LogWarning("Shader preprocessor: #elif isn't supported after #ifdef/#ifndef, treating the branch as inactive in " + path + ":" + std::to_string(lineNumber));
+                block.active = false;
+            }
+            else if(directive == "else")
+            {
+                block.active = block.parentActive && !block.branchTaken;
+                block.branchTaken = true;
+            }
+
+            if(directive == "endif")
+                conditionals.pop_back();
+        }
+        else if(!isActive())
+        {
+            continue;
+        }
+        else if(directive == "include")
+        {
+            // Strip the quotes or angle brackets around the path
+            std::string includePath = argument.size() > 2 ? argument.substr(1, argument.size() - 2) : "";
+            includePath = directory + includePath;
+
+            // Every file gets included at most once, which makes include guards unnecessary
+            if(std::find(state.files.begin(), state.files.end(), includePath) != state.files.end())
+                continue;
+
+            std::string includeSource = ResourceManager::ReadFile(includePath);
+            if(includeSource.empty())
+            {
+                Log::LogError("Shader preprocessor: couldn't include '" + includePath + "' in " + path + ":" + std::to_string(lineNumber));
+                return false;
+            }
+
+            state.files.push_back(includePath);
+            state.output << "#line 1 " << state.files.size() - 1 << '\n';
+            if(!ProcessSource(includeSource, includePath, state, false))
+                return false;
+            state.output << "#line " << lineNumber + 1 << " " << fileIndex << '\n';
+        }
+        else if(directive == "pragma" && argument == "once")
+        {
+            continue;
+        }
+        else
+        {
+            if(directive == "define")
+            {
+                std::string value;
+                std::getline(directiveStream, value);
+                state.defines[argument] = TrimLeft(value);
+                if(state.injectedDefines.count(argument) == 0)
+                    state.definedInSource.insert(argument);
+            }
+            else if(directive == "undef")
+            {
+                state.defines.erase(argument);
+            }
+
+            state.output << line << '\n';
+
+            // The injected defines have to come right after #version because nothing but comments may precede it
+            if(directive == "version" && isRoot && !injectedDefines)
+            {
+                for(const auto &define: state.injectedDefines)
+                    state.output << "#define " << define.first << " " << define.second << '\n';
+                state.output << "#line " << lineNumber + 1 << " " << fileIndex << '\n';
+                injectedDefines = true;
+            }
+        }
+    }
+
+    if(!conditionals.empty())
+    {
+        Log::LogError("Shader preprocessor: unterminated #ifdef/#ifndef/#if in " + path);
+        return false;
+    }
+
+    return true;
+}
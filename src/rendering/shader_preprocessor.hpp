@@ -0,0 +1,42 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Macro name -> value. Ordered so that the same set of defines always produces the same key
+using ShaderDefines = std::map<std::string, std::string>;
+
+struct PreprocessedShader final
+{
+    bool success = false;
+    std::string source;
+    // Macros the shader checks with #ifdef/#ifndef but doesn't define itself,
+    // ie. the features that can be toggled by injecting defines
+    std::set<std::string> keywords;
+    // Every file the source was assembled from, including the root file
+    std::vector<std::string> files;
+};
+
+/*
+Resolves #include "file" directives (relative to the including file), injects defines right after #version
+and strips the #ifdef/#ifndef/#else/#endif branches that aren't active.
+Stripping the inactive branches matters because the uniforms are parsed straight from the resulting source.
+#if expressions are left for the GLSL compiler to evaluate.
+*/
+class ShaderPreprocessor final
+{
+    private:
+    ShaderPreprocessor() {}
+    ~ShaderPreprocessor() {}
+
+    public:
+    static PreprocessedShader ProcessFile(const std::string &path, const ShaderDefines &defines = {});
+    // Returns a string that uniquely identifies the set of defines, eg. "LIT;TEXTURED=1"
+    static std::string GetDefinesKey(const ShaderDefines &defines);
+
+    private:
+    struct State;
+    static bool ProcessSource(const std::string &source, const std::string &path, State &state, bool isRoot);
+};
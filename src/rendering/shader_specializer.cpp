@@ -0,0 +1,255 @@
+#include "shader_specializer.hpp"
+
+#include "core/log.hpp"
+#include "misc/utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <sstream>
+
+const Shader *ShaderSpecializer::Update(const Shader *shader, unsigned int frameThreshold)
+{
+    if(shader == nullptr || !shader->isReady())
+        return shader;
+
+    ShaderSpecialization &specialization = _specializations[shader];
+    const std::vector<ShaderUniform*> &uniforms = shader->getUniforms();
+    if(specialization.valueSnapshots.size() != uniforms.size())
+    {
+        specialization.valueSnapshots.assign(uniforms.size(), {});
+        specialization.framesUnchanged.assign(uniforms.size(), 0);
+    }
+
+    // Compare every uniform against its value from the last frame
+    bool bakedUniformChanged = false;
+    std::vector<const ShaderUniform*> staticUniforms;
+    for(size_t i = 0; i < uniforms.size(); i++)
+    {
+        const ShaderUniform &uniform = *uniforms[i];
+        // Samplers can't be turned into constants
+        const size_t valueSize = uniform.getValueSize();
+        if(valueSize == 0 || uniform.value == nullptr)
+            continue;
+        if(std::find(_perDrawUniforms.begin(), _perDrawUniforms.end(), uniform.getName()) != _perDrawUniforms.end())
+            continue;
+
+        const unsigned char *value = (const unsigned char*)uniform.value;
+        std::vector<unsigned char> &snapshot = specialization.valueSnapshots[i];
+        if(snapshot.size() == valueSize && memcmp(snapshot.data(), value, valueSize) == 0)
+        {
+            specialization.framesUnchanged[i]++;
+        }
+        else
+        {
+            snapshot.assign(value, value + valueSize);
+            specialization.framesUnchanged[i] = 0;
+
+            auto &baked = specialization.bakedUniforms;
+            if(std::find(baked.begin(), baked.end(), uniform.getName()) != baked.end())
+                bakedUniformChanged = true;
+            // The new value might compile where the old one didn't
+            auto &failed = specialization.failedUniforms;
+            if(std::find(failed.begin(), failed.end(), uniform.getName()) != failed.end())
+                failed.clear();
+        }
+
+        // NaNs and infinities have no GLSL literal, those stay uniforms
+        if(specialization.framesUnchanged[i] >= frameThreshold && HasFiniteValue(uniform))
+            staticUniforms.push_back(&uniform);
+    }
+
+    // Any edit of a baked uniform makes the specialization useless, go back to the generic program right away
+    if(bakedUniformChanged)
+    {
+        delete specialization.program;
+        specialization.program = nullptr;
+        specialization.bakedUniforms.clear();
+    }
+
+    // A program that failed to compile is thrown away, the set it baked in isn't tried again until one of its values changes
+    if(specialization.program != nullptr && specialization.program->getStatus() == ShaderStatus::FAILED)
+    {
+        delete specialization.program;
+        specialization.program = nullptr;
+        specialization.failedUniforms = std::move(specialization.bakedUniforms);
+        specialization.bakedUniforms.clear();
+    }
+
+    // Specialize (again) once more uniforms have settled than the current specialization has baked in.
+    // A program that is still compiling is left alone
+    const bool isCompiling = specialization.program != nullptr && !specialization.program->isReady();
+    if(!isCompiling && staticUniforms.size() > specialization.bakedUniforms.size())
+    {
+        std::vector<std::string> uniformsToBake;
+        for(const ShaderUniform *uniform: staticUniforms)
+            uniformsToBake.push_back(uniform->getName());
+
+        if(uniformsToBake != specialization.failedUniforms)
+        {
+            delete specialization.program;
+            specialization.program = CreateSpecialization(*shader, staticUniforms);
+            specialization.bakedUniforms = std::move(uniformsToBake);
+        }
+    }
+
+    if(specialization.program != nullptr && specialization.program->isReady())
+        return specialization.program;
+    return shader;
+}
+
+void ShaderSpecializer::Reset()
+{
+    for(auto &specialization: _specializations)
+        delete specialization.second.program;
+    _specializations.clear();
+}
+
+void ShaderSpecializer::SetPerDrawUniforms(const std::vector<std::string> &names)
+{
+    _perDrawUniforms = names;
+    // A specialization may have baked in one of them already
+    Reset();
+}
+
+void ShaderSpecializer::Invalidate(const Shader *shader)
+{
+    auto specialization = _specializations.find(shader);
+    if(specialization == _specializations.end())
+        return;
+
+    delete specialization->second.program;
+    _specializations.erase(specialization);
+}
+
+bool ShaderSpecializer::IsSpecialized(const Shader *shader) const
+{
+    auto specialization = _specializations.find(shader);
+    return specialization != _specializations.end() && specialization->second.program != nullptr && specialization->second.program->isReady();
+}
+
+Shader *ShaderSpecializer::CreateSpecialization(const Shader &shader, const std::vector<const ShaderUniform*> &uniformsToBake)
+{
+    std::string vertSource = BakeUniforms(shader.getVertSource(), uniformsToBake);
+    std::string fragSource = BakeUniforms(shader.getFragSource(), uniformsToBake);
+
+    // Compiled in the background by the ShaderCompiler like any other shader
+    Shader *specialization = new Shader(vertSource.c_str(), fragSource.c_str());
+    specialization->setVariantInfo(shader.getName(), shader.getDefines(), {});
+
+    Log::LogInfo("Specializing shader '" + shader.getName() + "' with " + std::to_string(uniformsToBake.size()) + " uniform(s) baked in");
+    return specialization;
+}
+
+bool ShaderSpecializer::HasFiniteValue(const ShaderUniform &uniform)
+{
+    switch(uniform.getType())
+    {
+        case ShaderUniformType::FLOAT:
+        case ShaderUniformType::VEC2:
+        case ShaderUniformType::VEC3:
+        case ShaderUniformType::VEC4:
+        case ShaderUniformType::MAT2:
+        case ShaderUniformType::MAT3:
+        case ShaderUniformType::MAT4:
+        {
+            const float *values = (const float*)uniform.value;
+            const size_t numOfValues = uniform.getValueSize() / sizeof(float);
+            for(size_t i = 0; i < numOfValues; i++)
+            {
+                if(!std::isfinite(values[i]))
+                    return false;
+            }
+            return true;
+        }
+
+        default:
+            return true;
+    }
+}
+
+std::string ShaderSpecializer::GetValueLiteral(const ShaderUniform &uniform)
+{
+    // Enough digits for a float to survive the round trip through text. Only ever called with finite values
+    auto floatLiteral = [](float value)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.9g", value);
+        std::string literal = buffer;
+        if(literal.find_first_of(".eE") == std::string::npos)
+            literal += ".0";
+        return literal;
+    };
+    auto floatsLiteral = [&](const char *type, int count)
+    {
+        const float *values = (const float*)uniform.value;
+        std::string literal = std::string(type) + "(";
+        for(int i = 0; i < count; i++)
+        {
+            if(i != 0)
+                literal += ", ";
+            literal += floatLiteral(values[i]);
+        }
+        return literal + ")";
+    };
+
+    switch(uniform.getType())
+    {
+        case ShaderUniformType::INT:
+            return std::to_string(*(int*)uniform.value);
+        case ShaderUniformType::UINT:
+            return std::to_string(*(unsigned int*)uniform.value) + "u";
+        case ShaderUniformType::BOOL:
+            // Same interpretation as the checkbox widget that edits it
+            return *(bool*)uniform.value ? "true" : "false";
+        case ShaderUniformType::FLOAT:
+            return floatLiteral(*(float*)uniform.value);
+
+        case ShaderUniformType::VEC2:
+            return floatsLiteral("vec2", 2);
+        case ShaderUniformType::VEC3:
+            return floatsLiteral("vec3", 3);
+        case ShaderUniformType::VEC4:
+            return floatsLiteral("vec4", 4);
+
+        // Both GL and the GLSL constructors are column-major, so the values go in as stored
+        case ShaderUniformType::MAT2:
+            return floatsLiteral("mat2", 2 * 2);
+        case ShaderUniformType::MAT3:
+            return floatsLiteral("mat3", 3 * 3);
+        case ShaderUniformType::MAT4:
+            return floatsLiteral("mat4", 4 * 4);
+
+        default:
+            return "";
+    }
+}
+
+std::string ShaderSpecializer::BakeUniforms(const std::string &source, const std::vector<const ShaderUniform*> &uniformsToBake)
+{
+    std::ostringstream bakedSource;
+    std::istringstream stream(source);
+    std::string line;
+    while(std::getline(stream, line))
+    {
+        // Same declaration format the uniform parser expects: uniform type name (= default_value);
+        auto splitLine = SplitString(line, ' ');
+        if(splitLine.size() >= 3 && splitLine[0] == "uniform")
+        {
+            std::string name = splitLine[2];
+            if(!name.empty() && name.back() == ';')
+                name.pop_back();
+
+            auto uniform = std::find_if(uniformsToBake.begin(), uniformsToBake.end(), [&](const ShaderUniform *uniform) { return uniform->getName() == name; });
+            if(uniform != uniformsToBake.end())
+            {
+                bakedSource << "const " << splitLine[1] << " " << name << " = " << GetValueLiteral(**uniform) << ";\n";
+                continue;
+            }
+        }
+
+        bakedSource << line << '\n';
+    }
+    return bakedSource.str();
+}
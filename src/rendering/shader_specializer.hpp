@@ -0,0 +1,61 @@
+#pragma once
+
+#include "misc/singleton.hpp"
+#include "shader.hpp"
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+struct ShaderSpecialization final
+{
+    // The value of every uniform as of the last frame and for how many frames it hasn't changed
+    std::vector<std::vector<unsigned char>> valueSnapshots;
+    std::vector<unsigned int> framesUnchanged;
+
+    // The program with the static uniforms baked in as constants. Only drawn with once it's ready
+    Shader *program = nullptr;
+    std::vector<std::string> bakedUniforms;
+    // The uniforms the last program that failed to compile had baked in
+    std::vector<std::string> failedUniforms;
+};
+
+/*
+Watches the uniform values of the shaders that get drawn. Once some of them haven't changed for a given number of frames,
+a program with those uniforms turned into constants gets compiled in the background so that the compiler can fold them.
+As soon as one of the baked uniforms changes, drawing falls back to the generic program.
+*/
+class ShaderSpecializer final : public Singleton<ShaderSpecializer>
+{
+    friend class Singleton<ShaderSpecializer>;
+
+    private:
+    std::unordered_map<const Shader*, ShaderSpecialization> _specializations;
+    // Uniforms that get set anew for every draw, what they hold at the end of a frame says nothing about the other draws
+    std::vector<std::string> _perDrawUniforms;
+
+    private:
+    ShaderSpecializer() = default;
+    ~ShaderSpecializer() = default;
+
+    public:
+    // Tracks the shader's uniforms for this frame and returns the program it should be drawn with,
+    // which is either the shader itself or its specialization
+    const Shader *Update(const Shader *shader, unsigned int frameThreshold);
+    // Throws away every specialization and the tracked uniform history
+    void Reset();
+    // The uniforms that never get baked in, however long they stay unchanged
+    void SetPerDrawUniforms(const std::vector<std::string> &names);
+    // Throws away the specialization of a single shader, eg. because its program was replaced
+    void Invalidate(const Shader *shader);
+
+    bool IsSpecialized(const Shader *shader) const;
+
+    private:
+    static Shader *CreateSpecialization(const Shader &shader, const std::vector<const ShaderUniform*> &uniformsToBake);
+    // False if any of the uniform's float components is a NaN or infinity
+    static bool HasFiniteValue(const ShaderUniform &uniform);
+    // Returns the GLSL constant expression of the uniform's current value, eg. "vec3(1.0, 0.5, 0.25)"
+    static std::string GetValueLiteral(const ShaderUniform &uniform);
+    static std::string BakeUniforms(const std::string &source, const std::vector<const ShaderUniform*> &uniformsToBake);
+};
@@ -66,6 +66,50 @@ ShaderUniform& ShaderUniform::operator=(ShaderUniform&& other)
     return *this;
 }
 
+size_t ShaderUniform::getValueSize() const
+{
+    switch(_type)
+    {
+        case ShaderUniformType::INT:
+        case ShaderUniformType::UINT:
+        case ShaderUniformType::BOOL:
+        case ShaderUniformType::FLOAT:
+            return 4;
+
+        case ShaderUniformType::VEC2:
+            return 2 * sizeof(float);
+        case ShaderUniformType::VEC3:
+            return 3 * sizeof(float);
+        case ShaderUniformType::VEC4:
+            return 4 * sizeof(float);
+
+        case ShaderUniformType::MAT2:
+            return 2 * 2 * sizeof(float);
+        case ShaderUniformType::MAT3:
+            return 3 * 3 * sizeof(float);
+        case ShaderUniformType::MAT4:
+            return 4 * 4 * sizeof(float);
+
+        default:
+            return 0;
+    }
+}
+
+void ShaderUniform::CopyValue(const ShaderUniform &other)
+{
+    if(other._type != _type || other.value == nullptr || this->value == nullptr)
+        return;
+
+    CopyValuePtr(other.value);
+}
+
+Texture *ShaderUniform::GetEmptyTexture()
+{
+    // Never deleted, it doesn't have a GL object and would otherwise outlive the context
+    static Texture *emptyTexture = new Texture();
+    return emptyTexture;
+}
+
 void ShaderUniform::CopyValuePtr(void* const src)
 {
     switch(_type)
@@ -107,8 +151,9 @@ void ShaderUniform::CopyValuePtr(void* const src)
             memcpy(this->value, src, 4 * 4 * sizeof(float));
         break;
 
+        // The texture itself is shared
         case ShaderUniformType::TEX2D:
-            memcpy(this->value, src, sizeof(Texture));
+            this->value = src;
         break;
     }
 }
@@ -138,8 +183,9 @@ void ShaderUniform::DeleteValuePtr()
             delete((float*)this->value);
         break;
 
+        // Textures belong to the resource manager (or are the empty one), never to the uniform
         case ShaderUniformType::TEX2D:
-            delete((Texture*)this->value);
+            this->value = nullptr;
         break;
     }
 }
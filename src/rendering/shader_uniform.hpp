@@ -5,6 +5,8 @@
 
 #include <string>
 
+class Texture;
+
 enum class ShaderUniformType
 {
     UNDEFINED = 0,
@@ -33,6 +35,7 @@ struct ShaderUniform final
     std::string _name = "";
     ShaderUniformType _type = ShaderUniformType::UNDEFINED;
     public:
+    // Owned by the uniform, except for textures which it only points to
     void* value = nullptr;
 
     public: 
@@ -49,6 +52,16 @@ struct ShaderUniform final
     inline const std::string &getName()       const { return _name; }
     inline const ShaderUniformType &getType() const { return _type; }
 
+    // The size of the value in bytes. Textures aren't stored by value so their size is 0
+    size_t getValueSize() const;
+
+    // Copies the value of another uniform of the same type into this one.
+    // Textures are shared rather than copied
+    void CopyValue(const ShaderUniform &other);
+
+    // What texture uniforms point to until a texture gets picked for them
+    static Texture *GetEmptyTexture();
+
     private:
     // Util func: Handles casting the pointer to the appropriate type before copying
     void CopyValuePtr(void* const src);
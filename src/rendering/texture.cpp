@@ -1,10 +1,26 @@
 #include "texture.hpp"
 
 #include "core/log.hpp"
+#include "gl_state.hpp"
+#include "render_counters.hpp"
 
 #include <glad/glad.h>
+#include <stb/stb_image.h>
 #include <cstring>
 
+// The size of the image data handed to glTexImage2D, which is always made of unsigned bytes
+static size_t GetImageDataSize(glm::uvec2 size, int format)
+{
+    size_t numOfChannels = 4;
+    switch(format)
+    {
+        case GL_RED: numOfChannels = 1; break;
+        case GL_RG:  numOfChannels = 2; break;
+        case GL_RGB: numOfChannels = 3; break;
+    }
+    return (size_t)size.x * size.y * numOfChannels;
+}
+
 Texture::Texture(): _id(0), _target(0), _imageUnit(0), _size(glm::vec2(0.0f)), _internalFormat(0), _format(0), data(nullptr) {}
 Texture::Texture(int target, glm::uvec2 size, int internalFormat, int format, void* const data, int imageUnit)
     : _id(0), _target(target), _imageUnit(0), _size(size), _internalFormat(internalFormat), _format(format)
@@ -18,12 +34,15 @@ Texture::Texture(int target, glm::uvec2 size, int internalFormat, int format, vo
     GL_CALL(glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
     GL_CALL(glad_glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
     GL_CALL(glad_glTexImage2D(_target, 0, _internalFormat, _size.x, _size.y, 0, _format, GL_UNSIGNED_BYTE, data));
+    if(data != nullptr)
+        RenderCounters::getInstance().CountTextureUpload(GetImageDataSize(_size, _format));
     Unbind();
 }
 Texture::~Texture()
 {
-
+    FreeData();
     GL_CALL(glad_glDeleteTextures(1, &_id));
+    GLState::getInstance().OnTextureDeleted(_id);
 } 
 
 // Copy
@@ -55,6 +74,8 @@ Texture::Texture(Texture&& other)
 {
     this->data = other.data;
     other.data = nullptr;
+    this->_ownsData = other._ownsData;
+    other._ownsData = false;
 
     this->_id             = std::move(other._id);
     this->_target         = std::move(other._target);
@@ -65,8 +86,11 @@ Texture::Texture(Texture&& other)
 }
 Texture& Texture::operator=(Texture&& other)
 {
+    FreeData();
     this->data = other.data;
     other.data = nullptr;
+    this->_ownsData = other._ownsData;
+    other._ownsData = false;
 
     this->_id             = std::move(other._id);
     this->_target         = std::move(other._target);
@@ -80,9 +104,33 @@ Texture& Texture::operator=(Texture&& other)
 
 void Texture::Bind() const
 {
-    GL_CALL(glad_glBindTexture(_target, _id));
+    GLState::getInstance().BindTexture(_target, _id);
 }
 void Texture::Unbind() const
 {
-    GL_CALL(glad_glBindTexture(_target, 0));
-}
\ No newline at end of file
+#ifdef GL_STATE_VALIDATION
+    GLState::getInstance().BindTexture(_target, 0);
+#endif
+}
+
+void Texture::UpdateData(glm::uvec2 size, void* const data, bool ownsData)
+{
+    FreeData();
+    this->data = const_cast<void*>(data);
+    _ownsData = ownsData;
+    _size = size;
+
+    Bind();
+    GL_CALL(glad_glTexImage2D(_target, 0, _internalFormat, _size.x, _size.y, 0, _format, GL_UNSIGNED_BYTE, data));
+    if(data != nullptr)
+        RenderCounters::getInstance().CountTextureUpload(GetImageDataSize(_size, _format));
+    Unbind();
+}
+
+void Texture::FreeData()
+{
+    if(_ownsData)
+        stbi_image_free(data);
+    data = nullptr;
+    _ownsData = false;
+}
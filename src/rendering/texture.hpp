@@ -14,6 +14,8 @@ class Texture final
     glm::uvec2 _size;
     int _internalFormat;
     int _format;
+    // Whether the data was decoded by stb_image for the texture alone, in which case the texture frees it
+    bool _ownsData = false;
     
     public:
     // TODO: Adjustable tex params
@@ -36,7 +38,16 @@ class Texture final
     inline const int          &getFormat()           const { return _format; }
 
     inline void               setTextureImageUnit(int imageUnit) { _imageUnit = imageUnit; }
+    // Makes the texture free its data with stbi_image_free once it's replaced or the texture is deleted
+    inline void               setOwnsData(bool ownsData) { _ownsData = ownsData; }
 
     void Bind() const;
     void Unbind() const;
+
+    // Uploads new image data into the existing texture object so that its ID stays the same.
+    // The previous data gets freed if the texture owned it, the new data is owned if ownsData is set
+    void UpdateData(glm::uvec2 size, void* const data, bool ownsData = false);
+
+    private:
+    void FreeData();
 };
\ No newline at end of file